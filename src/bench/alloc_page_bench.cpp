@@ -0,0 +1,67 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Pages allocated per second through BufMgr::allocPage().
+ *
+ * Fills a new file with <pages> pages, each allocated through the pool,
+ * given a record and unpinned dirty, then flushes the file; the time includes
+ * the flush, so every page is on disk when the clock stops.  The pool either
+ * holds the whole file, so pages are written only by the flush, or 64 frames,
+ * so most are written back as they are evicted.  Each is run on a backend
+ * without latency and on one with <latency_us> per operation.
+ *
+ * Usage: alloc_page_bench [pages] [latency_us]
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+double run(const PageId pages, const std::uint32_t frames,
+           const int latency_us) {
+  std::shared_ptr<bench::SlowBackend> disk(new bench::SlowBackend);
+  File file = File::create("alloc_page_bench", disk);
+  disk->setLatency(latency_us);
+  BufMgr bufMgr(frames);
+  const std::string record(100, 'a');
+  bench::Timer timer;
+  for (PageId i = 0; i < pages; ++i) {
+    PageId page_number;
+    Page* page;
+    bufMgr.allocPage(&file, page_number, page);
+    page->insertRecord(record);
+    bufMgr.unPinPage(&file, page_number, true);
+  }
+  bufMgr.flushFile(&file);
+  return pages / timer.seconds();
+}
+
+}
+
+int main(int argc, char** argv) {
+  const PageId pages = bench::argOr(argc, argv, 1, 2000);
+  const int latency_us = bench::argOr(argc, argv, 2, 20);
+
+  std::printf("pages=%u\n", pages);
+  const std::uint32_t frames[] = {pages + 1, 64};
+  const int latencies[] = {0, latency_us};
+  for (int f = 0; f < 2; ++f) {
+    for (int l = 0; l < 2; ++l) {
+      std::printf("frames=%-6u latency=%3d us %10.0f pages/s\n", frames[f],
+                  latencies[l], run(pages, frames[f], latencies[l]));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Read throughput of blocking readPage() threads against readPageAsync()
+ * with many reads in flight on a few event loop threads.
+ *
+ * Pages are read uniformly from files four times larger than the pool, so
+ * most reads miss.  The files sit on an in-memory backend that sleeps like a
+ * device would.  Every read goes through one IoScheduler, which merges reads
+ * of adjacent pages, so the more reads are in flight the fewer operations
+ * the device sees.
+ *
+ * Usage: async_read_bench [reads] [latency_us]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "event_loop.h"
+#include "io_scheduler.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const int NUM_FILES = 8;
+const PageId PAGES_PER_FILE = 1024;
+const std::uint32_t FRAMES = NUM_FILES * PAGES_PER_FILE / 4;
+
+/**
+ * Picks pages with a per-lane linear congruential generator.
+ */
+struct PageChooser {
+  std::uint64_t state;
+
+  explicit PageChooser(const std::uint64_t seed) : state(seed * 2 + 1) {}
+
+  void next(int& file, PageId& page_number) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const std::uint64_t pick = state >> 33;
+    file = pick % NUM_FILES;
+    page_number = 1 + (pick / NUM_FILES) % PAGES_PER_FILE;
+  }
+};
+
+/**
+ * Keeps <lanes> reads in flight until <total> have completed.
+ */
+class AsyncDriver {
+ public:
+  AsyncDriver(BufMgr& buf_mgr, std::vector<File>& files, EventLoop& loop,
+              const long total)
+      : buf_mgr_(buf_mgr), files_(files), loop_(loop), total_(total),
+        issued_(0), completed_(0) {}
+
+  void start(const int lanes) {
+    for (int lane = 0; lane < lanes; ++lane) {
+      choosers_.push_back(PageChooser(lane));
+    }
+    for (int lane = 0; lane < lanes; ++lane) {
+      loop_.post([this, lane] { issue(lane); });
+    }
+  }
+
+ private:
+  void issue(const int lane) {
+    if (issued_++ >= total_) {
+      return;
+    }
+    int f;
+    PageId page_number;
+    choosers_[lane].next(f, page_number);
+    File* file = &files_[f];
+    buf_mgr_.readPageAsync(
+        file, page_number, loop_,
+        [this, lane, file, page_number](Page*, std::exception_ptr error) {
+          if (error) {
+            std::rethrow_exception(error);
+          }
+          buf_mgr_.unPinPage(file, page_number, false);
+          if (++completed_ == total_) {
+            loop_.stop();
+          }
+          // Posted rather than called, so hits do not recurse.
+          loop_.post([this, lane] { issue(lane); });
+        });
+  }
+
+  BufMgr& buf_mgr_;
+  std::vector<File>& files_;
+  EventLoop& loop_;
+  const long total_;
+  std::vector<PageChooser> choosers_;
+  std::atomic<long> issued_;
+  std::atomic<long> completed_;
+};
+
+double runBlocking(BufMgr& buf_mgr, std::vector<File>& files,
+                   const long reads, const int threads) {
+  bench::Timer timer;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&, t] {
+      PageChooser chooser(t);
+      for (long i = t; i < reads; i += threads) {
+        int f;
+        PageId page_number;
+        chooser.next(f, page_number);
+        Page* page;
+        buf_mgr.readPage(&files[f], page_number, page);
+        buf_mgr.unPinPage(&files[f], page_number, false);
+      }
+    }));
+  }
+  for (std::size_t t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
+  return reads / timer.seconds();
+}
+
+double runAsync(BufMgr& buf_mgr, std::vector<File>& files, const long reads,
+                const int threads, const int in_flight) {
+  EventLoop loop;
+  AsyncDriver driver(buf_mgr, files, loop, reads);
+  bench::Timer timer;
+  driver.start(in_flight);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&loop] { loop.run(); }));
+  }
+  for (std::size_t t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
+  return reads / timer.seconds();
+}
+
+/**
+ * Empties the pool so every configuration starts cold.
+ */
+void evictAll(BufMgr& buf_mgr, std::vector<File>& files) {
+  for (std::size_t f = 0; f < files.size(); ++f) {
+    buf_mgr.flushFile(&files[f]);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long reads = bench::argOr(argc, argv, 1, 20000);
+  const int latency_us = bench::argOr(argc, argv, 2, 50);
+
+  std::vector<std::shared_ptr<bench::SlowBackend> > disks;
+  std::vector<File> files;
+  for (int f = 0; f < NUM_FILES; ++f) {
+    std::stringstream name;
+    name << "async_read_bench." << f;
+    disks.push_back(std::make_shared<bench::SlowBackend>());
+    files.push_back(File::create(name.str(), disks.back()));
+    for (PageId p = 0; p < PAGES_PER_FILE; ++p) {
+      files.back().allocatePage();
+    }
+    disks.back()->setLatency(latency_us);
+  }
+
+  std::printf("reads=%ld pages=%u frames=%u latency=%dus+%dus/page\n", reads,
+              NUM_FILES * PAGES_PER_FILE, FRAMES, latency_us,
+              bench::SlowBackend::PAGE_TRANSFER_US);
+  IoScheduler scheduler;
+  BufMgr buf_mgr(FRAMES, 0, &scheduler);
+  const int thread_counts[] = {1, 4, 16};
+  for (int i = 0; i < 3; ++i) {
+    evictAll(buf_mgr, files);
+    const IoClassStats before = scheduler.getStats(IO_FOREGROUND);
+    const double rate = runBlocking(buf_mgr, files, reads, thread_counts[i]);
+    const IoClassStats after = scheduler.getStats(IO_FOREGROUND);
+    std::printf("readPage      threads=%-2d                %8.0f reads/s "
+                "%5.2f pages/op\n",
+                thread_counts[i], rate,
+                double(after.pages - before.pages) /
+                    (after.batches - before.batches));
+  }
+  const int in_flight[] = {1, 16, 256, 1024};
+  for (int threads = 1; threads <= 2; ++threads) {
+    for (int i = 0; i < 4; ++i) {
+      evictAll(buf_mgr, files);
+      const IoClassStats before = scheduler.getStats(IO_FOREGROUND);
+      const double rate =
+          runAsync(buf_mgr, files, reads, threads, in_flight[i]);
+      const IoClassStats after = scheduler.getStats(IO_FOREGROUND);
+      std::printf("readPageAsync threads=%-2d in flight=%-5d %8.0f reads/s "
+                  "%5.2f pages/op\n",
+                  threads, in_flight[i], rate,
+                  double(after.pages - before.pages) /
+                      (after.batches - before.batches));
+    }
+  }
+  for (int f = 0; f < NUM_FILES; ++f) {
+    disks[f]->setLatency(0);
+  }
+  evictAll(buf_mgr, files);
+  return 0;
+}
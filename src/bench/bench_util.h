@@ -0,0 +1,133 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file.h"
+#include "io_backend.h"
+
+namespace badgerdb {
+namespace bench {
+
+/**
+ * @brief Wall clock stopwatch used by the benchmark programs.
+ */
+class Timer {
+ public:
+  Timer() { reset(); }
+
+  /**
+   * Restarts the stopwatch.
+   */
+  void reset() { start_ = std::chrono::steady_clock::now(); }
+
+  /**
+   * Returns the time since the last reset in seconds.
+   */
+  double seconds() const {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count();
+  }
+
+  /**
+   * Returns the time since the last reset in nanoseconds.
+   */
+  double nanos() const { return seconds() * 1e9; }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief MemoryBackend that takes as long as a slow device once given a
+ *        latency: a fixed time per operation plus a transfer time per page.
+ */
+class SlowBackend : public IoBackend {
+ public:
+  /**
+   * Transfer time of one page, on top of the latency per operation.
+   */
+  static const int PAGE_TRANSFER_US = 8;
+
+  SlowBackend() : memory_(new MemoryBackend), latency_us_(0) {}
+
+  /**
+   * Sets the latency of every operation; 0 makes the backend fast again.
+   */
+  void setLatency(const int latency_us) { latency_us_ = latency_us; }
+
+  virtual void read(const std::uint64_t offset, char* buffer,
+                    const std::size_t length) {
+    wait(length);
+    memory_->read(offset, buffer, length);
+  }
+
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length) {
+    wait(length);
+    memory_->write(offset, buffer, length);
+  }
+
+  virtual void flush() { memory_->flush(); }
+  virtual void sync() { memory_->sync(); }
+  virtual std::uint64_t size() { return memory_->size(); }
+
+ private:
+  void wait(const std::size_t length) {
+    const int latency_us = latency_us_;
+    if (latency_us > 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(
+          latency_us + PAGE_TRANSFER_US * length / Page::SIZE));
+    }
+  }
+
+  std::unique_ptr<MemoryBackend> memory_;
+  std::atomic<int> latency_us_;
+};
+
+/**
+ * Returns the <p>-th percentile (0-100) of the samples, sorting them in place.
+ */
+inline double percentile(std::vector<double>& samples, const double p) {
+  if (samples.empty()) {
+    return 0;
+  }
+  std::sort(samples.begin(), samples.end());
+  std::size_t index = static_cast<std::size_t>(p / 100 * samples.size());
+  if (index >= samples.size()) {
+    index = samples.size() - 1;
+  }
+  return samples[index];
+}
+
+/**
+ * Returns argv[index] parsed as an integer, or <fallback> if it is missing.
+ */
+inline long argOr(int argc, char** argv, int index, long fallback) {
+  return index < argc ? std::atol(argv[index]) : fallback;
+}
+
+/**
+ * Deletes the file if it is left over from an earlier run.
+ */
+inline void removeIfExists(const std::string& filename) {
+  if (File::exists(filename)) {
+    File::remove(filename);
+  }
+}
+
+}
+}
@@ -0,0 +1,399 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Randomized multi-threaded stress test and throughput benchmark for BufMgr.
+ *
+ * Several threads share one buffer pool over a set of files and issue a
+ * random mix of operations:
+ *
+ * - read:   pin a random page, check it and unpin it.
+ * - update: pin a page owned by this thread, check it holds the last version
+ *           this thread wrote, write the next version and unpin it dirty.
+ * - hold:   pin several random pages at once, check that pinning a page again
+ *           while it is pinned returns the same frame, then unpin them all.
+ * - flush:  flush a random file; this fails while other threads have pages of
+ *           the file pinned, which is expected and only counted.
+ *
+ * Page p of every file is owned by thread p % threads, and only its owner
+ * changes it, so each owner knows exactly what its pages must contain no
+ * matter how often they are evicted, compressed, flushed and read back.
+ * Other threads only check the page number of the pages they pin, since the
+ * buffer pool does not latch page contents.
+ *
+ * When the threads are done every file is flushed, which fails if any pin was
+ * leaked, and every page is read straight from its file and compared with the
+ * versions the owners wrote.  The exit status is nonzero if any check failed.
+ *
+ * Build with -DBADGERDB_TSAN=ON (or -fsanitize=thread) to run it under
+ * ThreadSanitizer.
+ *
+ * Usage: bufmgr_stress [threads] [frames] [files] [pages_per_file]
+ *                      [ops_per_thread] [read%] [update%] [hold%] [flush%]
+ *                      [compressed_bytes] [disk]
+ *
+ * Files live in memory unless <disk> is 1.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Parameters of one run.
+ */
+struct Config {
+  int threads;
+  std::uint32_t frames;
+  int files;
+  PageId pages_per_file;
+  long ops_per_thread;
+  int read_pct;
+  int update_pct;
+  int hold_pct;
+  int flush_pct;
+  std::size_t compressed_bytes;
+  bool disk;
+};
+
+/**
+ * Number of pages pinned at once by a hold operation.
+ */
+const int HOLD_PAGES = 4;
+
+/**
+ * Counters of one worker thread.
+ */
+struct WorkerStats {
+  long reads;
+  long updates;
+  long holds;
+  long flushes;
+  long buffer_exceeded;
+  long flush_pinned;
+  long failures;
+
+  WorkerStats()
+      : reads(0), updates(0), holds(0), flushes(0), buffer_exceeded(0),
+        flush_pinned(0), failures(0) {}
+};
+
+/**
+ * Slot of the one record every page holds.
+ */
+const SlotId RECORD_SLOT = 1;
+
+/**
+ * Returns the record page <page_number> of file <file_index> holds after its
+ * owner wrote <version>.  Records have a fixed width so updates stay in place.
+ */
+std::string makeRecord(const int file_index, const PageId page_number,
+                       const std::uint32_t version) {
+  char record[64];
+  std::snprintf(record, sizeof(record), "file=%04d page=%08u version=%010u",
+                file_index, page_number, version);
+  return record;
+}
+
+class StressTest {
+ public:
+  StressTest(const Config& config, BufMgr& bufMgr, std::vector<File>& files)
+      : config_(config),
+        bufMgr_(bufMgr),
+        files_(files),
+        versions_(config.threads),
+        stats_(config.threads) {
+    for (int t = 0; t < config.threads; ++t) {
+      versions_[t].assign(files.size() * (config.pages_per_file + 1), 0);
+    }
+  }
+
+  void worker(const int thread_index) {
+    std::mt19937 rng(1000 + thread_index);
+    std::uniform_int_distribution<int> pick_op(0, 99);
+    std::uniform_int_distribution<int> pick_file(0, files_.size() - 1);
+    std::uniform_int_distribution<PageId> pick_page(1, config_.pages_per_file);
+    WorkerStats& stats = stats_[thread_index];
+
+    for (long i = 0; i < config_.ops_per_thread; ++i) {
+      int op = pick_op(rng);
+      const int file_index = pick_file(rng);
+      try {
+        if (op < config_.read_pct) {
+          readOp(file_index, pick_page(rng), stats);
+        } else if ((op -= config_.read_pct) < config_.update_pct) {
+          updateOp(thread_index, file_index, pick_page(rng), stats);
+        } else if ((op -= config_.update_pct) < config_.hold_pct) {
+          holdOp(rng, pick_page, stats);
+        } else if ((op -= config_.hold_pct) < config_.flush_pct) {
+          ++stats.flushes;
+          try {
+            bufMgr_.flushFile(&files_[file_index]);
+          } catch (const PagePinnedException&) {
+            ++stats.flush_pinned;
+          }
+        }
+      } catch (const BufferExceededException&) {
+        ++stats.buffer_exceeded;
+      } catch (BadgerDbException& e) {
+        fail(stats, e.message());
+      }
+    }
+  }
+
+  /**
+   * Flushes every file and checks each page against what its owner wrote.
+   * Returns the number of failed checks, including those of the workers.
+   */
+  long verify() {
+    long failures = 0;
+    for (std::size_t f = 0; f < files_.size(); ++f) {
+      try {
+        bufMgr_.flushFile(&files_[f]);
+      } catch (BadgerDbException& e) {
+        std::printf("FAIL: final flush of %s: %s\n",
+                    files_[f].filename().c_str(), e.message().c_str());
+        ++failures;
+        continue;
+      }
+      for (PageId p = 1; p <= config_.pages_per_file; ++p) {
+        const Page page = files_[f].readPage(p);
+        const std::string expected =
+            makeRecord(f, p, versionOf(owner(p), f, p));
+        const RecordId rid = {p, RECORD_SLOT};
+        if (page.getRecord(rid) != expected) {
+          std::printf("FAIL: file %zu page %u holds \"%s\", expected \"%s\"\n",
+                      f, p, page.getRecord(rid).c_str(), expected.c_str());
+          ++failures;
+        }
+      }
+    }
+    for (std::size_t t = 0; t < stats_.size(); ++t) {
+      failures += stats_[t].failures;
+    }
+    return failures;
+  }
+
+  /**
+   * Returns the counters of all threads added up.
+   */
+  WorkerStats total() const {
+    WorkerStats sum;
+    for (std::size_t t = 0; t < stats_.size(); ++t) {
+      sum.reads += stats_[t].reads;
+      sum.updates += stats_[t].updates;
+      sum.holds += stats_[t].holds;
+      sum.flushes += stats_[t].flushes;
+      sum.buffer_exceeded += stats_[t].buffer_exceeded;
+      sum.flush_pinned += stats_[t].flush_pinned;
+      sum.failures += stats_[t].failures;
+    }
+    return sum;
+  }
+
+ private:
+  int owner(const PageId page_number) const {
+    return page_number % config_.threads;
+  }
+
+  std::uint32_t& versionOf(const int thread_index, const int file_index,
+                           const PageId page_number) {
+    return versions_[thread_index]
+        [file_index * (config_.pages_per_file + 1) + page_number];
+  }
+
+  void fail(WorkerStats& stats, const std::string& what) {
+    ++stats.failures;
+    // Only the first few failures are printed so a broken pool stays readable.
+    if (printed_failures_.fetch_add(1) < 10) {
+      std::printf("FAIL: %s\n", what.c_str());
+    }
+  }
+
+  void checkPageNumber(const Page* page, const int file_index,
+                       const PageId page_number, WorkerStats& stats) {
+    if (page->page_number() != page_number) {
+      std::stringstream ss;
+      ss << "pinned page " << page_number << " of file " << file_index
+         << " but got page " << page->page_number();
+      fail(stats, ss.str());
+    }
+  }
+
+  void readOp(const int file_index, const PageId page_number,
+              WorkerStats& stats) {
+    File* file = &files_[file_index];
+    Page* page;
+    bufMgr_.readPage(file, page_number, page);
+    checkPageNumber(page, file_index, page_number, stats);
+    bufMgr_.unPinPage(file, page_number, false);
+    ++stats.reads;
+  }
+
+  void updateOp(const int thread_index, const int file_index,
+                PageId page_number, WorkerStats& stats) {
+    // Move to a nearby page owned by this thread.
+    page_number += thread_index - owner(page_number);
+    if (page_number == 0) {
+      page_number += config_.threads;
+    }
+    if (page_number > config_.pages_per_file) {
+      return;
+    }
+    File* file = &files_[file_index];
+    std::uint32_t& version = versionOf(thread_index, file_index, page_number);
+    const RecordId rid = {page_number, RECORD_SLOT};
+    Page* page;
+    bufMgr_.readPage(file, page_number, page);
+    const std::string found = page->getRecord(rid);
+    const std::string expected = makeRecord(file_index, page_number, version);
+    if (found != expected) {
+      fail(stats, "read \"" + found + "\", expected \"" + expected + "\"");
+    }
+    page->updateRecord(rid, makeRecord(file_index, page_number, version + 1));
+    ++version;
+    bufMgr_.unPinPage(file, page_number, true);
+    ++stats.updates;
+  }
+
+  void holdOp(std::mt19937& rng,
+              std::uniform_int_distribution<PageId>& pick_page,
+              WorkerStats& stats) {
+    std::uniform_int_distribution<int> pick_file(0, files_.size() - 1);
+    int file_indexes[HOLD_PAGES];
+    PageId page_numbers[HOLD_PAGES];
+    Page* pages[HOLD_PAGES];
+    int pinned = 0;
+    try {
+      for (; pinned < HOLD_PAGES; ++pinned) {
+        file_indexes[pinned] = pick_file(rng);
+        page_numbers[pinned] = pick_page(rng);
+        bufMgr_.readPage(&files_[file_indexes[pinned]], page_numbers[pinned],
+                         pages[pinned]);
+        checkPageNumber(pages[pinned], file_indexes[pinned],
+                        page_numbers[pinned], stats);
+      }
+      // A pinned page cannot move, so pinning it again finds the same frame.
+      for (int i = 0; i < HOLD_PAGES; ++i) {
+        File* file = &files_[file_indexes[i]];
+        Page* again;
+        bufMgr_.readPage(file, page_numbers[i], again);
+        if (again != pages[i]) {
+          fail(stats, "pinned page moved to another frame");
+        }
+        bufMgr_.unPinPage(file, page_numbers[i], false);
+      }
+    } catch (const BufferExceededException&) {
+      ++stats.buffer_exceeded;
+    }
+    for (int i = 0; i < pinned; ++i) {
+      bufMgr_.unPinPage(&files_[file_indexes[i]], page_numbers[i], false);
+    }
+    ++stats.holds;
+  }
+
+  const Config config_;
+  BufMgr& bufMgr_;
+  std::vector<File>& files_;
+
+  /**
+   * Last version each thread wrote to its pages; only the owner touches them.
+   */
+  std::vector<std::vector<std::uint32_t> > versions_;
+
+  std::vector<WorkerStats> stats_;
+  std::atomic<int> printed_failures_{0};
+};
+
+}
+
+int main(int argc, char** argv) {
+  Config config;
+  config.threads = bench::argOr(argc, argv, 1, 4);
+  config.frames = bench::argOr(argc, argv, 2, 64);
+  config.files = bench::argOr(argc, argv, 3, 2);
+  config.pages_per_file = bench::argOr(argc, argv, 4, 256);
+  config.ops_per_thread = bench::argOr(argc, argv, 5, 20000);
+  config.read_pct = bench::argOr(argc, argv, 6, 60);
+  config.update_pct = bench::argOr(argc, argv, 7, 30);
+  config.hold_pct = bench::argOr(argc, argv, 8, 9);
+  config.flush_pct = bench::argOr(argc, argv, 9, 1);
+  config.compressed_bytes = bench::argOr(argc, argv, 10, 0);
+  config.disk = bench::argOr(argc, argv, 11, 0) != 0;
+
+  if (config.threads < 1 || config.files < 1 || config.pages_per_file < 1) {
+    std::printf("threads, files and pages_per_file must be positive\n");
+    return 2;
+  }
+
+  std::vector<File> files;
+  for (int f = 0; f < config.files; ++f) {
+    std::stringstream name;
+    name << (config.disk ? "" : File::MEMORY_PREFIX) << "bufmgr_stress." << f;
+    bench::removeIfExists(name.str());
+    files.push_back(File::create(name.str()));
+    for (PageId p = 1; p <= config.pages_per_file; ++p) {
+      Page page = files.back().allocatePage();
+      page.insertRecord(makeRecord(f, page.page_number(), 0));
+      files.back().writePage(page);
+    }
+  }
+
+  long failures;
+  {
+    BufMgr bufMgr(config.frames, config.compressed_bytes);
+    StressTest test(config, bufMgr, files);
+
+    bench::Timer timer;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < config.threads; ++t) {
+      threads.push_back(std::thread(&StressTest::worker, &test, t));
+    }
+    for (std::size_t t = 0; t < threads.size(); ++t) {
+      threads[t].join();
+    }
+    const double elapsed = timer.seconds();
+
+    failures = test.verify();
+    const WorkerStats total = test.total();
+    const long ops = config.threads * config.ops_per_thread;
+    std::printf("threads=%d frames=%u files=%d pages=%u ops=%ld\n",
+                config.threads, config.frames, config.files,
+                config.pages_per_file, ops);
+    std::printf("reads=%ld updates=%ld holds=%ld flushes=%ld "
+                "(pinned=%ld) buffer_exceeded=%ld\n",
+                total.reads, total.updates, total.holds, total.flushes,
+                total.flush_pinned, total.buffer_exceeded);
+    std::printf("diskreads=%d diskwrites=%d\n", bufMgr.getBufStats().diskreads,
+                bufMgr.getBufStats().diskwrites);
+    std::printf("%.0f ops/sec, %s\n", ops / elapsed,
+                failures == 0 ? "all checks passed" : "CHECKS FAILED");
+  }
+
+  std::vector<std::string> names;
+  for (std::size_t f = 0; f < files.size(); ++f) {
+    names.push_back(files[f].filename());
+  }
+  files.clear();
+  for (std::size_t f = 0; f < names.size(); ++f) {
+    File::remove(names[f]);
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Effective capacity versus CPU cost of the compressed page tier.
+ *
+ * Fills a file with pages whose records are partly random bytes, so the
+ * fraction of random bytes controls how well pages compress, then reads pages
+ * uniformly at random from a working set larger than the buffer pool.  Each
+ * run is repeated without the compressed tier and with a tier whose budget
+ * equals the memory of the buffer pool.
+ *
+ * Usage: compressed_cache_bench [frames] [working_set_pages] [reads]
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "page_compressor.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::size_t RECORD_SIZE = 96;
+
+std::string makeRecord(std::mt19937& rng, const double random_fraction,
+                       const PageId page_number) {
+  char prefix[32];
+  std::snprintf(prefix, sizeof(prefix), "tenant/%06u/", page_number % 64);
+  std::string record(prefix);
+  const std::size_t num_random =
+      static_cast<std::size_t>(random_fraction * RECORD_SIZE);
+  for (std::size_t i = 0; i < num_random; ++i) {
+    record.push_back(static_cast<char>(rng()));
+  }
+  while (record.size() < RECORD_SIZE) {
+    record.push_back("abcdefgh"[record.size() % 8]);
+  }
+  return record;
+}
+
+void fillFile(File& file, const PageId num_pages, const double random_fraction,
+              const double fill) {
+  std::mt19937 rng(42);
+  for (PageId i = 0; i < num_pages; ++i) {
+    Page page = file.allocatePage();
+    while (page.getFreeSpace() > Page::DATA_SIZE * (1 - fill)) {
+      const std::string record =
+          makeRecord(rng, random_fraction, page.page_number());
+      if (!page.hasSpaceForRecord(record)) {
+        break;
+      }
+      page.insertRecord(record);
+    }
+    file.writePage(page);
+  }
+}
+
+void run(const double random_fraction, const std::uint32_t frames,
+         const PageId working_set, const long reads) {
+  const std::string filename = "compressed_cache_bench.db";
+  bench::removeIfExists(filename);
+  {
+    File file = File::create(filename);
+    fillFile(file, working_set, random_fraction, 0.75);
+
+    // Cost of the codec on a representative page.
+    Page sample = file.readPage(1);
+    std::string compressed;
+    bench::Timer timer;
+    const int codec_rounds = 2000;
+    for (int i = 0; i < codec_rounds; ++i) {
+      PageCompressor::compressPage(sample, compressed);
+    }
+    const double compress_ns = timer.nanos() / codec_rounds;
+    timer.reset();
+    for (int i = 0; i < codec_rounds; ++i) {
+      PageCompressor::decompressPage(compressed, sample);
+    }
+    const double decompress_ns = timer.nanos() / codec_rounds;
+    std::printf("random=%.2f ratio=%.2f compress=%.0fns decompress=%.0fns\n",
+                random_fraction,
+                static_cast<double>(Page::SIZE) / compressed.size(),
+                compress_ns, decompress_ns);
+
+    const std::size_t budgets[] = {0, frames * Page::SIZE};
+    for (std::size_t b = 0; b < 2; ++b) {
+      BufMgr bufMgr(frames, budgets[b]);
+      std::mt19937 rng(7);
+      std::uniform_int_distribution<PageId> pick(1, working_set);
+      Page* page;
+      // Warm up both tiers before measuring.
+      for (long i = 0; i < reads / 4; ++i) {
+        const PageId page_number = pick(rng);
+        bufMgr.readPage(&file, page_number, page);
+        bufMgr.unPinPage(&file, page_number, false);
+      }
+      bufMgr.clearBufStats();
+      timer.reset();
+      for (long i = 0; i < reads; ++i) {
+        const PageId page_number = pick(rng);
+        bufMgr.readPage(&file, page_number, page);
+        bufMgr.unPinPage(&file, page_number, false);
+      }
+      const double elapsed = timer.seconds();
+      const BufStats& stats = bufMgr.getBufStats();
+      const CompressedPageCache* tier = bufMgr.getCompressedCache();
+      const std::size_t resident = frames + (tier ? tier->size() : 0);
+      std::printf("  tier=%-8zu capacity=%zu pages hit=%.3f diskreads=%d "
+                  "%.0f ns/read\n",
+                  budgets[b], resident,
+                  1 - static_cast<double>(stats.diskreads) / stats.accesses,
+                  stats.diskreads, elapsed * 1e9 / reads);
+      bufMgr.flushFile(&file);
+    }
+  }
+  File::remove(filename);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const std::uint32_t frames = bench::argOr(argc, argv, 1, 128);
+  const PageId working_set = bench::argOr(argc, argv, 2, 1024);
+  const long reads = bench::argOr(argc, argv, 3, 100000);
+
+  const double fractions[] = {0.0, 0.25, 0.5, 0.75, 1.0};
+  for (std::size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); ++i) {
+    run(fractions[i], frames, working_set, reads);
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Write amplification of small updates, writing whole pages against writing
+ * only the sectors that changed.
+ *
+ * A file of pages full of small records sits in a buffer pool that holds all
+ * of it.  Random records are updated through the pool, and every so many
+ * updates a checkpoint writes the dirty pages back.  The bytes and writes
+ * that reach the backend are counted and divided by the updates.  Two kinds
+ * of update are run:
+ *
+ * - counter:  a record is overwritten with a value of the same length, like
+ *             a counter being bumped.
+ * - resize:   a record is replaced by one of another length, which moves the
+ *             records stored below it on the page.
+ *
+ * Whole-page write-back is emulated by marking every sector of an updated
+ * page changed, which is what write-back did before sectors were tracked.
+ * Amplification is bytes written over bytes of record data updated.
+ *
+ * Usage: dirty_sector_bench [pages] [updates]
+ */
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Records per page and their length in bytes when the file is built.
+ */
+const int RECORDS_PER_PAGE = 90;
+const std::size_t RECORD_LENGTH = 64;
+
+/**
+ * @brief MemoryBackend that counts the writes reaching it.
+ */
+class CountingBackend : public IoBackend {
+ public:
+  CountingBackend() : writes_(0), bytes_written_(0) {}
+
+  virtual void read(const std::uint64_t offset, char* buffer,
+                    const std::size_t length) {
+    memory_.read(offset, buffer, length);
+  }
+
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length) {
+    ++writes_;
+    bytes_written_ += length;
+    memory_.write(offset, buffer, length);
+  }
+
+  virtual void flush() { memory_.flush(); }
+  virtual void sync() { memory_.sync(); }
+  virtual std::uint64_t size() { return memory_.size(); }
+
+  void reset() {
+    writes_ = 0;
+    bytes_written_ = 0;
+  }
+
+  std::uint64_t writes() const { return writes_; }
+  std::uint64_t bytesWritten() const { return bytes_written_; }
+
+ private:
+  MemoryBackend memory_;
+  std::uint64_t writes_;
+  std::uint64_t bytes_written_;
+};
+
+struct Result {
+  double bytes_per_update;
+  double writes_per_update;
+  double amplification;
+};
+
+/**
+ * Runs <updates> updates over a fresh file of <pages> pages, with a
+ * checkpoint every <per_checkpoint> updates.
+ */
+Result run(const PageId pages, const long updates, const long per_checkpoint,
+           const bool resize, const bool whole_pages) {
+  std::shared_ptr<CountingBackend> disk(new CountingBackend);
+  File file = File::create("dirty_sector_bench", disk);
+  for (PageId p = 0; p < pages; ++p) {
+    Page page = file.allocatePage();
+    for (int r = 0; r < RECORDS_PER_PAGE; ++r) {
+      page.insertRecord(std::string(RECORD_LENGTH, 'a'));
+    }
+    file.writePage(page);
+  }
+
+  BufMgr bufMgr(pages + 1);
+  Page* page;
+  for (PageId p = 1; p <= pages; ++p) {
+    bufMgr.readPage(&file, p, page);
+    bufMgr.unPinPage(&file, p, false);
+  }
+  disk->reset();
+
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<PageId> pick_page(1, pages);
+  std::uniform_int_distribution<SlotId> pick_slot(1, RECORDS_PER_PAGE);
+  std::uniform_int_distribution<std::size_t> pick_length(
+      RECORD_LENGTH - 16, RECORD_LENGTH + 16);
+  std::uint64_t updated = 0;
+  for (long i = 0; i < updates; ++i) {
+    const RecordId rid = {pick_page(rng), pick_slot(rng)};
+    const std::size_t length = resize ? pick_length(rng) : RECORD_LENGTH;
+    bufMgr.readPage(&file, rid.page_number, page);
+    page->updateRecord(rid, std::string(length, static_cast<char>('b' + i % 20)));
+    if (whole_pages) {
+      page->add_dirty_sectors(Page::ALL_SECTORS);
+    }
+    bufMgr.unPinPage(&file, rid.page_number, true);
+    updated += length;
+    if ((i + 1) % per_checkpoint == 0) {
+      bufMgr.checkpoint();
+    }
+  }
+  bufMgr.checkpoint();
+
+  Result result;
+  result.bytes_per_update = static_cast<double>(disk->bytesWritten()) / updates;
+  result.writes_per_update = static_cast<double>(disk->writes()) / updates;
+  result.amplification = static_cast<double>(disk->bytesWritten()) / updated;
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const PageId pages = bench::argOr(argc, argv, 1, 256);
+  const long updates = bench::argOr(argc, argv, 2, 100000);
+
+  std::printf("pages=%u records/page=%d record=%zu bytes updates=%ld\n", pages,
+              RECORDS_PER_PAGE, RECORD_LENGTH, updates);
+  std::printf("%-8s %-12s %-8s %12s %12s %14s\n", "update", "updates/ckpt",
+              "writes", "bytes/update", "ops/update", "amplification");
+  const long per_checkpoint[] = {pages / 4, pages, pages * 4L};
+  for (int resize = 0; resize < 2; ++resize) {
+    for (int c = 0; c < 3; ++c) {
+      for (int whole = 1; whole >= 0; --whole) {
+        const Result result = run(pages, updates, per_checkpoint[c],
+                                  resize != 0, whole != 0);
+        std::printf("%-8s %-12ld %-8s %12.0f %12.2f %13.1fx\n",
+                    resize ? "resize" : "counter", per_checkpoint[c],
+                    whole ? "page" : "sectors", result.bytes_per_update,
+                    result.writes_per_update, result.amplification);
+      }
+    }
+  }
+  return 0;
+}
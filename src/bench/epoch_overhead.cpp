@@ -0,0 +1,162 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Cost of epoch-based reclamation, on one thread.
+ *
+ * - guard:   entering and leaving an epoch.
+ * - retire:  retiring an object and reclaiming it later.
+ * - hit:     reading a record of a resident page with readPage()/unPinPage()
+ *            against readResident() inside a guard.
+ * - churn:   readPage()/unPinPage() over a working set larger than the pool,
+ *            so every access evicts a page, with and without an epoch
+ *            manager attached; this is what writers pay for the deferred
+ *            frame reuse and bucket reclamation.
+ *
+ * Usage: epoch_overhead [ops] [frames]
+ */
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "epoch_manager.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Pages per file; the working set is spread over many small files because
+ * allocating a page scans its file.
+ */
+const PageId PAGES_PER_FILE = 64;
+
+/**
+ * Reads page <page_number> of <file> through readPage() and returns the
+ * length of its record.
+ */
+std::size_t pinnedRead(BufMgr& bufMgr, File& file, const PageId page_number) {
+  Page* page;
+  bufMgr.readPage(&file, page_number, page);
+  const RecordId rid = {page_number, 1};
+  const std::size_t length = page->getRecord(rid).size();
+  bufMgr.unPinPage(&file, page_number, false);
+  return length;
+}
+
+double churn(std::vector<File>& files, const std::uint32_t frames,
+             const long ops, EpochManager* epochs) {
+  BufMgr bufMgr(frames, 0, NULL, epochs);
+  const std::size_t pages = files.size() * PAGES_PER_FILE;
+  std::size_t sink = 0;
+  bench::Timer timer;
+  for (long i = 0; i < ops; ++i) {
+    // A stride coprime with the working set visits every page before any
+    // comes round again, so a pool smaller than it never hits.
+    const std::size_t index = (i * 7919) % pages;
+    sink += pinnedRead(bufMgr, files[index / PAGES_PER_FILE],
+                       1 + index % PAGES_PER_FILE);
+  }
+  const double nanos = timer.nanos() / ops;
+  if (sink == 1) {
+    std::printf(" ");
+  }
+  return nanos;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long ops = bench::argOr(argc, argv, 1, 1000000);
+  const std::uint32_t frames = bench::argOr(argc, argv, 2, 256);
+
+  // Four times as many pages as frames.
+  const std::size_t file_count = frames * 4 / PAGES_PER_FILE + 1;
+  std::vector<File> files;
+  for (std::size_t f = 0; f < file_count; ++f) {
+    std::stringstream name;
+    name << File::MEMORY_PREFIX << "epoch_overhead." << f;
+    bench::removeIfExists(name.str());
+    files.push_back(File::create(name.str()));
+    for (PageId p = 1; p <= PAGES_PER_FILE; ++p) {
+      Page page = files.back().allocatePage();
+      page.insertRecord(std::string(100, 'a'));
+      files.back().writePage(page);
+    }
+  }
+  std::printf("ops=%ld frames=%u pages=%zu\n", ops, frames,
+              file_count * PAGES_PER_FILE);
+
+  {
+    EpochManager epochs;
+    EpochManager::Participant participant(epochs);
+    bench::Timer timer;
+    for (long i = 0; i < ops; ++i) {
+      EpochManager::Guard guard(participant);
+    }
+    std::printf("guard enter/exit          %8.1f ns\n", timer.nanos() / ops);
+
+    timer.reset();
+    for (long i = 0; i < ops; ++i) {
+      epochs.retire([] {});
+    }
+    epochs.reclaim();
+    std::printf("retire + reclaim          %8.1f ns\n", timer.nanos() / ops);
+  }
+
+  {
+    EpochManager epochs;
+    EpochManager::Participant participant(epochs);
+    BufMgr bufMgr(frames, 0, NULL, &epochs);
+    File& file = files[0];
+    for (PageId p = 1; p <= PAGES_PER_FILE; ++p) {
+      pinnedRead(bufMgr, file, p);
+    }
+    std::size_t sink = 0;
+    bench::Timer timer;
+    for (long i = 0; i < ops; ++i) {
+      sink += pinnedRead(bufMgr, file, 1 + i % PAGES_PER_FILE);
+    }
+    std::printf("hit, readPage             %8.1f ns\n", timer.nanos() / ops);
+
+    timer.reset();
+    for (long i = 0; i < ops; ++i) {
+      const PageId page_number = 1 + i % PAGES_PER_FILE;
+      EpochManager::Guard guard(participant);
+      bufMgr.readResident(&file, page_number, [&](const Page& page) {
+        const RecordId rid = {page_number, 1};
+        sink += page.getRecord(rid).size();
+      });
+    }
+    std::printf("hit, readResident         %8.1f ns\n", timer.nanos() / ops);
+    if (sink == 1) {
+      std::printf(" ");
+    }
+  }
+
+  std::printf("churn, no epochs          %8.1f ns\n",
+              churn(files, frames, ops, NULL));
+  {
+    EpochManager epochs;
+    std::printf("churn, epochs             %8.1f ns\n",
+                churn(files, frames, ops, &epochs));
+  }
+
+  std::vector<std::string> names;
+  for (std::size_t f = 0; f < files.size(); ++f) {
+    names.push_back(files[f].filename());
+  }
+  files.clear();
+  for (std::size_t f = 0; f < names.size(); ++f) {
+    File::remove(names[f]);
+  }
+  return 0;
+}
@@ -0,0 +1,256 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Multi-threaded stress test of lock-free reads against frame reuse.
+ *
+ * Reader threads read random pages with BufMgr::readResident(), which takes
+ * neither the pool latch nor a pin, while churn threads keep the pool
+ * evicting: they pin random pages of a working set several times larger than
+ * the pool, rewrite some of them under the frame latch, and now and then
+ * flush a whole file.  Every frame a reader looks at is thus about to be
+ * freed and refilled with another page, and only the epoch manager keeps
+ * that from happening while the reader is on it.
+ *
+ * Every page holds one record naming its file and page number plus a
+ * version, so a reader that saw a reused frame, a half-loaded frame or a
+ * torn update notices.  The exit status is nonzero if any check failed.
+ *
+ * Build with -DBADGERDB_TSAN=ON (or -fsanitize=thread) to run it under
+ * ThreadSanitizer.
+ *
+ * Usage: epoch_stress [readers] [churners] [frames] [files] [pages_per_file]
+ *                     [ops_per_thread]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "epoch_manager.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Slot of the one record every page holds.
+ */
+const SlotId RECORD_SLOT = 1;
+
+/**
+ * Returns the record of page <page_number> of file <file_index> at
+ * <version>.  Records have a fixed width so updates stay in place.
+ */
+std::string makeRecord(const int file_index, const PageId page_number,
+                       const std::uint32_t version) {
+  char record[64];
+  std::snprintf(record, sizeof(record), "file=%04d page=%08u version=%010u",
+                file_index, page_number, version);
+  return record;
+}
+
+/**
+ * Length of the part of a record that does not change with the version.
+ */
+const std::size_t RECORD_KEY_LENGTH = sizeof("file=0000 page=00000000") - 1;
+
+class StressTest {
+ public:
+  StressTest(BufMgr& bufMgr, EpochManager& epochs, std::vector<File>& files,
+             const PageId pages_per_file, const long ops)
+      : bufMgr_(bufMgr),
+        epochs_(epochs),
+        files_(files),
+        pages_per_file_(pages_per_file),
+        ops_(ops),
+        hits_(0),
+        misses_(0),
+        churned_(0),
+        failures_(0) {}
+
+  void reader(const int thread_index) {
+    EpochManager::Participant participant(epochs_);
+    std::mt19937 rng(2000 + thread_index);
+    std::uniform_int_distribution<int> pick_file(0, files_.size() - 1);
+    std::uniform_int_distribution<PageId> pick_page(1, pages_per_file_);
+    long hits = 0;
+    long misses = 0;
+    for (long i = 0; i < ops_; ++i) {
+      const int file_index = pick_file(rng);
+      const PageId page_number = pick_page(rng);
+      std::string record;
+      bool read;
+      {
+        EpochManager::Guard guard(participant);
+        read = bufMgr_.readResident(
+            &files_[file_index], page_number, [&](const Page& page) {
+              if (page.page_number() != page_number) {
+                std::stringstream ss;
+                ss << "page " << page.page_number();
+                record = ss.str();
+                return;
+              }
+              const RecordId rid = {page_number, RECORD_SLOT};
+              record = page.getRecord(rid);
+            });
+      }
+      if (!read) {
+        ++misses;
+        continue;
+      }
+      ++hits;
+      const std::string expected = makeRecord(file_index, page_number, 0);
+      if (record.compare(0, RECORD_KEY_LENGTH, expected, 0,
+                         RECORD_KEY_LENGTH) != 0) {
+        fail("read \"" + record + "\" for \"" +
+             expected.substr(0, RECORD_KEY_LENGTH) + "\"");
+      }
+    }
+    hits_ += hits;
+    misses_ += misses;
+  }
+
+  void churner(const int thread_index) {
+    std::mt19937 rng(3000 + thread_index);
+    std::uniform_int_distribution<int> pick_op(0, 999);
+    std::uniform_int_distribution<int> pick_file(0, files_.size() - 1);
+    std::uniform_int_distribution<PageId> pick_page(1, pages_per_file_);
+    for (long i = 0; i < ops_; ++i) {
+      const int op = pick_op(rng);
+      const int file_index = pick_file(rng);
+      File* file = &files_[file_index];
+      const PageId page_number = pick_page(rng);
+      try {
+        if (op < 5) {
+          bufMgr_.flushFile(file);
+          continue;
+        }
+        const bool write = op < 200;
+        const LatchMode mode = write ? LATCH_EXCLUSIVE : LATCH_SHARED;
+        Page* page;
+        bufMgr_.readPage(file, page_number, page, mode);
+        if (write) {
+          const RecordId rid = {page_number, RECORD_SLOT};
+          page->updateRecord(rid, makeRecord(file_index, page_number, i));
+        }
+        bufMgr_.unPinPage(file, page_number, write, mode);
+        ++churned_;
+      } catch (const PagePinnedException&) {
+      } catch (const BufferExceededException&) {
+      } catch (BadgerDbException& e) {
+        fail(e.message());
+      }
+    }
+  }
+
+  long hits() const { return hits_; }
+  long misses() const { return misses_; }
+  long churned() const { return churned_; }
+  long failures() const { return failures_; }
+
+ private:
+  void fail(const std::string& what) {
+    // Only the first few failures are printed so a broken pool stays readable.
+    if (failures_.fetch_add(1) < 10) {
+      std::printf("FAIL: %s\n", what.c_str());
+    }
+  }
+
+  BufMgr& bufMgr_;
+  EpochManager& epochs_;
+  std::vector<File>& files_;
+  const PageId pages_per_file_;
+  const long ops_;
+  std::atomic<long> hits_;
+  std::atomic<long> misses_;
+  std::atomic<long> churned_;
+  std::atomic<long> failures_;
+};
+
+}
+
+int main(int argc, char** argv) {
+  const int readers = bench::argOr(argc, argv, 1, 4);
+  const int churners = bench::argOr(argc, argv, 2, 2);
+  const std::uint32_t frames = bench::argOr(argc, argv, 3, 32);
+  const int file_count = bench::argOr(argc, argv, 4, 4);
+  const PageId pages_per_file = bench::argOr(argc, argv, 5, 32);
+  const long ops = bench::argOr(argc, argv, 6, 50000);
+
+  if (readers < 1 || churners < 1 || file_count < 1 || pages_per_file < 1) {
+    std::printf("readers, churners, files and pages_per_file must be positive\n");
+    return 2;
+  }
+
+  std::vector<File> files;
+  for (int f = 0; f < file_count; ++f) {
+    std::stringstream name;
+    name << File::MEMORY_PREFIX << "epoch_stress." << f;
+    bench::removeIfExists(name.str());
+    files.push_back(File::create(name.str()));
+    for (PageId p = 1; p <= pages_per_file; ++p) {
+      Page page = files.back().allocatePage();
+      page.insertRecord(makeRecord(f, page.page_number(), 0));
+      files.back().writePage(page);
+    }
+  }
+
+  long failures;
+  {
+    EpochManager epochs;
+    BufMgr bufMgr(frames, 0, NULL, &epochs);
+    StressTest test(bufMgr, epochs, files, pages_per_file, ops);
+
+    bench::Timer timer;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; ++t) {
+      threads.push_back(std::thread(&StressTest::reader, &test, t));
+    }
+    for (int t = 0; t < churners; ++t) {
+      threads.push_back(std::thread(&StressTest::churner, &test, t));
+    }
+    for (std::size_t t = 0; t < threads.size(); ++t) {
+      threads[t].join();
+    }
+    const double elapsed = timer.seconds();
+
+    for (std::size_t f = 0; f < files.size(); ++f) {
+      bufMgr.flushFile(&files[f]);
+    }
+    failures = test.failures();
+    std::printf("readers=%d churners=%d frames=%u files=%d pages=%u "
+                "ops/thread=%ld\n",
+                readers, churners, frames, file_count, pages_per_file, ops);
+    std::printf("lock-free hits=%ld misses=%ld churn ops=%ld diskreads=%d "
+                "epoch=%llu pending=%zu\n",
+                test.hits(), test.misses(), test.churned(),
+                bufMgr.getBufStats().diskreads,
+                static_cast<unsigned long long>(epochs.epoch()),
+                epochs.pending());
+    std::printf("%.1f s, %s\n", elapsed,
+                failures == 0 ? "all checks passed" : "CHECKS FAILED");
+  }
+
+  std::vector<std::string> names;
+  for (std::size_t f = 0; f < files.size(); ++f) {
+    names.push_back(files[f].filename());
+  }
+  files.clear();
+  for (std::size_t f = 0; f < names.size(); ++f) {
+    File::remove(names[f]);
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Append throughput and on-disk fragmentation for each growth chunk.
+ *
+ * Grows <files> files on the filesystem (in the working directory) to
+ * <pages> pages each, appending to them in turn through a 64 frame pool, so
+ * their growth interleaves the way tables filled side by side do; the time
+ * includes flushing every file.  Then the extents of each file are counted
+ * with the FIEMAP ioctl, after the kernel has written the data back.  A
+ * growth chunk of 0 grows each file by a page at a time.
+ *
+ * Usage: file_growth_bench [pages] [files]
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Returns the number of extents of the file <filename> (syncing it first),
+ * or -1 if the filesystem cannot tell.
+ */
+long extents(const std::string& filename) {
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct fiemap map;
+  std::memset(&map, 0, sizeof(map));
+  map.fm_length = FIEMAP_MAX_OFFSET;
+  map.fm_flags = FIEMAP_FLAG_SYNC;
+  map.fm_extent_count = 0;  // Only count them.
+  const long count =
+      ::ioctl(fd, FS_IOC_FIEMAP, &map) == 0 ? map.fm_mapped_extents : -1;
+  ::close(fd);
+  return count;
+}
+
+/**
+ * Makes the file <filename> durable, as a checkpoint would.
+ */
+void durable(const std::string& filename) {
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    ::fdatasync(fd);
+    ::close(fd);
+  }
+}
+
+/**
+ * Returns the bytes the filesystem has allocated to <filename>.
+ */
+long long allocatedBytes(const std::string& filename) {
+  struct stat st;
+  return ::stat(filename.c_str(), &st) == 0 ? st.st_blocks * 512LL : -1;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const PageId pages = bench::argOr(argc, argv, 1, 4096);
+  const std::size_t file_count = bench::argOr(argc, argv, 2, 4);
+  const PageId sync_every = bench::argOr(argc, argv, 3, 256);
+
+  std::printf("pages=%u files=%zu (%.1f MiB each)\n", pages, file_count,
+              static_cast<double>(pages) * Page::SIZE / (1024 * 1024));
+  const std::uint64_t chunks[] = {0, 1 << 20, 16 << 20, 64 << 20};
+  for (std::size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+    File::setGrowthChunk(chunks[c]);
+    std::vector<std::string> names;
+    std::vector<File> files;
+    for (std::size_t f = 0; f < file_count; ++f) {
+      std::stringstream name;
+      name << "file_growth_bench." << f;
+      bench::removeIfExists(name.str());
+      names.push_back(name.str());
+      files.push_back(File::create(name.str()));
+    }
+
+    double rate;
+    {
+      BufMgr bufMgr(64);
+      const std::string record(100, 'a');
+      bench::Timer timer;
+      for (PageId i = 0; i < pages; ++i) {
+        for (std::size_t f = 0; f < file_count; ++f) {
+          PageId page_number;
+          Page* page;
+          bufMgr.allocPage(&files[f], page_number, page);
+          page->insertRecord(record);
+          bufMgr.unPinPage(&files[f], page_number, true);
+        }
+        if (sync_every > 0 && (i + 1) % sync_every == 0) {
+          for (std::size_t f = 0; f < file_count; ++f) {
+            bufMgr.flushFile(&files[f]);
+            durable(names[f]);
+          }
+        }
+      }
+      for (std::size_t f = 0; f < file_count; ++f) {
+        bufMgr.flushFile(&files[f]);
+      }
+      rate = pages * file_count / timer.seconds();
+    }
+
+    long total_extents = 0;
+    long long allocated = 0;
+    for (std::size_t f = 0; f < file_count; ++f) {
+      total_extents += extents(names[f]);
+      allocated += allocatedBytes(names[f]);
+    }
+    std::printf("chunk=%5llu KiB %10.0f pages/s %8.1f extents/file "
+                "%8.1f MiB allocated/file\n",
+                static_cast<unsigned long long>(chunks[c] / 1024), rate,
+                static_cast<double>(total_extents) / file_count,
+                static_cast<double>(allocated) / file_count / (1024 * 1024));
+
+    files.clear();
+    for (std::size_t f = 0; f < names.size(); ++f) {
+      File::remove(names[f]);
+    }
+  }
+  File::setGrowthChunk(0);
+  return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Records per page and scan speed of fixed-length pages against slotted
+ * pages.
+ *
+ * For each record length, fills a slotted page and a fixed-length page with
+ * as many records as fit, deletes every fourth one, then walks the records:
+ *
+ * - iterate: a PageIterator walk, copying every record.
+ * - get:     tryGetRecord() of every record by its RecordId into one string.
+ *
+ * Usage: fixed_page_bench [rounds]
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "page.h"
+#include "page_iterator.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Fills <page> with records of <length> bytes, setting <capacity> to their
+ * number, and deletes every fourth; returns the IDs of the records left.
+ */
+std::vector<RecordId> fill(Page& page, const std::size_t length,
+                           std::size_t& capacity) {
+  std::vector<RecordId> record_ids;
+  const std::string record(length, 'r');
+  RecordId record_id;
+  while (page.tryInsertRecord(record, record_id) == STATUS_OK) {
+    record_ids.push_back(record_id);
+  }
+  capacity = record_ids.size();
+  std::vector<RecordId> kept;
+  for (std::size_t i = 0; i < record_ids.size(); ++i) {
+    if (i % 4 == 0) {
+      page.deleteRecord(record_ids[i]);
+    } else {
+      kept.push_back(record_ids[i]);
+    }
+  }
+  return kept;
+}
+
+/**
+ * Times walking the records of <page>; sets <iterate> and <get> to the
+ * nanoseconds per record of each walk.
+ */
+void scan(Page& page, const std::vector<RecordId>& record_ids,
+          const long rounds, double& iterate, double& get) {
+  std::size_t bytes = 0;
+  bench::Timer timer;
+  for (long r = 0; r < rounds; ++r) {
+    for (PageIterator iter = page.begin(); iter != page.end(); ++iter) {
+      bytes += (*iter).size();
+    }
+  }
+  iterate = timer.nanos() / (rounds * record_ids.size());
+  std::string record;
+  timer.reset();
+  for (long r = 0; r < rounds; ++r) {
+    for (std::size_t i = 0; i < record_ids.size(); ++i) {
+      page.tryGetRecord(record_ids[i], record);
+      bytes += record.size();
+    }
+  }
+  get = timer.nanos() / (rounds * record_ids.size());
+  if (bytes == 0) {
+    std::printf("error: no records\n");
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long rounds = bench::argOr(argc, argv, 1, 2000);
+
+  std::printf("rounds=%ld\n", rounds);
+  const std::size_t lengths[] = {8, 16, 32, 64};
+  for (std::size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+    std::size_t slotted_capacity;
+    std::size_t fixed_capacity;
+    Page slotted;
+    const std::vector<RecordId> slotted_ids =
+        fill(slotted, lengths[l], slotted_capacity);
+    Page fixed;
+    fixed.makeFixedLength(lengths[l]);
+    const std::vector<RecordId> fixed_ids =
+        fill(fixed, lengths[l], fixed_capacity);
+
+    double slotted_iterate, slotted_get, fixed_iterate, fixed_get;
+    scan(slotted, slotted_ids, rounds, slotted_iterate, slotted_get);
+    scan(fixed, fixed_ids, rounds, fixed_iterate, fixed_get);
+    std::printf("%2zu byte records  per page: slotted %4zu  fixed %4zu   "
+                "iterate: slotted %5.1f  fixed %5.1f   get: slotted %5.1f  "
+                "fixed %5.1f ns/record\n",
+                lengths[l], slotted_capacity, fixed_capacity, slotted_iterate,
+                fixed_iterate, slotted_get, fixed_get);
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Disk usage of a file after a bulk delete, with and without giving the
+ * space of deleted pages back.
+ *
+ * Fills a file on the filesystem (in the working directory) with <pages>
+ * pages, then deletes 3/4 of them: either the first pages, leaving a run of
+ * free pages in the middle of the file, or the last ones, leaving free pages
+ * at its end.  Deleted pages are either kept, punched out one at a time by
+ * deletePage(), or punched out and then reclaimed in runs with
+ * reclaimFreeSpace().  Reports the file size, the space the filesystem has
+ * allocated to it and the time per delete (including reclaiming).
+ *
+ * Usage: hole_punch_bench [pages]
+ */
+
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "file.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const char* const FILENAME = "hole_punch_bench.db";
+
+enum Mode { KEEP, PUNCH, RECLAIM };
+
+/**
+ * Prints the size and allocated space of the file, after syncing it.
+ */
+void printUsage(const char* label) {
+  const int fd = ::open(FILENAME, O_RDONLY);
+  if (fd >= 0) {
+    ::fsync(fd);
+    ::close(fd);
+  }
+  struct stat st;
+  ::stat(FILENAME, &st);
+  std::printf("%-24s size %7.2f MiB  allocated %7.2f MiB", label,
+              st.st_size / (1024.0 * 1024),
+              st.st_blocks * 512 / (1024.0 * 1024));
+}
+
+void run(const PageId pages, const bool tail, const Mode mode) {
+  bench::removeIfExists(FILENAME);
+  File::setPunchFreedPages(mode != KEEP);
+  {
+    File file = File::create(FILENAME);
+    const std::string record(100, 'a');
+    for (PageId i = 0; i < pages; ++i) {
+      Page page = file.allocatePage();
+      page.insertRecord(record);
+      file.writePage(page);
+    }
+    // Page numbers start at 1; the first used page is the cheapest to
+    // delete, so delete in ascending order.
+    const PageId deleted = pages / 4 * 3;
+    const PageId first = tail ? pages - deleted + 1 : 1;
+    bench::Timer timer;
+    for (PageId p = first; p < first + deleted; ++p) {
+      file.deletePage(p);
+    }
+    if (mode == RECLAIM) {
+      file.reclaimFreeSpace();
+    }
+    const double us = timer.nanos() / deleted / 1000;
+    static const char* const MODES[] = {"kept", "punched", "punched+reclaimed"};
+    std::string label = std::string(tail ? "tail, " : "head, ") + MODES[mode];
+    printUsage(label.c_str());
+    std::printf("  %8.1f us/delete\n", us);
+  }
+  File::remove(FILENAME);
+  File::setPunchFreedPages(false);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const PageId pages = bench::argOr(argc, argv, 1, 1024);
+
+  std::printf("pages=%u (%.1f MiB), deleting 3/4 of them\n", pages,
+              static_cast<double>(pages) * Page::SIZE / (1024 * 1024));
+  for (int tail = 0; tail < 2; ++tail) {
+    for (int mode = KEEP; mode <= RECLAIM; ++mode) {
+      run(pages, tail != 0, static_cast<Mode>(mode));
+    }
+  }
+  return 0;
+}
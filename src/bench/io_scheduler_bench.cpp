@@ -0,0 +1,128 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Foreground read latency of a BufMgr while another thread checkpoints it.
+ *
+ * One thread reads random pages of a file larger than the pool (a fifth of
+ * the pages take 80% of the reads) and dirties 30% of them when unpinning;
+ * another calls checkpoint() every few milliseconds.  The file sits on an
+ * in-memory backend that sleeps like a device would, a fixed latency per
+ * operation plus a transfer time per page.
+ *
+ * Each run is repeated with I/O done directly under the pool latch, through
+ * an IoScheduler, and through an IoScheduler whose background class is rate
+ * limited with a small burst.
+ *
+ * Usage: io_scheduler_bench [reads] [pages] [frames] [latency_us]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "io_scheduler.h"
+
+using namespace badgerdb;
+
+namespace {
+
+struct Result {
+  double p50_us;
+  double p99_us;
+  double p999_us;
+  double reads_per_sec;
+  std::uint64_t checkpointed;
+  int checkpoints;
+};
+
+Result runMode(const int mode, const long reads, const PageId pages,
+               const std::uint32_t frames, const int latency_us) {
+  std::shared_ptr<bench::SlowBackend> disk(new bench::SlowBackend);
+  File file = File::create("io_scheduler_bench", disk);
+  for (PageId p = 0; p < pages; ++p) {
+    file.allocatePage();
+  }
+  disk->setLatency(latency_us);
+
+  Result result = Result();
+  std::unique_ptr<IoScheduler> scheduler;
+  if (mode > 0) {
+    scheduler.reset(new IoScheduler);
+  }
+  if (mode == 2) {
+    // Half the transfer budget of the device, in runs of at most 4 pages.
+    const int page_us = latency_us + bench::SlowBackend::PAGE_TRANSFER_US;
+    scheduler->setRateLimit(IO_BACKGROUND, 0.5e6 / page_us, 4);
+  }
+  {
+    BufMgr bufMgr(frames, 0, scheduler.get());
+    std::atomic<bool> done(false);
+    std::thread checkpointer([&] {
+      while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        result.checkpointed += bufMgr.checkpoint();
+        ++result.checkpoints;
+      }
+    });
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<PageId> hot(1, pages / 5);
+    std::uniform_int_distribution<PageId> any(1, pages);
+    std::vector<double> samples;
+    samples.reserve(reads);
+    bench::Timer total;
+    for (long i = 0; i < reads; ++i) {
+      const PageId page_number = percent(rng) < 80 ? hot(rng) : any(rng);
+      const bool dirty = percent(rng) < 30;
+      bench::Timer timer;
+      Page* page;
+      bufMgr.readPage(&file, page_number, page);
+      bufMgr.unPinPage(&file, page_number, dirty);
+      samples.push_back(timer.nanos() / 1e3);
+    }
+    result.reads_per_sec = reads / total.seconds();
+    done = true;
+    checkpointer.join();
+
+    result.p50_us = bench::percentile(samples, 50);
+    result.p99_us = bench::percentile(samples, 99);
+    result.p999_us = bench::percentile(samples, 99.9);
+    disk->setLatency(0);
+    bufMgr.flushFile(&file);
+  }
+  return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long reads = bench::argOr(argc, argv, 1, 20000);
+  const PageId pages = bench::argOr(argc, argv, 2, 2000);
+  const std::uint32_t frames = bench::argOr(argc, argv, 3, 400);
+  const int latency_us = bench::argOr(argc, argv, 4, 50);
+  const char* const modes[] = {"direct", "scheduler", "scheduler+limit"};
+
+  std::printf("reads=%ld pages=%u frames=%u latency=%dus+%dus/page\n", reads,
+              pages, frames, latency_us,
+              bench::SlowBackend::PAGE_TRANSFER_US);
+  for (int mode = 0; mode < 3; ++mode) {
+    const Result r = runMode(mode, reads, pages, frames, latency_us);
+    std::printf("%-16s p50=%7.1fus p99=%7.1fus p99.9=%7.1fus %8.0f reads/s "
+                "checkpoints=%d pages=%llu\n",
+                modes[mode], r.p50_us, r.p99_us, r.p999_us, r.reads_per_sec,
+                r.checkpoints,
+                static_cast<unsigned long long>(r.checkpointed));
+  }
+  return 0;
+}
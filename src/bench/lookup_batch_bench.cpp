@@ -0,0 +1,114 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Lookups per second of pages in the buffer pool, one at a time with
+ * readPage() against batches of BufMgr::pinResidentPages().
+ *
+ * Fills a pool with pages of in-memory files and probes random resident
+ * pages, so every lookup hits but most miss the processor caches in the hash
+ * chains and frame descriptors.  Only the lookups are timed; the pages are
+ * unpinned afterwards.
+ *
+ * Usage: lookup_batch_bench [frames] [probes] [pages_per_file]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+int main(int argc, char** argv) {
+  const std::uint32_t frames = bench::argOr(argc, argv, 1, 100000);
+  const long probes = bench::argOr(argc, argv, 2, 1000000);
+  const PageId pages_per_file = bench::argOr(argc, argv, 3, 64);
+
+  std::vector<std::string> names;
+  {
+    std::vector<File> files;
+    BufMgr bufMgr(frames);
+    for (std::uint32_t f = 0; f * pages_per_file < frames; ++f) {
+      std::stringstream name;
+      name << File::MEMORY_PREFIX << "lookup_batch_bench." << f;
+      names.push_back(name.str());
+      files.push_back(File::create(name.str()));
+    }
+    // The vector no longer grows, so pointers into it stay valid.
+    Page* page;
+    PageId page_number;
+    for (std::uint32_t i = 0; i < frames; ++i) {
+      File* file = &files[i / pages_per_file];
+      bufMgr.allocPage(file, page_number, page);
+      bufMgr.unPinPage(file, page_number, false);
+    }
+
+    std::vector<File*> keyFiles(probes);
+    std::vector<PageId> keyPages(probes);
+    std::uint64_t state = 12345;
+    for (long i = 0; i < probes; ++i) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      const std::uint32_t frame = (state >> 33) % frames;
+      keyFiles[i] = &files[frame / pages_per_file];
+      keyPages[i] = 1 + frame % pages_per_file;
+    }
+
+    std::printf("frames=%u files=%zu probes=%ld\n", frames, files.size(),
+                probes);
+    // Probes are timed a chunk at a time, and the chunk is unpinned after.
+    const long chunk = 4096;
+    std::vector<Page*> pages(chunk);
+    double seconds = 0;
+    for (long start = 0; start < probes; start += chunk) {
+      const long end = std::min(probes, start + chunk);
+      bench::Timer timer;
+      for (long i = start; i < end; ++i) {
+        bufMgr.readPage(keyFiles[i], keyPages[i], pages[i - start]);
+      }
+      seconds += timer.seconds();
+      for (long i = start; i < end; ++i) {
+        bufMgr.unPinPage(keyFiles[i], keyPages[i], false);
+      }
+    }
+    std::printf("readPage            %6.2f M lookups/s\n",
+                probes / seconds / 1e6);
+
+    for (long batch = 1; batch <= 64; batch *= 2) {
+      seconds = 0;
+      long found = 0;
+      for (long start = 0; start < probes; start += chunk) {
+        const long end = std::min(probes, start + chunk);
+        bench::Timer timer;
+        for (long i = start; i < end; i += batch) {
+          found += bufMgr.pinResidentPages(std::min(batch, end - i),
+                                           &keyFiles[i], &keyPages[i],
+                                           &pages[i - start]);
+        }
+        seconds += timer.seconds();
+        for (long i = start; i < end; ++i) {
+          bufMgr.unPinPage(keyFiles[i], keyPages[i], false);
+        }
+      }
+      std::printf("pinResidentPages %2ld %6.2f M lookups/s%s\n", batch,
+                  probes / seconds / 1e6,
+                  found == probes ? "" : " (missed pages)");
+    }
+
+    for (std::size_t f = 0; f < files.size(); ++f) {
+      bufMgr.flushFile(&files[f]);
+    }
+  }
+  for (std::size_t f = 0; f < names.size(); ++f) {
+    File::remove(names[f]);
+  }
+  return 0;
+}
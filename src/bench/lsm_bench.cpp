@@ -0,0 +1,220 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Ingest and lookup rates of an LsmTree against updating pages in place.
+ *
+ * Writes <keys> random 16 byte keys with 100 byte values, then looks up
+ * <reads> random keys written, with:
+ *
+ * - lsm:   an LsmTree with its default settings, waiting for its compactions
+ *          before the lookups.
+ * - paged: sorted pages, each holding a fixed range of keys, read and written
+ *          through a BufMgr of <frames> frames; the leaf level of a B-tree
+ *          whose inner nodes are all cached.  Pages start half full so none
+ *          overflows.
+ *
+ * Reports operations per second, the bytes each wrote to its files per byte
+ * of keys and values, and for the tree the runs it read a page of per lookup.
+ * Files go in the working directory, or in memory if [dir] is "mem:".
+ *
+ * Usage: lsm_bench [keys] [reads] [frames] [dir]
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "lsm_tree.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::size_t KEY_LENGTH = 16;
+const std::size_t VALUE_LENGTH = 100;
+
+/**
+ * Returns the <i>th key: the hex digits of a hash of <i>, so keys come in
+ * random order and spread evenly over the key space.
+ */
+std::string makeKey(const std::uint64_t i) {
+  std::uint64_t h = (i + 1) * 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 31;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 29;
+  char key[KEY_LENGTH + 1];
+  std::snprintf(key, sizeof(key), "%016llx",
+                static_cast<unsigned long long>(h));
+  return key;
+}
+
+/**
+ * Returns the bytes written to files whose names start with <name>.
+ */
+std::uint64_t bytesWritten(const std::string& name) {
+  const std::vector<FileStatsSnapshot> stats = File::allStats();
+  std::uint64_t bytes = 0;
+  for (std::size_t i = 0; i < stats.size(); ++i) {
+    if (stats[i].filename.compare(0, name.length(), name) == 0) {
+      bytes += stats[i].bytes_written;
+    }
+  }
+  return bytes;
+}
+
+/**
+ * Pages of the paged layout, each holding the keys whose first eight hex
+ * digits map to it.
+ */
+class PagedStore {
+ public:
+  PagedStore(const std::string& filename, const std::uint32_t pages,
+             const std::uint32_t frames)
+      : file_(File::create(filename)), pages_(pages), buf_mgr_(frames) {
+    std::vector<Page> blank(pages);
+    for (std::uint32_t i = 0; i < pages; ++i) {
+      blank[i].makeSorted();
+    }
+    file_.appendPages(blank);
+  }
+
+  void put(const std::string& key, const std::string& value) {
+    const PageId page_number = pageOf(key);
+    Page* page;
+    buf_mgr_.readPage(&file_, page_number, page);
+    RecordId record_id;
+    if (page->tryFindRecord(key, record_id) == STATUS_OK) {
+      page->deleteRecord(record_id);
+    }
+    page->insertRecord(key, value);
+    buf_mgr_.unPinPage(&file_, page_number, true);
+  }
+
+  bool get(const std::string& key, std::string& value) {
+    const PageId page_number = pageOf(key);
+    Page* page;
+    buf_mgr_.readPage(&file_, page_number, page);
+    RecordId record_id;
+    const bool found = page->tryFindRecord(key, record_id) == STATUS_OK;
+    if (found) {
+      value = page->getRecord(record_id).substr(KEY_LENGTH);
+    }
+    buf_mgr_.unPinPage(&file_, page_number, false);
+    return found;
+  }
+
+  void flush() { buf_mgr_.flushFile(&file_); }
+
+ private:
+  PageId pageOf(const std::string& key) const {
+    const std::uint64_t prefix = std::stoull(key.substr(0, 8), NULL, 16);
+    return 1 + static_cast<PageId>((prefix * pages_) >> 32);
+  }
+
+  File file_;
+  const std::uint32_t pages_;
+  BufMgr buf_mgr_;
+};
+
+}
+
+int main(int argc, char** argv) {
+  const long keys = bench::argOr(argc, argv, 1, 1000000);
+  const long reads = bench::argOr(argc, argv, 2, 200000);
+  const std::uint32_t frames = bench::argOr(argc, argv, 3, 2000);
+  const std::string dir = argc > 4 ? argv[4] : "";
+  const std::string value(VALUE_LENGTH, 'v');
+  const double user_bytes = static_cast<double>(keys) *
+      (KEY_LENGTH + VALUE_LENGTH);
+
+  std::vector<std::uint64_t> lookups(reads);
+  std::uint64_t state = 42;
+  for (long i = 0; i < reads; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    lookups[i] = (state >> 33) % keys;
+  }
+  std::printf("keys=%ld reads=%ld frames=%u, %zu byte keys, %zu byte values\n",
+              keys, reads, frames, KEY_LENGTH, VALUE_LENGTH);
+
+  {
+    const std::string name = dir + "lsm_bench";
+    LsmTree::destroy(name);
+    double ingest, lookup;
+    LsmStats stats;
+    {
+      LsmTree tree(name);
+      bench::Timer timer;
+      for (long i = 0; i < keys; ++i) {
+        tree.put(makeKey(i), value);
+      }
+      tree.flush();
+      tree.waitForCompactions();
+      ingest = keys / timer.seconds();
+      std::string found;
+      timer.reset();
+      for (long i = 0; i < reads; ++i) {
+        if (tree.get(makeKey(lookups[i]), found) != STATUS_OK) {
+          std::printf("error: key %llu missing\n",
+                      static_cast<unsigned long long>(lookups[i]));
+        }
+      }
+      lookup = reads / timer.seconds();
+      stats = tree.stats();
+    }
+    LsmTree::destroy(name);
+    std::printf("lsm    put %9.0f/s  get %9.0f/s  written %5.2fx  "
+                "runs read/get %.2f  filter skips/get %.2f  "
+                "flushes %llu  compactions %llu  stalls %llu\n",
+                ingest, lookup,
+                (stats.bytes_flushed + stats.bytes_compacted) / user_bytes,
+                static_cast<double>(stats.run_reads) / stats.gets,
+                static_cast<double>(stats.filter_skips) / stats.gets,
+                static_cast<unsigned long long>(stats.flushes),
+                static_cast<unsigned long long>(stats.compactions),
+                static_cast<unsigned long long>(stats.write_stalls));
+    std::printf("       runs by level:");
+    for (std::size_t level = 0; level < stats.level_runs.size(); ++level) {
+      std::printf(" %zu", stats.level_runs[level]);
+    }
+    std::printf("\n");
+  }
+
+  {
+    const std::string filename = dir + "lsm_bench.paged";
+    bench::removeIfExists(filename);
+    // Half full: a page holds about 35 records of this size.
+    const std::uint32_t pages = keys / 17 + 1;
+    double ingest, lookup, written;
+    {
+      PagedStore store(filename, pages, frames);
+      const std::uint64_t before = bytesWritten(filename);
+      bench::Timer timer;
+      for (long i = 0; i < keys; ++i) {
+        store.put(makeKey(i), value);
+      }
+      store.flush();
+      ingest = keys / timer.seconds();
+      written = (bytesWritten(filename) - before) / user_bytes;
+      std::string found;
+      timer.reset();
+      for (long i = 0; i < reads; ++i) {
+        if (!store.get(makeKey(lookups[i]), found)) {
+          std::printf("error: key %llu missing\n",
+                      static_cast<unsigned long long>(lookups[i]));
+        }
+      }
+      lookup = reads / timer.seconds();
+    }
+    File::remove(filename);
+    std::printf("paged  put %9.0f/s  get %9.0f/s  written %5.2fx  "
+                "pages %u\n", ingest, lookup, written, pages);
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Cost of the per-file counters and of exporting them.
+ *
+ * - counter:   one relaxed increment of a file counter, against a plain
+ *              increment, on one thread and with threads sharing a file.
+ * - hit:       readPage()/unPinPage() of a resident page, which counts one
+ *              cache hit.
+ * - read:      File::readPage() of a memory file, which counts a page and
+ *              its bytes.
+ * - export:    rendering and writing the metrics of <files> open files and
+ *              a pool holding pages of all of them.
+ *
+ * Usage: metrics_overhead [ops] [threads] [files]
+ */
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "metrics_exporter.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const PageId PAGES_PER_FILE = 16;
+
+/**
+ * Increments <file>'s hit counter <ops> times from each of <threads>
+ * threads; returns wall clock nanoseconds per increment.
+ */
+double contended(File& file, const long ops, const int threads) {
+  std::vector<std::thread> workers;
+  bench::Timer timer;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&file, ops] {
+      for (long i = 0; i < ops; ++i) {
+        FileStats::add(file.stats().cache_hits, 1);
+      }
+    }));
+  }
+  for (int t = 0; t < threads; ++t) {
+    workers[t].join();
+  }
+  return timer.nanos() / (ops * threads);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long ops = bench::argOr(argc, argv, 1, 10000000);
+  const int threads = bench::argOr(argc, argv, 2, 4);
+  const std::size_t file_count = bench::argOr(argc, argv, 3, 100);
+
+  std::vector<File> files;
+  for (std::size_t f = 0; f < file_count; ++f) {
+    std::stringstream name;
+    name << File::MEMORY_PREFIX << "metrics_overhead." << f;
+    bench::removeIfExists(name.str());
+    files.push_back(File::create(name.str()));
+    for (PageId p = 1; p <= PAGES_PER_FILE; ++p) {
+      Page page = files.back().allocatePage();
+      page.insertRecord(std::string(100, 'a'));
+      files.back().writePage(page);
+    }
+  }
+  std::printf("ops=%ld threads=%d files=%zu\n", ops, threads, file_count);
+  File& file = files[0];
+
+  {
+    volatile std::uint64_t plain = 0;
+    bench::Timer timer;
+    for (long i = 0; i < ops; ++i) {
+      plain = plain + 1;
+    }
+    std::printf("counter, plain increment   %8.2f ns\n", timer.nanos() / ops);
+    timer.reset();
+    for (long i = 0; i < ops; ++i) {
+      FileStats::add(file.stats().cache_hits, 1);
+    }
+    std::printf("counter, relaxed atomic    %8.2f ns\n", timer.nanos() / ops);
+    std::printf("counter, %d threads         %8.2f ns\n", threads,
+                contended(file, ops / threads, threads));
+  }
+
+  {
+    BufMgr bufMgr(file_count * PAGES_PER_FILE + 1);
+    Page* page;
+    for (std::size_t f = 0; f < file_count; ++f) {
+      for (PageId p = 1; p <= PAGES_PER_FILE; ++p) {
+        bufMgr.readPage(&files[f], p, page);
+        bufMgr.unPinPage(&files[f], p, false);
+      }
+    }
+    bench::Timer timer;
+    for (long i = 0; i < ops; ++i) {
+      const PageId page_number = 1 + i % PAGES_PER_FILE;
+      bufMgr.readPage(&file, page_number, page);
+      bufMgr.unPinPage(&file, page_number, false);
+    }
+    std::printf("hit, readPage              %8.1f ns\n", timer.nanos() / ops);
+
+    const long reads = ops / 100;
+    timer.reset();
+    for (long i = 0; i < reads; ++i) {
+      file.readPage(1 + i % PAGES_PER_FILE);
+    }
+    std::printf("read, File::readPage       %8.1f ns\n", timer.nanos() / reads);
+
+    const std::string path = "metrics_overhead.prom";
+    MetricsExporter exporter(MetricsExporter::TEXT_FILE, path,
+                             std::chrono::milliseconds(0));
+    exporter.addPool("bench", &bufMgr);
+    const long exports = 1000;
+    std::size_t bytes = 0;
+    timer.reset();
+    for (long i = 0; i < exports; ++i) {
+      bytes = exporter.render().size();
+    }
+    std::printf("export, render             %8.1f us (%zu bytes)\n",
+                timer.nanos() / exports / 1000, bytes);
+    timer.reset();
+    for (long i = 0; i < exports; ++i) {
+      exporter.exportNow();
+    }
+    std::printf("export, render + write     %8.1f us\n",
+                timer.nanos() / exports / 1000);
+    exporter.removePool(&bufMgr);
+    std::remove(path.c_str());
+  }
+
+  std::vector<std::string> names;
+  for (std::size_t f = 0; f < files.size(); ++f) {
+    names.push_back(files[f].filename());
+  }
+  files.clear();
+  for (std::size_t f = 0; f < names.size(); ++f) {
+    File::remove(names[f]);
+  }
+  return 0;
+}
@@ -0,0 +1,280 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * How well the same memory serves small and large pages when they share one
+ * pool, against splitting it into fixed pools.
+ *
+ * An index is probed one 8 KiB page at a time with a skewed distribution, and
+ * a table is scanned in 64 KiB extents (BufMgr::readExtent()).  The workload
+ * runs in two phases whose mix shifts from mostly probes to mostly scans.
+ * With the same number of frames in total, it runs against:
+ *
+ * - shared:  one pool holding both, evicting by one clock.
+ * - split:   half the frames for index pages, half for table extents.
+ * - 64k:     one pool of 64 KiB frames only, so every index page takes a
+ *            whole extent, of which one page is used.
+ *
+ * For each it prints the hit rates of both kinds of access and the pages read
+ * from the files per phase, and the share of resident pages that were asked
+ * for at the end.
+ *
+ * Usage: mixed_page_bench [frames] [ops_per_phase]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Pages per 64 KiB extent.
+ */
+const std::uint32_t EXTENT_PAGES = 8;
+
+/**
+ * Index pages per file; the index is spread over small files because
+ * allocating a page scans its file.
+ */
+const PageId INDEX_PAGES_PER_FILE = 64;
+
+/**
+ * Counters of one phase.
+ */
+struct PhaseStats {
+  long probes;
+  long probe_hits;
+  long scans;
+  long scan_hits;
+  long diskreads;
+
+  PhaseStats() : probes(0), probe_hits(0), scans(0), scan_hits(0), diskreads(0) {}
+};
+
+/**
+ * Index and table files and the workload over them.
+ */
+class Workload {
+ public:
+  Workload(const std::uint32_t frames, const long ops)
+      : ops_(ops),
+        index_pages_(frames),
+        table_extents_(frames / EXTENT_PAGES),
+        scan_position_(0) {
+    // The 64k layout stores every index page at the start of its own extent.
+    for (PageId p = 0; p < index_pages_; p += INDEX_PAGES_PER_FILE) {
+      index_.push_back(create("mixed_page_bench.index", index_.size(),
+                              INDEX_PAGES_PER_FILE));
+      wide_index_.push_back(create("mixed_page_bench.wide", wide_index_.size(),
+                                   INDEX_PAGES_PER_FILE * EXTENT_PAGES));
+    }
+    table_.push_back(create("mixed_page_bench.table", 0,
+                            table_extents_ * EXTENT_PAGES));
+  }
+
+  ~Workload() {
+    std::vector<std::string> names;
+    for (std::size_t f = 0; f < index_.size(); ++f) {
+      names.push_back(index_[f].filename());
+      names.push_back(wide_index_[f].filename());
+    }
+    names.push_back(table_[0].filename());
+    index_.clear();
+    wide_index_.clear();
+    table_.clear();
+    for (std::size_t f = 0; f < names.size(); ++f) {
+      File::remove(names[f]);
+    }
+  }
+
+  /**
+   * Runs a phase with <probe_percent> of the operations probing the index.
+   * Index pages go to <index_pool> and extents to <table_pool>, which may be
+   * the same pool; with <wide_index>, index pages are read as whole extents.
+   */
+  PhaseStats phase(const int probe_percent, BufMgr& index_pool,
+                   BufMgr& table_pool, const bool wide_index,
+                   std::set<std::pair<File*, PageId> >& used,
+                   std::mt19937& rng) {
+    PhaseStats stats;
+    // Skewed probes: a page is picked with probability falling off with its
+    // rank, so about a fifth of the index takes most of them.
+    std::exponential_distribution<double> rank(5.0 / index_pages_);
+    std::uniform_int_distribution<int> pick_op(0, 99);
+    const int before = index_pool.getBufStats().diskreads +
+                       (&table_pool != &index_pool
+                            ? table_pool.getBufStats().diskreads
+                            : 0);
+    for (long i = 0; i < ops_; ++i) {
+      if (pick_op(rng) < probe_percent) {
+        const PageId page = static_cast<PageId>(rank(rng)) % index_pages_;
+        ++stats.probes;
+        if (wide_index) {
+          File* file = &wide_index_[page / INDEX_PAGES_PER_FILE];
+          const PageId first = 1 + page % INDEX_PAGES_PER_FILE * EXTENT_PAGES;
+          stats.probe_hits += readExtent(index_pool, file, first);
+          used.insert(std::make_pair(file, first));
+        } else {
+          File* file = &index_[page / INDEX_PAGES_PER_FILE];
+          const PageId page_number = 1 + page % INDEX_PAGES_PER_FILE;
+          stats.probe_hits += readPage(index_pool, file, page_number);
+          used.insert(std::make_pair(file, page_number));
+        }
+      } else {
+        const PageId first = 1 + scan_position_ * EXTENT_PAGES;
+        scan_position_ = (scan_position_ + 1) % table_extents_;
+        ++stats.scans;
+        stats.scan_hits += readExtent(table_pool, &table_[0], first);
+        for (std::uint32_t p = 0; p < EXTENT_PAGES; ++p) {
+          used.insert(std::make_pair(&table_[0], first + p));
+        }
+      }
+    }
+    stats.diskreads = index_pool.getBufStats().diskreads +
+                      (&table_pool != &index_pool
+                           ? table_pool.getBufStats().diskreads
+                           : 0) -
+                      before;
+    return stats;
+  }
+
+  /**
+   * Returns how many of the pages resident in <pool> are in <used>.
+   */
+  std::size_t residentUsed(BufMgr& pool,
+                           const std::set<std::pair<File*, PageId> >& used) {
+    std::size_t count = 0;
+    std::set<std::pair<File*, PageId> >::const_iterator it;
+    for (it = used.begin(); it != used.end(); ++it) {
+      File* files[] = {it->first};
+      const PageId page_numbers[] = {it->second};
+      Page* pages[1];
+      if (pool.pinResidentPages(1, files, page_numbers, pages) == 1) {
+        pool.unPinPage(it->first, it->second, false);
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  void resetScan() { scan_position_ = 0; }
+
+ private:
+  static File create(const std::string& prefix, const std::size_t index,
+                     const PageId pages) {
+    std::stringstream name;
+    name << File::MEMORY_PREFIX << prefix << "." << index;
+    bench::removeIfExists(name.str());
+    File file = File::create(name.str());
+    for (PageId p = 0; p < pages; ++p) {
+      Page page = file.allocatePage();
+      page.insertRecord(std::string(100, 'a'));
+      file.writePage(page);
+    }
+    return file;
+  }
+
+  /**
+   * Reads and unpins a page; returns 1 if it was a hit.
+   */
+  static int readPage(BufMgr& pool, File* file, const PageId page_number) {
+    const int before = pool.getBufStats().diskreads;
+    Page* page;
+    pool.readPage(file, page_number, page);
+    pool.unPinPage(file, page_number, false);
+    return pool.getBufStats().diskreads == before ? 1 : 0;
+  }
+
+  /**
+   * Reads and unpins an extent; returns 1 if it was a hit.
+   */
+  static int readExtent(BufMgr& pool, File* file, const PageId first) {
+    const int before = pool.getBufStats().diskreads;
+    Page* pages;
+    pool.readExtent(file, first, EXTENT_PAGES, pages);
+    pool.unPinExtent(file, first, EXTENT_PAGES, false);
+    return pool.getBufStats().diskreads == before ? 1 : 0;
+  }
+
+  const long ops_;
+  const PageId index_pages_;
+  const PageId table_extents_;
+  PageId scan_position_;
+  std::vector<File> index_;
+  std::vector<File> wide_index_;
+  std::vector<File> table_;
+};
+
+void print(const char* name, const int phase, const PhaseStats& stats) {
+  std::printf("%-7s phase %d  probe hits %5.1f%%  scan hits %5.1f%%  "
+              "pages read %7ld\n",
+              name, phase, 100.0 * stats.probe_hits / std::max(1L, stats.probes),
+              100.0 * stats.scan_hits / std::max(1L, stats.scans),
+              stats.diskreads);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const std::uint32_t frames = bench::argOr(argc, argv, 1, 512);
+  const long ops = bench::argOr(argc, argv, 2, 50000);
+  const int mixes[] = {90, 10};
+
+  Workload workload(frames, ops);
+  std::printf("frames=%u (%u KiB) index pages=%u table=%u KiB ops/phase=%ld\n",
+              frames, frames * 8, frames, frames * 8, ops);
+
+  {
+    BufMgr pool(frames);
+    std::set<std::pair<File*, PageId> > used;
+    std::mt19937 rng(7);
+    workload.resetScan();
+    for (int p = 0; p < 2; ++p) {
+      print("shared", p + 1, workload.phase(mixes[p], pool, pool, false, used, rng));
+    }
+    std::printf("shared  resident pages asked for: %zu of %u\n",
+                workload.residentUsed(pool, used), frames);
+  }
+  {
+    BufMgr index_pool(frames / 2);
+    BufMgr table_pool(frames / 2);
+    std::set<std::pair<File*, PageId> > used;
+    std::mt19937 rng(7);
+    workload.resetScan();
+    for (int p = 0; p < 2; ++p) {
+      print("split", p + 1,
+            workload.phase(mixes[p], index_pool, table_pool, false, used, rng));
+    }
+    std::printf("split   resident pages asked for: %zu of %u\n",
+                workload.residentUsed(index_pool, used) +
+                    workload.residentUsed(table_pool, used),
+                frames);
+  }
+  {
+    BufMgr pool(frames);
+    std::set<std::pair<File*, PageId> > used;
+    std::mt19937 rng(7);
+    workload.resetScan();
+    for (int p = 0; p < 2; ++p) {
+      print("64k", p + 1, workload.phase(mixes[p], pool, pool, true, used, rng));
+    }
+    std::printf("64k     resident pages asked for: %zu of %u\n",
+                workload.residentUsed(pool, used), frames);
+  }
+  return 0;
+}
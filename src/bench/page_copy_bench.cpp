@@ -0,0 +1,210 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Heap allocations and page copies of the workloads main.cpp runs.
+ *
+ * Replaces the global operator new to count allocations; an allocation of at
+ * least Page::DATA_SIZE bytes is the data of a page being built or copied, so
+ * those are counted on their own as page buffers.
+ *
+ * - file:      what main() does with File and Page: allocatePage() and
+ *              writePage() of <pages> pages, a FileIterator/PageIterator walk
+ *              of them, readPage() of each and deletePage() of every other
+ *              one.  Per page.
+ * - reuse:     allocatePage() of the pages deleted above, which links each
+ *              back into the middle of the used list.  Per page.
+ * - alloc:     test1: BufMgr::allocPage(), insertRecord() and unPinPage() of
+ *              <pages> pages, then readPage()/unPinPage() of each.  Per page.
+ * - miss:      readPage()/unPinPage() of pages not in a 64 frame pool, so
+ *              every read loads the page.  Per read.
+ * - files:     opening 64 File objects into a std::vector, which moves or
+ *              copies them as it grows.  Per file.
+ *
+ * Usage: page_copy_bench [pages]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
+
+namespace {
+
+std::atomic<long> allocations(0);
+std::atomic<long> page_buffers(0);
+
+}
+
+// GCC sees free() on memory from operator new when it inlines the library's
+// deletes, not knowing that the operator new below calls malloc().
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (size >= badgerdb::Page::DATA_SIZE) {
+    page_buffers.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+#pragma GCC diagnostic pop
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Counts allocations and time from construction; report() prints them per
+ * operation.
+ */
+class Counter {
+ public:
+  Counter()
+      : allocations_(allocations.load()),
+        page_buffers_(page_buffers.load()) {}
+
+  void report(const char* label, const long ops) const {
+    const double ns = timer_.nanos() / ops;
+    std::printf("%-8s %8.2f allocs  %6.2f page buffers  %9.1f ns  per op\n",
+                label,
+                static_cast<double>(allocations.load() - allocations_) / ops,
+                static_cast<double>(page_buffers.load() - page_buffers_) / ops,
+                ns);
+  }
+
+ private:
+  const long allocations_;
+  const long page_buffers_;
+  bench::Timer timer_;
+};
+
+}
+
+int main(int argc, char** argv) {
+  const PageId pages = bench::argOr(argc, argv, 1, 1000);
+  std::printf("pages=%u\n", pages);
+
+  {
+    File file = File::create("page_copy_bench",
+                             std::make_shared<MemoryBackend>());
+    Counter counter;
+    for (PageId i = 0; i < pages; ++i) {
+      Page new_page = file.allocatePage();
+      new_page.insertRecord("hello!");
+      file.writePage(new_page);
+    }
+    long records = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      Page curr_page = *iter;
+      for (PageIterator page_iter = curr_page.begin();
+           page_iter != curr_page.end(); ++page_iter) {
+        records += (*page_iter).size();
+      }
+    }
+    for (PageId p = 1; p <= pages; ++p) {
+      Page page = file.readPage(p);
+      records += page.page_number() == p;
+    }
+    for (PageId p = 2; p <= pages; p += 2) {
+      file.deletePage(p);
+    }
+    counter.report("file", pages);
+    if (records != 7 * static_cast<long>(pages)) {
+      std::printf("error: records went missing\n");
+      return 1;
+    }
+
+    Counter reuse;
+    for (PageId p = 2; p <= pages; p += 2) {
+      file.allocatePage();
+    }
+    reuse.report("reuse", pages / 2);
+  }
+
+  {
+    File file = File::create("page_copy_bench",
+                             std::make_shared<MemoryBackend>());
+    BufMgr bufMgr(pages + 1);
+    std::vector<PageId> page_numbers(pages);
+    Counter counter;
+    Page* page;
+    for (PageId i = 0; i < pages; ++i) {
+      bufMgr.allocPage(&file, page_numbers[i], page);
+      page->insertRecord("test.1 Page");
+      bufMgr.unPinPage(&file, page_numbers[i], true);
+    }
+    for (PageId i = 0; i < pages; ++i) {
+      bufMgr.readPage(&file, page_numbers[i], page);
+      bufMgr.unPinPage(&file, page_numbers[i], false);
+    }
+    counter.report("alloc", pages);
+    bufMgr.flushFile(&file);
+  }
+
+  {
+    File file = File::create("page_copy_bench",
+                             std::make_shared<MemoryBackend>());
+    for (PageId i = 0; i < pages; ++i) {
+      Page page = file.allocatePage();
+      page.insertRecord(std::string(100, 'a'));
+      file.writePage(page);
+    }
+    BufMgr bufMgr(64);
+    Page* page;
+    const long reads = 10 * static_cast<long>(pages);
+    Counter counter;
+    for (long i = 0; i < reads; ++i) {
+      const PageId page_number = 1 + i % pages;
+      bufMgr.readPage(&file, page_number, page);
+      bufMgr.unPinPage(&file, page_number, false);
+    }
+    counter.report("miss", reads);
+  }
+
+  {
+    const int count = 64;
+    std::vector<std::string> names;
+    for (int f = 0; f < count; ++f) {
+      std::stringstream name;
+      name << "page_copy_bench." << f;
+      names.push_back(name.str());
+    }
+    Counter counter;
+    {
+      std::vector<File> files;
+      for (int f = 0; f < count; ++f) {
+        files.push_back(
+            File::create(names[f], std::make_shared<MemoryBackend>()));
+      }
+    }
+    counter.report("files", count);
+  }
+  return 0;
+}
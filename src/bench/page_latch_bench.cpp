@@ -0,0 +1,134 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Throughput of many threads reading and occasionally updating a few hot
+ * pages, with the page contents guarded by one mutex for all pages against
+ * the frames' own reader/writer latches.
+ *
+ * Readers read every record of a page; writers rewrite one record.  Either
+ * way the page is pinned and unpinned through the buffer manager, whose own
+ * latch is the same in both runs.
+ *
+ * Usage: page_latch_bench [threads] [ops_per_thread] [write_percent]
+ *                         [hot_pages]
+ */
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const int RECORDS_PER_PAGE = 16;
+
+/**
+ * Reads every record of a page and returns their total length.
+ */
+std::size_t readRecords(const Page& page) {
+  std::size_t total = 0;
+  for (SlotId slot = 1; slot <= RECORDS_PER_PAGE; ++slot) {
+    RecordId rid;
+    rid.page_number = page.page_number();
+    rid.slot_number = slot;
+    total += page.getRecord(rid).size();
+  }
+  return total;
+}
+
+double run(BufMgr& bufMgr, File& file, const int threads, const long ops,
+           const int write_percent, const PageId hot_pages,
+           const bool frame_latches) {
+  std::mutex pages_mutex;
+  bench::Timer timer;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&, t] {
+      std::uint64_t state = t * 2 + 1;
+      std::size_t sink = 0;
+      for (long i = 0; i < ops; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const PageId page_number = 1 + (state >> 33) % hot_pages;
+        const bool write = static_cast<int>((state >> 20) % 100) < write_percent;
+        const LatchMode mode = write ? LATCH_EXCLUSIVE : LATCH_SHARED;
+        Page* page;
+        if (frame_latches) {
+          bufMgr.readPage(&file, page_number, page, mode);
+        } else {
+          bufMgr.readPage(&file, page_number, page);
+          pages_mutex.lock();
+        }
+        if (write) {
+          RecordId rid;
+          rid.page_number = page_number;
+          rid.slot_number = 1 + i % RECORDS_PER_PAGE;
+          page->updateRecord(rid, std::string(100, 'a' + t % 26));
+        } else {
+          sink += readRecords(*page);
+        }
+        if (frame_latches) {
+          bufMgr.unPinPage(&file, page_number, write, mode);
+        } else {
+          pages_mutex.unlock();
+          bufMgr.unPinPage(&file, page_number, write);
+        }
+      }
+      if (sink == 1) {
+        std::printf(" ");
+      }
+    }));
+  }
+  for (std::size_t t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
+  return threads * ops / timer.seconds();
+}
+
+}
+
+int main(int argc, char** argv) {
+  const int threads = bench::argOr(argc, argv, 1, 32);
+  const long ops = bench::argOr(argc, argv, 2, 20000);
+  const int write_percent = bench::argOr(argc, argv, 3, 5);
+  const PageId hot_pages = bench::argOr(argc, argv, 4, 8);
+
+  const std::string name = std::string(File::MEMORY_PREFIX) + "page_latch_bench";
+  bench::removeIfExists(name);
+  {
+    File file = File::create(name);
+    BufMgr bufMgr(hot_pages + 16);
+    for (PageId p = 0; p < hot_pages; ++p) {
+      Page* page;
+      PageId page_number;
+      bufMgr.allocPage(&file, page_number, page);
+      for (int r = 0; r < RECORDS_PER_PAGE; ++r) {
+        page->insertRecord(std::string(100, 'a'));
+      }
+      bufMgr.unPinPage(&file, page_number, true);
+    }
+
+    std::printf("threads=%d ops/thread=%ld writes=%d%% hot pages=%u cpus=%u\n",
+                threads, ops, write_percent, hot_pages,
+                std::thread::hardware_concurrency());
+    std::printf("one mutex    %10.0f ops/s\n",
+                run(bufMgr, file, threads, ops, write_percent, hot_pages,
+                    false));
+    std::printf("frame latch  %10.0f ops/s\n",
+                run(bufMgr, file, threads, ops, write_percent, hot_pages,
+                    true));
+    bufMgr.flushFile(&file);
+  }
+  File::remove(name);
+  return 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Records per page and the cost of reading them back with prefix-compressed
+ * pages against plain ones.
+ *
+ * Records are keys such as "tenant-0042/us-east-1/orders/000001234567"
+ * followed by an 8 byte value, filled into pages until <pages> pages are
+ * full:
+ *
+ * - clustered: keys in key order, as a sorted run or an index leaf gets
+ *              them, so the records of a page share most of their key.
+ * - sorted:    the same into sorted pages, keyed by the key, in a shuffled
+ *              order within each page's worth of records.
+ * - mixed:     keys of random tenants, regions and tables, as a heap file
+ *              gets them, so little is shared.
+ *
+ * Reports the records per full page, the time per insert, and the time per
+ * tryGetRecord() of every record, which puts prefix-compressed records back
+ * together.
+ *
+ * Usage: prefix_page_bench [pages]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const std::size_t VALUE_LENGTH = 8;
+
+enum Workload { CLUSTERED, SORTED, MIXED };
+
+/**
+ * Returns the key of <id> within <table> of <region> of <tenant>.
+ */
+std::string makeKey(const int tenant, const int region, const int table,
+                    const long id) {
+  static const char* regions[] = {"us-east-1", "us-west-2", "eu-central-1",
+                                  "ap-south-1"};
+  static const char* tables[] = {"orders", "users", "events"};
+  char key[64];
+  std::snprintf(key, sizeof(key), "tenant-%04d/%s/%s/%012ld", tenant,
+                regions[region], tables[table], id);
+  return key;
+}
+
+/**
+ * Fills pages with records until <pages> of them are full; sets
+ * <per_page> to the records per full page and <insert> and <get> to the
+ * nanoseconds per record of filling and of reading them.
+ */
+void fill(const Workload workload, const bool compressed, const long pages,
+          std::mt19937& random, double& per_page, double& insert,
+          double& get) {
+  std::vector<Page> filled;
+  std::vector<std::vector<RecordId> > record_ids;
+  std::vector<std::string> keys;
+  const std::string value(VALUE_LENGTH, 'v');
+  long next_id = 0;
+  long records = 0;
+  double nanos = 0;
+  while (static_cast<long>(filled.size()) < pages) {
+    // A page's worth of keys at a time, more than any page holds.
+    keys.clear();
+    for (int i = 0; i < 1000; ++i) {
+      if (workload == MIXED) {
+        keys.push_back(makeKey(random() % 1000, random() % 4, random() % 3,
+                               random() % 1000000000));
+      } else {
+        keys.push_back(makeKey(42, 0, 0, next_id++));
+      }
+    }
+    if (workload == SORTED) {
+      std::shuffle(keys.begin(), keys.end(), random);
+    }
+    Page page;
+    if (workload == SORTED) {
+      page.makeSorted();
+    }
+    if (compressed) {
+      page.makePrefixCompressed();
+    }
+    std::vector<RecordId> page_ids;
+    RecordId record_id;
+    bench::Timer timer;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      const Status status = workload == SORTED
+          ? page.tryInsertRecord(keys[i], value, record_id)
+          : page.tryInsertRecord(keys[i] + value, record_id);
+      if (status != STATUS_OK) {
+        break;
+      }
+      page_ids.push_back(record_id);
+    }
+    nanos += timer.nanos();
+    records += page_ids.size();
+    filled.push_back(page);
+    record_ids.push_back(page_ids);
+  }
+  per_page = static_cast<double>(records) / pages;
+  insert = nanos / records;
+
+  const int rounds = 20;
+  std::string record;
+  std::size_t bytes = 0;
+  bench::Timer timer;
+  for (int r = 0; r < rounds; ++r) {
+    for (std::size_t p = 0; p < filled.size(); ++p) {
+      for (std::size_t i = 0; i < record_ids[p].size(); ++i) {
+        filled[p].tryGetRecord(record_ids[p][i], record);
+        bytes += record.size();
+      }
+    }
+  }
+  get = timer.nanos() / (rounds * records);
+  if (bytes == 0) {
+    std::printf("error: no records\n");
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long pages = bench::argOr(argc, argv, 1, 200);
+  std::mt19937 random(42);
+
+  std::printf("pages=%ld, records of %zu bytes\n", pages,
+              makeKey(42, 0, 0, 0).length() + VALUE_LENGTH);
+  const char* names[] = {"clustered", "sorted", "mixed"};
+  const Workload workloads[] = {CLUSTERED, SORTED, MIXED};
+  for (int w = 0; w < 3; ++w) {
+    double plain_per_page, plain_insert, plain_get;
+    double prefix_per_page, prefix_insert, prefix_get;
+    fill(workloads[w], false, pages, random, plain_per_page, plain_insert,
+         plain_get);
+    fill(workloads[w], true, pages, random, prefix_per_page, prefix_insert,
+         prefix_get);
+    std::printf("%-9s  per page: plain %6.1f  prefix %6.1f (x%.2f)   "
+                "insert: plain %6.1f  prefix %6.1f   get: plain %5.1f  "
+                "prefix %5.1f ns/record\n",
+                names[w], plain_per_page, prefix_per_page,
+                prefix_per_page / plain_per_page, plain_insert, prefix_insert,
+                plain_get, prefix_get);
+  }
+  return 0;
+}
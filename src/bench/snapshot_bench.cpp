@@ -0,0 +1,120 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Cost of BufMgr::snapshot() as the buffer pool grows.
+ *
+ * Fills pools of increasing size with pages from in-memory files, then times
+ * snapshots that read only the counters, that sample the default number of
+ * frames for the age histogram, and that scan every frame.  The longest time
+ * the pool latch is held in one go is one batch of sampled frames, reported
+ * as "latch hold".
+ *
+ * Every frame costs a whole page of memory, so the largest pool this can
+ * build is bounded by RAM; the per-frame cost of the exact scan extrapolates
+ * to larger pools.
+ *
+ * If a file name is given, the last snapshot is written to it for the
+ * bufstat tool.
+ *
+ * Usage: snapshot_bench [max_frames] [pages_per_file] [snapshot_out]
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Returns the median time of <rounds> snapshots in microseconds.
+ */
+double timeSnapshot(BufMgr& bufMgr, const std::uint32_t sample_frames,
+                    const int rounds, BufPoolSnapshot& last) {
+  std::vector<double> samples;
+  for (int r = 0; r < rounds; ++r) {
+    bench::Timer timer;
+    last = bufMgr.snapshot(sample_frames);
+    samples.push_back(timer.nanos() / 1e3);
+  }
+  return bench::percentile(samples, 50);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const std::uint32_t max_frames = bench::argOr(argc, argv, 1, 100000);
+  const PageId pages_per_file = bench::argOr(argc, argv, 2, 64);
+
+  BufPoolSnapshot last;
+  for (std::uint32_t frames = 1000; frames <= max_frames; frames *= 10) {
+    std::vector<std::string> names;
+    {
+      std::vector<File> files;
+      BufMgr bufMgr(frames);
+      Page* page;
+      PageId page_number;
+      for (std::uint32_t f = 0; f * pages_per_file < frames; ++f) {
+        std::stringstream name;
+        name << File::MEMORY_PREFIX << "snapshot_bench." << f;
+        names.push_back(name.str());
+        files.push_back(File::create(name.str()));
+      }
+      // The vector no longer grows, so pointers into it stay valid.
+      for (std::uint32_t i = 0; i < frames; ++i) {
+        File* file = &files[i / pages_per_file];
+        bufMgr.allocPage(file, page_number, page);
+        bufMgr.unPinPage(file, page_number, i % 4 == 0);
+      }
+
+      bench::Timer timer;
+      const long hits = 200000;
+      for (long i = 0; i < hits; ++i) {
+        const std::uint32_t frame = (i * 7919) % frames;
+        File* file = &files[frame / pages_per_file];
+        page_number = 1 + frame % pages_per_file;
+        bufMgr.readPage(file, page_number, page);
+        bufMgr.unPinPage(file, page_number, false);
+      }
+      const double hit_ns = timer.nanos() / hits;
+
+      const int rounds = frames >= 100000 ? 5 : 20;
+      const double counters_us = timeSnapshot(bufMgr, 0, rounds, last);
+      const double sampled_us = timeSnapshot(
+          bufMgr, BufMgr::DEFAULT_SAMPLE_FRAMES, rounds, last);
+      const double exact_us = timeSnapshot(bufMgr, frames, rounds, last);
+      const double batches = (frames + 255) / 256.0;
+
+      std::printf("frames=%-7u files=%-5zu hit=%.0fns counters=%.1fus "
+                  "sampled=%.1fus exact=%.1fus (%.2f ns/frame) "
+                  "latch hold=%.1fus\n",
+                  frames, files.size(), hit_ns, counters_us, sampled_us,
+                  exact_us, exact_us * 1e3 / frames, exact_us / batches);
+
+      for (std::size_t f = 0; f < files.size(); ++f) {
+        bufMgr.flushFile(&files[f]);
+      }
+    }
+    for (std::size_t f = 0; f < names.size(); ++f) {
+      File::remove(names[f]);
+    }
+  }
+
+  if (argc > 3) {
+    std::ofstream out(argv[3]);
+    last.write(out);
+    std::printf("wrote %s\n", argv[3]);
+  }
+  return 0;
+}
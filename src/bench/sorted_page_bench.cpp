@@ -0,0 +1,149 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Finding a record by key within a page, with and without a sorted key
+ * directory.
+ *
+ * For each number of records per page, fills one page in insertion order and
+ * one sorted page with the same records, inserted in a shuffled order.  Each
+ * record starts with a key of up to 8 bytes.  Then looks up every key, in a
+ * shuffled order:
+ *
+ * - iterator: a PageIterator walk comparing the key with each record, as a
+ *             caller without a directory does.
+ * - scan:     tryFindRecord() on the unsorted page, which compares records in
+ *             place.
+ * - sorted:   tryFindRecord() on the sorted page, a binary search.
+ *
+ * Also reports the time per insert into each page.  Records are made as long
+ * as the page allows, up to 64 bytes; at 8 KiB per page no more than about
+ * 580 records fit once each has a slot and a directory entry.
+ *
+ * Usage: sorted_page_bench [rounds]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "page.h"
+#include "page_iterator.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Returns the <length> byte big-endian encoding of <value>.
+ */
+std::string encodeKey(std::size_t value, const std::size_t length) {
+  std::string key(length, '\0');
+  for (std::size_t i = length; i > 0; --i) {
+    key[i - 1] = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  return key;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long rounds = bench::argOr(argc, argv, 1, 200);
+  std::mt19937 random(42);
+
+  std::printf("rounds=%ld\n", rounds);
+  const std::size_t counts[] = {50, 100, 200, 400, 500};
+  for (std::size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    const std::size_t count = counts[c];
+    const std::size_t record_length = std::min<std::size_t>(
+        64, Page::DATA_SIZE / count - sizeof(PageSlot) - sizeof(PageKeySlot));
+    const std::size_t key_length = std::min<std::size_t>(8, record_length);
+    std::vector<std::string> keys;
+    // Keys differ in their first (up to) 3 bytes, in a scattered order.
+    const std::size_t varying = std::min<std::size_t>(key_length, 3);
+    for (std::size_t i = 0; i < count; ++i) {
+      keys.push_back(encodeKey(i * 104729 % (1 << (8 * varying)), varying) +
+                     std::string(key_length - varying, 'k'));
+    }
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), random);
+    const std::string value(record_length - key_length, 'v');
+    std::vector<std::string> records;
+    for (std::size_t i = 0; i < count; ++i) {
+      records.push_back(keys[i] + value);
+    }
+
+    Page plain;
+    Page sorted;
+    bench::Timer timer;
+    for (long r = 0; r < rounds; ++r) {
+      plain = Page();
+      for (std::size_t i = 0; i < count; ++i) {
+        plain.insertRecord(records[order[i]]);
+      }
+    }
+    const double plain_insert = timer.nanos() / (rounds * count);
+    timer.reset();
+    for (long r = 0; r < rounds; ++r) {
+      sorted = Page();
+      sorted.makeSorted();
+      for (std::size_t i = 0; i < count; ++i) {
+        sorted.insertRecord(keys[order[i]], value);
+      }
+    }
+    const double sorted_insert = timer.nanos() / (rounds * count);
+
+    std::shuffle(order.begin(), order.end(), random);
+    long found = 0;
+    timer.reset();
+    for (long r = 0; r < rounds; ++r) {
+      for (std::size_t i = 0; i < count; ++i) {
+        const std::string& key = keys[order[i]];
+        for (PageIterator iter = plain.begin(); iter != plain.end(); ++iter) {
+          if ((*iter).compare(0, key_length, key) == 0) {
+            ++found;
+            break;
+          }
+        }
+      }
+    }
+    const double iterator = timer.nanos() / (rounds * count);
+    timer.reset();
+    RecordId record_id;
+    for (long r = 0; r < rounds; ++r) {
+      for (std::size_t i = 0; i < count; ++i) {
+        found += plain.tryFindRecord(records[order[i]], record_id) ==
+            STATUS_OK;
+      }
+    }
+    const double scan = timer.nanos() / (rounds * count);
+    timer.reset();
+    for (long r = 0; r < rounds; ++r) {
+      for (std::size_t i = 0; i < count; ++i) {
+        found += sorted.tryFindRecord(keys[order[i]], record_id) == STATUS_OK;
+      }
+    }
+    const double binary = timer.nanos() / (rounds * count);
+    if (found != 3 * rounds * static_cast<long>(count)) {
+      std::printf("error: a key was not found\n");
+      return 1;
+    }
+    std::printf("%4zu records of %2zu bytes  lookup: iterator %8.1f  scan "
+                "%7.1f  sorted %6.1f ns   insert: plain %6.1f  sorted %6.1f "
+                "ns\n",
+                count, record_length, iterator, scan, binary, plain_insert,
+                sorted_insert);
+  }
+  return 0;
+}
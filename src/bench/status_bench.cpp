@@ -0,0 +1,149 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Cost of reporting expected conditions with exceptions against statuses.
+ *
+ * - insert:  fills <pages> pages through the pool with records of several
+ *            sizes, moving to a new page when the current one is full.  The
+ *            full page is found by catching InsufficientSpaceException, by
+ *            asking hasSpaceForRecord() first, or by tryInsertRecord().
+ * - miss:    readPage()/unPinPage() of pages not in a 64 frame pool, so
+ *            every read looks the page up, misses and loads it.
+ * - invalid: reading a page that does not exist, catching
+ *            InvalidPageException against tryReadPage().
+ *
+ * Usage: status_bench [pages]
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+enum InsertMode { CATCH, CHECK, STATUS };
+
+/**
+ * Fills <pages> pages of a new memory file with records of <record_size>
+ * bytes; returns nanoseconds per record.
+ */
+double fill(const PageId pages, const std::size_t record_size,
+            const InsertMode mode) {
+  File file = File::create("status_bench", std::make_shared<MemoryBackend>());
+  BufMgr bufMgr(pages + 1);
+  const std::string record(record_size, 'a');
+  PageId page_number;
+  Page* page;
+  bufMgr.allocPage(&file, page_number, page);
+  PageId filled = 0;
+  long records = 0;
+  bench::Timer timer;
+  while (filled < pages) {
+    RecordId record_id;
+    bool full = false;
+    switch (mode) {
+      case CATCH:
+        try {
+          record_id = page->insertRecord(record);
+        } catch (const InsufficientSpaceException&) {
+          full = true;
+        }
+        break;
+      case CHECK:
+        full = !page->hasSpaceForRecord(record);
+        if (!full) {
+          record_id = page->insertRecord(record);
+        }
+        break;
+      case STATUS:
+        full = page->tryInsertRecord(record, record_id) != STATUS_OK;
+        break;
+    }
+    if (full) {
+      bufMgr.unPinPage(&file, page_number, true);
+      if (++filled < pages) {
+        bufMgr.allocPage(&file, page_number, page);
+      }
+    } else {
+      ++records;
+    }
+  }
+  const double ns = timer.nanos() / records;
+  bufMgr.flushFile(&file);
+  return ns;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const PageId pages = bench::argOr(argc, argv, 1, 2000);
+
+  std::printf("pages=%u\n", pages);
+  const std::size_t sizes[] = {16, 100, 1000};
+  for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    const double caught = fill(pages, sizes[s], CATCH);
+    const double checked = fill(pages, sizes[s], CHECK);
+    const double status = fill(pages, sizes[s], STATUS);
+    std::printf("insert, %4zu byte records  catch %7.1f  check %7.1f  "
+                "status %7.1f ns/record\n",
+                sizes[s], caught, checked, status);
+  }
+
+  File file = File::create("status_bench", std::make_shared<MemoryBackend>());
+  const PageId file_pages = 1024;
+  for (PageId i = 0; i < file_pages; ++i) {
+    Page page = file.allocatePage();
+    page.insertRecord(std::string(100, 'a'));
+    file.writePage(page);
+  }
+  {
+    BufMgr bufMgr(64);
+    Page* page;
+    const long reads = 100000;
+    bench::Timer timer;
+    for (long i = 0; i < reads; ++i) {
+      const PageId page_number = 1 + i % file_pages;
+      bufMgr.readPage(&file, page_number, page);
+      bufMgr.unPinPage(&file, page_number, false);
+    }
+    std::printf("miss, readPage             %8.1f ns\n", timer.nanos() / reads);
+
+    const long lookups = 100000;
+    long invalid = 0;
+    timer.reset();
+    for (long i = 0; i < lookups; ++i) {
+      try {
+        bufMgr.readPage(&file, file_pages + 1, page);
+      } catch (const InvalidPageException&) {
+        ++invalid;
+      }
+    }
+    std::printf("invalid, catch             %8.1f ns\n",
+                timer.nanos() / lookups);
+    timer.reset();
+    for (long i = 0; i < lookups; ++i) {
+      if (bufMgr.tryReadPage(&file, file_pages + 1, page) != STATUS_OK) {
+        ++invalid;
+      }
+    }
+    std::printf("invalid, status            %8.1f ns\n",
+                timer.nanos() / lookups);
+    if (invalid != 2 * lookups) {
+      std::printf("error: a missing page was read\n");
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Index traversal throughput with and without pointer swizzling.
+ *
+ * Builds a three-level tree of pages, root, inner nodes and leaves, and
+ * keeps the child references of each node in memory as PageRefs, the way an
+ * index keeps decoded nodes.  Each lookup walks from the root to a random
+ * leaf, pinning every page on the way and reading a record from it.  With
+ * swizzling off the pages are read by page number, which looks each one up
+ * in the hash table; with it on they are read through the references, which
+ * skips the lookup once a reference points at its frame.
+ *
+ * The run is repeated with a pool that holds the whole tree and with one
+ * that holds only a quarter of the leaves, where references are unswizzled
+ * as their leaves are evicted.
+ *
+ * Usage: swizzle_bench [fanout] [lookups]
+ */
+
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "buffer.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Pages per file; the tree is spread over small files because allocating a
+ * page scans its file.
+ */
+const PageId PAGES_PER_FILE = 64;
+
+/**
+ * In-memory copy of a tree node.
+ */
+struct Node {
+  Node(File* node_file, const PageId page_number)
+      : file(node_file), ref(page_number) {}
+
+  File* file;
+  PageRef ref;
+  std::vector<std::unique_ptr<Node> > children;
+};
+
+class Tree {
+ public:
+  explicit Tree(const std::size_t fanout) : fanout_(fanout), pages_(0) {
+    root_.reset(newNode());
+    for (std::size_t i = 0; i < fanout; ++i) {
+      root_->children.push_back(std::unique_ptr<Node>(newNode()));
+      for (std::size_t j = 0; j < fanout; ++j) {
+        root_->children[i]->children.push_back(std::unique_ptr<Node>(newNode()));
+      }
+    }
+  }
+
+  ~Tree() {
+    root_.reset();
+    std::vector<std::string> names;
+    for (std::size_t f = 0; f < files_.size(); ++f) {
+      names.push_back(files_[f]->filename());
+    }
+    files_.clear();
+    for (std::size_t f = 0; f < names.size(); ++f) {
+      File::remove(names[f]);
+    }
+  }
+
+  std::size_t pages() const { return pages_; }
+  std::size_t leaves() const { return fanout_ * fanout_; }
+
+  /**
+   * Runs <lookups> root-to-leaf walks and returns lookups per second.
+   */
+  double run(BufMgr& bufMgr, const long lookups, const bool swizzle) {
+    std::uint64_t state = 1;
+    std::size_t sink = 0;
+    bench::Timer timer;
+    for (long i = 0; i < lookups; ++i) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      const std::size_t leaf = (state >> 33) % leaves();
+      Node* node = root_.get();
+      sink += visit(bufMgr, node, swizzle);
+      node = node->children[leaf / fanout_].get();
+      sink += visit(bufMgr, node, swizzle);
+      node = node->children[leaf % fanout_].get();
+      sink += visit(bufMgr, node, swizzle);
+    }
+    const double rate = lookups / timer.seconds();
+    if (sink == 1) {
+      std::printf(" ");
+    }
+    return rate;
+  }
+
+ private:
+  Node* newNode() {
+    if (pages_ % PAGES_PER_FILE == 0) {
+      std::stringstream name;
+      name << File::MEMORY_PREFIX << "swizzle_bench." << files_.size();
+      bench::removeIfExists(name.str());
+      files_.push_back(std::unique_ptr<File>(new File(File::create(name.str()))));
+    }
+    File* file = files_.back().get();
+    Page page = file->allocatePage();
+    page.insertRecord(std::string(32, 'k'));
+    file->writePage(page);
+    ++pages_;
+    return new Node(file, page.page_number());
+  }
+
+  static std::size_t visit(BufMgr& bufMgr, Node* node, const bool swizzle) {
+    Page* page;
+    if (swizzle) {
+      bufMgr.readPage(node->file, node->ref, page);
+    } else {
+      bufMgr.readPage(node->file, node->ref.page_number(), page);
+    }
+    const RecordId rid = {node->ref.page_number(), 1};
+    const std::size_t length = page->getRecord(rid).size();
+    bufMgr.unPinPage(node->file, node->ref.page_number(), false);
+    return length;
+  }
+
+  const std::size_t fanout_;
+  std::size_t pages_;
+  std::vector<std::unique_ptr<File> > files_;
+  std::unique_ptr<Node> root_;
+};
+
+}
+
+int main(int argc, char** argv) {
+  const std::size_t fanout = bench::argOr(argc, argv, 1, 64);
+  const long lookups = bench::argOr(argc, argv, 2, 1000000);
+
+  Tree tree(fanout);
+  const std::uint32_t sizes[] = {
+      static_cast<std::uint32_t>(tree.pages() + tree.pages() / 4),
+      static_cast<std::uint32_t>(1 + fanout + tree.leaves() / 4)};
+  const char* names[] = {"whole tree", "quarter of leaves"};
+  std::printf("fanout=%zu pages=%zu lookups=%ld\n", fanout, tree.pages(),
+              lookups);
+  for (int s = 0; s < 2; ++s) {
+    for (int swizzle = 0; swizzle < 2; ++swizzle) {
+      BufMgr bufMgr(sizes[s]);
+      // Warm the pool, and swizzle what fits.
+      tree.run(bufMgr, lookups / 10, swizzle != 0);
+      const double rate = tree.run(bufMgr, lookups, swizzle != 0);
+      std::printf("%-18s frames=%-6u swizzling %-3s %10.0f lookups/s\n",
+                  names[s], sizes[s], swizzle ? "on" : "off", rate);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Cost of the tracing hooks on buffer pool hits.
+ *
+ * Repeatedly pins a resident page, reads a record from it and unpins it, which
+ * crosses three traced calls per operation and no I/O, so the hooks are as
+ * large a share of the time as they get.  The loop runs with tracing off and
+ * at each level with several sampling intervals.
+ *
+ * Build it with and without BADGERDB_TRACE (make bench TRACE=1, or
+ * -DBADGERDB_TRACE=ON with CMake) to compare against the compiled-out hooks.
+ * If a file name is given, the spans of the last run are written to it as
+ * Chrome trace JSON.
+ *
+ * Usage: trace_overhead [ops] [trace.json]
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "bench_util.h"
+#include "buffer.h"
+#include "trace.h"
+
+using namespace badgerdb;
+
+namespace {
+
+const PageId NUM_PAGES = 16;
+
+double run(BufMgr& bufMgr, File& file, const long ops) {
+  Page* page;
+  bench::Timer timer;
+  for (long i = 0; i < ops; ++i) {
+    const PageId page_number = 1 + i % NUM_PAGES;
+    bufMgr.readPage(&file, page_number, page);
+    const RecordId rid = {page_number, 1};
+    if (page->getRecord(rid).empty()) {
+      std::printf("unexpected empty record\n");
+    }
+    bufMgr.unPinPage(&file, page_number, false);
+  }
+  return timer.nanos() / ops;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const long ops = bench::argOr(argc, argv, 1, 2000000);
+
+#ifdef BADGERDB_TRACE
+  std::printf("tracing compiled in\n");
+#else
+  std::printf("tracing compiled out\n");
+#endif
+
+  const std::string filename = std::string(File::MEMORY_PREFIX) + "trace.db";
+  {
+    File file = File::create(filename);
+    for (PageId i = 0; i < NUM_PAGES; ++i) {
+      Page page = file.allocatePage();
+      page.insertRecord("a record that is read back on every operation");
+      file.writePage(page);
+    }
+    BufMgr bufMgr(NUM_PAGES * 2);
+    run(bufMgr, file, ops / 10);
+
+    Tracer::setLevel(TRACE_OFF);
+    std::printf("level=off            %6.1f ns/op\n",
+                run(bufMgr, file, ops));
+
+    const TraceLevel levels[] = {TRACE_IO, TRACE_ALL};
+    const std::uint32_t intervals[] = {1, 16, 256};
+    for (std::size_t l = 0; l < 2; ++l) {
+      for (std::size_t s = 0; s < 3; ++s) {
+        Tracer::clear();
+        Tracer::setLevel(levels[l]);
+        Tracer::setSampleInterval(intervals[s]);
+        const double ns = run(bufMgr, file, ops);
+        Tracer::setLevel(TRACE_OFF);
+        std::printf("level=%-3s sample=1/%-3u %6.1f ns/op spans=%zu\n",
+                    levels[l] == TRACE_IO ? "io" : "all", intervals[s], ns,
+                    Tracer::recordedSpans());
+      }
+    }
+
+    if (argc > 2) {
+      std::ofstream out(argv[2]);
+      Tracer::exportChromeJson(out);
+      std::printf("wrote %s\n", argv[2]);
+    }
+    bufMgr.flushFile(&file);
+  }
+  File::remove(filename);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Smallest bit array, so that filters of a few keys are not all collisions.
+ */
+const std::size_t MIN_BITS = 64;
+
+/**
+ * Most probes per key.
+ */
+const std::size_t MAX_PROBES = 30;
+
+}
+
+BloomFilter::BloomFilter(const std::vector<std::uint64_t>& hashes,
+                         const std::size_t bits_per_key) {
+  assert(bits_per_key > 0);
+  // ln 2 bits per key and probe give the fewest false positives.
+  const std::size_t probes = std::min(
+      MAX_PROBES, std::max<std::size_t>(1, bits_per_key * 69 / 100));
+  const std::size_t bytes =
+      (std::max(MIN_BITS, hashes.size() * bits_per_key) + 7) / 8;
+  const std::uint64_t bit_count = bytes * 8;
+  bits_.assign(bytes + 1, '\0');
+  bits_[bytes] = static_cast<char>(probes);
+  for (std::size_t i = 0; i < hashes.size(); ++i) {
+    // Double hashing: the probes step through the array by the high half.
+    std::uint64_t bit = hashes[i];
+    const std::uint64_t step = (hashes[i] >> 32) | 1;
+    for (std::size_t p = 0; p < probes; ++p) {
+      const std::uint64_t index = bit % bit_count;
+      bits_[index / 8] |= static_cast<char>(1 << (index % 8));
+      bit += step;
+    }
+  }
+}
+
+BloomFilter::BloomFilter(const std::string& bits) : bits_(bits) {}
+
+bool BloomFilter::mayContain(const std::string& key) const {
+  if (bits_.size() < 2) {
+    return true;
+  }
+  const std::uint64_t bit_count = (bits_.size() - 1) * 8;
+  const std::size_t probes =
+      static_cast<unsigned char>(bits_[bits_.size() - 1]);
+  const std::uint64_t key_hash = hash(key);
+  std::uint64_t bit = key_hash;
+  const std::uint64_t step = (key_hash >> 32) | 1;
+  for (std::size_t p = 0; p < probes; ++p) {
+    const std::uint64_t index = bit % bit_count;
+    if ((static_cast<unsigned char>(bits_[index / 8]) &
+         (1 << (index % 8))) == 0) {
+      return false;
+    }
+    bit += step;
+  }
+  return true;
+}
+
+std::uint64_t BloomFilter::hash(const std::string& key) {
+  // FNV-1a, then the finalizer of MurmurHash3 to spread the bits.
+  std::uint64_t h = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < key.size(); ++i) {
+    h ^= static_cast<unsigned char>(key[i]);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+}
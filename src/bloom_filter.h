@@ -0,0 +1,77 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace badgerdb {
+
+/**
+ * @brief Set of keys that answers "maybe present" or "certainly absent".
+ *
+ * Each key sets <probes> bits of a bit array, chosen by double hashing of
+ * one 64-bit hash of the key.  With 10 bits per key and 7 probes, about 1%
+ * of the keys not in the set are reported as maybe present.
+ *
+ * The bits are a string that can be stored and read back: the array
+ * followed by a byte holding the number of probes.  The hash does not
+ * depend on the platform, so stored filters stay valid.
+ */
+class BloomFilter {
+ public:
+  /**
+   * Builds a filter of the keys whose hashes (see hash()) are given.
+   *
+   * @param hashes        Hashes of the keys.
+   * @param bits_per_key  Bits of the array per key, at least 1.
+   */
+  BloomFilter(const std::vector<std::uint64_t>& hashes,
+              const std::size_t bits_per_key);
+
+  /**
+   * Takes a filter built earlier, as returned by bits().  An empty string
+   * makes a filter that reports every key as maybe present.
+   *
+   * @param bits  Bits of the filter.
+   */
+  explicit BloomFilter(const std::string& bits = std::string());
+
+  /**
+   * Returns false if <key> is certainly not in the set.
+   *
+   * @param key   Key to look for.
+   * @return  Whether the key may be in the set.
+   */
+  bool mayContain(const std::string& key) const;
+
+  /**
+   * Returns the bits of the filter, to be stored.
+   *
+   * @return  Bit array followed by the number of probes.
+   */
+  const std::string& bits() const { return bits_; }
+
+  /**
+   * Returns the hash of <key> that filters are built from.
+   *
+   * @param key   Key to hash.
+   * @return  64-bit hash.
+   */
+  static std::uint64_t hash(const std::string& key);
+
+ private:
+  /**
+   * Bit array followed by the number of probes.
+   */
+  std::string bits_;
+};
+
+}
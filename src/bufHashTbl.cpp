@@ -5,16 +5,20 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
 #include <memory>
 #include <iostream>
 #include "buffer.h"
 #include "bufHashTbl.h"
+#include "epoch_manager.h"
 #include "exceptions/hash_already_present_exception.h"
 #include "exceptions/hash_not_found_exception.h"
 #include "exceptions/hash_table_exception.h"
 
 namespace badgerdb {
 
+const std::size_t BufHashTbl::LOOKUP_GROUP;
+
 int BufHashTbl::hash(const File* file, const PageId pageNo)
 {
   int tmp, value;
@@ -23,11 +27,11 @@ int BufHashTbl::hash(const File* file, const PageId pageNo)
   return value;
 }
 
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+BufHashTbl::BufHashTbl(int htSize, EpochManager* epochs)
+	: HTSIZE(htSize), epochs(epochs)
 {
   // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
+  ht = new std::atomic<hashBucket*> [htSize];
   for(int i=0; i < HTSIZE; i++)
     ht[i] = NULL;
 }
@@ -36,10 +40,10 @@ BufHashTbl::~BufHashTbl()
 {
   for(int i = 0; i < HTSIZE; i++) {
     hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
+    while (tmpBuf) {
+      hashBucket* next = tmpBuf->next;
       delete tmpBuf;
+      tmpBuf = next;
     }
   }
   delete [] ht;
@@ -63,27 +67,102 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
   tmpBuc->file = (File*) file;
   tmpBuc->pageNo = pageNo;
   tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  tmpBuc->next.store(ht[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  // Publish the bucket only once it is filled in.
+  ht[index].store(tmpBuc, std::memory_order_release);
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+hashBucket* BufHashTbl::find(const File* file, const PageId pageNo)
 {
   int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
+  hashBucket* tmpBuc = ht[index].load(std::memory_order_acquire);
   while (tmpBuc) {
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
+      return tmpBuc;
+    tmpBuc = tmpBuc->next.load(std::memory_order_acquire);
   }
+  return NULL;
+}
 
-  throw HashNotFoundException(file->filename(), pageNo);
+void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+{
+  if (tryLookup(file, pageNo, frameNo) != STATUS_OK)
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+Status BufHashTbl::tryLookup(const File* file, const PageId pageNo, FrameId &frameNo)
+{
+  hashBucket* tmpBuc = find(file, pageNo);
+  if (tmpBuc == NULL)
+    return STATUS_NOT_FOUND;
+  frameNo = tmpBuc->frameNo; // return frameNo by reference
+  return STATUS_OK;
+}
+
+std::size_t BufHashTbl::lookupBatch(const std::size_t count, const File* const* files, const PageId* pageNos,
+                                    FrameId* frameNos, bool* found)
+{
+  // A lone page has nothing to overlap with; staging would only add work.
+  if (count == 1) {
+    hashBucket* tmpBuc = find(files[0], pageNos[0]);
+    found[0] = tmpBuc != NULL;
+    if (found[0])
+      frameNos[0] = tmpBuc->frameNo;
+    return found[0] ? 1 : 0;
+  }
+
+  std::size_t hits = 0;
+  int index[LOOKUP_GROUP];
+  hashBucket* cursor[LOOKUP_GROUP];
+
+  for (std::size_t start = 0; start < count; start += LOOKUP_GROUP) {
+    const std::size_t n = std::min(LOOKUP_GROUP, count - start);
+    const File* const* groupFiles = files + start;
+    const PageId* groupPages = pageNos + start;
+
+    // Hash every page and prefetch its slot.
+    for (std::size_t i = 0; i < n; i++) {
+      index[i] = hash(groupFiles[i], groupPages[i]);
+      prefetch(&ht[index[i]]);
+      found[start + i] = false;
+    }
+    // Read the slots and prefetch the first bucket of each chain.
+    for (std::size_t i = 0; i < n; i++) {
+      cursor[i] = ht[index[i]].load(std::memory_order_acquire);
+      if (cursor[i])
+        prefetch(cursor[i]);
+    }
+    // Walk the chains side by side, one bucket per page and round.
+    for (bool walking = true; walking;) {
+      walking = false;
+      for (std::size_t i = 0; i < n; i++) {
+        hashBucket* tmpBuc = cursor[i];
+        if (tmpBuc == NULL)
+          continue;
+        if (tmpBuc->file == groupFiles[i] && tmpBuc->pageNo == groupPages[i]) {
+          frameNos[start + i] = tmpBuc->frameNo;
+          found[start + i] = true;
+          hits++;
+          cursor[i] = NULL;
+          continue;
+        }
+        cursor[i] = tmpBuc->next.load(std::memory_order_acquire);
+        if (cursor[i]) {
+          prefetch(cursor[i]);
+          walking = true;
+        }
+      }
+    }
+  }
+  return hits;
 }
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
+  if (tryRemove(file, pageNo) != STATUS_OK)
+    throw HashNotFoundException(file->filename(), pageNo);
+}
+
+Status BufHashTbl::tryRemove(const File* file, const PageId pageNo) {
 
   int index = hash(file, pageNo);
   hashBucket* tmpBuc = ht[index];
@@ -93,13 +172,17 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
 	{
     if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
 		{
+      // Readers already on tmpBuc still find the rest of the chain through it.
       if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
+				prevBuc->next.store(tmpBuc->next.load(std::memory_order_relaxed), std::memory_order_release);
       else
-				ht[index] = tmpBuc->next;
+				ht[index].store(tmpBuc->next.load(std::memory_order_relaxed), std::memory_order_release);
 
-      delete tmpBuc;
-      return;
+      if (epochs)
+        epochs->retire([tmpBuc]() { delete tmpBuc; });
+      else
+        delete tmpBuc;
+      return STATUS_OK;
     }
 		else
 		{
@@ -108,7 +191,7 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  return STATUS_NOT_FOUND;
 }
 
 }
@@ -7,10 +7,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include "file.h"
 
 namespace badgerdb {
 
+class EpochManager;
+
+/**
+ * Hints the processor to start loading the cache line holding an address. Does nothing if the compiler has no
+ * prefetch builtin.
+ */
+inline void prefetch(const void* address)
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(address);
+#else
+	(void) address;
+#endif
+}
+
 /**
 * @brief Declarations for buffer pool hash table
 */
@@ -31,16 +48,17 @@ struct hashBucket {
 	FrameId frameNo;
 
 	/**
-	 * Next node in the hash table
+	 * Next node in the hash table. Atomic so that lock-free readers can walk the chain while it changes.
 	 */
-	hashBucket*   next;
+	std::atomic<hashBucket*>   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* @warning This class is not threadsafe. Changes must be serialized by the caller; with an EpochManager attached,
+*          lookups may run alongside them without locks, inside a guard of that manager.
 */
 class BufHashTbl
 {
@@ -52,7 +70,12 @@ class BufHashTbl
 	/**
 	 * Actual Hash table object
 	 */
-  hashBucket**  ht;
+  std::atomic<hashBucket*>*  ht;
+
+	/**
+	 * Defers freeing removed buckets while lock-free readers may still be on them, or NULL to free them at once
+	 */
+  EpochManager* epochs;
 
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
@@ -63,11 +86,23 @@ class BufHashTbl
 	 */
   int	 hash(const File* file, const PageId pageNo);
 
+	/**
+	 * returns the bucket of (file, pageNo), or NULL if it is not in the table
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Bucket of the page.
+	 */
+  hashBucket* find(const File* file, const PageId pageNo);
+
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize	Number of chains
+	 * @param epochs	Epoch manager to retire removed buckets through, or NULL if no lookup runs without locks
 	 */
-	BufHashTbl(const int htSize);  // constructor
+	BufHashTbl(const int htSize, EpochManager* epochs = NULL);  // constructor
 
 	/**
    * Destructor of BufHashTbl class
@@ -96,6 +131,37 @@ class BufHashTbl
 	 */
   void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
 
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool, like lookup(), but report a missing page instead
+   * of throwing.
+	 *
+	 * @param file  	File object
+	 * @param pageNo	Page number in the file
+	 * @param frameNo Frame number reference, set if the page is found
+	 * @return 			STATUS_OK, or STATUS_NOT_FOUND if the page entry is not in the hash table
+	 */
+  Status tryLookup(const File* file, const PageId pageNo, FrameId &frameNo);
+
+	/**
+   * Number of pages lookupBatch() moves through its stages together
+	 */
+  static const std::size_t LOOKUP_GROUP = 16;
+
+	/**
+   * Looks up many pages at once, overlapping the cache misses of their chains. The pages are taken in groups of
+   * LOOKUP_GROUP and each stage prefetches what the next one touches for every page of the group, so the group
+   * waits for memory about once per stage instead of once per page.
+	 *
+	 * @param count   	Number of pages
+	 * @param files   	File of each page
+	 * @param pageNos 	Page number of each page
+	 * @param frameNos	Receives the frame of each page found
+	 * @param found   	Receives whether each page was found
+	 * @return  			Number of pages found
+	 */
+  std::size_t lookupBatch(const std::size_t count, const File* const* files, const PageId* pageNos,
+                          FrameId* frameNos, bool* found);
+
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
@@ -104,6 +170,15 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Delete entry (file,pageNo) from hash table, like remove(), but report a missing entry instead of throwing.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return 			STATUS_OK, or STATUS_NOT_FOUND if the page entry is not in the hash table
+	 */
+  Status tryRemove(const File* file, const PageId pageNo);
 };
 
 }
@@ -5,19 +5,96 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <memory>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include "buffer.h"
+#include "trace.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
-#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/write_discarded_exception.h"
 
 namespace badgerdb { 
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+const std::uint32_t BufMgr::DEFAULT_SAMPLE_FRAMES;
+
+/**
+ * Number of sampled frames snapshot() visits per acquisition of the pool latch.
+ */
+static const std::uint32_t SNAPSHOT_BATCH = 256;
+
+/**
+ * Throws the exception the plain operations report <status> with.
+ */
+static void throwStatus(const Status status, const File* file, const PageId pageNo)
+{
+	if (status == STATUS_BUFFER_EXCEEDED)
+		throw BufferExceededException();
+	if (status == STATUS_INVALID_PAGE)
+		throw InvalidPageException(pageNo, file->filename());
+}
+
+namespace {
+
+/**
+ * A page checkpoint() failed to write, with the sectors the write was for.
+ */
+struct FailedWrite {
+	File* file;
+	PageId pageNo;
+	std::uint32_t sectors;
+};
+
+/**
+ * Writes checkpoint() queued with the scheduler that have not completed yet, and those that failed.
+ */
+struct CheckpointWrites {
+	std::mutex latch;
+	std::condition_variable doneCv;
+	std::uint32_t pending;
+	std::exception_ptr error;
+	std::vector<FailedWrite> failed;
+
+	CheckpointWrites() : pending(0) {}
+
+	/**
+	 * Counts the write of <page> to <file> as done.  A write dropped because its page was deleted
+	 * meanwhile is done as well.
+	 */
+	void complete(File* file, const Page& page, std::exception_ptr writeError)
+	{
+		if (writeError) {
+			try {
+				std::rethrow_exception(writeError);
+			} catch (const WriteDiscardedException&) {
+				writeError = std::exception_ptr();
+			} catch (...) {
+			}
+		}
+		std::lock_guard<std::mutex> done(latch);
+		if (writeError) {
+			if (!error)
+				error = writeError;
+			FailedWrite write = {file, page.page_number(), page.dirty_sectors()};
+			failed.push_back(write);
+		}
+		if (--pending == 0)
+			doneCv.notify_all();
+	}
+};
+
+}
+
+BufMgr::BufMgr(std::uint32_t bufs, std::size_t compressedBytes, IoScheduler* scheduler, EpochManager* epochs)
+	: numBufs(bufs), compressedCache(NULL), numValid(0), numPinned(0), numDirty(0),
+	  accessCount(0), clockAdvances(0), evictions(0), ioScheduler(scheduler), epochs(epochs) {
 	bufDescTable = new BufDesc[bufs];
 
   for (FrameId i = 0; i < bufs; i++) 
@@ -29,7 +106,10 @@ BufMgr::BufMgr(std::uint32_t bufs)
   bufPool = new Page[bufs];
 
 	int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  hashTable = new BufHashTbl (htsize, epochs);  // allocate the buffer hash table
+
+  if (compressedBytes > 0)
+  	compressedCache = new CompressedPageCache(compressedBytes);
 
   clockHand = bufs - 1;
 }
@@ -42,11 +122,21 @@ BufMgr::~BufMgr() {
 	for (FrameId i=0; i<numBufs; i++)
 		if(bufDescTable[i].valid == true && bufDescTable[i].dirty == true)
 			flushFile(bufDescTable[i].file);
+	// Write-back of evicted pages may still be queued.
+	if (ioScheduler != NULL)
+		ioScheduler->drain(NULL);
+	// References must not point into the pool once it is gone.
+	for (FrameId i = 0; i < numBufs; i++)
+		if (bufDescTable[i].swizzledBy != NULL) {
+			bufDescTable[i].swizzledBy->page_ = NULL;
+			bufDescTable[i].swizzledBy->owner_ = NULL;
+		}
 
 	// Deallocates the buffer pool and the BufDesc table.
 	delete[] bufDescTable;
 	delete[] bufPool;
 	delete hashTable;
+	delete compressedCache;
 }
 
 	/**
@@ -55,6 +145,80 @@ BufMgr::~BufMgr() {
 void BufMgr::advanceClock()
 {
 	clockHand = (clockHand+1) % numBufs;
+	clockAdvances++;
+}
+
+void BufMgr::assignFrame(FrameId frame, File* file, PageId pageNo)
+{
+	bufDescTable[frame].Set(file, pageNo);
+	bufDescTable[frame].lastAccess = ++accessCount;
+	numValid++;
+	numPinned++;
+	residentPages[file]++;
+}
+
+void BufMgr::pinFrame(FrameId frame)
+{
+	if (bufDescTable[frame].pinCnt++ == 0)
+		numPinned++;
+	bufDescTable[frame].lastAccess = ++accessCount;
+}
+
+void BufMgr::releaseFrame(FrameId frame)
+{
+	BufDesc& desc = bufDescTable[frame];
+	if (desc.valid) {
+		numValid--;
+		if (desc.pinCnt > 0) numPinned--;
+		if (desc.dirty) numDirty--;
+		std::map<const File*, std::uint32_t>::iterator resident = residentPages.find(desc.file);
+		if (--resident->second == 0)
+			residentPages.erase(resident);
+	}
+	if (desc.swizzledBy != NULL) {
+		desc.swizzledBy->page_ = NULL;
+		desc.swizzledBy->owner_ = NULL;
+	}
+	desc.Clear();
+	// Lock-free readers may still be looking at the frame; the caller has already unmapped the page.
+	if (epochs != NULL)
+		desc.retiredAt = epochs->epoch();
+}
+
+bool BufMgr::frameReusable(FrameId frame, std::uint64_t& safeEpoch)
+{
+	BufDesc& desc = bufDescTable[frame];
+	if (desc.retiredAt == 0)
+		return true;
+	if (desc.retiredAt >= safeEpoch)
+		safeEpoch = epochs->advance();
+	if (desc.retiredAt >= safeEpoch)
+		return false;
+	desc.retiredAt = 0;
+	return true;
+}
+
+void BufMgr::waitReusable(FrameId frame, std::uint64_t& safeEpoch)
+{
+	if (frameReusable(frame, safeEpoch))
+		return;
+	epochs->synchronize(bufDescTable[frame].retiredAt);
+	bufDescTable[frame].retiredAt = 0;
+}
+
+void BufMgr::evictFrame(FrameId frame)
+{
+	if (bufDescTable[frame].dirty == true) {
+		writeBack(bufDescTable[frame].file, bufPool[frame], IO_BACKGROUND);
+		bufStats.diskwrites++;
+	}
+	// The page is clean now, keep a compressed copy of it.
+	if (compressedCache != NULL)
+		compressedCache->insert(bufDescTable[frame].file, bufPool[frame]);
+	// Remove the appropriate entry from the hash table.
+	hashTable->remove(bufDescTable[frame].file,bufDescTable[frame].pageNo);
+	releaseFrame(frame);
+	evictions++;
 }
 
 	/**
@@ -65,6 +229,18 @@ void BufMgr::advanceClock()
 	 */
 void BufMgr::allocBuf(FrameId & frame)
 {
+	if (tryAllocBuf(frame) != STATUS_OK)
+		throw BufferExceededException();
+}
+
+Status BufMgr::tryAllocBuf(FrameId & frame)
+{
+	BADGERDB_TRACE_SPAN(TRACE_ALL, "bufmgr", "BufMgr::allocBuf");
+	// Oldest epoch a lock-free reader may still be in, brought up to date when a free frame needs it.
+	std::uint64_t safeEpoch = 0;
+	// A free frame skipped because readers may still see its old page.
+	bool retiredSkipped = false;
+	FrameId retiredFrame = 0;
 	// Remember the start point and pass.
 	// All frame is pinned if two passed be made.
 	FrameId flag = clockHand;
@@ -72,10 +248,15 @@ void BufMgr::allocBuf(FrameId & frame)
 	while(pass < 2) {
 		advanceClock();
 		if (clockHand == flag) pass++;
-		// If this frame is unused, return this page.
+		// If this frame is unused, return this page, unless lock-free readers may still see its old page.
 		if (bufDescTable[clockHand].valid == false) {
-			frame = clockHand;
-			return;
+			if (frameReusable(clockHand, safeEpoch)) {
+				frame = clockHand;
+				return STATUS_OK;
+			}
+			retiredSkipped = true;
+			retiredFrame = clockHand;
+			continue;
 		}
 		// If this page is recently used, clear the ref bit, continue.
 		if (bufDescTable[clockHand].refbit == true) {
@@ -87,16 +268,61 @@ void BufMgr::allocBuf(FrameId & frame)
 			continue;
 		}
 		// This frame is selected, clean this frame.
-		if (bufDescTable[clockHand].dirty == true) {
-			bufDescTable[clockHand].file->writePage(bufPool[clockHand]);
-		}
-		// Remove the appropriate entry from the hash table.
-		hashTable->remove(bufDescTable[clockHand].file,bufDescTable[clockHand].pageNo);
-		bufDescTable[clockHand].Clear();
+		evictFrame(clockHand);
+		// Rather than evict more pages, wait for the readers that may still see this one.
+		waitReusable(clockHand, safeEpoch);
 		frame = clockHand;
-		return;
+		return STATUS_OK;
+	}
+	// Only free frames that readers may still see are left. Their sections are short and take no pool
+	// latch, so wait them out.
+	if (retiredSkipped) {
+		waitReusable(retiredFrame, safeEpoch);
+		frame = retiredFrame;
+		return STATUS_OK;
 	}
 	// If the buffer is full.
+	return STATUS_BUFFER_EXCEEDED;
+}
+
+void BufMgr::allocRun(std::uint32_t count, FrameId& first)
+{
+	if (count == 1) {
+		allocBuf(first);
+		return;
+	}
+	BADGERDB_TRACE_SPAN(TRACE_ALL, "bufmgr", "BufMgr::allocRun");
+	std::uint64_t safeEpoch = 0;
+	const FrameId blocks = numBufs / count;
+	// The clock hand moves a block at a time, giving the frames of a block the same second chance as in
+	// allocBuf(); two passes over all blocks find one unless every block has a pinned frame.
+	FrameId block = (clockHand + 1) % numBufs / count;
+	for (FrameId step = 0; step < 2 * blocks; step++, block++) {
+		if (block >= blocks)
+			block = 0;
+		const FrameId base = block * count;
+		bool busy = false;
+		bool referenced = false;
+		for (FrameId i = base; i < base + count; i++) {
+			if (bufDescTable[i].pinCnt > 0 || bufDescTable[i].loading)
+				busy = true;
+			if (bufDescTable[i].refbit) {
+				bufDescTable[i].refbit = false;
+				referenced = true;
+			}
+		}
+		clockHand = base + count - 1;
+		clockAdvances += count;
+		if (busy || referenced)
+			continue;
+		for (FrameId i = base; i < base + count; i++) {
+			if (bufDescTable[i].valid)
+				evictFrame(i);
+			waitReusable(i, safeEpoch);
+		}
+		first = base;
+		return;
+	}
 	throw BufferExceededException();
 }
 
@@ -110,24 +336,481 @@ void BufMgr::allocBuf(FrameId & frame)
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
 	 */
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::readPage");
+	std::unique_lock<std::mutex> lock(bufLatch);
+	bufStats.accesses++;
+	// Return a pointer to the frame containing the page.
+	page = &bufPool[pinPage(lock, file, pageNo)];
+}
+
+Status BufMgr::tryReadPage(File* file, const PageId pageNo, Page*& page)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::readPage");
+	std::unique_lock<std::mutex> lock(bufLatch);
+	bufStats.accesses++;
+	FrameId frame;
+	const Status status = tryPinPage(lock, file, pageNo, frame);
+	if (status == STATUS_OK)
+		page = &bufPool[frame];
+	return status;
+}
+
+FrameId BufMgr::pinPage(std::unique_lock<std::mutex>& lock, File* file, PageId pageNo)
+{
+	FrameId frame;
+	const Status status = tryPinPage(lock, file, pageNo, frame);
+	if (status != STATUS_OK)
+		throwStatus(status, file, pageNo);
+	return frame;
+}
+
+Status BufMgr::tryPinPage(std::unique_lock<std::mutex>& lock, File* file, PageId pageNo, FrameId& frame)
 {
 	FrameId tmpFrameId;
-	try{
+	for (;;) {
+		if (hashTable->tryLookup(file, pageNo, tmpFrameId) != STATUS_OK) {
+			// Page is not in the buffer pool.
+			FileStats::add(file->stats().cache_misses, 1);
+			const Status status = loadPage(lock, file, pageNo, tmpFrameId);
+			if (status != STATUS_OK)
+				return status;
+			break;
+		}
 		// Page is in the buffer pool.
-		hashTable->lookup(file, pageNo, tmpFrameId);
-		bufDescTable[tmpFrameId].pinCnt ++;
-	}catch (HashNotFoundException e){
-		// Page is not in the buffer pool.
-		// Allocate a buffer frame. Read the page from disk.
-		// Insert the page into the hashtable. Set the frame.
-		allocBuf(tmpFrameId);
-		bufPool[tmpFrameId] = file->readPage(pageNo);
-		hashTable->insert(file, pageNo, tmpFrameId);
-		bufDescTable[tmpFrameId].Set(file, pageNo);
+		if (!bufDescTable[tmpFrameId].loading) {
+			FileStats::add(file->stats().cache_hits, 1);
+			pinFrame(tmpFrameId);
+			break;
+		}
+		// Another thread is reading the page in. Look again once it is done, since the read may fail.
+		frameLoaded.wait(lock);
 	}
 	bufDescTable[tmpFrameId].refbit = true;
-	// Return a pointer to the frame containing the page.
-	page = &bufPool[tmpFrameId];
+	frame = tmpFrameId;
+	return STATUS_OK;
+}
+
+void BufMgr::readPage(File* file, PageRef& ref, Page*& page)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::readPage");
+	std::unique_lock<std::mutex> lock(bufLatch);
+	bufStats.accesses++;
+	FrameId frame;
+	if (ref.page_ != NULL) {
+		// Swizzled: the frame still holds the page, or eviction would have reset the reference.
+		frame = ref.page_ - bufPool;
+		assert(bufDescTable[frame].file == file && bufDescTable[frame].swizzledBy == &ref);
+		FileStats::add(file->stats().cache_hits, 1);
+		pinFrame(frame);
+		bufDescTable[frame].refbit = true;
+	} else {
+		frame = pinPage(lock, file, ref.page_number());
+		if (bufDescTable[frame].swizzledBy == NULL) {
+			bufDescTable[frame].swizzledBy = &ref;
+			ref.page_ = &bufPool[frame];
+			ref.owner_ = this;
+		}
+	}
+	page = &bufPool[frame];
+}
+
+void BufMgr::unswizzle(PageRef& ref)
+{
+	std::lock_guard<std::mutex> guard(bufLatch);
+	if (ref.page_ != NULL)
+		bufDescTable[ref.page_ - bufPool].swizzledBy = NULL;
+	ref.page_ = NULL;
+	ref.owner_ = NULL;
+}
+
+Status BufMgr::loadPage(std::unique_lock<std::mutex>& lock, File* file, PageId pageNo, FrameId& frame)
+{
+	// Allocate a buffer frame. Insert the page into the hashtable. Set the frame.
+	// Read the page from the compressed tier or disk.
+	if (tryAllocBuf(frame) != STATUS_OK)
+		return STATUS_BUFFER_EXCEEDED;
+	// Lock-free readers find the page as soon as it is in the hash table; keep them off the frame until
+	// it is filled. Nobody else can hold the latch of a frame just allocated.
+	bufDescTable[frame].latch.lockExclusive();
+	hashTable->insert(file, pageNo, frame);
+	assignFrame(frame, file, pageNo);
+	if (compressedCache != NULL && compressedCache->take(file, pageNo, bufPool[frame])) {
+		bufDescTable[frame].latch.unlockExclusive();
+		return STATUS_OK;
+	}
+	bufStats.diskreads++;
+
+	if (ioScheduler == NULL) {
+		Status status;
+		try {
+			status = file->tryReadPage(pageNo, bufPool[frame]);
+		} catch (...) {
+			bufDescTable[frame].latch.unlockExclusive();
+			hashTable->remove(file, pageNo);
+			releaseFrame(frame);
+			throw;
+		}
+		bufDescTable[frame].latch.unlockExclusive();
+		if (status != STATUS_OK) {
+			hashTable->remove(file, pageNo);
+			releaseFrame(frame);
+		}
+		return status;
+	} else {
+		// The frame is pinned, so it stays put while the latch is released; readers of the
+		// same page wait for it to finish loading.
+		bufDescTable[frame].loading = true;
+		lock.unlock();
+		std::exception_ptr error;
+		try {
+			ioScheduler->read(IO_FOREGROUND, file, pageNo, bufPool[frame]);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+		finishLoad(frame, file, pageNo, error);
+		if (error) {
+			// The scheduler reports every failure as an exception; a missing page is still only a status.
+			try {
+				std::rethrow_exception(error);
+			} catch (const InvalidPageException&) {
+				return STATUS_INVALID_PAGE;
+			}
+		}
+		return STATUS_OK;
+	}
+}
+
+void BufMgr::finishLoad(FrameId frame, File* file, PageId pageNo, std::exception_ptr error)
+{
+	bufDescTable[frame].latch.unlockExclusive();
+	bufDescTable[frame].loading = false;
+	frameLoaded.notify_all();
+	std::vector<PendingRead> waiters;
+	std::map<FrameId, std::vector<PendingRead> >::iterator pending = loadWaiters.find(frame);
+	if (pending != loadWaiters.end()) {
+		waiters.swap(pending->second);
+		loadWaiters.erase(pending);
+	}
+
+	if (error) {
+		hashTable->remove(file, pageNo);
+		releaseFrame(frame);
+	} else {
+		for (std::size_t i = 0; i < waiters.size(); i++)
+			pinFrame(frame);
+		bufDescTable[frame].refbit = true;
+	}
+	Page* page = error ? NULL : &bufPool[frame];
+	for (std::size_t i = 0; i < waiters.size(); i++) {
+		ReadCallback done = waiters[i].done;
+		waiters[i].loop->post([done, page, error] { done(page, error); });
+	}
+}
+
+void BufMgr::readPageAsync(File* file, const PageId pageNo, EventLoop& loop, const ReadCallback& done)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::readPageAsync");
+	if (ioScheduler == NULL) {
+		Page* page = NULL;
+		std::exception_ptr error;
+		try {
+			readPage(file, pageNo, page);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		done(page, error);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(bufLatch);
+	FrameId frame;
+	bufStats.accesses++;
+	const bool resident = hashTable->tryLookup(file, pageNo, frame) == STATUS_OK;
+	// A page still being read in counts as a hit, as it does once tryPinPage() has waited for it.
+	FileStats::add(resident ? file->stats().cache_hits : file->stats().cache_misses, 1);
+
+	if (resident && bufDescTable[frame].loading) {
+		// Someone else is reading the page in; the callback is posted once it is done.
+		PendingRead waiter = {&loop, done};
+		loadWaiters[frame].push_back(waiter);
+		return;
+	}
+	if (resident) {
+		pinFrame(frame);
+	} else {
+		allocBuf(frame);
+		// As in loadPage(), keep lock-free readers off the frame until it is filled.
+		bufDescTable[frame].latch.lockExclusive();
+		hashTable->insert(file, pageNo, frame);
+		assignFrame(frame, file, pageNo);
+		if (compressedCache != NULL && compressedCache->take(file, pageNo, bufPool[frame])) {
+			bufDescTable[frame].latch.unlockExclusive();
+		} else {
+			// The frame is pinned, so it stays put until the read completes. The scheduler
+			// fills it on its own thread; the rest is done on the loop, since the scheduler
+			// must not wait for the pool latch.
+			bufStats.diskreads++;
+			bufDescTable[frame].loading = true;
+			lock.unlock();
+			ioScheduler->submitRead(IO_FOREGROUND, file, pageNo,
+				[this, file, pageNo, frame, &loop, done](const Page& result, std::exception_ptr error) {
+					if (!error)
+						bufPool[frame] = result;
+					loop.post([this, file, pageNo, frame, done, error] {
+						{
+							std::lock_guard<std::mutex> guard(bufLatch);
+							finishLoad(frame, file, pageNo, error);
+						}
+						done(error ? NULL : &bufPool[frame], error);
+					});
+				});
+			return;
+		}
+	}
+	bufDescTable[frame].refbit = true;
+	Page* page = &bufPool[frame];
+	lock.unlock();
+	done(page, std::exception_ptr());
+}
+
+void BufMgr::writeBack(File* file, const Page& page, IoClass ioClass)
+{
+	if (ioScheduler != NULL)
+		ioScheduler->submitWrite(ioClass, file, page);
+	else
+		file->writeDirtySectors(page);
+}
+
+void BufMgr::fileOp(const std::function<void()>& operation)
+{
+	if (ioScheduler != NULL)
+		ioScheduler->exclusive(operation);
+	else
+		operation();
+}
+
+std::size_t BufMgr::pinResidentPages(const std::size_t count, File* const* files, const PageId* pageNos, Page** pages)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::pinResidentPages");
+	std::lock_guard<std::mutex> guard(bufLatch);
+	const std::size_t group = BufHashTbl::LOOKUP_GROUP;
+	FrameId frames[group];
+	bool found[group];
+	std::size_t pinned = 0;
+
+	for (std::size_t start = 0; start < count; start += group) {
+		const std::size_t n = std::min(group, count - start);
+		hashTable->lookupBatch(n, files + start, pageNos + start, frames, found);
+		// The descriptors of the hits are the next cache misses; start them all before using any.
+		for (std::size_t i = 0; i < n; i++)
+			if (found[i])
+				prefetch(&bufDescTable[frames[i]]);
+		for (std::size_t i = 0; i < n; i++) {
+			if (!found[i] || bufDescTable[frames[i]].loading) {
+				pages[start + i] = NULL;
+				continue;
+			}
+			bufStats.accesses++;
+			FileStats::add(files[start + i]->stats().cache_hits, 1);
+			pinFrame(frames[i]);
+			bufDescTable[frames[i]].refbit = true;
+			pages[start + i] = &bufPool[frames[i]];
+			pinned++;
+		}
+	}
+	return pinned;
+}
+
+void BufMgr::readExtent(File* file, const PageId firstPageNo, const std::uint32_t count, Page*& pages)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::readExtent");
+	assert(count > 0 && (count & (count - 1)) == 0);
+	std::unique_lock<std::mutex> lock(bufLatch);
+	bufStats.accesses += count;
+	std::vector<const File*> files(count, file);
+	std::vector<PageId> pageNos(count);
+	for (std::uint32_t i = 0; i < count; i++)
+		pageNos[i] = firstPageNo + i;
+	std::vector<FrameId> frames(count);
+	std::unique_ptr<bool[]> found(new bool[count]);
+	std::size_t resident;
+	for (;;) {
+		resident = hashTable->lookupBatch(count, &files[0], &pageNos[0], &frames[0], found.get());
+		bool loading = false;
+		for (std::uint32_t i = 0; i < count; i++)
+			loading = loading || (found[i] && bufDescTable[frames[i]].loading);
+		if (!loading)
+			break;
+		// Look again once the reads are done, since they may fail.
+		frameLoaded.wait(lock);
+	}
+	FileStats::add(file->stats().cache_hits, resident);
+	FileStats::add(file->stats().cache_misses, count - resident);
+
+	// Already in the pool as a run.
+	bool run = resident == count;
+	for (std::uint32_t i = 1; run && i < count; i++)
+		run = frames[i] == frames[0] + i;
+	if (run) {
+		for (std::uint32_t i = 0; i < count; i++) {
+			pinFrame(frames[i]);
+			bufDescTable[frames[i]].refbit = true;
+		}
+		pages = &bufPool[frames[0]];
+		return;
+	}
+
+	// Pages in the pool are moved into the new run, so they must not be pinned where they are. Pin them
+	// meanwhile so that allocRun() leaves them alone.
+	for (std::uint32_t i = 0; i < count; i++)
+		if (found[i] && bufDescTable[frames[i]].pinCnt > 0)
+			throw PagePinnedException(file->filename(), pageNos[i], frames[i]);
+	for (std::uint32_t i = 0; i < count; i++)
+		if (found[i])
+			pinFrame(frames[i]);
+	FrameId first;
+	try {
+		allocRun(count, first);
+	} catch (...) {
+		for (std::uint32_t i = 0; i < count; i++)
+			if (found[i] && --bufDescTable[frames[i]].pinCnt == 0)
+				numPinned--;
+		throw;
+	}
+
+	// Move the resident pages into the run and take what the compressed tier has; the rest is read below.
+	std::unique_ptr<bool[]> missing(new bool[count]);
+	for (std::uint32_t i = 0; i < count; i++) {
+		missing[i] = false;
+		bool dirty = false;
+		if (found[i]) {
+			bufPool[first + i] = bufPool[frames[i]];
+			dirty = bufDescTable[frames[i]].dirty;
+			hashTable->remove(file, pageNos[i]);
+			releaseFrame(frames[i]);
+		} else if (compressedCache == NULL || !compressedCache->take(file, pageNos[i], bufPool[first + i])) {
+			missing[i] = true;
+			continue;
+		}
+		hashTable->insert(file, pageNos[i], first + i);
+		assignFrame(first + i, file, pageNos[i]);
+		bufDescTable[first + i].refbit = true;
+		if (dirty) {
+			bufDescTable[first + i].dirty = true;
+			numDirty++;
+		}
+	}
+
+	std::exception_ptr error;
+	if (ioScheduler == NULL) {
+		// One read per stretch of missing pages, under the latch like loadPage().
+		try {
+			for (std::uint32_t i = 0; i < count;) {
+				if (!missing[i]) {
+					i++;
+					continue;
+				}
+				std::uint32_t end = i + 1;
+				while (end < count && missing[end])
+					end++;
+				std::vector<Page> read = file->readPages(pageNos[i], end - i);
+				bufStats.diskreads += end - i;
+				for (std::uint32_t j = i; j < end; j++)
+					bufPool[first + j] = std::move(read[j - i]);
+				i = end;
+			}
+		} catch (...) {
+			error = std::current_exception();
+		}
+		for (std::uint32_t i = 0; i < count && !error; i++) {
+			if (missing[i]) {
+				hashTable->insert(file, pageNos[i], first + i);
+				assignFrame(first + i, file, pageNos[i]);
+				bufDescTable[first + i].refbit = true;
+			}
+		}
+	} else {
+		// As in loadPage(), the missing pages are marked loading so that the latch can be released
+		// while they are read; readers of them wait, and lock-free readers stay off their frames.
+		bool any = false;
+		for (std::uint32_t i = 0; i < count; i++) {
+			if (!missing[i])
+				continue;
+			bufDescTable[first + i].latch.lockExclusive();
+			hashTable->insert(file, pageNos[i], first + i);
+			assignFrame(first + i, file, pageNos[i]);
+			bufDescTable[first + i].loading = true;
+			bufStats.diskreads++;
+			any = true;
+		}
+		if (any) {
+			lock.unlock();
+			try {
+				for (std::uint32_t i = 0; i < count;) {
+					if (!missing[i]) {
+						i++;
+						continue;
+					}
+					std::uint32_t end = i + 1;
+					while (end < count && missing[end])
+						end++;
+					// Pages whose write-back is still queued come from the queue.
+					std::vector<Page> read = ioScheduler->readPages(file, pageNos[i], end - i);
+					for (std::uint32_t j = i; j < end; j++)
+						bufPool[first + j] = std::move(read[j - i]);
+					i = end;
+				}
+			} catch (...) {
+				error = std::current_exception();
+			}
+			lock.lock();
+			for (std::uint32_t i = 0; i < count; i++)
+				if (missing[i])
+					finishLoad(first + i, file, pageNos[i], error);
+		}
+	}
+
+	if (error) {
+		// The pages that are in the run stay in the pool, unpinned.
+		for (std::uint32_t i = 0; i < count; i++)
+			if (!missing[i] && --bufDescTable[first + i].pinCnt == 0)
+				numPinned--;
+		std::rethrow_exception(error);
+	}
+	pages = &bufPool[first];
+}
+
+void BufMgr::unPinExtent(File* file, const PageId firstPageNo, const std::uint32_t count, const bool dirty)
+{
+	for (std::uint32_t i = 0; i < count; i++)
+		unPinPage(file, firstPageNo + i, dirty);
+}
+
+bool BufMgr::readResident(const File* file, const PageId pageNo, const std::function<void(const Page& page)>& reader)
+{
+	assert(epochs != NULL);
+	FrameId frame;
+	bool found;
+	hashTable->lookupBatch(1, &file, &pageNo, &frame, &found);
+	if (!found)
+		return false;
+	// Fails while the frame is being filled or written to.
+	FrameLatch& latch = bufDescTable[frame].latch;
+	if (!latch.tryLockShared())
+		return false;
+	// The frame cannot be reused before the caller's epoch ends, but the page may have been evicted
+	// between the lookup and the latch; only hand it out if it is still mapped there.
+	FrameId again;
+	hashTable->lookupBatch(1, &file, &pageNo, &again, &found);
+	found = found && again == frame;
+	if (found) {
+		bufDescTable[frame].refbit.store(true, std::memory_order_relaxed);
+		reader(bufPool[frame]);
+	}
+	latch.unlockShared();
+	return found;
 }
 
 	/**
@@ -140,20 +823,70 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 	 */
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::unPinPage");
+	std::lock_guard<std::mutex> guard(bufLatch);
 	FrameId tmpFrameId;
 
-	try{
-		hashTable->lookup(file, pageNo, tmpFrameId);
-	}catch (HashNotFoundException e){
-		// Does nothing if page is not found in the hash table lookup.
+	// Does nothing if page is not found in the hash table lookup.
+	if (hashTable->tryLookup(file, pageNo, tmpFrameId) != STATUS_OK)
 		return;
-	}
 
 	// Throws PAGENOTPINNED if the pin count is already 0.
 	if(bufDescTable[tmpFrameId].pinCnt == 0)
 		throw PageNotPinnedException(file->filename(), pageNo, tmpFrameId);
-	bufDescTable[tmpFrameId].pinCnt--;
-	if(dirty) bufDescTable[tmpFrameId].dirty = true;	//if dirty == true, sets the dirty bit.
+	if (--bufDescTable[tmpFrameId].pinCnt == 0) numPinned--;
+	//if dirty == true, sets the dirty bit.
+	if(dirty && !bufDescTable[tmpFrameId].dirty) {
+		bufDescTable[tmpFrameId].dirty = true;
+		numDirty++;
+	}
+}
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page, const LatchMode mode)
+{
+	readPage(file, pageNo, page);
+	latchPage(page, mode);
+}
+
+void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty, const LatchMode mode)
+{
+	FrameId frame;
+	{
+		std::lock_guard<std::mutex> guard(bufLatch);
+		// Does nothing if page is not found in the hash table lookup.
+		if (hashTable->tryLookup(file, pageNo, frame) != STATUS_OK)
+			return;
+	}
+	// The page stays pinned, so the frame does not change while the latch is released.
+	unlatchPage(&bufPool[frame], mode);
+	unPinPage(file, pageNo, dirty);
+}
+
+FrameLatch& BufMgr::latchOf(const Page* page)
+{
+	assert(page >= bufPool && page < bufPool + numBufs);
+	return bufDescTable[page - bufPool].latch;
+}
+
+void BufMgr::latchPage(const Page* page, const LatchMode mode)
+{
+	if (mode == LATCH_SHARED)
+		latchOf(page).lockShared();
+	else
+		latchOf(page).lockExclusive();
+}
+
+void BufMgr::unlatchPage(const Page* page, const LatchMode mode)
+{
+	if (mode == LATCH_SHARED)
+		latchOf(page).unlockShared();
+	else
+		latchOf(page).unlockExclusive();
+}
+
+bool BufMgr::upgradeLatch(const Page* page)
+{
+	return latchOf(page).upgrade();
 }
 
 	/**
@@ -167,6 +900,8 @@ void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
 	 */
 void BufMgr::flushFile(const File* file) 
 {
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::flushFile");
+	std::lock_guard<std::mutex> guard(bufLatch);
 	//Throws PagePinnedException if some page of the file is pinned.
 	//Throws BadBufferException if an invalid page belonging to the file is encountered.
 	for (FrameId i=0;i<numBufs;i++)
@@ -178,19 +913,30 @@ void BufMgr::flushFile(const File* file)
 		}
 
 	// Scan bufTable for pages belonging to the file.
-	// If the page is dirty, call file->writePage() to flush the page to disk
-	// and then set the dirty bit for the page to false.
+	// If the page is dirty, call file->writePage() to flush the page to disk.
+	// Sync the file, and only then clear the dirty bits: if a write or the sync
+	// fails, the pages stay dirty in the buffer pool and the flush can be retried.
+	for (FrameId i=0; i<numBufs; i++)
+		if(bufDescTable[i].file == file && bufDescTable[i].dirty == true){
+			writeBack(bufDescTable[i].file, bufPool[i], IO_BACKGROUND);
+			bufStats.diskwrites++;
+		}
+	// Pages evicted earlier may still be queued with the scheduler.
+	if (ioScheduler != NULL)
+		ioScheduler->drain(file);
+	fileOp([file] { file->sync(); });
+
 	// Remove the page from the hashtable (whether the page is clean or dirty.
 	// Invoke the Clear() method of BufDesc for the page frame.
 	for (FrameId i=0; i<numBufs; i++)
 		if(bufDescTable[i].file == file){
-			if(bufDescTable[i].dirty == true){
-				bufDescTable[i].file->writePage(bufPool[i]);
-				bufDescTable[i].dirty = false;
-			}
 			hashTable->remove(file,bufDescTable[i].pageNo);
-			bufDescTable[i].Clear();
+			releaseFrame(i);
 		}
+
+	// Compressed copies are keyed by the File object, which may go away once flushed.
+	if (compressedCache != NULL)
+		compressedCache->eraseFile(file);
 }
 
 	/**
@@ -203,18 +949,31 @@ void BufMgr::flushFile(const File* file)
 	 */
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+	if (tryAllocPage(file, pageNo, page) != STATUS_OK)
+		throw BufferExceededException();
+}
+
+Status BufMgr::tryAllocPage(File* file, PageId &pageNo, Page*& page)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::allocPage");
+	std::lock_guard<std::mutex> guard(bufLatch);
 	FrameId tmpFrameId;
-	// Allocate an empty page in the specified file and obtain a buffer pool.
-	PageId NewPage = file->allocatePage().page_number();
-	allocBuf(tmpFrameId);
+	bufStats.accesses++;
+	// Format a blank page in a frame; it reaches the file at write-back, which is why the frame starts dirty.
+	if (tryAllocBuf(tmpFrameId) != STATUS_OK)
+		return STATUS_BUFFER_EXCEEDED;
+	fileOp([&] { file->reservePage(bufPool[tmpFrameId]); });
+	const PageId NewPage = bufPool[tmpFrameId].page_number();
 
 	// Set the hash table and frame.
-	bufPool[tmpFrameId] = file->readPage(NewPage);
 	hashTable->insert(file, NewPage, tmpFrameId);
-	bufDescTable[tmpFrameId].Set(file, NewPage);
+	assignFrame(tmpFrameId, file, NewPage);
+	bufDescTable[tmpFrameId].dirty = true;
+	numDirty++;
 
 	pageNo = NewPage;
 	page = &bufPool[tmpFrameId];
+	return STATUS_OK;
 }
 
 	/**
@@ -226,23 +985,156 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 	 */
 void BufMgr::disposePage(File* file, const PageId PageNo)
 {
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::disposePage");
+	std::unique_lock<std::mutex> lock(bufLatch);
 	FrameId tmpFrameId;
-	try{
-		// Makes sure that if the page to be deleted is allocated a frame in the buffer pool, that frame
-		// is freed and correspondingly entry from hash table is also removed.
-		hashTable->lookup(file, PageNo, tmpFrameId);
-		bufDescTable[tmpFrameId].Clear();
+	// Makes sure that if the page to be deleted is allocated a frame in the buffer pool, that frame
+	// is freed and correspondingly entry from hash table is also removed. If the page is not in the
+	// buffer pool, just delete.
+	bool resident = hashTable->tryLookup(file, PageNo, tmpFrameId) == STATUS_OK;
+	// A read into the frame has to finish first; it may also fail and free the frame.
+	while (resident && bufDescTable[tmpFrameId].loading) {
+		frameLoaded.wait(lock);
+		resident = hashTable->tryLookup(file, PageNo, tmpFrameId) == STATUS_OK;
+	}
+	if (resident) {
+		// Unmap the page before freeing the frame, which stamps it for lock-free readers.
 		hashTable->remove(file,PageNo);
-	}catch (HashNotFoundException e){
-		// Page not in buffer pool, just delete.
+		releaseFrame(tmpFrameId);
+	}
+	if (compressedCache != NULL)
+		compressedCache->erase(file, PageNo);
+
+	// A queued write of the page would otherwise land after the delete.
+	if (ioScheduler != NULL)
+		ioScheduler->discard(file, PageNo);
+	fileOp([&] { file->deletePage(PageNo); });
+
+}
+
+std::uint32_t BufMgr::checkpoint()
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::checkpoint");
+	std::set<File*> files;
+	std::uint32_t written = 0;
+	// Shared with the callbacks, which may still be returning when checkpoint() does.
+	std::shared_ptr<CheckpointWrites> writes = std::make_shared<CheckpointWrites>();
+
+	for (FrameId i = 0; i < numBufs; i++) {
+		std::lock_guard<std::mutex> guard(bufLatch);
+		BufDesc& desc = bufDescTable[i];
+		if (!desc.valid || !desc.dirty || desc.pinCnt > 0)
+			continue;
+		if (ioScheduler != NULL) {
+			{
+				std::lock_guard<std::mutex> done(writes->latch);
+				writes->pending++;
+			}
+			File* file = desc.file;
+			ioScheduler->submitWrite(IO_BACKGROUND, file, bufPool[i],
+				[writes, file](const Page& page, std::exception_ptr writeError) {
+					writes->complete(file, page, writeError);
+				});
+		} else {
+			desc.file->writeDirtySectors(bufPool[i]);
+		}
+		// A write that fails in the scheduler stays queued there for the next flush, and its page is
+		// marked dirty again below.
+		bufPool[i].clear_dirty_sectors();
+		desc.dirty = false;
+		numDirty--;
+		bufStats.diskwrites++;
+		files.insert(desc.file);
+		written++;
+	}
+
+	{
+		std::unique_lock<std::mutex> done(writes->latch);
+		writes->doneCv.wait(done, [&] { return writes->pending == 0; });
+	}
+	if (writes->error) {
+		// The pages are clean only once written, so those still in the pool become dirty again.
+		std::lock_guard<std::mutex> guard(bufLatch);
+		for (std::size_t f = 0; f < writes->failed.size(); f++) {
+			const FailedWrite& write = writes->failed[f];
+			FrameId frame;
+			if (hashTable->tryLookup(write.file, write.pageNo, frame) != STATUS_OK ||
+					bufDescTable[frame].loading)
+				continue;
+			bufPool[frame].add_dirty_sectors(write.sectors);
+			if (!bufDescTable[frame].dirty) {
+				bufDescTable[frame].dirty = true;
+				numDirty++;
+			}
+		}
+		std::rethrow_exception(writes->error);
+	}
+	for (std::set<File*>::iterator iter = files.begin(); iter != files.end(); ++iter) {
+		File* file = *iter;
+		if (ioScheduler != NULL) {
+			ioScheduler->exclusive([file] { file->sync(); });
+		} else {
+			std::lock_guard<std::mutex> guard(bufLatch);
+			file->sync();
+		}
 	}
+	return written;
+}
 
-	file->deletePage(PageNo);
+BufPoolSnapshot BufMgr::snapshot(std::uint32_t sampleFrames)
+{
+	BADGERDB_TRACE_SPAN(TRACE_IO, "bufmgr", "BufMgr::snapshot");
+	BufPoolSnapshot snap;
+	{
+		std::lock_guard<std::mutex> guard(bufLatch);
+		snap.takenAt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		snap.frames = numBufs;
+		snap.valid = numValid;
+		snap.pinned = numPinned;
+		snap.dirty = numDirty;
+		snap.accesses = accessCount;
+		snap.clockAdvances = clockAdvances;
+		snap.evictions = evictions;
+		snap.files.reserve(residentPages.size());
+		for (std::map<const File*, std::uint32_t>::const_iterator it = residentPages.begin();
+				 it != residentPages.end(); ++it) {
+			FileResidency residency;
+			residency.filename = it->first->filename();
+			residency.pages = it->second;
+			snap.files.push_back(residency);
+		}
+	}
+	std::stable_sort(snap.files.begin(), snap.files.end(),
+									 [](const FileResidency& a, const FileResidency& b) { return a.pages > b.pages; });
 
+	if (sampleFrames == 0)
+		return snap;
+	// Visit every step-th frame, starting at a varying offset so repeated snapshots cover the whole pool.
+	const std::uint32_t step = std::max<std::uint32_t>(1, numBufs / sampleFrames);
+	FrameId i = snap.accesses % step;
+	while (i < numBufs) {
+		std::lock_guard<std::mutex> guard(bufLatch);
+		for (std::uint32_t n = 0; n < SNAPSHOT_BATCH && i < numBufs; n++, i += step) {
+			snap.sampledFrames++;
+			if (!bufDescTable[i].valid)
+				continue;
+			const std::uint64_t age = accessCount - bufDescTable[i].lastAccess;
+			int bucket = 0;
+			while (bucket < BufPoolSnapshot::AGE_BUCKETS - 1 && age >= BufPoolSnapshot::bucketStart(bucket + 1))
+				bucket++;
+			snap.ageHistogram[bucket]++;
+		}
+	}
+	// Scale the sampled counts up to the whole pool.
+	for (int b = 0; b < BufPoolSnapshot::AGE_BUCKETS; b++)
+		snap.ageHistogram[b] = snap.ageHistogram[b] * numBufs / snap.sampledFrames;
+	return snap;
 }
 
 void BufMgr::printSelf(void) 
 {
+	std::lock_guard<std::mutex> guard(bufLatch);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
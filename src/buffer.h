@@ -7,8 +7,22 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+
 #include "file.h"
 #include "bufHashTbl.h"
+#include "buffer_snapshot.h"
+#include "compressed_cache.h"
+#include "epoch_manager.h"
+#include "event_loop.h"
+#include "frame_latch.h"
+#include "io_scheduler.h"
+#include "page_ref.h"
 
 namespace badgerdb {
 
@@ -56,9 +70,34 @@ class BufDesc {
   bool valid;
 
 	/**
-   * Has this buffer frame been reference recently
+   * Has this buffer frame been reference recently.  Atomic because readResident() sets it without the pool latch.
+	 */
+  std::atomic<bool> refbit;
+
+	/**
+   * True while the page is being read into the frame with the pool latch released
+	 */
+  bool loading;
+
+	/**
+   * Value of the pool's access counter when this page was last accessed
+	 */
+  std::uint64_t lastAccess;
+
+	/**
+   * Latch guarding the contents of the page in the frame; not reset with the frame, since only pinned pages are latched
+	 */
+  FrameLatch latch;
+
+	/**
+   * Epoch the frame was freed in while lock-free readers may still look at it, 0 once it may be reused
+	 */
+  std::uint64_t retiredAt;
+
+	/**
+   * Reference swizzled to point at this frame, NULL if none
 	 */
-  bool refbit;
+  PageRef* swizzledBy;
 
 	/**
    * Initialize buffer frame for a new user
@@ -66,11 +105,15 @@ class BufDesc {
   void Clear()
 	{
     pinCnt = 0;
+    lastAccess = 0;
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
 		valid = false;
+		loading = false;
+		retiredAt = 0;
+		swizzledBy = NULL;
   };
 
 	/**
@@ -156,10 +199,41 @@ struct BufStats
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* All public methods are serialized on a single latch, so one BufMgr can be shared by several threads.
+* The pool latch does not cover the contents of pinned pages. Threads sharing a page coordinate through the
+* frame's own reader/writer latch, taken with the LatchMode overloads of readPage() and unPinPage() or with
+* latchPage() on a page they have pinned.
+*
+* Given an IoScheduler, the pool reads missing pages with the latch released and hands write-back of
+* evicted pages to the scheduler's background class instead of writing them while the latch is held.
+*
+* Given an EpochManager, pages can also be read with readResident() without taking the pool latch. The hash
+* table then retires removed entries through the manager, and a freed frame is not reused until every reader
+* that might still see its old page has left its epoch.
 */
 class BufMgr 
 {
+ public:
+	/**
+   * Called by readPageAsync() with the pinned page, or with NULL and the reason the page could not be read
+	 */
+  typedef std::function<void(Page* page, std::exception_ptr error)> ReadCallback;
+
  private:
+	/**
+   * A readPageAsync() call waiting for a frame that is loading
+	 */
+  struct PendingRead {
+		EventLoop* loop;
+		ReadCallback done;
+  };
+
+	/**
+   * Latch serializing access to the frame table, hash table, clock and statistics
+	 */
+  std::mutex bufLatch;
+
 	/**
    * Current position of clockhand in our buffer pool
 	 */
@@ -185,11 +259,118 @@ class BufMgr
 	 */
   BufStats bufStats;
 
+	/**
+   * Compressed tier holding clean pages evicted from the buffer pool, NULL if disabled
+	 */
+  CompressedPageCache *compressedCache;
+
+	/**
+   * Number of frames holding a page
+	 */
+  std::uint32_t numValid;
+
+	/**
+   * Number of frames pinned at least once
+	 */
+  std::uint32_t numPinned;
+
+	/**
+   * Number of frames holding a dirty page
+	 */
+  std::uint32_t numDirty;
+
+	/**
+   * Number of frames holding pages of each file
+	 */
+  std::map<const File*, std::uint32_t> residentPages;
+
+	/**
+   * Accesses since the pool was created; frames remember it as their last access time
+	 */
+  std::uint64_t accessCount;
+
+	/**
+   * Frames the clock hand has passed since the pool was created
+	 */
+  std::uint64_t clockAdvances;
+
+	/**
+   * Pages evicted to make room since the pool was created
+	 */
+  std::uint64_t evictions;
+
+	/**
+   * Scheduler all file I/O goes through, NULL to do I/O directly while holding the latch
+	 */
+  IoScheduler *ioScheduler;
+
+	/**
+   * Signalled when a frame stops loading
+	 */
+  std::condition_variable frameLoaded;
+
+	/**
+   * readPageAsync() calls waiting for each loading frame, apart from the one that started the load
+	 */
+  std::map<FrameId, std::vector<PendingRead> > loadWaiters;
+
+	/**
+   * Epoch manager of lock-free readers, NULL if there are none
+	 */
+  EpochManager *epochs;
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
   void advanceClock();
 
+	/**
+	 * Assigns a frame to a page, pinning it once, and counts it as resident.
+	 *
+	 * @param frame   	Frame to assign
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  void assignFrame(FrameId frame, File* file, PageId pageNo);
+
+	/**
+	 * Pins the page held by a frame once more and counts the access.
+	 *
+	 * @param frame   	Frame holding the page
+	 */
+  void pinFrame(FrameId frame);
+
+	/**
+	 * Frees a frame, removing its page from the resident counts.
+	 * Does not touch the hash table.
+	 *
+	 * @param frame   	Frame to free
+	 */
+  void releaseFrame(FrameId frame);
+
+	/**
+	 * Returns true if a free frame may be reused, that is if no lock-free reader can still see the page it held.
+	 *
+	 * @param frame   	Free frame
+	 * @param safeEpoch	Oldest epoch a reader may be in, as last computed; updated if it is too old to tell
+	 */
+  bool frameReusable(FrameId frame, std::uint64_t& safeEpoch);
+
+	/**
+	 * Waits until a free frame may be reused.
+	 *
+	 * @param frame   	Free frame
+	 * @param safeEpoch	As for frameReusable()
+	 */
+  void waitReusable(FrameId frame, std::uint64_t& safeEpoch);
+
+	/**
+	 * Evicts the unpinned page held by a frame, writing it back if it is dirty.
+	 *
+	 * @param frame   	Frame to evict
+	 */
+  void evictFrame(FrameId frame);
+
 	/**
 	 * Allocate a free frame.  
 	 *
@@ -198,6 +379,92 @@ class BufMgr
 	 */
   void allocBuf(FrameId & frame);
 
+	/**
+	 * Allocate a free frame, like allocBuf(), but report a full pool instead of throwing.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return 			STATUS_OK, or STATUS_BUFFER_EXCEEDED if no such buffer is found which can be allocated
+	 */
+  Status tryAllocBuf(FrameId & frame);
+
+	/**
+	 * Allocates <count> adjacent free frames, starting at a multiple of <count> like a buddy allocator. Blocks
+	 * are picked by the same clock as single frames, so pages of all sizes compete for the pool alike.
+	 *
+	 * @param count   	Number of frames, a power of two
+	 * @param first   	Receives the first frame of the run
+	 * @throws BufferExceededException If every block has a pinned frame
+	 */
+  void allocRun(std::uint32_t count, FrameId& first);
+
+	/**
+	 * Allocates a frame for a page that is not in the pool and fills it from the compressed tier or the file.
+	 * With a scheduler, the file is read with the latch released while the frame is marked loading.
+	 * If the read fails, the frame is freed again.
+	 *
+	 * @param lock   	Lock holding the pool latch
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frame   	Frame reference, frame ID of the frame holding the page returned via this variable
+	 * @return 			STATUS_OK, STATUS_BUFFER_EXCEEDED or STATUS_INVALID_PAGE; other failures throw
+	 */
+  Status loadPage(std::unique_lock<std::mutex>& lock, File* file, PageId pageNo, FrameId& frame);
+
+	/**
+	 * Pins a page, loading it if it is not in the pool and waiting if another thread is loading it.
+	 *
+	 * @param lock   	Lock holding the pool latch
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Frame holding the page
+	 */
+  FrameId pinPage(std::unique_lock<std::mutex>& lock, File* file, PageId pageNo);
+
+	/**
+	 * Pins a page like pinPage(), but reports a full pool or a missing page instead of throwing.
+	 *
+	 * @param lock   	Lock holding the pool latch
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frame   	Frame reference, frame ID of the frame holding the page returned via this variable
+	 * @return 			STATUS_OK, STATUS_BUFFER_EXCEEDED or STATUS_INVALID_PAGE
+	 */
+  Status tryPinPage(std::unique_lock<std::mutex>& lock, File* file, PageId pageNo, FrameId& frame);
+
+	/**
+	 * Marks a frame as loaded, waking the threads waiting for it and pinning it once for each waiting
+	 * readPageAsync() call, whose callbacks are posted to their loops. If the read failed, frees the frame instead.
+	 *
+	 * @param frame   	Frame that was loading
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param error   	Why the read failed, if it did
+	 */
+  void finishLoad(FrameId frame, File* file, PageId pageNo, std::exception_ptr error);
+
+	/**
+	 * Writes a page to its file, or queues the write in the given class if there is a scheduler.
+	 *
+	 * @param file   	File object
+	 * @param page   	Page to write
+	 * @param ioClass Class to queue the write in
+	 */
+  void writeBack(File* file, const Page& page, IoClass ioClass);
+
+	/**
+	 * Runs an operation on a file that the scheduler has no request for, such as allocating or syncing.
+	 *
+	 * @param operation	Operation to run
+	 */
+  void fileOp(const std::function<void()>& operation);
+
+	/**
+	 * Returns the latch of the frame holding a page of the pool.
+	 *
+	 * @param page  	Page in the pool
+	 */
+  FrameLatch& latchOf(const Page* page);
+
  public:
 	/**
    * Actual buffer pool from which frames are allocated
@@ -206,8 +473,14 @@ class BufMgr
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs   					Number of frames in the buffer pool
+	 * @param compressedBytes Memory budget of the compressed page tier in bytes, 0 to disable it
+	 * @param scheduler				Scheduler to do file I/O through, NULL to do it directly; it must outlive the BufMgr
+	 * @param epochs					Epoch manager of readResident() callers, NULL if there are none; it must outlive the BufMgr
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, std::size_t compressedBytes = 0, IoScheduler* scheduler = NULL,
+         EpochManager* epochs = NULL);
 	
 	/**
    * Destructor of BufMgr class
@@ -225,6 +498,101 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Reads the given page like readPage(), but reports the conditions callers are expected to handle
+	 * instead of throwing. Without an I/O scheduler none of them throws on the way.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer, set to the pinned page if it is read
+	 * @return 			STATUS_OK, STATUS_BUFFER_EXCEEDED if every frame is pinned, or STATUS_INVALID_PAGE if
+	 *             the page does not exist in the file or is not used
+	 */
+  Status tryReadPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Reads the page a reference refers to like readPage(), swizzling the reference to point at the frame
+	 * unless another reference already does. Reads through a swizzled reference pin the frame directly,
+	 * without a hash table lookup.
+	 *
+	 * @param file   	File object
+	 * @param ref   	Reference to the page, which must stay put while swizzled
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 */
+  void readPage(File* file, PageRef& ref, Page*& page);
+
+	/**
+	 * Resets a reference swizzled by this pool to its page number. Called by the reference's destructor.
+	 *
+	 * @param ref   	Reference
+	 */
+  void unswizzle(PageRef& ref);
+
+	/**
+	 * Reads the given page into a frame and passes it, pinned, to a callback without blocking on I/O.
+	 * If the page is in the buffer pool, the callback runs before readPageAsync() returns. Otherwise the page
+	 * is read through the scheduler and the callback runs on a thread driving <loop>, which has to be running
+	 * for the read to finish. Without a scheduler the page is read synchronously.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param loop   	Event loop to finish the read on
+	 * @param done   	Called with the page once it is in the buffer pool, or with the exception reading it threw
+	 * @throws BufferExceededException If no frame can be allocated for the page
+	 */
+  void readPageAsync(File* file, const PageId PageNo, EventLoop& loop, const ReadCallback& done);
+
+	/**
+	 * Pins those of the given pages that are in the buffer pool, taking the latch once for the whole batch.
+	 * Lookups are interleaved in groups with prefetching (see BufHashTbl::lookupBatch()), which pays off when
+	 * the hash table and frame table do not fit in the processor caches. Pages that are not in the pool, or
+	 * still being read into it, are left to readPage(), which counts them in the file's statistics.
+	 *
+	 * @param count   	Number of pages
+	 * @param files   	File of each page
+	 * @param pageNos 	Page number of each page
+	 * @param pages   	Receives a pointer to each page pinned, NULL for the others
+	 * @return  			Number of pages pinned
+	 */
+  std::size_t pinResidentPages(const std::size_t count, File* const* files, const PageId* pageNos, Page** pages);
+
+	/**
+	 * Reads <count> consecutive pages of a file into adjacent frames and pins them, so that they can be
+	 * used as one large page of count * Page::SIZE bytes. The frames are taken from the same pool and clock
+	 * as single pages; pages of the extent already in the pool elsewhere are moved into it.
+	 *
+	 * @param file   	File object
+	 * @param firstPageNo	Number of the first page
+	 * @param count   	Number of pages, a power of two; 2 and 8 give 16 KiB and 64 KiB pages
+	 * @param pages  	Receives the first of the <count> pages
+	 * @throws PagePinnedException If a page of the extent is pinned in a frame outside the run
+	 * @throws BufferExceededException If no run of frames can be allocated
+	 */
+  void readExtent(File* file, const PageId firstPageNo, const std::uint32_t count, Page*& pages);
+
+	/**
+	 * Unpins the pages of an extent read with readExtent().
+	 *
+	 * @param file   	File object
+	 * @param firstPageNo	Number of the first page
+	 * @param count   	Number of pages
+	 * @param dirty		True if the pages need to be marked dirty
+	 */
+  void unPinExtent(File* file, const PageId firstPageNo, const std::uint32_t count, const bool dirty);
+
+	/**
+	 * Passes a page in the buffer pool to <reader> without taking the pool latch or pinning the page. The page
+	 * is latched shared while <reader> runs, which must not call back into the BufMgr. The caller has to be
+	 * inside a guard of the pool's EpochManager, which keeps the frame from being reused meanwhile. A page read
+	 * this way counts as recently used for replacement, as it does with readPage().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param reader 	Called with the page if it is in the pool
+	 * @return  			False if the page is not in the pool, is being read in, or is latched exclusive; use readPage() then
+	 */
+  bool readResident(const File* file, const PageId pageNo, const std::function<void(const Page& page)>& reader);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -235,6 +603,53 @@ class BufMgr
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
+	/**
+	 * Reads the given page like readPage() and then latches it. The latch is taken after the pool latch is
+	 * released, so waiting for it does not hold up other threads' use of the pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param mode   	Whether to latch the page shared or exclusive
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page, const LatchMode mode);
+
+	/**
+	 * Releases the latch of a page read with the LatchMode overload of readPage() and unpins it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+	 * @param mode   	Mode the page was latched in
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty, const LatchMode mode);
+
+	/**
+	 * Latches a page the caller has pinned.
+	 *
+	 * @param page  	Page returned by readPage() or allocPage()
+	 * @param mode   	Whether to latch the page shared or exclusive
+	 */
+  void latchPage(const Page* page, const LatchMode mode);
+
+	/**
+	 * Releases the latch of a page, which stays pinned.
+	 *
+	 * @param page  	Latched page
+	 * @param mode   	Mode the page was latched in
+	 */
+  void unlatchPage(const Page* page, const LatchMode mode);
+
+	/**
+	 * Turns a shared latch on a page into an exclusive one. Fails if another thread is upgrading the same
+	 * latch; the caller then still holds it shared and has to release it before latching it exclusive.
+	 *
+	 * @param page  	Page latched shared
+	 * @return  			True if the page is now latched exclusive
+	 */
+  bool upgradeLatch(const Page* page);
+
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
 	 * The newly allocated page is also assigned a frame in the buffer pool.
@@ -245,6 +660,16 @@ class BufMgr
 	 */
   void allocPage(File* file, PageId &PageNo, Page*& page); 
 
+	/**
+	 * Allocates a new, empty page like allocPage(), but reports a full pool instead of throwing.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @return 			STATUS_OK, or STATUS_BUFFER_EXCEEDED if every frame is pinned
+	 */
+  Status tryAllocPage(File* file, PageId &PageNo, Page*& page);
+
 		/**
 		 * Writes out all dirty pages of the file to disk.
 		 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
@@ -256,6 +681,15 @@ class BufMgr
 		 */
   void flushFile(const File* file);
 
+	/**
+	 * Writes out the dirty pages of all files that are not pinned and syncs the files, keeping the pages in the pool.
+	 * The latch is taken once per frame, so other threads keep using the pool meanwhile. With a scheduler the
+	 * pages are copied and written in the background class, merged into runs where they are adjacent.
+	 *
+	 * @return Number of pages written
+	 */
+  std::uint32_t checkpoint();
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
@@ -266,7 +700,7 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
-   * Print member variable values. 
+   * Print member variable values. Visits every frame while holding the pool latch; see snapshot() for a cheaper summary.
 	 */
   void  printSelf();
 
@@ -278,11 +712,35 @@ class BufMgr
 		return bufStats;
   }
 
+	/**
+   * Get the compressed page tier, NULL if it is disabled
+	 */
+  CompressedPageCache* getCompressedCache()
+  {
+		return compressedCache;
+  }
+
+	/**
+   * Default number of frames snapshot() estimates ages from
+	 */
+  static const std::uint32_t DEFAULT_SAMPLE_FRAMES = 4096;
+
+	/**
+	 * Returns the aggregated state of the buffer pool.
+	 * Counts come from counters kept up to date by every operation. The age histogram is estimated from
+	 * about <sampleFrames> frames spread over the pool, which are visited in small batches so that other
+	 * threads can use the pool in between.
+	 *
+	 * @param sampleFrames	Number of frames to estimate ages from; the whole pool if it has no more frames, none if 0
+	 */
+  BufPoolSnapshot snapshot(std::uint32_t sampleFrames = DEFAULT_SAMPLE_FRAMES);
+
 	/**
    * Clear buffer pool usage statistics
 	 */
   void clearBufStats() 
   {
+		std::lock_guard<std::mutex> guard(bufLatch);
 		bufStats.clear();
   }
 };
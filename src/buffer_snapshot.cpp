@@ -0,0 +1,126 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "buffer_snapshot.h"
+
+#include <sstream>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * First line of the text form, naming the format and its version.
+ */
+const char* const SNAPSHOT_MAGIC = "badgerdb-bufpool-snapshot 1";
+
+}
+
+const int BufPoolSnapshot::AGE_BUCKETS;
+
+BufPoolSnapshot::BufPoolSnapshot()
+    : takenAt(0),
+      frames(0),
+      valid(0),
+      pinned(0),
+      dirty(0),
+      accesses(0),
+      clockAdvances(0),
+      evictions(0),
+      sampledFrames(0),
+      ageHistogram(AGE_BUCKETS, 0) {
+}
+
+std::uint64_t BufPoolSnapshot::bucketStart(const int bucket) {
+  return bucket == 0 ? 0 : std::uint64_t(1) << (bucket - 1);
+}
+
+double BufPoolSnapshot::rate(const BufPoolSnapshot& earlier,
+                             const BufPoolSnapshot& later,
+                             const std::uint64_t earlierCount,
+                             const std::uint64_t laterCount) {
+  if (later.takenAt <= earlier.takenAt || laterCount < earlierCount) {
+    return 0;
+  }
+  return (laterCount - earlierCount) * 1e9 /
+         (later.takenAt - earlier.takenAt);
+}
+
+void BufPoolSnapshot::write(std::ostream& out) const {
+  out << SNAPSHOT_MAGIC << "\n"
+      << "taken_at " << takenAt << "\n"
+      << "frames " << frames << "\n"
+      << "valid " << valid << "\n"
+      << "pinned " << pinned << "\n"
+      << "dirty " << dirty << "\n"
+      << "accesses " << accesses << "\n"
+      << "clock_advances " << clockAdvances << "\n"
+      << "evictions " << evictions << "\n"
+      << "sampled_frames " << sampledFrames << "\n"
+      << "age_histogram";
+  for (int i = 0; i < AGE_BUCKETS; ++i) {
+    out << " " << ageHistogram[i];
+  }
+  out << "\n";
+  // The file name goes last on its line since it may contain spaces.
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    out << "file " << files[i].pages << " " << files[i].filename << "\n";
+  }
+  out << "end\n";
+}
+
+bool BufPoolSnapshot::read(std::istream& in) {
+  std::string line;
+  if (!std::getline(in, line) || line != SNAPSHOT_MAGIC) {
+    return false;
+  }
+  *this = BufPoolSnapshot();
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+    if (key == "end") {
+      return true;
+    } else if (key == "taken_at") {
+      fields >> takenAt;
+    } else if (key == "frames") {
+      fields >> frames;
+    } else if (key == "valid") {
+      fields >> valid;
+    } else if (key == "pinned") {
+      fields >> pinned;
+    } else if (key == "dirty") {
+      fields >> dirty;
+    } else if (key == "accesses") {
+      fields >> accesses;
+    } else if (key == "clock_advances") {
+      fields >> clockAdvances;
+    } else if (key == "evictions") {
+      fields >> evictions;
+    } else if (key == "sampled_frames") {
+      fields >> sampledFrames;
+    } else if (key == "age_histogram") {
+      for (int i = 0; i < AGE_BUCKETS; ++i) {
+        fields >> ageHistogram[i];
+      }
+    } else if (key == "file") {
+      FileResidency residency;
+      fields >> residency.pages;
+      fields.get();
+      std::getline(fields, residency.filename);
+      files.push_back(residency);
+    }
+    // Unknown keys are skipped so newer writers stay readable.
+    if (fields.fail()) {
+      return false;
+    }
+  }
+  // Truncated: the end marker is missing.
+  return false;
+}
+
+}
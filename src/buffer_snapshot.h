@@ -0,0 +1,148 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace badgerdb {
+
+/**
+ * @brief Number of buffer pool frames holding pages of one file.
+ */
+struct FileResidency {
+  /**
+   * Name of the file.
+   */
+  std::string filename;
+
+  /**
+   * Number of frames holding pages of the file.
+   */
+  std::uint32_t pages;
+};
+
+/**
+ * @brief Aggregated state of a buffer pool at one point in time.
+ *
+ * Returned by BufMgr::snapshot().  Frame counts and residency are exact; the
+ * age histogram is estimated from a sample of frames.  Ages count pool
+ * accesses (readPage and allocPage calls) since a frame's page was last
+ * accessed, so they do not depend on how fast the pool is being used.
+ *
+ * Counters that only grow (accesses, clock advances, evictions) are meant to
+ * be compared between two snapshots; see rate().
+ *
+ * Snapshots can be written to and read back from a line-oriented text format
+ * so that tools outside the process can look at them.
+ */
+struct BufPoolSnapshot {
+  /**
+   * Number of buckets of the age histogram.  Bucket 0 counts frames accessed
+   * by the latest access; bucket i > 0 counts ages in [2^(i-1), 2^i).  The
+   * last bucket also counts everything older.
+   */
+  static const int AGE_BUCKETS = 32;
+
+  /**
+   * Steady clock time the snapshot was taken at, in nanoseconds.
+   */
+  std::uint64_t takenAt;
+
+  /**
+   * Number of frames in the pool.
+   */
+  std::uint32_t frames;
+
+  /**
+   * Number of frames holding a page.
+   */
+  std::uint32_t valid;
+
+  /**
+   * Number of frames pinned at least once.
+   */
+  std::uint32_t pinned;
+
+  /**
+   * Number of frames holding a dirty page.
+   */
+  std::uint32_t dirty;
+
+  /**
+   * Accesses to the pool since it was created.
+   */
+  std::uint64_t accesses;
+
+  /**
+   * Frames the clock hand has passed since the pool was created.
+   */
+  std::uint64_t clockAdvances;
+
+  /**
+   * Pages evicted to make room since the pool was created.
+   */
+  std::uint64_t evictions;
+
+  /**
+   * Frames held by each file with pages in the pool, most frames first.
+   */
+  std::vector<FileResidency> files;
+
+  /**
+   * Number of frames the age histogram was estimated from.
+   */
+  std::uint32_t sampledFrames;
+
+  /**
+   * Estimated number of valid frames per age bucket.
+   */
+  std::vector<std::uint64_t> ageHistogram;
+
+  BufPoolSnapshot();
+
+  /**
+   * Returns the lowest age counted by an age bucket.
+   *
+   * @param bucket  Index of the bucket.
+   */
+  static std::uint64_t bucketStart(const int bucket);
+
+  /**
+   * Returns the rate of a counter between two snapshots, per second.
+   *
+   * @param earlier       Snapshot taken first.
+   * @param later         Snapshot taken second.
+   * @param earlierCount  Value of the counter in <earlier>.
+   * @param laterCount    Value of the counter in <later>.
+   */
+  static double rate(const BufPoolSnapshot& earlier,
+                     const BufPoolSnapshot& later,
+                     const std::uint64_t earlierCount,
+                     const std::uint64_t laterCount);
+
+  /**
+   * Writes the snapshot in text form.
+   *
+   * @param out Stream to write to.
+   */
+  void write(std::ostream& out) const;
+
+  /**
+   * Reads a snapshot written by write().
+   *
+   * @param in  Stream to read from.
+   * @return  False if the stream does not hold a snapshot.
+   */
+  bool read(std::istream& in);
+};
+
+}
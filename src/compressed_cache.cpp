@@ -0,0 +1,87 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "compressed_cache.h"
+
+#include <cassert>
+
+#include "page_compressor.h"
+
+namespace badgerdb {
+
+CompressedPageCache::CompressedPageCache(const std::size_t capacity_bytes)
+    : capacity_(capacity_bytes),
+      bytes_used_(0) {
+}
+
+void CompressedPageCache::insert(const File* file, const Page& page) {
+  erase(file, page.page_number());
+
+  std::string data;
+  PageCompressor::compressPage(page, data);
+  const std::size_t cost = data.size() + ENTRY_OVERHEAD;
+  if (data.size() >= Page::SIZE || cost > capacity_) {
+    ++stats_.rejections;
+    return;
+  }
+
+  while (bytes_used_ + cost > capacity_) {
+    const Entry& oldest = entries_.back();
+    remove(index_.find(Key(oldest.file, oldest.page_number)));
+    ++stats_.evictions;
+  }
+
+  entries_.push_front(Entry());
+  Entry& entry = entries_.front();
+  entry.file = file;
+  entry.page_number = page.page_number();
+  entry.data.swap(data);
+  index_[Key(file, entry.page_number)] = entries_.begin();
+  bytes_used_ += cost;
+  ++stats_.insertions;
+}
+
+bool CompressedPageCache::take(const File* file, const PageId page_number,
+                               Page& page) {
+  EntryMap::iterator iter = index_.find(Key(file, page_number));
+  if (iter == index_.end()) {
+    ++stats_.misses;
+    return false;
+  }
+  const bool valid = PageCompressor::decompressPage(iter->second->data, page);
+  assert(valid);
+  remove(iter);
+  if (!valid) {
+    ++stats_.misses;
+    return false;
+  }
+  ++stats_.hits;
+  return true;
+}
+
+void CompressedPageCache::erase(const File* file, const PageId page_number) {
+  EntryMap::iterator iter = index_.find(Key(file, page_number));
+  if (iter != index_.end()) {
+    remove(iter);
+  }
+}
+
+void CompressedPageCache::eraseFile(const File* file) {
+  // Keys are ordered by file first, so the file's pages are contiguous.
+  EntryMap::iterator iter = index_.lower_bound(Key(file, 0));
+  while (iter != index_.end() && iter->first.first == file) {
+    remove(iter++);
+  }
+}
+
+void CompressedPageCache::remove(EntryMap::iterator iter) {
+  bytes_used_ -= iter->second->data.size() + ENTRY_OVERHEAD;
+  entries_.erase(iter->second);
+  index_.erase(iter);
+}
+
+}
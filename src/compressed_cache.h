@@ -0,0 +1,199 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Class to maintain statistics of compressed cache usage
+ */
+struct CompressedCacheStats
+{
+  /**
+   * Number of lookups satisfied by the compressed cache
+   */
+  int hits;
+
+  /**
+   * Number of lookups that had to go to disk
+   */
+  int misses;
+
+  /**
+   * Number of pages compressed into the cache
+   */
+  int insertions;
+
+  /**
+   * Number of compressed pages dropped to stay within the memory budget
+   */
+  int evictions;
+
+  /**
+   * Number of pages not retained because they did not compress
+   */
+  int rejections;
+
+  /**
+   * Clear all values
+   */
+  void clear()
+  {
+    hits = misses = insertions = evictions = rejections = 0;
+  }
+
+  /**
+   * Constructor of CompressedCacheStats class
+   */
+  CompressedCacheStats()
+  {
+    clear();
+  }
+};
+
+/**
+ * @brief Second buffer tier holding compressed images of clean pages.
+ *
+ * Pages evicted from the buffer pool are compressed with PageCompressor and
+ * kept here, in least recently inserted order, until the memory budget is
+ * used up.  A page read back into the buffer pool is removed from this cache,
+ * so a page lives in at most one of the two tiers.
+ *
+ * Entries are keyed by File pointer like the buffer hash table, so they must be
+ * dropped (see eraseFile()) before the File object goes away.
+ *
+ * @warning This class is not threadsafe.
+ */
+class CompressedPageCache {
+ public:
+  /**
+   * Approximate bookkeeping cost of one entry, charged against the budget
+   * on top of the compressed bytes.
+   */
+  static const std::size_t ENTRY_OVERHEAD = 64;
+
+  /**
+   * Constructs an empty cache.
+   *
+   * @param capacity_bytes  Memory budget for compressed pages, in bytes.
+   */
+  explicit CompressedPageCache(const std::size_t capacity_bytes);
+
+  /**
+   * Compresses the page and adds it to the cache, replacing any older image
+   * of the same page.  Least recently inserted pages are dropped until the
+   * new one fits.  Pages that do not compress are not retained.
+   *
+   * @param file  File the page belongs to.
+   * @param page  Clean page to retain.
+   */
+  void insert(const File* file, const Page& page);
+
+  /**
+   * Looks up a page and, if present, decompresses it into <page> and removes
+   * it from the cache.
+   *
+   * @param file        File object
+   * @param page_number Page number in the file
+   * @param page        Page to decompress into.
+   * @return  True if the page was found.
+   */
+  bool take(const File* file, const PageId page_number, Page& page);
+
+  /**
+   * Drops the page from the cache if present.
+   *
+   * @param file        File object
+   * @param page_number Page number in the file
+   */
+  void erase(const File* file, const PageId page_number);
+
+  /**
+   * Drops all pages of the file from the cache.
+   *
+   * @param file  File object
+   */
+  void eraseFile(const File* file);
+
+  /**
+   * Returns the number of pages held in the cache.
+   */
+  std::size_t size() const { return index_.size(); }
+
+  /**
+   * Returns the number of budget bytes currently used.
+   */
+  std::size_t bytesUsed() const { return bytes_used_; }
+
+  /**
+   * Returns the memory budget in bytes.
+   */
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * Get compressed cache usage statistics
+   */
+  CompressedCacheStats& getStats() { return stats_; }
+
+ private:
+  /**
+   * Compressed image of one page.
+   */
+  struct Entry {
+    const File* file;
+    PageId page_number;
+    std::string data;
+  };
+
+  typedef std::list<Entry> EntryList;
+  typedef std::pair<const File*, PageId> Key;
+  typedef std::map<Key, EntryList::iterator> EntryMap;
+
+  /**
+   * Removes the entry from the list and index and releases its budget.
+   *
+   * @param iter  Index entry to remove.
+   */
+  void remove(EntryMap::iterator iter);
+
+  /**
+   * Memory budget in bytes.
+   */
+  const std::size_t capacity_;
+
+  /**
+   * Budget bytes currently in use.
+   */
+  std::size_t bytes_used_;
+
+  /**
+   * Entries, most recently inserted first.
+   */
+  EntryList entries_;
+
+  /**
+   * Maps (file, page) to its entry.
+   */
+  EntryMap index_;
+
+  /**
+   * Usage statistics.
+   */
+  CompressedCacheStats stats_;
+};
+
+}
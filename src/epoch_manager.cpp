@@ -0,0 +1,139 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "epoch_manager.h"
+
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+
+const std::size_t EpochManager::RECLAIM_INTERVAL;
+
+EpochManager::Participant::Participant(EpochManager& manager)
+    : manager_(manager), slot_(manager.acquireSlot()), depth_(0) {
+}
+
+EpochManager::Participant::~Participant() {
+  slot_->epoch.store(0, std::memory_order_release);
+  slot_->in_use.store(false, std::memory_order_release);
+}
+
+void EpochManager::Participant::enter() {
+  if (depth_++ > 0) {
+    return;
+  }
+  slot_->epoch.store(manager_.epoch_.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  // Pairs with the fence in advance(): either the writer sees this epoch, or
+  // this thread sees everything the writer unlinked before advancing.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void EpochManager::Participant::exit() {
+  if (--depth_ == 0) {
+    slot_->epoch.store(0, std::memory_order_release);
+  }
+}
+
+EpochManager::EpochManager()
+    : epoch_(1), slots_(NULL), retired_since_reclaim_(0) {
+}
+
+EpochManager::~EpochManager() {
+  for (std::size_t i = 0; i < retired_.size(); ++i) {
+    retired_[i].second();
+  }
+  Slot* slot = slots_.load();
+  while (slot != NULL) {
+    Slot* next = slot->next;
+    delete slot;
+    slot = next;
+  }
+}
+
+std::uint64_t EpochManager::epoch() const {
+  return epoch_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t EpochManager::advance() {
+  std::uint64_t safe = epoch_.fetch_add(1) + 1;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  for (Slot* slot = slots_.load(std::memory_order_acquire); slot != NULL;
+       slot = slot->next) {
+    const std::uint64_t epoch = slot->epoch.load(std::memory_order_acquire);
+    if (epoch != 0 && epoch < safe) {
+      safe = epoch;
+    }
+  }
+  return safe;
+}
+
+void EpochManager::retire(const Reclaimer& reclaim) {
+  bool due;
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    retired_.push_back(std::make_pair(epoch(), reclaim));
+    due = ++retired_since_reclaim_ >= RECLAIM_INTERVAL;
+    if (due) {
+      retired_since_reclaim_ = 0;
+    }
+  }
+  if (due) {
+    this->reclaim();
+  }
+}
+
+std::size_t EpochManager::reclaim() {
+  const std::uint64_t safe = advance();
+  std::vector<Reclaimer> ready;
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    // Entries are in epoch order, since they are stamped under the mutex.
+    while (!retired_.empty() && retired_.front().first < safe) {
+      ready.push_back(retired_.front().second);
+      retired_.pop_front();
+    }
+  }
+  for (std::size_t i = 0; i < ready.size(); ++i) {
+    ready[i]();
+  }
+  return ready.size();
+}
+
+void EpochManager::synchronize(const std::uint64_t epoch) {
+  while (advance() <= epoch) {
+    std::this_thread::yield();
+  }
+}
+
+std::size_t EpochManager::pending() {
+  std::lock_guard<std::mutex> lock(retired_mutex_);
+  return retired_.size();
+}
+
+EpochManager::Slot* EpochManager::acquireSlot() {
+  for (Slot* slot = slots_.load(std::memory_order_acquire); slot != NULL;
+       slot = slot->next) {
+    bool free = false;
+    if (!slot->in_use.load(std::memory_order_relaxed) &&
+        slot->in_use.compare_exchange_strong(free, true,
+                                             std::memory_order_acquire)) {
+      return slot;
+    }
+  }
+  Slot* slot = new Slot;
+  slot->epoch.store(0, std::memory_order_relaxed);
+  slot->in_use.store(true, std::memory_order_relaxed);
+  slot->next = slots_.load(std::memory_order_relaxed);
+  while (!slots_.compare_exchange_weak(slot->next, slot,
+                                       std::memory_order_release)) {
+  }
+  return slot;
+}
+
+}
@@ -0,0 +1,181 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace badgerdb {
+
+/**
+ * @brief Epoch-based reclamation: defers freeing or reusing memory until no
+ *        reader that might still see it is left.
+ *
+ * Readers that follow pointers without locks register a Participant per
+ * thread and hold a Guard while they look at shared objects.  A writer that
+ * unlinks an object retires it, or notes epoch(), after unlinking; the object
+ * may be reclaimed once advance() returns an epoch greater than that, since
+ * every reader that could have seen it has left its guard by then.
+ *
+ * Guards cost two stores and a fence; writers pay a scan of the registered
+ * threads when they advance the epoch.
+ */
+class EpochManager {
+ public:
+  /**
+   * Frees or recycles a retired object.
+   */
+  typedef std::function<void()> Reclaimer;
+
+ private:
+  /**
+   * Epoch published by one registered thread, 0 while it is outside any
+   * guard.  Padded to a cache line so threads do not share one.
+   */
+  struct Slot {
+    std::atomic<std::uint64_t> epoch;
+    std::atomic<bool> in_use;
+    Slot* next;
+    char padding[64 - sizeof(std::atomic<std::uint64_t>) -
+                 sizeof(std::atomic<bool>) - sizeof(Slot*)];
+  };
+
+ public:
+  /**
+   * @brief Registration of one thread with the manager.
+   *
+   * Owned by its thread and not shared with others; it must go away before
+   * the manager does.
+   */
+  class Participant {
+   public:
+    explicit Participant(EpochManager& manager);
+    ~Participant();
+
+    /**
+     * Enters a critical section; objects seen until the matching exit() are
+     * not reclaimed.  Sections nest.
+     */
+    void enter();
+
+    /**
+     * Leaves the critical section entered last.
+     */
+    void exit();
+
+   private:
+    Participant(const Participant&);
+    Participant& operator=(const Participant&);
+
+    EpochManager& manager_;
+    Slot* slot_;
+    int depth_;
+  };
+
+  /**
+   * @brief Holds a participant in a critical section for its lifetime.
+   */
+  class Guard {
+   public:
+    explicit Guard(Participant& participant) : participant_(participant) {
+      participant_.enter();
+    }
+    ~Guard() { participant_.exit(); }
+
+   private:
+    Guard(const Guard&);
+    Guard& operator=(const Guard&);
+
+    Participant& participant_;
+  };
+
+  EpochManager();
+
+  /**
+   * Reclaims everything still retired.  No participant may be left.
+   */
+  ~EpochManager();
+
+  /**
+   * Returns the current epoch.
+   */
+  std::uint64_t epoch() const;
+
+  /**
+   * Starts a new epoch and returns the oldest epoch a reader may still be
+   * in.  Anything retired in an earlier epoch can be reclaimed.
+   */
+  std::uint64_t advance();
+
+  /**
+   * Queues an object for reclamation once no reader can still see it.  Every
+   * RECLAIM_INTERVAL retirements, reclaims what has become safe.
+   *
+   * @param reclaim Frees the object; runs on whichever thread reclaims it,
+   *                without locks held.
+   */
+  void retire(const Reclaimer& reclaim);
+
+  /**
+   * Reclaims the retired objects no reader can see any more.
+   *
+   * @return Number of objects reclaimed.
+   */
+  std::size_t reclaim();
+
+  /**
+   * Waits until advance() returns an epoch greater than <epoch>, that is
+   * until every reader that entered in it or before has left.
+   */
+  void synchronize(const std::uint64_t epoch);
+
+  /**
+   * Returns the number of objects waiting to be reclaimed.
+   */
+  std::size_t pending();
+
+  /**
+   * Retirements between automatic reclaim() calls.
+   */
+  static const std::size_t RECLAIM_INTERVAL = 64;
+
+ private:
+  EpochManager(const EpochManager&);
+  EpochManager& operator=(const EpochManager&);
+
+  /**
+   * Returns a free slot, adding one if all are taken.
+   */
+  Slot* acquireSlot();
+
+  std::atomic<std::uint64_t> epoch_;
+
+  /**
+   * Registered slots, newest first.  Slots are reused but never freed while
+   * the manager lives, so readers can walk the list without locks.
+   */
+  std::atomic<Slot*> slots_;
+
+  /**
+   * Protects retired_ and retired_since_reclaim_.
+   */
+  std::mutex retired_mutex_;
+
+  /**
+   * Retired objects with the epoch they were retired in, oldest first.
+   */
+  std::deque<std::pair<std::uint64_t, Reclaimer> > retired_;
+
+  std::size_t retired_since_reclaim_;
+};
+
+}
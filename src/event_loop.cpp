@@ -0,0 +1,63 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "event_loop.h"
+
+namespace badgerdb {
+
+EventLoop::EventLoop()
+    : stopping_(false) {
+}
+
+void EventLoop::post(const Task& task) {
+  // Notifies under the lock: once the task is queued, a runner may finish it
+  // and the owner destroy the loop.
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_.push_back(task);
+  ready_cv_.notify_one();
+}
+
+void EventLoop::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_cv_.wait(lock, [this] { return !tasks_.empty() || stopping_; });
+    if (tasks_.empty()) {
+      return;
+    }
+    Task task;
+    task.swap(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+std::size_t EventLoop::poll() {
+  std::deque<Task> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready.swap(tasks_);
+  }
+  for (std::size_t i = 0; i < ready.size(); ++i) {
+    ready[i]();
+  }
+  return ready.size();
+}
+
+void EventLoop::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopping_ = true;
+  ready_cv_.notify_all();
+}
+
+bool EventLoop::stopped() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_;
+}
+
+}
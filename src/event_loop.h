@@ -0,0 +1,76 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace badgerdb {
+
+/**
+ * @brief Queue of tasks run by the threads that drive it.
+ *
+ * Any thread may post tasks; they run in posting order on whichever thread
+ * calls run() or poll() next.  Several threads may run the same loop, in
+ * which case tasks run concurrently.
+ *
+ * BufMgr::readPageAsync() finishes reads on the loop it is given, so a
+ * thread running a loop must not block on a page that is still being read
+ * for that loop, for instance by calling BufMgr::readPage() on it.
+ */
+class EventLoop {
+ public:
+  typedef std::function<void()> Task;
+
+  EventLoop();
+
+  /**
+   * Queues a task and wakes a thread waiting in run().
+   *
+   * @param task  Task to run.
+   */
+  void post(const Task& task);
+
+  /**
+   * Runs tasks, waiting for more when there are none, until stop() has been
+   * called and no task is left.
+   */
+  void run();
+
+  /**
+   * Runs the tasks queued when it is called, without waiting for more.
+   *
+   * @return Number of tasks run.
+   */
+  std::size_t poll();
+
+  /**
+   * Makes run() return once the queue is empty.
+   */
+  void stop();
+
+  /**
+   * Returns true once stop() has been called.
+   */
+  bool stopped();
+
+ private:
+  std::mutex mutex_;
+
+  /**
+   * Signalled when a task is posted or the loop stops.
+   */
+  std::condition_variable ready_cv_;
+
+  std::deque<Task> tasks_;
+  bool stopping_;
+};
+
+}
@@ -0,0 +1,25 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_format_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+FileFormatException::FileFormatException(const std::string& name,
+                                         const std::uint16_t found,
+                                         const std::uint16_t expected)
+    : BadgerDbException(""), filename_(name), found_version_(found) {
+  std::stringstream ss;
+  ss << "File '" << filename_ << "' has layout version " << found_version_
+     << " instead of " << expected;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,56 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file being opened was written
+ *        with a different layout of its header or pages.
+ */
+class FileFormatException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file format exception for the given file.
+   *
+   * @param name      Name of the file.
+   * @param found     Layout version of the file, or 0 if it has none.
+   * @param expected  Layout version this code reads and writes.
+   */
+  FileFormatException(const std::string& name, const std::uint16_t found,
+                      const std::uint16_t expected);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the layout version of the file, or 0 if it has none.
+   */
+  virtual std::uint16_t found_version() const { return found_version_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * Layout version of the file.
+   */
+  const std::uint16_t found_version_;
+};
+
+}
@@ -0,0 +1,23 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_fault_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+IoFaultException::IoFaultException(const std::string& operation,
+                                   const std::string& detail)
+    : BadgerDbException(""), operation_(operation) {
+  std::stringstream ss;
+  ss << "I/O " << operation_ << " failed: " << detail;
+  message_.assign(ss.str());
+}
+
+}
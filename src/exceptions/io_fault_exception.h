@@ -0,0 +1,42 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the storage underneath a file fails
+ *        to carry out a read, write or sync.
+ */
+class IoFaultException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an I/O fault exception.
+   *
+   * @param operation Operation that failed (e.g. "read" or "write").
+   * @param detail    What the operation was applied to or why it failed.
+   */
+  IoFaultException(const std::string& operation, const std::string& detail);
+
+  /**
+   * Returns the operation that failed.
+   */
+  virtual const std::string& operation() const { return operation_; }
+
+ protected:
+  /**
+   * Operation that failed.
+   */
+  const std::string operation_;
+};
+
+}
@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "write_discarded_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+WriteDiscardedException::WriteDiscardedException(const PageId page_number,
+                                                 const std::string& file)
+    : BadgerDbException(""), page_number_(page_number), filename_(file) {
+  std::stringstream ss;
+  ss << "Queued write of page " << page_number_ << " of file '" << filename_
+     << "' was discarded";
+  message_.assign(ss.str());
+}
+
+}
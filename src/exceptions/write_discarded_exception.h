@@ -0,0 +1,60 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is reported to those waiting for a queued write
+ *        when the write is dropped before it reached its file, for instance
+ *        because the page is being deleted.
+ */
+class WriteDiscardedException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a write discarded exception for the given page and filename.
+   *
+   * @param page_number Page whose write was dropped.
+   * @param file        Name of the file the write was for.
+   */
+  WriteDiscardedException(const PageId page_number, const std::string& file);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~WriteDiscardedException() throw() {}
+
+  /**
+   * Returns the page whose write was dropped.
+   */
+  virtual PageId page_number() const { return page_number_; }
+
+  /**
+   * Returns name of the file the write was for.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Page whose write was dropped.
+   */
+  const PageId page_number_;
+
+  /**
+   * Name of the file the write was for.
+   */
+  const std::string filename_;
+};
+
+}
@@ -0,0 +1,154 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "fault_injecting_backend.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "exceptions/io_fault_exception.h"
+
+namespace badgerdb {
+
+FaultInjectingBackend::FaultInjectingBackend(
+    const std::shared_ptr<IoBackend>& inner)
+    : inner_(inner),
+      op_count_(0),
+      armed_(false),
+      fault_type_(IO_ERROR),
+      fault_op_(ANY_OP),
+      fault_after_(0),
+      torn_bytes_(0),
+      delayed_writes_(false),
+      crashed_(false) {
+}
+
+void FaultInjectingBackend::read(const std::uint64_t offset, char* buffer,
+                                 const std::size_t length) {
+  beginOp(READ_OP, "read");
+  inner_->read(offset, buffer, length);
+}
+
+void FaultInjectingBackend::write(const std::uint64_t offset,
+                                  const char* buffer,
+                                  const std::size_t length) {
+  if (beginOp(WRITE_OP, "write")) {
+    const std::size_t stored =
+        std::min(length, torn_bytes_ == 0 ? length / 2 : torn_bytes_);
+    apply(offset, buffer, stored);
+    std::stringstream ss;
+    ss << "injected torn write, " << stored << " of " << length
+       << " bytes stored at offset " << offset;
+    throw IoFaultException("write", ss.str());
+  }
+  apply(offset, buffer, length);
+}
+
+void FaultInjectingBackend::flush() {
+  beginOp(FLUSH_OP, "flush");
+  inner_->flush();
+}
+
+void FaultInjectingBackend::sync() {
+  beginOp(SYNC_OP, "sync");
+  inner_->sync();
+  undo_log_.clear();
+}
+
+std::uint64_t FaultInjectingBackend::size() {
+  if (crashed_) {
+    throw IoFaultException("size", "storage is down after a crash");
+  }
+  return inner_->size();
+}
+
+void FaultInjectingBackend::allocate(const std::uint64_t offset,
+                                     const std::uint64_t length) {
+  if (crashed_) {
+    throw IoFaultException("allocate", "storage is down after a crash");
+  }
+  inner_->allocate(offset, length);
+}
+
+void FaultInjectingBackend::deallocate(const std::uint64_t offset,
+                                       const std::uint64_t length) {
+  if (crashed_) {
+    throw IoFaultException("deallocate", "storage is down after a crash");
+  }
+  inner_->deallocate(offset, length);
+}
+
+void FaultInjectingBackend::truncate(const std::uint64_t size) {
+  if (crashed_) {
+    throw IoFaultException("truncate", "storage is down after a crash");
+  }
+  inner_->truncate(size);
+}
+
+void FaultInjectingBackend::injectFault(const FaultType type,
+                                        const std::uint64_t skip_ops,
+                                        const OpType op) {
+  armed_ = true;
+  fault_type_ = type;
+  fault_op_ = op;
+  fault_after_ = op_count_ + skip_ops;
+}
+
+void FaultInjectingBackend::crash() {
+  // Roll back newest first so overlapping writes restore the oldest bytes.
+  for (std::vector<UndoRecord>::reverse_iterator iter = undo_log_.rbegin();
+       iter != undo_log_.rend(); ++iter) {
+    std::string bytes(iter->old_bytes);
+    bytes.resize(iter->length, '\0');
+    inner_->write(iter->offset, bytes.data(), bytes.size());
+  }
+  undo_log_.clear();
+  crashed_ = true;
+  armed_ = false;
+}
+
+bool FaultInjectingBackend::beginOp(const OpType op, const std::string& name) {
+  ++op_count_;
+  if (crashed_) {
+    throw IoFaultException(name, "storage is down after a crash");
+  }
+  if (!armed_ || op_count_ <= fault_after_ ||
+      (fault_op_ != ANY_OP && fault_op_ != op) ||
+      (fault_type_ == TORN_WRITE && op != WRITE_OP)) {
+    return false;
+  }
+  armed_ = false;
+  switch (fault_type_) {
+    case TORN_WRITE:
+      return true;
+    case CRASH:
+      crash();
+      throw IoFaultException(name, "injected crash");
+    case IO_ERROR:
+    default:
+      throw IoFaultException(name, "injected I/O error");
+  }
+}
+
+void FaultInjectingBackend::apply(const std::uint64_t offset,
+                                  const char* buffer,
+                                  const std::size_t length) {
+  if (delayed_writes_) {
+    UndoRecord record;
+    record.offset = offset;
+    record.length = length;
+    const std::uint64_t end = inner_->size();
+    if (offset < end) {
+      record.old_bytes.resize(std::min<std::uint64_t>(length, end - offset));
+      inner_->read(offset, &record.old_bytes[0], record.old_bytes.size());
+    }
+    undo_log_.push_back(record);
+  }
+  inner_->write(offset, buffer, length);
+}
+
+}
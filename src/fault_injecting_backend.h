@@ -0,0 +1,221 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Backend wrapper that fails operations on a deterministic schedule.
+ *
+ * Every read, write, flush and sync passed to the wrapped backend is counted.
+ * A fault armed with injectFault() fires on the first matching operation once
+ * the requested number of operations has gone by:
+ *
+ * - IO_ERROR fails that one operation without touching the storage.
+ * - TORN_WRITE (writes only) stores a prefix of the bytes and then fails.
+ * - CRASH fails the operation, discards all writes not yet synced and fails
+ *   every later operation until recover() is called, like a power loss.
+ *
+ * With delayed writes enabled, writes are visible to reads right away but are
+ * only durable once sync() succeeds; a crash rolls them back.
+ *
+ * allocate(), deallocate() and truncate() change no bytes File still refers
+ * to; they are passed on uncounted and a crash does not roll them back.
+ *
+ * @warning This class is not threadsafe.
+ */
+class FaultInjectingBackend : public IoBackend {
+ public:
+  /**
+   * Kinds of faults that can be injected.
+   */
+  enum FaultType {
+    IO_ERROR,
+    TORN_WRITE,
+    CRASH
+  };
+
+  /**
+   * Kinds of operations a fault can be restricted to.
+   */
+  enum OpType {
+    ANY_OP,
+    READ_OP,
+    WRITE_OP,
+    FLUSH_OP,
+    SYNC_OP
+  };
+
+  /**
+   * Wraps a backend.
+   *
+   * @param inner Backend that operations are passed on to.
+   */
+  explicit FaultInjectingBackend(const std::shared_ptr<IoBackend>& inner);
+
+  virtual void read(const std::uint64_t offset, char* buffer,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length);
+  virtual void flush();
+  virtual void sync();
+  virtual std::uint64_t size();
+  virtual void allocate(const std::uint64_t offset,
+                        const std::uint64_t length);
+  virtual void deallocate(const std::uint64_t offset,
+                          const std::uint64_t length);
+  virtual void truncate(const std::uint64_t size);
+
+  /**
+   * Arms a fault.  Only one fault is armed at a time; arming another replaces
+   * it.  TORN_WRITE faults only fire on writes.
+   *
+   * @param type      Kind of fault.
+   * @param skip_ops  Number of operations to let through before the fault
+   *                  can fire (0 means the next matching operation).
+   * @param op        Kind of operation the fault fires on.
+   */
+  void injectFault(const FaultType type, const std::uint64_t skip_ops,
+                   const OpType op = ANY_OP);
+
+  /**
+   * Disarms any pending fault.
+   */
+  void clearFault() { armed_ = false; }
+
+  /**
+   * Sets how many bytes of a torn write reach the storage.  By default half
+   * of the write is stored.
+   *
+   * @param bytes Number of leading bytes to store.
+   */
+  void setTornWriteBytes(const std::size_t bytes) { torn_bytes_ = bytes; }
+
+  /**
+   * Enables or disables delayed (not yet durable) writes.
+   *
+   * @param delayed True to keep writes undoable until the next sync().
+   */
+  void setDelayedWrites(const bool delayed) { delayed_writes_ = delayed; }
+
+  /**
+   * Simulates a power loss now: unsynced writes are rolled back and every
+   * operation fails until recover() is called.
+   */
+  void crash();
+
+  /**
+   * Brings the storage back after a crash.
+   */
+  void recover() { crashed_ = false; }
+
+  /**
+   * Returns true if the storage is down after a crash.
+   */
+  bool crashed() const { return crashed_; }
+
+  /**
+   * Returns the number of operations issued so far, including failed ones.
+   */
+  std::uint64_t opCount() const { return op_count_; }
+
+  /**
+   * Returns the number of writes that are not durable yet.
+   */
+  std::size_t pendingWrites() const { return undo_log_.size(); }
+
+ private:
+  /**
+   * Bytes overwritten by a delayed write, kept to roll it back.  Bytes the
+   * write appended past the old end of the storage roll back to zeros.
+   */
+  struct UndoRecord {
+    std::uint64_t offset;
+    std::size_t length;
+    std::string old_bytes;
+  };
+
+  /**
+   * Counts an operation and throws if the storage is down or a fault fires
+   * on it.  A firing TORN_WRITE fault is left to the caller.
+   *
+   * @param op    Kind of operation being issued.
+   * @param name  Name of the operation for error messages.
+   * @return  True if the caller must tear the write and then fail.
+   */
+  bool beginOp(const OpType op, const std::string& name);
+
+  /**
+   * Applies a write to the wrapped backend, remembering how to undo it if
+   * writes are delayed.
+   *
+   * @param offset  Position of the first byte to write.
+   * @param buffer  Bytes to write.
+   * @param length  Number of bytes to write.
+   */
+  void apply(const std::uint64_t offset, const char* buffer,
+             const std::size_t length);
+
+  /**
+   * Wrapped backend.
+   */
+  std::shared_ptr<IoBackend> inner_;
+
+  /**
+   * Number of operations issued so far.
+   */
+  std::uint64_t op_count_;
+
+  /**
+   * True if a fault is waiting to fire.
+   */
+  bool armed_;
+
+  /**
+   * Kind of the armed fault.
+   */
+  FaultType fault_type_;
+
+  /**
+   * Kind of operation the armed fault fires on.
+   */
+  OpType fault_op_;
+
+  /**
+   * Operation count after which the armed fault may fire.
+   */
+  std::uint64_t fault_after_;
+
+  /**
+   * Bytes stored by a torn write, or 0 for half of the write.
+   */
+  std::size_t torn_bytes_;
+
+  /**
+   * True if writes are kept undoable until the next sync.
+   */
+  bool delayed_writes_;
+
+  /**
+   * True if the storage is down after a crash.
+   */
+  bool crashed_;
+
+  /**
+   * Delayed writes since the last sync, oldest first.
+   */
+  std::vector<UndoRecord> undo_log_;
+};
+
+}
@@ -7,31 +7,58 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_format_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
+#include "trace.h"
 
 namespace badgerdb {
 
+const char* const File::MEMORY_PREFIX = "mem:";
+
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+File::StatsMap File::open_stats_;
+std::mutex File::stats_mutex_;
+File::ReservationMap File::open_reservations_;
+File::StreamMap File::memory_files_;
+std::uint64_t File::memory_spill_limit_ = 0;
+std::uint64_t File::growth_chunk_ = 0;
+bool File::punch_freed_pages_ = false;
+const std::size_t File::TRUNK_CAPACITY;
+const std::uint16_t File::FORMAT_MAGIC;
+const std::uint16_t File::FORMAT_VERSION;
 
 File File::create(const std::string& filename) {
-  return File(filename, true /* create_new */);
+  return File(filename, true /* create_new */, NULL);
 }
 
 File File::open(const std::string& filename) {
-  return File(filename, false /* create_new */);
+  return File(filename, false /* create_new */, NULL);
+}
+
+File File::create(const std::string& filename,
+                  const std::shared_ptr<IoBackend>& backend) {
+  return File(filename, true /* create_new */, backend);
+}
+
+File File::open(const std::string& filename,
+                const std::shared_ptr<IoBackend>& backend) {
+  return File(filename, false /* create_new */, backend);
 }
 
 void File::remove(const std::string& filename) {
@@ -41,7 +68,11 @@ void File::remove(const std::string& filename) {
   if (isOpen(filename)) {
     throw FileOpenException(filename);
   }
-  std::remove(filename.c_str());
+  if (isMemoryFile(filename)) {
+    memory_files_.erase(filename);
+  } else {
+    std::remove(filename.c_str());
+  }
 }
 
 bool File::isOpen(const std::string& filename) {
@@ -52,6 +83,12 @@ bool File::isOpen(const std::string& filename) {
 }
 
 bool File::exists(const std::string& filename) {
+  if (open_streams_.find(filename) != open_streams_.end()) {
+    return true;
+  }
+  if (isMemoryFile(filename)) {
+    return memory_files_.find(filename) != memory_files_.end();
+  }
 	std::fstream file(filename);
 	if(file)
 	{
@@ -62,18 +99,74 @@ bool File::exists(const std::string& filename) {
 	return false;
 }
 
+bool File::isMemoryFile(const std::string& filename) {
+  return filename.compare(0, std::strlen(MEMORY_PREFIX), MEMORY_PREFIX) == 0;
+}
+
+std::vector<FileStatsSnapshot> File::allStats() {
+  std::lock_guard<std::mutex> guard(stats_mutex_);
+  std::vector<FileStatsSnapshot> all;
+  all.reserve(open_stats_.size());
+  for (StatsMap::const_iterator it = open_stats_.begin();
+       it != open_stats_.end(); ++it) {
+    const FileStats& stats = *it->second;
+    FileStatsSnapshot snapshot;
+    snapshot.filename = it->first;
+    snapshot.page_reads = stats.page_reads.load(std::memory_order_relaxed);
+    snapshot.page_writes = stats.page_writes.load(std::memory_order_relaxed);
+    snapshot.bytes_read = stats.bytes_read.load(std::memory_order_relaxed);
+    snapshot.bytes_written =
+        stats.bytes_written.load(std::memory_order_relaxed);
+    snapshot.syncs = stats.syncs.load(std::memory_order_relaxed);
+    snapshot.cache_hits = stats.cache_hits.load(std::memory_order_relaxed);
+    snapshot.cache_misses = stats.cache_misses.load(std::memory_order_relaxed);
+    all.push_back(snapshot);
+  }
+  return all;
+}
+
 File::File(const File& other)
   : filename_(other.filename_),
-    stream_(open_streams_[filename_]) {
-  ++open_counts_[filename_];
+    stream_(other.stream_),
+    stats_(other.stats_),
+    reserved_(other.reserved_) {
+  // A moved-from File refers to no file, and neither does its copy.
+  if (stream_) {
+    ++open_counts_[filename_];
+  }
+}
+
+File::File(File&& other) noexcept
+  : filename_(std::move(other.filename_)),
+    stream_(std::move(other.stream_)),
+    stats_(std::move(other.stats_)),
+    reserved_(std::move(other.reserved_)) {
 }
 
 File& File::operator=(const File& rhs) {
   // This accounts for self-assignment and assignment of a File object for the
   // same file.
+  if (this == &rhs) {
+    return *this;
+  }
+  std::shared_ptr<IoBackend> backend = rhs.stream_;
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
-  openIfNeeded(false /* create_new */);
+  if (backend) {
+    openIfNeeded(false /* create_new */, backend);
+  }
+  return *this;
+}
+
+File& File::operator=(File&& rhs) noexcept {
+  if (this == &rhs) {
+    return *this;
+  }
+  close();
+  filename_ = std::move(rhs.filename_);
+  stream_ = std::move(rhs.stream_);
+  stats_ = std::move(rhs.stats_);
+  reserved_ = std::move(rhs.reserved_);
   return *this;
 }
 
@@ -82,13 +175,27 @@ File::~File() {
 }
 
 Page File::allocatePage() {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::allocatePage");
   FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  // Page whose next page pointer is changed to link the new page in.
+  PageId previous_page_number = Page::INVALID_NUMBER;
+  PageHeader previous_header;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-    header.first_free_page = new_page.next_page_number();
+    Page trunk = readPage(header.first_free_page, true /* allow_free */);
+    std::vector<PageId> leaves = trunkLeaves(trunk);
+    if (leaves.empty()) {
+      new_page = std::move(trunk);
+      new_page.set_page_number(header.first_free_page);
+      header.first_free_page = new_page.next_page_number();
+    } else {
+      // Take a punched page the head of the free list records; writing it
+      // allocates its space again.
+      new_page.set_page_number(leaves.back());
+      leaves.pop_back();
+      setTrunkLeaves(trunk, leaves);
+      writePage(header.first_free_page, trunk);
+    }
     --header.num_free_pages;
 
     if (header.first_used_page == Page::INVALID_NUMBER ||
@@ -101,64 +208,242 @@ Page File::allocatePage() {
       header.first_used_page = new_page.page_number();
     } else {
       // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
+      // find where in the used list to insert it.  The page headers are all
+      // the walk needs.
+      previous_page_number = header.first_used_page;
+      previous_header = readPageHeader(previous_page_number);
+      while (previous_header.next_page_number != Page::INVALID_NUMBER &&
+             previous_header.next_page_number < new_page.page_number()) {
+        previous_page_number = previous_header.next_page_number;
+        previous_header = readPageHeader(previous_page_number);
       }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+      new_page.set_next_page_number(previous_header.next_page_number);
+      previous_header.next_page_number = new_page.page_number();
     }
 
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
-    new_page.set_page_number(header.num_pages);
+    new_page.set_page_number(nextPageNumber(header));
     if (header.first_used_page == Page::INVALID_NUMBER) {
       header.first_used_page = new_page.page_number();
     } else {
       // If we have pages allocated, we need to add the new page to the tail
       // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
+      previous_page_number = header.first_used_page;
+      previous_header = readPageHeader(previous_page_number);
+      while (previous_header.next_page_number != Page::INVALID_NUMBER) {
+        previous_page_number = previous_header.next_page_number;
+        previous_header = readPageHeader(previous_page_number);
       }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
+      assert(previous_header.current_page_number == previous_page_number);
+      previous_header.next_page_number = new_page.page_number();
     }
-    ++header.num_pages;
+    header.num_pages = new_page.page_number() + 1;
+    growFor(new_page.page_number());
   }
   writePage(new_page.page_number(), new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
+  if (previous_page_number != Page::INVALID_NUMBER) {
     // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page);
+    // used list, we need to write its header out.
+    writePageHeader(previous_page_number, previous_header);
   }
   writeHeader(header);
 
   return new_page;
 }
 
+Page File::reservePage() {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::reservePage");
+  Page new_page;
+  new_page.set_page_number(reserveNextPage());
+  return new_page;
+}
+
+void File::reservePage(Page& page) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::reservePage");
+  const PageId page_number = reserveNextPage();
+  page.initialize();
+  page.set_page_number(page_number);
+}
+
+PageId File::reserveNextPage() {
+  const PageId page_number = nextPageNumber(readHeader());
+  growFor(page_number);
+  reserved_->pages[page_number] = false;
+  return page_number;
+}
+
+void File::growFor(const PageId page_number) {
+  if (growth_chunk_ == 0) {
+    return;
+  }
+  // The header keeps no high-water mark of the preallocated space: the size
+  // of the file is that mark, and it never disagrees with a header that a
+  // crash left behind.
+  const std::uint64_t end = pagePosition(page_number) + Page::SIZE;
+  const std::uint64_t size = stream_->size();
+  if (end <= size) {
+    return;
+  }
+  // Chunks are aligned in the file, so preallocated space ends at the same
+  // offsets whichever page set it off.
+  const std::uint64_t grown_end =
+      (end + growth_chunk_ - 1) / growth_chunk_ * growth_chunk_;
+  stream_->allocate(size, grown_end - size);
+}
+
+PageId File::nextPageNumber(const FileHeader& header) const {
+  if (!reserved_->pages.empty() &&
+      reserved_->pages.rbegin()->first >= header.num_pages) {
+    return reserved_->pages.rbegin()->first + 1;
+  }
+  return header.num_pages;
+}
+
+void File::linkReservedPage(const Page& new_page) {
+  const PageId page_number = new_page.page_number();
+  FileHeader header = readHeader();
+  // Find the used pages either side of the new one.  Rather than walk the
+  // list from its head, start from the closest known used page before it: a
+  // reserved page linked since the last sync, or the last page of the list.
+  // It is checked on disk first, in case it has been deleted since.
+  PageId start_page_number = reserved_->last_used_page;
+  if (start_page_number >= page_number) {
+    start_page_number = Page::INVALID_NUMBER;
+  }
+  std::map<PageId, bool>::const_iterator linked =
+      reserved_->pages.lower_bound(page_number);
+  while (linked != reserved_->pages.begin()) {
+    --linked;
+    if (linked->second) {
+      start_page_number = std::max(start_page_number, linked->first);
+      break;
+    }
+  }
+  PageId previous_page_number = Page::INVALID_NUMBER;
+  PageHeader previous_header;
+  PageId next_page_number = header.first_used_page;
+  if (start_page_number != Page::INVALID_NUMBER &&
+      start_page_number < header.num_pages) {
+    previous_header = readPageHeader(start_page_number);
+    if (previous_header.current_page_number == start_page_number) {
+      previous_page_number = start_page_number;
+      next_page_number = previous_header.next_page_number;
+    }
+  }
+  while (next_page_number != Page::INVALID_NUMBER &&
+         next_page_number < page_number) {
+    previous_page_number = next_page_number;
+    previous_header = readPageHeader(next_page_number);
+    next_page_number = previous_header.next_page_number;
+  }
+  if (next_page_number == page_number) {
+    // Linked by an earlier write that is not durable yet.
+    const PageHeader linked_header = readPageHeader(page_number);
+    next_page_number = linked_header.current_page_number == page_number
+                           ? linked_header.next_page_number
+                           : Page::INVALID_NUMBER;
+  }
+  // Until the link from the previous page is written, a crash leaves the page
+  // out of the used list, its space lost but the file consistent.
+  PageHeader page_header = new_page.header_;
+  page_header.next_page_number = next_page_number;
+  writePage(page_number, page_header, new_page);
+  if (header.num_pages <= page_number) {
+    header.num_pages = page_number + 1;
+  }
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = page_number;
+  }
+  writeHeader(header);
+  if (previous_page_number != Page::INVALID_NUMBER) {
+    previous_header.next_page_number = page_number;
+    writePageHeader(previous_page_number, previous_header);
+  }
+  reserved_->pages[page_number] = true;
+  if (next_page_number == Page::INVALID_NUMBER) {
+    reserved_->last_used_page = page_number;
+  }
+}
+
+void File::appendPages(std::vector<Page>& pages) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::appendPages");
+  if (pages.empty()) {
+    return;
+  }
+  FileHeader header = readHeader();
+  const PageId first_page = nextPageNumber(header);
+  const PageId last_page = first_page + pages.size() - 1;
+  // Every used page comes before the new ones, so they go at the tail of the
+  // used list.  Start looking for it at the last page a write linked.
+  PageId previous_page_number = Page::INVALID_NUMBER;
+  PageHeader previous_header;
+  PageId next_page_number = header.first_used_page;
+  const PageId hint = reserved_->last_used_page;
+  if (hint != Page::INVALID_NUMBER && hint < header.num_pages) {
+    previous_header = readPageHeader(hint);
+    if (previous_header.current_page_number == hint) {
+      previous_page_number = hint;
+      next_page_number = previous_header.next_page_number;
+    }
+  }
+  while (next_page_number != Page::INVALID_NUMBER) {
+    previous_page_number = next_page_number;
+    previous_header = readPageHeader(next_page_number);
+    next_page_number = previous_header.next_page_number;
+  }
+
+  std::string bytes(pages.size() * Page::SIZE, '\0');
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    const PageId page_number = first_page + i;
+    pages[i].set_page_number(page_number);
+    pages[i].set_next_page_number(
+        page_number == last_page ? Page::INVALID_NUMBER : page_number + 1);
+    std::memcpy(&bytes[i * Page::SIZE], &pages[i].header_, sizeof(PageHeader));
+    std::memcpy(&bytes[i * Page::SIZE + sizeof(PageHeader)],
+                pages[i].data_.data(), Page::DATA_SIZE);
+    pages[i].clear_dirty_sectors();
+  }
+  growFor(last_page);
+  stream_->write(pagePosition(first_page), bytes.data(), bytes.size());
+  stream_->flush();
+  FileStats::add(stats_->page_writes, pages.size());
+  FileStats::add(stats_->bytes_written, bytes.size());
+
+  header.num_pages = last_page + 1;
+  if (previous_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = first_page;
+  }
+  writeHeader(header);
+  if (previous_page_number != Page::INVALID_NUMBER) {
+    previous_header.next_page_number = first_page;
+    writePageHeader(previous_page_number, previous_header);
+  }
+  reserved_->last_used_page = last_page;
+}
+
 Page File::readPage(const PageId page_number) const {
+  Page page;
+  if (tryReadPage(page_number, page) != STATUS_OK) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return page;
+}
+
+Status File::tryReadPage(const PageId page_number, Page& page) const {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::readPage");
   FileHeader header = readHeader();
   if (page_number >= header.num_pages) {
-    throw InvalidPageException(page_number, filename_);
+    return STATUS_INVALID_PAGE;
   }
-  return readPage(page_number, false /* allow_free */);
+  readPageInto(page_number, page);
+  return page.isUsed() ? STATUS_OK : STATUS_INVALID_PAGE;
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  readPageInto(page_number, page);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -166,7 +451,108 @@ Page File::readPage(const PageId page_number, const bool allow_free) const {
   return page;
 }
 
+void File::readPageInto(const PageId page_number, Page& page) const {
+  // A page that was moved from has no data left to read into.
+  page.data_.resize(Page::DATA_SIZE);
+  const std::uint64_t position = pagePosition(page_number);
+  stream_->read(position, reinterpret_cast<char*>(&page.header_),
+                sizeof(page.header_));
+  stream_->read(position + sizeof(page.header_), &page.data_[0],
+                Page::DATA_SIZE);
+  FileStats::add(stats_->page_reads, 1);
+  FileStats::add(stats_->bytes_read, Page::SIZE);
+  page.clear_dirty_sectors();
+}
+
+std::vector<Page> File::readPages(const PageId first_page,
+                                  const PageId count) const {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::readPages");
+  const FileHeader header = readHeader();
+  if (count == 0 || first_page == Page::INVALID_NUMBER ||
+      first_page + count > header.num_pages) {
+    throw InvalidPageException(first_page + count - 1, filename_);
+  }
+  std::string bytes(count * Page::SIZE, '\0');
+  stream_->read(pagePosition(first_page), &bytes[0], bytes.size());
+  FileStats::add(stats_->page_reads, count);
+  FileStats::add(stats_->bytes_read, bytes.size());
+
+  std::vector<Page> pages(count);
+  for (PageId i = 0; i < count; ++i) {
+    const char* page_bytes = bytes.data() + i * Page::SIZE;
+    std::memcpy(&pages[i].header_, page_bytes, sizeof(PageHeader));
+    pages[i].data_.assign(page_bytes + sizeof(PageHeader), Page::DATA_SIZE);
+    pages[i].clear_dirty_sectors();
+    if (!pages[i].isUsed()) {
+      throw InvalidPageException(first_page + i, filename_);
+    }
+  }
+  return pages;
+}
+
+void File::writePages(const std::vector<Page>& pages) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::writePages");
+  if (pages.empty()) {
+    return;
+  }
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (reserved_->pages.count(pages[i].page_number()) != 0) {
+      // Reserved pages are linked into the file one at a time.
+      for (std::size_t j = 0; j < pages.size(); ++j) {
+        writePage(pages[j]);
+      }
+      return;
+    }
+  }
+  const PageId first_page = pages.front().page_number();
+  std::string bytes(pages.size() * Page::SIZE, '\0');
+  stream_->read(pagePosition(first_page), &bytes[0], bytes.size());
+  FileStats::add(stats_->bytes_read, bytes.size());
+
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    assert(pages[i].page_number() == first_page + i);
+    char* page_bytes = &bytes[i * Page::SIZE];
+    PageHeader header;
+    std::memcpy(&header, page_bytes, sizeof(header));
+    if (header.current_page_number == Page::INVALID_NUMBER) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(pages[i].page_number(), filename_);
+    }
+    // As in writePage(), keep the next page pointer that is on disk.
+    const PageId next_page_number = header.next_page_number;
+    header = pages[i].header_;
+    header.next_page_number = next_page_number;
+    std::memcpy(page_bytes, &header, sizeof(header));
+    std::memcpy(page_bytes + sizeof(header), pages[i].data_.data(),
+                Page::DATA_SIZE);
+  }
+  stream_->write(pagePosition(first_page), bytes.data(), bytes.size());
+  stream_->flush();
+  FileStats::add(stats_->page_writes, pages.size());
+  FileStats::add(stats_->bytes_written, bytes.size());
+}
+
+void File::sync() const {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::sync");
+  stream_->sync();
+  FileStats::add(stats_->syncs, 1);
+  // Reserved pages written so far are in the file for good.
+  for (std::map<PageId, bool>::iterator it = reserved_->pages.begin();
+       it != reserved_->pages.end();) {
+    if (it->second) {
+      reserved_->pages.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
 void File::writePage(const Page& new_page) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::writePage");
+  if (reserved_->pages.count(new_page.page_number()) != 0) {
+    linkReservedPage(new_page);
+    return;
+  }
   PageHeader header = readPageHeader(new_page.page_number());
   if (header.current_page_number == Page::INVALID_NUMBER) {
     // Page has been deleted since it was read.
@@ -181,22 +567,102 @@ void File::writePage(const Page& new_page) {
   writePage(new_page.page_number(), header, new_page);
 }
 
+void File::writeDirtySectors(const Page& new_page) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::writeDirtySectors");
+  const std::uint32_t sectors = new_page.dirty_sectors();
+  if (sectors == Page::ALL_SECTORS ||
+      reserved_->pages.count(new_page.page_number()) != 0) {
+    writePage(new_page);
+    return;
+  }
+  if (sectors == 0) {
+    return;
+  }
+  PageHeader header = readPageHeader(new_page.page_number());
+  if (header.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(new_page.page_number(), filename_);
+  }
+  // As in writePage(), keep the next page pointer that is on disk.
+  const PageId next_page_number = header.next_page_number;
+  header = new_page.header_;
+  header.next_page_number = next_page_number;
+  std::string bytes(Page::SIZE, '\0');
+  std::memcpy(&bytes[0], &header, sizeof(header));
+  std::memcpy(&bytes[sizeof(header)], new_page.data_.data(), Page::DATA_SIZE);
+
+  const std::uint64_t position = pagePosition(new_page.page_number());
+  std::size_t sector = 0;
+  while (sector < Page::SECTORS) {
+    if ((sectors & (1U << sector)) == 0) {
+      ++sector;
+      continue;
+    }
+    const std::size_t first = sector;
+    while (sector < Page::SECTORS && (sectors & (1U << sector)) != 0) {
+      ++sector;
+    }
+    stream_->write(position + first * Page::SECTOR_SIZE,
+                   bytes.data() + first * Page::SECTOR_SIZE,
+                   (sector - first) * Page::SECTOR_SIZE);
+    FileStats::add(stats_->bytes_written,
+                   (sector - first) * Page::SECTOR_SIZE);
+  }
+  stream_->flush();
+  FileStats::add(stats_->page_writes, 1);
+}
+
 void File::deletePage(const PageId page_number) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::deletePage");
+  std::map<PageId, bool>::iterator reservation =
+      reserved_->pages.find(page_number);
+  if (reservation != reserved_->pages.end()) {
+    const bool linked = reservation->second;
+    reserved_->pages.erase(reservation);
+    if (!linked) {
+      return;
+    }
+  }
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
-  Page previous_page;
   // If this page is the head of the used list, update the header to point to
   // the next page in line.
   if (page_number == header.first_used_page) {
     header.first_used_page = existing_page.next_page_number();
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
+    // Walk the used list so we can update the header of the page that points
+    // to this one.
+    PageId previous_page_number = header.first_used_page;
+    while (previous_page_number != Page::INVALID_NUMBER) {
+      PageHeader previous_header = readPageHeader(previous_page_number);
+      if (previous_header.next_page_number == page_number) {
+        previous_header.next_page_number = existing_page.next_page_number();
+        writePageHeader(previous_page_number, previous_header);
         break;
       }
+      previous_page_number = previous_header.next_page_number;
+    }
+  }
+  if (punch_freed_pages_) {
+    if (page_number == header.num_pages - 1 && !hasUnlinkedReservations()) {
+      // The last page leaves the file altogether.
+      header.num_pages = page_number;
+      writeHeader(header);
+      stream_->truncate(pagePosition(page_number));
+      return;
+    }
+    if (header.num_free_pages > 0) {
+      Page trunk = readPage(header.first_free_page, true /* allow_free */);
+      std::vector<PageId> leaves = trunkLeaves(trunk);
+      if (leaves.size() < TRUNK_CAPACITY) {
+        // Record the page in the head of the free list before punching it.
+        leaves.push_back(page_number);
+        setTrunkLeaves(trunk, leaves);
+        writePage(header.first_free_page, trunk);
+        ++header.num_free_pages;
+        writeHeader(header);
+        stream_->deallocate(pagePosition(page_number), Page::SIZE);
+        return;
+      }
     }
   }
   // Clear the page and add it to the head of the free list.
@@ -204,13 +670,102 @@ void File::deletePage(const PageId page_number) {
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page);
-  }
   writePage(page_number, existing_page);
   writeHeader(header);
 }
 
+void File::reclaimFreeSpace() {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "file", "File::reclaimFreeSpace");
+  FileHeader header = readHeader();
+  std::vector<PageId> free_pages;
+  free_pages.reserve(header.num_free_pages);
+  for (PageId trunk_number = header.first_free_page;
+       trunk_number != Page::INVALID_NUMBER;) {
+    const Page trunk = readPage(trunk_number, true /* allow_free */);
+    const std::vector<PageId> leaves = trunkLeaves(trunk);
+    free_pages.push_back(trunk_number);
+    free_pages.insert(free_pages.end(), leaves.begin(), leaves.end());
+    trunk_number = trunk.next_page_number();
+  }
+  std::sort(free_pages.begin(), free_pages.end());
+
+  const PageId old_num_pages = header.num_pages;
+  if (!hasUnlinkedReservations()) {
+    while (!free_pages.empty() && free_pages.back() == header.num_pages - 1) {
+      free_pages.pop_back();
+      --header.num_pages;
+    }
+  }
+
+  // Rebuild the free list with its lowest pages as trunks, so later cuts at
+  // the end of the file rarely meet one; the other free pages are leaves.
+  const std::size_t trunks =
+      (free_pages.size() + TRUNK_CAPACITY) / (TRUNK_CAPACITY + 1);
+  for (std::size_t t = 0; t < trunks; ++t) {
+    const std::size_t first_leaf = trunks + t * TRUNK_CAPACITY;
+    const std::size_t last_leaf =
+        std::min(first_leaf + TRUNK_CAPACITY, free_pages.size());
+    Page trunk;
+    if (t + 1 < trunks) {
+      trunk.set_next_page_number(free_pages[t + 1]);
+    }
+    setTrunkLeaves(trunk,
+                   std::vector<PageId>(free_pages.begin() + first_leaf,
+                                       free_pages.begin() + last_leaf));
+    writePage(free_pages[t], trunk);
+  }
+  header.first_free_page = Page::INVALID_NUMBER;
+  if (trunks > 0) {
+    header.first_free_page = free_pages[0];
+  }
+  header.num_free_pages = free_pages.size();
+  writeHeader(header);
+
+  // Only now that nothing refers to their contents are pages released.
+  std::size_t run_start = trunks;
+  for (std::size_t i = trunks; i < free_pages.size(); ++i) {
+    if (i + 1 == free_pages.size() || free_pages[i + 1] != free_pages[i] + 1) {
+      stream_->deallocate(pagePosition(free_pages[run_start]),
+                          (i + 1 - run_start) * Page::SIZE);
+      run_start = i + 1;
+    }
+  }
+  if (header.num_pages < old_num_pages) {
+    stream_->truncate(pagePosition(header.num_pages));
+  }
+}
+
+std::vector<PageId> File::trunkLeaves(const Page& trunk) {
+  // A free page's data starts with the number of leaves, then lists them.
+  PageId count;
+  std::memcpy(&count, trunk.data_.data(), sizeof(count));
+  std::vector<PageId> leaves(std::min<std::size_t>(count, TRUNK_CAPACITY));
+  if (!leaves.empty()) {
+    std::memcpy(&leaves[0], trunk.data_.data() + sizeof(count),
+                leaves.size() * sizeof(PageId));
+  }
+  return leaves;
+}
+
+void File::setTrunkLeaves(Page& trunk, const std::vector<PageId>& leaves) {
+  const PageId count = leaves.size();
+  std::memcpy(&trunk.data_[0], &count, sizeof(count));
+  if (!leaves.empty()) {
+    std::memcpy(&trunk.data_[sizeof(count)], &leaves[0],
+                leaves.size() * sizeof(PageId));
+  }
+}
+
+bool File::hasUnlinkedReservations() const {
+  for (std::map<PageId, bool>::const_iterator it = reserved_->pages.begin();
+       it != reserved_->pages.end(); ++it) {
+    if (!it->second) {
+      return true;
+    }
+  }
+  return false;
+}
+
 FileIterator File::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -220,21 +775,66 @@ FileIterator File::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+File::File(const std::string& name, const bool create_new,
+           const std::shared_ptr<IoBackend>& backend) : filename_(name) {
+  openIfNeeded(create_new, backend);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         FORMAT_MAGIC, FORMAT_VERSION};
     writeHeader(header);
+    return;
+  }
+
+  // Pages of another layout would be misread, so refuse the file outright.
+  FileHeader header;
+  try {
+    header = readHeader();
+  } catch (...) {
+    close();
+    throw;
+  }
+  if (header.magic != FORMAT_MAGIC || header.format_version != FORMAT_VERSION) {
+    const std::uint16_t version =
+        header.magic == FORMAT_MAGIC ? header.format_version : 0;
+    close();
+    throw FileFormatException(filename_, version, FORMAT_VERSION);
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new,
+                        const std::shared_ptr<IoBackend>& backend) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
+    if (create_new) {
+      throw FileExistsException(filename_);
+    }
+    if (backend && backend != open_streams_[filename_]) {
+      throw FileOpenException(filename_);
+    }
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+  } else if (backend) {
+    stream_ = backend;
+    open_streams_[filename_] = stream_;
+    open_counts_[filename_] = 1;
+  } else if (isMemoryFile(filename_)) {
+    StreamMap::iterator iter = memory_files_.find(filename_);
+    if (create_new) {
+      if (iter != memory_files_.end()) {
+        throw FileExistsException(filename_);
+      }
+      stream_.reset(new MemoryBackend(memory_spill_limit_));
+      memory_files_[filename_] = stream_;
+    } else {
+      if (iter == memory_files_.end()) {
+        throw FileNotFoundException(filename_);
+      }
+      stream_ = iter->second;
+    }
+    open_streams_[filename_] = stream_;
+    open_counts_[filename_] = 1;
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
@@ -252,18 +852,40 @@ void File::openIfNeeded(const bool create_new) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
+    stream_.reset(new StreamBackend(filename_, mode));
     open_streams_[filename_] = stream_;
     open_counts_[filename_] = 1;
   }
+
+  std::shared_ptr<Reservations>& reserved = open_reservations_[filename_];
+  if (!reserved) {
+    reserved.reset(new Reservations);
+  }
+  reserved_ = reserved;
+
+  std::lock_guard<std::mutex> guard(stats_mutex_);
+  std::shared_ptr<FileStats>& stats = open_stats_[filename_];
+  if (!stats) {
+    stats.reset(new FileStats);
+  }
+  stats_ = stats;
 }
 
 void File::close() {
+  if (!stream_) {
+    // Moved from (or closed by an explicit destructor call already).
+    return;
+  }
   --open_counts_[filename_];
   stream_.reset();
+  stats_.reset();
+  reserved_.reset();
   if (open_counts_[filename_] == 0) {
     open_streams_.erase(filename_);
     open_counts_.erase(filename_);
+    open_reservations_.erase(filename_);
+    std::lock_guard<std::mutex> guard(stats_mutex_);
+    open_stats_.erase(filename_);
   }
 }
 
@@ -273,31 +895,44 @@ void File::writePage(const PageId page_number, const Page& new_page) {
 
 void File::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
+  const std::uint64_t position = pagePosition(page_number);
+  stream_->write(position, reinterpret_cast<const char*>(&header),
+                 sizeof(header));
+  stream_->write(position + sizeof(header), new_page.data_.data(),
                  Page::DATA_SIZE);
   stream_->flush();
+  FileStats::add(stats_->page_writes, 1);
+  FileStats::add(stats_->bytes_written, Page::SIZE);
+}
+
+void File::writePageHeader(const PageId page_number,
+                           const PageHeader& header) {
+  stream_->write(pagePosition(page_number),
+                 reinterpret_cast<const char*>(&header), sizeof(header));
+  stream_->flush();
+  FileStats::add(stats_->bytes_written, sizeof(header));
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  stream_->read(0 /* pos */, reinterpret_cast<char*>(&header), sizeof(header));
+  FileStats::add(stats_->bytes_read, sizeof(header));
 
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
+  stream_->write(0 /* pos */, reinterpret_cast<const char*>(&header),
+                 sizeof(header));
   stream_->flush();
+  FileStats::add(stats_->bytes_written, sizeof(header));
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  stream_->read(pagePosition(page_number), reinterpret_cast<char*>(&header),
+                sizeof(header));
+  FileStats::add(stats_->bytes_read, sizeof(header));
 
   return header;
 }
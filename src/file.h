@@ -7,23 +7,90 @@
 
 #pragma once
 
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "io_backend.h"
 #include "page.h"
 
 namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief I/O and cache counters of one file, shared by every File object
+ *        open on it.
+ *
+ * File counts its own I/O; BufMgr counts the lookups that find the file's
+ * pages in the pool or not.  Counters are relaxed atomics, so they can be
+ * read from another thread (see File::allStats()) while the file is in use.
+ * They start from zero whenever the file is opened and no other File object
+ * has it open.
+ */
+struct FileStats {
+  /**
+   * Pages read from and written to the backend.
+   */
+  std::atomic<std::uint64_t> page_reads;
+  std::atomic<std::uint64_t> page_writes;
+
+  /**
+   * Bytes read from and written to the backend, headers included.
+   */
+  std::atomic<std::uint64_t> bytes_read;
+  std::atomic<std::uint64_t> bytes_written;
+
+  /**
+   * Calls to File::sync().
+   */
+  std::atomic<std::uint64_t> syncs;
+
+  /**
+   * Buffer pool lookups of the file's pages that found them resident, and
+   * that had to load them.
+   */
+  std::atomic<std::uint64_t> cache_hits;
+  std::atomic<std::uint64_t> cache_misses;
+
+  FileStats()
+      : page_reads(0), page_writes(0), bytes_read(0), bytes_written(0),
+        syncs(0), cache_hits(0), cache_misses(0) {}
+
+  /**
+   * Adds <count> to <counter>.
+   */
+  static void add(std::atomic<std::uint64_t>& counter,
+                  const std::uint64_t count) {
+    counter.fetch_add(count, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief Values of the counters of one open file at one point in time.
+ */
+struct FileStatsSnapshot {
+  std::string filename;
+  std::uint64_t page_reads;
+  std::uint64_t page_writes;
+  std::uint64_t bytes_read;
+  std::uint64_t bytes_written;
+  std::uint64_t syncs;
+  std::uint64_t cache_hits;
+  std::uint64_t cache_misses;
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
 struct FileHeader {
   /**
-   * Number of pages allocated in the file.
+   * Number of pages allocated in the file.  Space preallocated past them
+   * (see File::setGrowthChunk()) is not recorded here.
    */
   PageId num_pages;
 
@@ -42,6 +109,18 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * File::FORMAT_MAGIC.  Files written before the header held it have the free
+   * space bound of their first page here, which never equals it.
+   */
+  std::uint16_t magic;
+
+  /**
+   * Layout of the file's pages; File::FORMAT_VERSION when written by this
+   * version.
+   */
+  std::uint16_t format_version;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +131,9 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        magic == rhs.magic &&
+        format_version == rhs.format_version;
   }
 };
 
@@ -61,9 +142,18 @@ struct FileHeader {
  *        pages.
  *
  * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * fixed-sized pages and reuse deleted pages if possible; they only give space
+ * back when asked to (see setPunchFreedPages() and reclaimFreeSpace()).  If
+ * multiple File objects refer to the same underlying file, they will share
+ * the stream in memory.
+ * The stream is an IoBackend; files on the filesystem use a StreamBackend, but
+ * a file can also be created or opened on any other backend (e.g. one kept in
+ * memory or one that injects faults).
+ *
+ * Files whose name starts with MEMORY_PREFIX (e.g. "mem:sort.run.1") never
+ * touch the filesystem unless they grow past the memory spill limit: they live
+ * in a MemoryBackend from create() until remove(), and can be opened, iterated
+ * and removed just like files on disk.
  * If a file that has already been opened (possibly by another query), then the File class
  * detects this (by looking in the open_streams_ map) and just returns a file object with
  * the already created stream for the file without actually opening the UNIX file again. 
@@ -72,6 +162,22 @@ struct FileHeader {
  */
 class File {
  public:
+  /**
+   * Name prefix of files kept in memory.
+   */
+  static const char* const MEMORY_PREFIX;
+
+  /**
+   * Value of FileHeader::magic in every file.
+   */
+  static const std::uint16_t FORMAT_MAGIC = 0xBADB;
+
+  /**
+   * Version of the file and page layout written by this code.  Raise it
+   * whenever the layout changes; files of other versions cannot be opened.
+   */
+  static const std::uint16_t FORMAT_VERSION = 2;
+
   /**
    * Creates a new file.
    *
@@ -89,9 +195,34 @@ class File {
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileFormatException     If the file has another layout version.
    */
   static File open(const std::string& filename);
 
+  /**
+   * Creates a new file stored on the given backend instead of the filesystem.
+   * The backend is shared with later File objects opened under the same name
+   * for as long as any of them is open.
+   *
+   * @param filename  Name of the file.
+   * @param backend   Storage for the file; its contents are overwritten.
+   * @throws  FileExistsException     If a file with this name is open.
+   */
+  static File create(const std::string& filename,
+                     const std::shared_ptr<IoBackend>& backend);
+
+  /**
+   * Opens an existing file stored on the given backend.
+   *
+   * @param filename  Name of the file.
+   * @param backend   Storage holding the file.
+   * @throws  FileOpenException       If a file with this name is open on a
+   *                                  different backend.
+   * @throws  FileFormatException     If the file has another layout version.
+   */
+  static File open(const std::string& filename,
+                   const std::shared_ptr<IoBackend>& backend);
+
   /**
    * Deletes an existing file.
    *
@@ -110,12 +241,68 @@ class File {
 
 
   /**
-   * Returns true if the file exists and is open.
+   * Returns true if the file exists on the filesystem or is open.
    *
    * @param filename  Name of the file.
    */
   static bool exists(const std::string& filename);
 
+  /**
+   * Returns true if files with this name are kept in memory.
+   *
+   * @param filename  Name of the file.
+   */
+  static bool isMemoryFile(const std::string& filename);
+
+  /**
+   * Sets the size above which newly created memory files spill to a temporary
+   * file on disk.
+   *
+   * @param bytes Spill limit in bytes, or 0 to never spill (the default).
+   */
+  static void setMemorySpillLimit(const std::uint64_t bytes) {
+    memory_spill_limit_ = bytes;
+  }
+
+  /**
+   * Sets how far files are preallocated when they grow.  A page appended past
+   * the end of the storage makes the file grow to the next multiple of
+   * <bytes>, reserved at once with IoBackend::allocate(), and the following
+   * pages are handed out from that space without growing the file again.
+   *
+   * Chunks much smaller than a file interleave with those of files growing
+   * alongside it and fragment it more than the filesystem's own delayed
+   * allocation does; 16 MiB or more suits large, append-heavy files.
+   *
+   * @param bytes Growth chunk in bytes, or 0 to grow the file by each page
+   *              as it is written (the default).
+   */
+  static void setGrowthChunk(const std::uint64_t bytes) {
+    growth_chunk_ = bytes;
+  }
+
+  /**
+   * Sets whether deletePage() gives the space of deleted pages back: the last
+   * page of the file is cut off, and others have a hole punched in their
+   * place (IoBackend::deallocate()).  Punched pages hold nothing, so the free
+   * list records them in the free pages that head it; reclaimFreeSpace()
+   * does the same for pages deleted earlier.
+   *
+   * @param punch True to give space back, false to keep deleted pages in the
+   *              file (the default).
+   */
+  static void setPunchFreedPages(const bool punch) {
+    punch_freed_pages_ = punch;
+  }
+
+  /**
+   * Returns the counters of every open file, by name.  Unlike the rest of
+   * this class, this may be called from any thread.
+   *
+   * @return  Counters of the open files.
+   */
+  static std::vector<FileStatsSnapshot> allStats();
+
   /**
    * Copy constructor.
    * 
@@ -124,6 +311,15 @@ class File {
    */
   File(const File& other);
 
+  /**
+   * Move constructor.  Takes over the file <other> refers to without opening
+   * it again; <other> is left referring to no file, and may only be assigned
+   * to or destroyed.
+   *
+   * @param other File object to move.
+   */
+  File(File&& other) noexcept;
+
   /**
    * Assignment operator.
    *
@@ -132,6 +328,16 @@ class File {
    */
   File& operator=(const File& rhs);
 
+  /**
+   * Move assignment operator.  Closes the file this object refers to and
+   * takes over the one <rhs> refers to, leaving <rhs> as the move
+   * constructor does.
+   *
+   * @param rhs File object to move.
+   * @return    Newly assigned file object.
+   */
+  File& operator=(File&& rhs) noexcept;
+
   /**
    * Destructor that automatically closes the underlying file if no other
    * File objects are using it.
@@ -145,6 +351,31 @@ class File {
    */
   Page allocatePage();
 
+  /**
+   * Reserves a new page at the end of the file without writing anything.
+   * The page becomes part of the file when it is first written with
+   * writePage() (or writeDirtySectors() or writePages()): its contents are
+   * written first, then the file header and then the link from the page
+   * before it, so a crash in between never leaves the file referring to a
+   * page that was not written.  Until then readPage() does not find the
+   * page, deletePage() just drops the reservation, and a crash or closing
+   * every File object open on the file forgets it.  Writes of the page
+   * check the link again until sync() has made it durable, so a write that
+   * a crash undid can be retried.
+   *
+   * @return The new page, blank.
+   */
+  Page reservePage();
+
+  /**
+   * Reserves a new page like reservePage(), but formats <page> as the blank
+   * new page instead of returning one, so a caller that already has a page
+   * to reuse (a buffer pool frame) does not build another.
+   *
+   * @param page  Set to the new page, blank.
+   */
+  void reservePage(Page& page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -155,6 +386,29 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file, like readPage(), but reports a
+   * page that does not exist or is not used instead of throwing.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Receives the page; unspecified if it is not valid.
+   * @return  STATUS_OK, or STATUS_INVALID_PAGE if the page doesn't exist in
+   *          the file or is not currently used.
+   */
+  Status tryReadPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Reads consecutive existing pages from the file with a single backend read.
+   *
+   * @param first_page  Number of the first page to read.
+   * @param count       Number of pages to read.
+   * @return  The pages, in page number order.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  std::vector<Page> readPages(const PageId first_page,
+                              const PageId count) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -164,6 +418,40 @@ class File {
    */
   void writePage(const Page& new_page);
 
+  /**
+   * Writes only the sectors of a page that have changed since it was read,
+   * as given by Page::dirty_sectors(), with one backend write for each run
+   * of adjacent sectors.  Otherwise like writePage(); a page with no changed
+   * sectors is not written at all.
+   *
+   * @param new_page  Page to write.
+   * @throws  InvalidPageException  If the page has been deleted.
+   */
+  void writeDirtySectors(const Page& new_page);
+
+  /**
+   * Writes pages with consecutive page numbers into the file, like
+   * writePage() but with a single backend write for all of them.
+   *
+   * @param pages Pages to write, in ascending page number order with no gaps.
+   * @throws  InvalidPageException  If any of the pages has been deleted; no
+   *                                page is written then.
+   */
+  void writePages(const std::vector<Page>& pages);
+
+  /**
+   * Adds pages to the end of the file with a single backend write, for data
+   * written once and in order, such as sorted runs and logs.  Each page is
+   * given the next page number and its contents are kept.  As with
+   * reservePage(), the pages are written first, then the file header and
+   * then the link from the last used page, so a crash in between loses the
+   * pages but leaves the file consistent.
+   *
+   * @param pages Pages to add; set to the pages as written, with their
+   *              page numbers.
+   */
+  void appendPages(std::vector<Page>& pages);
+
   /**
    * Deletes a page from the file.
    *
@@ -171,6 +459,22 @@ class File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Gives the space of every free page back: free pages at the end of the
+   * file are cut off, unless pages past the end are reserved, and the rest
+   * are punched out in runs, except for the few that head the free list and
+   * record the others.  Runs of adjacent pages release more than pages
+   * punched one at a time, since pages do not start on block boundaries.
+   */
+  void reclaimFreeSpace();
+
+  /**
+   * Makes all pages written so far durable.
+   *
+   * @throws  IoFaultException  If the backend fails to sync.
+   */
+  void sync() const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -178,6 +482,14 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the counters of the file, shared with other File objects open on
+   * it.
+   *
+   * @return  Counters of the file.
+   */
+  FileStats& stats() const { return *stats_; }
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -201,7 +513,7 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
+  static std::uint64_t pagePosition(const PageId page_number) {
     return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
   }
 
@@ -214,12 +526,14 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param backend     Storage for the file, or NULL to use the filesystem.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const std::shared_ptr<IoBackend>& backend);
 
   /**
    * Opens the underlying file named in filename_.
@@ -227,12 +541,14 @@ class File {
    * the same filesystem file; otherwise, it reuses the existing stream.
    *
    * @param create_new  Whether to create a new file.
+   * @param backend     Storage for the file, or NULL to use the filesystem.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new,
+                    const std::shared_ptr<IoBackend>& backend);
 
   /**
    * Closes the underlying file stream in <stream_>.
@@ -256,6 +572,16 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into <page>, reusing its storage.  Like
+   * readPage(page_number, true), no check is made that the page is in use
+   * and no bounds checking is performed.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Set to the page read.
+   */
+  void readPageInto(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -301,9 +627,90 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk.  No bounds checking is
+   * performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Returns the punched pages a free page heading the free list records.
+   *
+   * @param trunk Free page.
+   */
+  static std::vector<PageId> trunkLeaves(const Page& trunk);
+
+  /**
+   * Sets the punched pages a free page heading the free list records.
+   *
+   * @param trunk   Free page.
+   * @param leaves  Punched pages, at most TRUNK_CAPACITY of them.
+   */
+  static void setTrunkLeaves(Page& trunk, const std::vector<PageId>& leaves);
+
+  /**
+   * Returns true if pages past the end of the file are reserved.
+   */
+  bool hasUnlinkedReservations() const;
+
+  /**
+   * Reserves the page after the end of the file for reservePage().
+   *
+   * @return  Number of the page reserved.
+   */
+  PageId reserveNextPage();
+
+  /**
+   * Makes sure the storage covers the page with the given number, growing it
+   * by a whole growth chunk if it does not; see setGrowthChunk().
+   *
+   * @param page_number   Number of page about to be appended.
+   */
+  void growFor(const PageId page_number);
+
+  /**
+   * Returns the number the next page appended to the file gets: the first
+   * past both the end of the file and the reserved pages.
+   *
+   * @param header  File header.
+   */
+  PageId nextPageNumber(const FileHeader& header) const;
+
+  /**
+   * Writes a reserved page and links it into the used list, in page number
+   * order, unless it is linked already; see reservePage().
+   *
+   * @param new_page  Reserved page to write.
+   */
+  void linkReservedPage(const Page& new_page);
+
   typedef std::map<std::string,
-                   std::shared_ptr<std::fstream> > StreamMap;
+                   std::shared_ptr<IoBackend> > StreamMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, std::shared_ptr<FileStats> > StatsMap;
+  /**
+   * @brief Pages of a file reserved with reservePage() and not durable yet.
+   */
+  struct Reservations {
+    /**
+     * Reserved pages, each with whether it has been linked into the file
+     * since the last sync().
+     */
+    std::map<PageId, bool> pages;
+
+    /**
+     * Last page of the used list when a reserved page was last linked or
+     * pages were appended, or INVALID_NUMBER.  Only a hint: it is checked against the page before
+     * use.
+     */
+    PageId last_used_page;
+
+    Reservations() : last_used_page(Page::INVALID_NUMBER) {}
+  };
+  typedef std::map<std::string, std::shared_ptr<Reservations> > ReservationMap;
 
   /**
    * Streams for opened files.
@@ -315,15 +722,66 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Counters of opened files, guarded by <stats_mutex_>.
+   */
+  static StatsMap open_stats_;
+
+  /**
+   * Guards <open_stats_>, which allStats() reads from other threads.
+   */
+  static std::mutex stats_mutex_;
+
+  /**
+   * Pages reserved with reservePage() and not durable yet, of opened files.
+   */
+  static ReservationMap open_reservations_;
+
+  /**
+   * Backends of memory files, from creation until removal.
+   */
+  static StreamMap memory_files_;
+
+  /**
+   * Spill limit given to newly created memory files.
+   */
+  static std::uint64_t memory_spill_limit_;
+
+  /**
+   * Bytes files grow by when a page is appended past their end, or 0.
+   */
+  static std::uint64_t growth_chunk_;
+
+  /**
+   * True if deletePage() gives the space of deleted pages back.
+   */
+  static bool punch_freed_pages_;
+
+  /**
+   * Number of punched pages a free page heading the free list can record.
+   */
+  static const std::size_t TRUNK_CAPACITY =
+      (Page::DATA_SIZE - sizeof(PageId)) / sizeof(PageId);
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Stream for underlying storage.
+   */
+  std::shared_ptr<IoBackend> stream_;
+
+  /**
+   * Counters of the underlying file.
+   */
+  std::shared_ptr<FileStats> stats_;
+
+  /**
+   * Reserved pages of the underlying file.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<Reservations> reserved_;
 
   friend class FileIterator;
   friend class FileTest;
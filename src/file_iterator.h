@@ -79,19 +79,20 @@ class FileIterator {
 	}
 
   /**
-   * Returns true if this iterator is equal to the given iterator.
+   * Returns true if this iterator is equal to the given iterator.  Iterators
+   * over the same File object (as from begin() and end()) compare without
+   * looking at the file names.
    *
    * @param rhs   Iterator to compare against.
    * @return    True if other iterator is equal to this one.
    */
 	inline bool operator==(const FileIterator& rhs) const {
-    return file_->filename() == rhs.file_->filename() &&
-        current_page_number_ == rhs.current_page_number_;
+    return current_page_number_ == rhs.current_page_number_ &&
+        (file_ == rhs.file_ || file_->filename() == rhs.file_->filename());
   }
 
 	inline bool operator!=(const FileIterator& rhs) const {
-    return (file_->filename() != rhs.file_->filename()) ||
-        (current_page_number_ != rhs.current_page_number_);
+    return !(*this == rhs);
   }
 
   /**
@@ -0,0 +1,201 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "frame_latch.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Number of condition variables parked threads are spread over.
+ */
+const std::size_t PARKING_BUCKETS = 64;
+
+struct ParkingBucket {
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+ParkingBucket& bucketFor(const void* latch) {
+  static ParkingBucket buckets[PARKING_BUCKETS];
+  const std::size_t address = reinterpret_cast<std::size_t>(latch);
+  return buckets[(address >> 4) % PARKING_BUCKETS];
+}
+
+/**
+ * Tells the processor the caller is spinning.
+ */
+inline void relax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+}
+
+const std::uint32_t FrameLatch::WRITER;
+const std::uint32_t FrameLatch::PENDING;
+const std::uint32_t FrameLatch::PARKED;
+const std::uint32_t FrameLatch::UPGRADER;
+const std::uint32_t FrameLatch::READER_MASK;
+const int FrameLatch::SPIN_LIMIT;
+
+void FrameLatch::lockShared() {
+  for (int spins = 0;; ++spins) {
+    std::uint32_t state = state_.load(std::memory_order_relaxed);
+    if (!(state & (WRITER | PENDING))) {
+      if (state_.compare_exchange_weak(state, state + 1,
+                                       std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if (spins < SPIN_LIMIT) {
+      relax();
+      continue;
+    }
+    park([](std::uint32_t s) { return (s & (WRITER | PENDING)) != 0; });
+    spins = 0;
+  }
+}
+
+bool FrameLatch::tryLockShared() {
+  std::uint32_t state = state_.load(std::memory_order_relaxed);
+  while (!(state & (WRITER | PENDING))) {
+    if (state_.compare_exchange_weak(state, state + 1,
+                                     std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameLatch::unlockShared() {
+  const std::uint32_t previous =
+      state_.fetch_sub(1, std::memory_order_release);
+  if (previous & PARKED) {
+    unpark();
+  }
+}
+
+void FrameLatch::lockExclusive() {
+  for (int spins = 0;; ++spins) {
+    std::uint32_t state = state_.load(std::memory_order_relaxed);
+    if (!(state & (WRITER | UPGRADER | READER_MASK))) {
+      // Taking the latch clears PENDING; other waiting writers set it again.
+      if (state_.compare_exchange_weak(state, (state & PARKED) | WRITER,
+                                       std::memory_order_acquire)) {
+        return;
+      }
+      continue;
+    }
+    if (!(state & PENDING)) {
+      state_.compare_exchange_weak(state, state | PENDING,
+                                   std::memory_order_relaxed);
+      continue;
+    }
+    if (spins < SPIN_LIMIT) {
+      relax();
+      continue;
+    }
+    park([](std::uint32_t s) {
+      return (s & (WRITER | UPGRADER | READER_MASK)) != 0;
+    });
+    spins = 0;
+  }
+}
+
+bool FrameLatch::tryLockExclusive() {
+  std::uint32_t state = state_.load(std::memory_order_relaxed);
+  while (!(state & (WRITER | UPGRADER | READER_MASK))) {
+    if (state_.compare_exchange_weak(state, (state & PARKED) | WRITER,
+                                     std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameLatch::unlockExclusive() {
+  const std::uint32_t previous =
+      state_.fetch_and(~WRITER, std::memory_order_release);
+  if (previous & PARKED) {
+    unpark();
+  }
+}
+
+bool FrameLatch::upgrade() {
+  std::uint32_t state = state_.load(std::memory_order_relaxed);
+  do {
+    if (state & UPGRADER) {
+      return false;
+    }
+  } while (!state_.compare_exchange_weak(state, state | UPGRADER | PENDING,
+                                         std::memory_order_relaxed));
+
+  // Writers cannot get in while UPGRADER is set, so only readers are left to
+  // wait for.
+  for (int spins = 0;; ++spins) {
+    state = state_.load(std::memory_order_relaxed);
+    if ((state & READER_MASK) == 1) {
+      if (state_.compare_exchange_weak(state, (state & PARKED) | WRITER,
+                                       std::memory_order_acquire)) {
+        return true;
+      }
+      continue;
+    }
+    if (spins < SPIN_LIMIT) {
+      relax();
+      continue;
+    }
+    park([](std::uint32_t s) { return (s & READER_MASK) != 1; });
+    spins = 0;
+  }
+}
+
+void FrameLatch::downgrade() {
+  std::uint32_t state = state_.load(std::memory_order_relaxed);
+  while (!state_.compare_exchange_weak(state, (state & ~WRITER) + 1,
+                                       std::memory_order_release)) {
+  }
+  if (state & PARKED) {
+    unpark();
+  }
+}
+
+void FrameLatch::park(bool (*blocked)(std::uint32_t state)) {
+  ParkingBucket& bucket = bucketFor(this);
+  std::unique_lock<std::mutex> lock(bucket.mutex);
+  std::uint32_t state = state_.load(std::memory_order_relaxed);
+  while (blocked(state)) {
+    // A release after PARKED is set has to take the bucket mutex to wake us,
+    // which it cannot do before we wait.
+    if (state & PARKED ||
+        state_.compare_exchange_weak(state, state | PARKED,
+                                     std::memory_order_relaxed)) {
+      bucket.cv.wait(lock);
+      return;
+    }
+  }
+}
+
+void FrameLatch::unpark() {
+  ParkingBucket& bucket = bucketFor(this);
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  // Threads still blocked after waking set the flag again.
+  state_.fetch_and(~PARKED, std::memory_order_relaxed);
+  bucket.cv.notify_all();
+}
+
+}
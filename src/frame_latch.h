@@ -0,0 +1,157 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Ways to latch a page.
+ */
+enum LatchMode {
+  /**
+   * Shared with other readers.
+   */
+  LATCH_SHARED,
+
+  /**
+   * Held by one writer.
+   */
+  LATCH_EXCLUSIVE
+};
+
+/**
+ * @brief Reader/writer latch small enough to keep one per buffer frame.
+ *
+ * The whole latch is one 32-bit word.  A thread that cannot get it spins for
+ * a while and then parks on a condition variable picked from a small table
+ * shared by all latches, so a latch costs no more memory when contended.
+ *
+ * A waiting writer holds off new readers, so writers are not starved by a
+ * steady stream of readers.  One reader at a time may upgrade to exclusive
+ * without letting go of the latch.
+ *
+ * The latch is not recursive and does not know its holders; releasing a
+ * latch that is not held is undefined.
+ */
+class FrameLatch {
+ public:
+  FrameLatch() : state_(0) {}
+
+  /**
+   * Takes the latch shared.
+   */
+  void lockShared();
+
+  /**
+   * Takes the latch shared if no writer holds it or waits for it.
+   *
+   * @return True if the latch was taken.
+   */
+  bool tryLockShared();
+
+  /**
+   * Releases a shared hold.
+   */
+  void unlockShared();
+
+  /**
+   * Takes the latch exclusive.
+   */
+  void lockExclusive();
+
+  /**
+   * Takes the latch exclusive if nobody holds it.
+   *
+   * @return True if the latch was taken.
+   */
+  bool tryLockExclusive();
+
+  /**
+   * Releases an exclusive hold.
+   */
+  void unlockExclusive();
+
+  /**
+   * Turns the caller's shared hold into an exclusive one, waiting for the
+   * other readers to leave.  Fails at once if another reader is already
+   * upgrading; the caller then still holds the latch shared, and has to
+   * release it before taking it exclusive, or the two would wait for each
+   * other.
+   *
+   * @return True if the caller now holds the latch exclusive.
+   */
+  bool upgrade();
+
+  /**
+   * Turns the caller's exclusive hold into a shared one, letting waiting
+   * readers in.
+   */
+  void downgrade();
+
+  /**
+   * Returns the number of shared holders, for diagnostics.
+   */
+  std::uint32_t readers() const { return state_.load() & READER_MASK; }
+
+  /**
+   * Returns true if the latch is held exclusive, for diagnostics.
+   */
+  bool exclusive() const { return (state_.load() & WRITER) != 0; }
+
+ private:
+  FrameLatch(const FrameLatch&);
+  FrameLatch& operator=(const FrameLatch&);
+
+  /**
+   * Set while a writer holds the latch.
+   */
+  static const std::uint32_t WRITER = 1u << 31;
+
+  /**
+   * Set while a writer or upgrader waits; keeps new readers out.
+   */
+  static const std::uint32_t PENDING = 1u << 30;
+
+  /**
+   * Set while a thread is parked on the latch; releases then wake it.
+   */
+  static const std::uint32_t PARKED = 1u << 29;
+
+  /**
+   * Set while a reader is upgrading.
+   */
+  static const std::uint32_t UPGRADER = 1u << 28;
+
+  /**
+   * Number of shared holders.
+   */
+  static const std::uint32_t READER_MASK = UPGRADER - 1;
+
+  /**
+   * Times a blocked thread checks the latch before parking.
+   */
+  static const int SPIN_LIMIT = 64;
+
+  /**
+   * Parks the caller until the latch changes, unless <blocked> no longer
+   * holds for its state.
+   */
+  void park(bool (*blocked)(std::uint32_t state));
+
+  /**
+   * Wakes the threads parked on the latch.
+   */
+  void unpark();
+
+  std::atomic<std::uint32_t> state_;
+};
+
+}
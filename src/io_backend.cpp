@@ -0,0 +1,274 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_backend.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "exceptions/io_fault_exception.h"
+
+namespace badgerdb {
+
+StreamBackend::StreamBackend(const std::string& filename,
+                             const std::ios_base::openmode mode)
+    : filename_(filename),
+      stream_(filename.c_str(), mode),
+      fd_(-1) {
+}
+
+StreamBackend::~StreamBackend() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void StreamBackend::read(const std::uint64_t offset, char* buffer,
+                         const std::size_t length) {
+  stream_.seekg(offset, std::ios::beg);
+  stream_.read(buffer, length);
+  if (!stream_) {
+    fail("read");
+  }
+}
+
+void StreamBackend::write(const std::uint64_t offset, const char* buffer,
+                          const std::size_t length) {
+  stream_.seekp(offset, std::ios::beg);
+  stream_.write(buffer, length);
+  if (!stream_) {
+    fail("write");
+  }
+}
+
+void StreamBackend::flush() {
+  stream_.flush();
+  if (!stream_) {
+    fail("flush");
+  }
+}
+
+void StreamBackend::sync() {
+  flush();
+}
+
+std::uint64_t StreamBackend::size() {
+  stream_.seekg(0, std::ios::end);
+  const std::streamoff end = stream_.tellg();
+  if (!stream_) {
+    fail("size");
+  }
+  return end;
+}
+
+void StreamBackend::allocate(const std::uint64_t offset,
+                             const std::uint64_t length) {
+  fallocate("allocate", 0, offset, length);
+}
+
+void StreamBackend::deallocate(const std::uint64_t offset,
+                               const std::uint64_t length) {
+  flush();
+  fallocate("deallocate", FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+            length);
+}
+
+void StreamBackend::truncate(const std::uint64_t size) {
+  // Buffered writes past <size> must not land after the file is cut.
+  flush();
+  const int fd = descriptor();
+  int result;
+  do {
+    result = ::ftruncate(fd, size);
+  } while (result != 0 && errno == EINTR);
+  if (result != 0) {
+    fail("truncate");
+  }
+}
+
+int StreamBackend::descriptor() {
+  // The stream does not expose its descriptor; a second one reaches the same
+  // inode.
+  if (fd_ < 0) {
+    fd_ = ::open(filename_.c_str(), O_WRONLY);
+    if (fd_ < 0) {
+      fail("open");
+    }
+  }
+  return fd_;
+}
+
+void StreamBackend::fallocate(const std::string& operation, const int mode,
+                              const std::uint64_t offset,
+                              const std::uint64_t length) {
+  const int fd = descriptor();
+  int result;
+  do {
+    result = ::fallocate(fd, mode, offset, length);
+  } while (result != 0 && errno == EINTR);
+  if (result != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+    fail(operation);
+  }
+}
+
+void StreamBackend::fail(const std::string& operation) {
+  stream_.clear();
+  throw IoFaultException(operation, filename_);
+}
+
+const std::size_t MemoryBackend::CHUNK_SIZE;
+
+MemoryBackend::MemoryBackend(const std::uint64_t spill_limit)
+    : spill_limit_(spill_limit),
+      size_(0) {
+}
+
+void MemoryBackend::read(const std::uint64_t offset, char* buffer,
+                         const std::size_t length) {
+  if (spilled_) {
+    spilled_->read(offset, buffer, length);
+    return;
+  }
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t position = offset + done;
+    const std::size_t in_chunk = position % CHUNK_SIZE;
+    const std::size_t chunk_bytes =
+        std::min<std::size_t>(length - done, CHUNK_SIZE - in_chunk);
+    const char* chunk =
+        position < size_ ? chunks_[position / CHUNK_SIZE].get() : NULL;
+    if (chunk != NULL) {
+      std::memcpy(buffer + done, chunk + in_chunk, chunk_bytes);
+    } else {
+      std::memset(buffer + done, 0, chunk_bytes);
+    }
+    done += chunk_bytes;
+  }
+}
+
+void MemoryBackend::write(const std::uint64_t offset, const char* buffer,
+                          const std::size_t length) {
+  if (!spilled_ && spill_limit_ > 0 && offset + length > spill_limit_) {
+    spill();
+  }
+  if (spilled_) {
+    spilled_->write(offset, buffer, length);
+    return;
+  }
+  const std::uint64_t end = offset + length;
+  while (chunks_.size() * CHUNK_SIZE < end) {
+    chunks_.push_back(std::unique_ptr<char[]>(new char[CHUNK_SIZE]()));
+  }
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t position = offset + done;
+    const std::size_t in_chunk = position % CHUNK_SIZE;
+    const std::size_t chunk_bytes =
+        std::min<std::size_t>(length - done, CHUNK_SIZE - in_chunk);
+    std::unique_ptr<char[]>& chunk = chunks_[position / CHUNK_SIZE];
+    if (!chunk) {
+      chunk.reset(new char[CHUNK_SIZE]());
+    }
+    std::memcpy(&chunk[in_chunk], buffer + done, chunk_bytes);
+    done += chunk_bytes;
+  }
+  size_ = std::max(size_, end);
+}
+
+void MemoryBackend::flush() {
+  if (spilled_) {
+    spilled_->flush();
+  }
+}
+
+void MemoryBackend::sync() {
+  if (spilled_) {
+    spilled_->sync();
+  }
+}
+
+std::uint64_t MemoryBackend::size() {
+  return spilled_ ? spilled_->size() : size_;
+}
+
+void MemoryBackend::deallocate(const std::uint64_t offset,
+                               const std::uint64_t length) {
+  if (spilled_) {
+    spilled_->deallocate(offset, length);
+    return;
+  }
+  const std::uint64_t end = std::min(offset + length, size_);
+  std::uint64_t position = offset;
+  while (position < end) {
+    const std::size_t in_chunk = position % CHUNK_SIZE;
+    const std::size_t chunk_bytes =
+        std::min<std::uint64_t>(end - position, CHUNK_SIZE - in_chunk);
+    std::unique_ptr<char[]>& chunk = chunks_[position / CHUNK_SIZE];
+    if (chunk_bytes == CHUNK_SIZE) {
+      chunk.reset();
+    } else if (chunk) {
+      std::memset(&chunk[in_chunk], 0, chunk_bytes);
+    }
+    position += chunk_bytes;
+  }
+}
+
+void MemoryBackend::truncate(const std::uint64_t size) {
+  if (spilled_) {
+    spilled_->truncate(size);
+    return;
+  }
+  if (size >= size_) {
+    return;
+  }
+  // Zero the rest of the last chunk kept, so growing again reads zeros.
+  deallocate(size, (size + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE - size);
+  chunks_.resize((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+  size_ = size;
+}
+
+void MemoryBackend::spill() {
+  const char* tmpdir = std::getenv("TMPDIR");
+  std::string path = std::string(tmpdir ? tmpdir : "/tmp") +
+                     "/badgerdb-spill-XXXXXX";
+  const int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    throw IoFaultException("spill", path);
+  }
+  ::close(fd);
+  std::unique_ptr<StreamBackend> file(new StreamBackend(
+      path, std::fstream::in | std::fstream::out | std::fstream::binary));
+  // Truncating the empty file opens the descriptor that truncate() and
+  // deallocate() use, which cannot be opened by name once it is removed.
+  file->truncate(0);
+  // The open stream keeps the file alive; nothing is left behind on exit.
+  std::remove(path.c_str());
+
+  for (std::size_t i = 0; i < chunks_.size(); ++i) {
+    const std::uint64_t position = i * CHUNK_SIZE;
+    if (position >= size_) {
+      break;
+    }
+    const std::size_t length =
+        std::min<std::uint64_t>(CHUNK_SIZE, size_ - position);
+    if (chunks_[i]) {
+      file->write(position, chunks_[i].get(), length);
+    } else {
+      file->write(position, std::string(length, '\0').data(), length);
+    }
+  }
+  file->flush();
+  chunks_.clear();
+  spilled_.swap(file);
+}
+
+}
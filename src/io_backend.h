@@ -0,0 +1,265 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace badgerdb {
+
+/**
+ * @brief Byte-addressed storage underneath a File.
+ *
+ * File lays out its header and pages on top of this interface and never
+ * touches the filesystem directly, so the storage can be swapped for memory
+ * or for a wrapper that injects faults.
+ *
+ * Implementations throw IoFaultException when an operation fails.
+ *
+ * @warning Implementations are not threadsafe.
+ */
+class IoBackend {
+ public:
+  virtual ~IoBackend() {}
+
+  /**
+   * Reads <length> bytes starting at <offset>.
+   *
+   * @param offset  Position of the first byte to read.
+   * @param buffer  Buffer receiving the bytes.
+   * @param length  Number of bytes to read.
+   * @throws  IoFaultException  If the bytes could not be read.
+   */
+  virtual void read(const std::uint64_t offset, char* buffer,
+                    const std::size_t length) = 0;
+
+  /**
+   * Writes <length> bytes starting at <offset>, growing the storage if needed.
+   *
+   * @param offset  Position of the first byte to write.
+   * @param buffer  Bytes to write.
+   * @param length  Number of bytes to write.
+   * @throws  IoFaultException  If the bytes could not be written.
+   */
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length) = 0;
+
+  /**
+   * Hands buffered writes to the layer below (for files, the OS).
+   *
+   * @throws  IoFaultException  If buffered writes could not be passed on.
+   */
+  virtual void flush() = 0;
+
+  /**
+   * Makes all completed writes durable.
+   *
+   * @throws  IoFaultException  If the writes could not be made durable.
+   */
+  virtual void sync() = 0;
+
+  /**
+   * Returns the current size of the storage in bytes.
+   */
+  virtual std::uint64_t size() = 0;
+
+  /**
+   * Reserves space for <length> bytes starting at <offset>, growing the
+   * storage to cover them if needed, so that later writes there neither
+   * allocate nor grow it.  The bytes read as zero until written.  Backends
+   * that have nothing to reserve ignore this.
+   *
+   * @param offset  Position of the first byte to reserve.
+   * @param length  Number of bytes to reserve.
+   * @throws  IoFaultException  If the space could not be reserved.
+   */
+  virtual void allocate(const std::uint64_t offset,
+                        const std::uint64_t length) {}
+
+  /**
+   * Tells the backend that <length> bytes starting at <offset> are no longer
+   * needed, so it can release their space; the size does not change.  The
+   * bytes read as zero afterwards if their space was released and keep
+   * their contents otherwise.  Backends that have nothing to release ignore
+   * this.
+   *
+   * @param offset  Position of the first byte to release.
+   * @param length  Number of bytes to release.
+   * @throws  IoFaultException  If the space could not be released.
+   */
+  virtual void deallocate(const std::uint64_t offset,
+                          const std::uint64_t length) {}
+
+  /**
+   * Shrinks the storage to <size> bytes if it is larger.  Backends that
+   * cannot shrink ignore this.
+   *
+   * @param size  New size in bytes.
+   * @throws  IoFaultException  If the storage could not be shrunk.
+   */
+  virtual void truncate(const std::uint64_t size) {}
+};
+
+/**
+ * @brief Backend storing bytes in a file on the filesystem through a stream.
+ *
+ * Streams cannot force data to stable storage, so sync() only flushes the
+ * stream buffer to the OS.  allocate() uses fallocate(), so space is reserved
+ * in as few extents as the filesystem can manage, and deallocate() punches a
+ * hole; on filesystems without them both do nothing.
+ */
+class StreamBackend : public IoBackend {
+ public:
+  /**
+   * Opens the file.
+   *
+   * @param filename  Name of the file.
+   * @param mode      Mode to open the stream with.
+   */
+  StreamBackend(const std::string& filename,
+                const std::ios_base::openmode mode);
+
+  /**
+   * Closes the file.
+   */
+  virtual ~StreamBackend();
+
+  virtual void read(const std::uint64_t offset, char* buffer,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length);
+  virtual void flush();
+  virtual void sync();
+  virtual std::uint64_t size();
+  virtual void allocate(const std::uint64_t offset,
+                        const std::uint64_t length);
+  virtual void deallocate(const std::uint64_t offset,
+                          const std::uint64_t length);
+  virtual void truncate(const std::uint64_t size);
+
+ private:
+  /**
+   * Returns a descriptor of the file for the operations streams lack,
+   * opening it on first use.
+   *
+   * @throws  IoFaultException  If the file could not be opened.
+   */
+  int descriptor();
+
+  /**
+   * Calls fallocate() on the file, ignoring filesystems that do not
+   * support <mode>.
+   *
+   * @param operation Operation to name if it fails.
+   * @param mode      Mode flags for fallocate().
+   * @param offset    Position of the first byte of the range.
+   * @param length    Number of bytes in the range.
+   * @throws  IoFaultException  If the call failed for another reason.
+   */
+  void fallocate(const std::string& operation, const int mode,
+                 const std::uint64_t offset, const std::uint64_t length);
+
+  /**
+   * Clears the error state of the stream and throws an IoFaultException.
+   *
+   * @param operation Operation that failed.
+   */
+  void fail(const std::string& operation);
+
+  /**
+   * Name of the underlying file.
+   */
+  const std::string filename_;
+
+  /**
+   * Stream for the underlying file.
+   */
+  std::fstream stream_;
+  /**
+   * Descriptor of the underlying file, or -1 until descriptor() opens it.
+   */
+  int fd_;
+};
+
+/**
+ * @brief Backend keeping all bytes in memory.
+ *
+ * Bytes are kept in an arena of fixed-size chunks, so growing the storage
+ * never moves what is already there.  Reads past the end return zero bytes,
+ * as for a sparse file, and deallocate() frees the chunks it covers whole.
+ *
+ * If a spill limit is set and the storage grows past it, the contents are
+ * moved to an anonymous temporary file (unlinked as soon as it is opened) and
+ * all later operations go to that file.
+ */
+class MemoryBackend : public IoBackend {
+ public:
+  /**
+   * Size of one arena chunk in bytes.
+   */
+  static const std::size_t CHUNK_SIZE = 64 * 1024;
+
+  /**
+   * Constructs an empty backend.
+   *
+   * @param spill_limit Size in bytes above which the contents spill to a
+   *                    temporary file, or 0 to always stay in memory.
+   */
+  explicit MemoryBackend(const std::uint64_t spill_limit = 0);
+
+  virtual void read(const std::uint64_t offset, char* buffer,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* buffer,
+                     const std::size_t length);
+  virtual void flush();
+  virtual void sync();
+  virtual std::uint64_t size();
+  virtual void deallocate(const std::uint64_t offset,
+                          const std::uint64_t length);
+  virtual void truncate(const std::uint64_t size);
+
+  /**
+   * Returns true if the contents have spilled to a temporary file.
+   */
+  bool spilled() const { return spilled_.get() != NULL; }
+
+ private:
+  /**
+   * Moves the contents to a temporary file.
+   *
+   * @throws  IoFaultException  If the temporary file could not be created.
+   */
+  void spill();
+
+  /**
+   * Size above which the contents spill, or 0 for no limit.
+   */
+  const std::uint64_t spill_limit_;
+
+  /**
+   * Size of the storage in bytes.
+   */
+  std::uint64_t size_;
+
+  /**
+   * Arena holding the contents; chunk i holds bytes [i, i + 1) * CHUNK_SIZE.
+   * Chunks released by deallocate() are NULL and read as zeros.
+   */
+  std::vector<std::unique_ptr<char[]> > chunks_;
+
+  /**
+   * Temporary file holding the contents once they have spilled.
+   */
+  std::unique_ptr<StreamBackend> spilled_;
+};
+
+}
@@ -0,0 +1,528 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/write_discarded_exception.h"
+#include "trace.h"
+
+namespace badgerdb {
+
+namespace {
+
+std::uint64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+const int IoScheduler::NUM_CLASSES;
+const std::size_t IoScheduler::MAX_MERGE_PAGES;
+
+IoScheduler::IoScheduler()
+    : stopping_(false) {
+  dispatcher_ = std::thread(&IoScheduler::run, this);
+}
+
+IoScheduler::~IoScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  queued_cv_.notify_all();
+  dispatcher_.join();
+  // Writes that failed and were never retried are lost.
+  for (std::list<Request*>::iterator iter = failed_.begin();
+       iter != failed_.end(); ++iter) {
+    delete *iter;
+  }
+}
+
+void IoScheduler::setRateLimit(const IoClass io_class,
+                               const double pages_per_sec,
+                               const std::uint32_t burst_pages) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RateLimit& limit = limits_[io_class];
+  limit.pages_per_sec = pages_per_sec;
+  limit.burst = std::max<double>(1, burst_pages);
+  limit.tokens = limit.burst;
+  limit.refilled_at = nowNanos();
+  queued_cv_.notify_all();
+}
+
+void IoScheduler::submitRead(const IoClass io_class, File* file,
+                             const PageId page_number, const Callback& done) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++stats_[io_class].requests;
+  const PageKey key(file, page_number);
+
+  // The newest data of the page is still waiting to be written.
+  std::map<PageKey, Request*>::iterator write = writes_.find(key);
+  if (write != writes_.end()) {
+    ++stats_[io_class].folded;
+    const Page page = write->second->page;
+    lock.unlock();
+    done(page, std::exception_ptr());
+    return;
+  }
+
+  std::map<PageKey, Request*>::iterator read = reads_.find(key);
+  if (read != reads_.end()) {
+    ++stats_[io_class].folded;
+    read->second->callbacks.push_back(done);
+    if (io_class < read->second->io_class && !read->second->dispatched) {
+      promote(read->second, io_class);
+    }
+    return;
+  }
+
+  Request* request = new Request;
+  request->type = READ_REQUEST;
+  request->io_class = io_class;
+  request->file = file;
+  request->page_number = page_number;
+  request->callbacks.push_back(done);
+  request->dispatched = false;
+  request->failed = false;
+  reads_[key] = request;
+  enqueue(request);
+}
+
+void IoScheduler::submitWrite(const IoClass io_class, File* file,
+                              const Page& page, const Callback& done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_[io_class].requests;
+  const PageKey key(file, page.page_number());
+
+  std::map<PageKey, Request*>::iterator write = writes_.find(key);
+  if (write != writes_.end() && !write->second->dispatched) {
+    // Replace the data of the queued write; it has not been issued yet.
+    Request* request = write->second;
+    ++stats_[io_class].folded;
+    // The older copy's changes are only in the queue, so write them as well.
+    const std::uint32_t sectors = request->page.dirty_sectors();
+    request->page = page;
+    request->page.add_dirty_sectors(sectors);
+    if (done) {
+      request->callbacks.push_back(done);
+    }
+    if (request->failed) {
+      failed_.remove(request);
+      request->failed = false;
+      request->io_class = io_class;
+      enqueue(request);
+    } else if (io_class < request->io_class) {
+      promote(request, io_class);
+    }
+    return;
+  }
+
+  // A write of the page that is being issued right now completes first, since
+  // requests are issued one run at a time.
+  Request* request = new Request;
+  request->type = WRITE_REQUEST;
+  request->io_class = io_class;
+  request->file = file;
+  request->page_number = page.page_number();
+  request->page = page;
+  if (done) {
+    request->callbacks.push_back(done);
+  }
+  request->dispatched = false;
+  request->failed = false;
+  writes_[key] = request;
+  enqueue(request);
+}
+
+void IoScheduler::read(const IoClass io_class, File* file,
+                       const PageId page_number, Page& page) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool completed = false;
+  std::exception_ptr error;
+  submitRead(io_class, file, page_number,
+             [&](const Page& result, std::exception_ptr result_error) {
+               std::lock_guard<std::mutex> lock(mutex);
+               if (!result_error) {
+                 page = result;
+               }
+               error = result_error;
+               completed = true;
+               cv.notify_one();
+             });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return completed; });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+std::vector<Page> IoScheduler::readPages(File* file, const PageId first_page,
+                                        const std::size_t count) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "io", "IoScheduler::readPages");
+  std::vector<Page> pages(count);
+  std::vector<bool> queued(count, false);
+  {
+    // The newest data of these pages may still be waiting to be written; it
+    // may not be on the file at all yet (a reserved page, say).
+    std::lock_guard<std::mutex> lock(mutex_);
+    IoClassStats& stats = stats_[IO_FOREGROUND];
+    stats.requests += count;
+    for (std::size_t i = 0; i < count; ++i) {
+      std::map<PageKey, Request*>::const_iterator write =
+          writes_.find(PageKey(file, first_page + i));
+      if (write != writes_.end()) {
+        ++stats.folded;
+        pages[i] = write->second->page;
+        queued[i] = true;
+      }
+    }
+  }
+
+  // Read the other pages with one backend operation per stretch of them.
+  for (std::size_t i = 0; i < count;) {
+    if (queued[i]) {
+      ++i;
+      continue;
+    }
+    std::size_t end = i + 1;
+    while (end < count && !queued[end]) {
+      ++end;
+    }
+    std::vector<Page> read;
+    {
+      std::lock_guard<std::mutex> device(device_);
+      read = file->readPages(first_page + i, end - i);
+    }
+    for (std::size_t j = i; j < end; ++j) {
+      pages[j] = std::move(read[j - i]);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    IoClassStats& stats = stats_[IO_FOREGROUND];
+    stats.pages += end - i;
+    ++stats.batches;
+    i = end;
+  }
+  return pages;
+}
+
+void IoScheduler::drain(const File* file) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Give writes that failed earlier another chance.
+  for (std::list<Request*>::iterator iter = failed_.begin();
+       iter != failed_.end();) {
+    Request* request = *iter;
+    if (file == NULL || request->file == file) {
+      iter = failed_.erase(iter);
+      request->failed = false;
+      enqueue(request);
+    } else {
+      ++iter;
+    }
+  }
+  done_cv_.wait(lock, [&] { return !hasWrites(file); });
+
+  for (std::list<Request*>::iterator iter = failed_.begin();
+       iter != failed_.end(); ++iter) {
+    if (file == NULL || (*iter)->file == file) {
+      std::rethrow_exception((*iter)->error);
+    }
+  }
+}
+
+void IoScheduler::discard(const File* file, const PageId page_number) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::map<PageKey, Request*>::iterator write =
+      writes_.find(PageKey(file, page_number));
+  if (write == writes_.end()) {
+    return;
+  }
+  Request* request = write->second;
+  writes_.erase(write);
+  // A dispatched write is deleted by the dispatcher once it sees that it is
+  // no longer the newest write of its page.
+  if (request->dispatched) {
+    done_cv_.notify_all();
+    return;
+  }
+  if (request->failed) {
+    failed_.remove(request);
+  } else {
+    queues_[request->io_class].erase(request->position);
+  }
+  lock.unlock();
+  done_cv_.notify_all();
+
+  // Those waiting for the write hear that it will never complete.
+  const std::exception_ptr error = std::make_exception_ptr(
+      WriteDiscardedException(page_number, file->filename()));
+  for (std::size_t c = 0; c < request->callbacks.size(); ++c) {
+    request->callbacks[c](request->page, error);
+  }
+  delete request;
+}
+
+void IoScheduler::exclusive(const std::function<void()>& operation) {
+  std::lock_guard<std::mutex> device(device_);
+  operation();
+}
+
+IoClassStats IoScheduler::getStats(const IoClass io_class) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_[io_class];
+}
+
+void IoScheduler::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    std::uint64_t wake_at = 0;
+    const int io_class = pickClass(wake_at);
+    if (io_class < 0) {
+      if (wake_at == 0) {
+        if (stopping_) {
+          break;
+        }
+        queued_cv_.wait(lock);
+      } else {
+        queued_cv_.wait_until(
+            lock, std::chrono::steady_clock::time_point(
+                      std::chrono::nanoseconds(wake_at)));
+      }
+      continue;
+    }
+
+    RateLimit& limit = limits_[io_class];
+    const bool limited = limit.pages_per_sec > 0;
+    const std::vector<Request*> run = takeRun(
+        io_class, limited ? static_cast<std::size_t>(limit.tokens)
+                          : MAX_MERGE_PAGES);
+    if (limited) {
+      limit.tokens -= run.size();
+    }
+    for (std::size_t i = 0; i < run.size(); ++i) {
+      run[i]->dispatched = true;
+    }
+    lock.unlock();
+
+    std::vector<std::exception_ptr> errors(run.size());
+    {
+      std::lock_guard<std::mutex> device(device_);
+      issue(run, errors);
+    }
+
+    // Completions are collected under the lock and delivered without it, so
+    // callbacks may submit new requests.
+    std::vector<Completion> completions(run.size());
+    lock.lock();
+    IoClassStats& stats = stats_[io_class];
+    for (std::size_t i = 0; i < run.size(); ++i) {
+      Request* request = run[i];
+      Completion& completion = completions[i];
+      request->dispatched = false;
+      completion.callbacks.swap(request->callbacks);
+      completion.error = errors[i];
+      completion.page = &request->page;
+      completion.request = request;
+      const PageKey key(request->file, request->page_number);
+      if (errors[i]) {
+        ++stats.failures;
+      } else {
+        ++stats.pages;
+      }
+      if (request->type == READ_REQUEST) {
+        reads_.erase(key);
+        continue;
+      }
+      std::map<PageKey, Request*>::iterator newest = writes_.find(key);
+      if (newest == writes_.end()) {
+        continue;
+      }
+      if (newest->second != request) {
+        // A newer write of the page carries only the sectors changed since
+        // this one was submitted, so it must write this one's as well.  It is
+        // not dispatched: it was queued after this one was.
+        if (errors[i]) {
+          newest->second->page.add_dirty_sectors(
+              request->page.dirty_sectors());
+        }
+        continue;
+      }
+      if (errors[i]) {
+        // Keep the data so reads still see it and drain() can retry.  Others
+        // may change the request from now on, so callbacks get a copy.
+        request->failed = true;
+        request->error = errors[i];
+        failed_.push_back(request);
+        completion.kept_page.reset(new Page(request->page));
+        completion.page = completion.kept_page.get();
+        completion.request = NULL;
+      } else {
+        writes_.erase(newest);
+      }
+    }
+    lock.unlock();
+    done_cv_.notify_all();
+
+    for (std::size_t i = 0; i < completions.size(); ++i) {
+      Completion& completion = completions[i];
+      for (std::size_t c = 0; c < completion.callbacks.size(); ++c) {
+        completion.callbacks[c](*completion.page, completion.error);
+      }
+      delete completion.request;
+    }
+    lock.lock();
+  }
+}
+
+int IoScheduler::pickClass(std::uint64_t& wake_at) {
+  const std::uint64_t now = nowNanos();
+  wake_at = 0;
+  for (int c = 0; c < NUM_CLASSES; ++c) {
+    if (queues_[c].empty()) {
+      continue;
+    }
+    RateLimit& limit = limits_[c];
+    if (limit.pages_per_sec <= 0) {
+      return c;
+    }
+    limit.tokens = std::min(limit.burst,
+                            limit.tokens + (now - limit.refilled_at) *
+                                               limit.pages_per_sec / 1e9);
+    limit.refilled_at = now;
+    if (limit.tokens >= 1) {
+      return c;
+    }
+    const std::uint64_t ready_at =
+        now + static_cast<std::uint64_t>((1 - limit.tokens) * 1e9 /
+                                         limit.pages_per_sec) + 1;
+    if (wake_at == 0 || ready_at < wake_at) {
+      wake_at = ready_at;
+    }
+  }
+  return -1;
+}
+
+std::vector<IoScheduler::Request*> IoScheduler::takeRun(
+    const int io_class, const std::size_t max_pages) {
+  const std::size_t limit = std::min(max_pages, MAX_MERGE_PAGES);
+  Request* head = queues_[io_class].front();
+  std::map<PageKey, Request*>& index =
+      head->type == READ_REQUEST ? reads_ : writes_;
+  std::vector<Request*> before;
+  std::vector<Request*> after;
+
+  // Collect queued requests of the same class and kind for the pages right
+  // before and after the head, as far as they go without a gap.
+  for (PageId page = head->page_number - 1;
+       page > 0 && 1 + before.size() < limit; --page) {
+    std::map<PageKey, Request*>::iterator iter =
+        index.find(PageKey(head->file, page));
+    if (iter == index.end() || iter->second->io_class != io_class ||
+        iter->second->dispatched || iter->second->failed) {
+      break;
+    }
+    before.push_back(iter->second);
+  }
+  for (PageId page = head->page_number + 1;
+       1 + before.size() + after.size() < limit; ++page) {
+    std::map<PageKey, Request*>::iterator iter =
+        index.find(PageKey(head->file, page));
+    if (iter == index.end() || iter->second->io_class != io_class ||
+        iter->second->dispatched || iter->second->failed) {
+      break;
+    }
+    after.push_back(iter->second);
+  }
+
+  std::vector<Request*> run(before.rbegin(), before.rend());
+  run.push_back(head);
+  run.insert(run.end(), after.begin(), after.end());
+  for (std::size_t i = 0; i < run.size(); ++i) {
+    queues_[io_class].erase(run[i]->position);
+  }
+  return run;
+}
+
+void IoScheduler::issue(const std::vector<Request*>& run,
+                        std::vector<std::exception_ptr>& errors) {
+  BADGERDB_TRACE_SPAN(TRACE_IO, "io", "IoScheduler::issue");
+  File* file = run.front()->file;
+  const bool is_read = run.front()->type == READ_REQUEST;
+  IoClassStats& stats = stats_[run.front()->io_class];
+  if (run.size() > 1) {
+    try {
+      if (is_read) {
+        std::vector<Page> pages =
+            file->readPages(run.front()->page_number, run.size());
+        for (std::size_t i = 0; i < run.size(); ++i) {
+          run[i]->page = std::move(pages[i]);
+        }
+      } else {
+        std::vector<Page> pages;
+        pages.reserve(run.size());
+        for (std::size_t i = 0; i < run.size(); ++i) {
+          pages.push_back(run[i]->page);
+        }
+        file->writePages(pages);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++stats.batches;
+      return;
+    } catch (...) {
+      // Fall back to one page at a time to find out which pages failed.
+    }
+  }
+  for (std::size_t i = 0; i < run.size(); ++i) {
+    try {
+      if (is_read) {
+        // Read into the request's page rather than copying a new one in.
+        if (file->tryReadPage(run[i]->page_number, run[i]->page) !=
+            STATUS_OK) {
+          throw InvalidPageException(run[i]->page_number, file->filename());
+        }
+      } else {
+        file->writeDirtySectors(run[i]->page);
+      }
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.batches += run.size();
+}
+
+bool IoScheduler::hasWrites(const File* file) const {
+  std::map<PageKey, Request*>::const_iterator iter =
+      file == NULL ? writes_.begin() : writes_.lower_bound(PageKey(file, 0));
+  for (; iter != writes_.end() && (file == NULL || iter->first.first == file);
+       ++iter) {
+    if (!iter->second->failed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IoScheduler::enqueue(Request* request) {
+  std::list<Request*>& queue = queues_[request->io_class];
+  request->position = queue.insert(queue.end(), request);
+  queued_cv_.notify_one();
+}
+
+void IoScheduler::promote(Request* request, const IoClass io_class) {
+  queues_[request->io_class].erase(request->position);
+  request->io_class = io_class;
+  enqueue(request);
+}
+
+}
@@ -0,0 +1,421 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * Priority classes of I/O requests, most urgent first.
+ */
+enum IoClass {
+  /**
+   * Reads a caller is blocked on, such as buffer pool misses.
+   */
+  IO_FOREGROUND = 0,
+
+  /**
+   * Reads issued ahead of need.
+   */
+  IO_PREFETCH = 1,
+
+  /**
+   * Write-back of evicted pages, flushes and checkpoints.
+   */
+  IO_BACKGROUND = 2
+};
+
+/**
+ * @brief Counters of one I/O class.
+ */
+struct IoClassStats {
+  /**
+   * Requests submitted, including those folded into an earlier request.
+   */
+  std::uint64_t requests;
+
+  /**
+   * Pages transferred to or from the files.
+   */
+  std::uint64_t pages;
+
+  /**
+   * Backend operations issued; each moves one run of adjacent pages.
+   */
+  std::uint64_t batches;
+
+  /**
+   * Reads answered from a queued write or joined to a queued read, and writes
+   * that replaced a queued write, without any I/O of their own.
+   */
+  std::uint64_t folded;
+
+  /**
+   * Requests that failed.
+   */
+  std::uint64_t failures;
+
+  IoClassStats()
+      : requests(0), pages(0), batches(0), folded(0), failures(0) {}
+};
+
+/**
+ * @brief Queues page reads and writes and issues them to the files from one
+ *        dispatcher thread, most urgent class first.
+ *
+ * Requests are served in strict priority order of their IoClass, and in
+ * arrival order within a class.  A class can be given a rate limit in pages
+ * per second (a token bucket with a burst size); while it is out of tokens,
+ * lower classes go ahead.
+ *
+ * When a request is dispatched, queued requests of the same class and kind
+ * for adjacent pages of the same file are merged into it, so a run of up to
+ * MAX_MERGE_PAGES pages moves in one backend operation.
+ *
+ * Queued writes hold a copy of the page, so the caller can reuse its memory
+ * right away.  Until a write has reached its file, reads of that page are
+ * answered from the copy, and a second write to it replaces the queued data.
+ * A read joins a queued read of the same page.
+ *
+ * Writes nobody waits for can fail after their submitter moved on.  Such
+ * writes stay queued (reads still see them) and drain() retries them and
+ * reports the failure.
+ *
+ * All I/O on a file handed to the scheduler must go through it, or through
+ * exclusive() for operations it has no request for (allocating, deleting,
+ * syncing).
+ */
+class IoScheduler {
+ public:
+  /**
+   * Number of priority classes.
+   */
+  static const int NUM_CLASSES = 3;
+
+  /**
+   * Largest number of pages merged into one backend operation.
+   */
+  static const std::size_t MAX_MERGE_PAGES = 32;
+
+  /**
+   * Called when a request completes, on the dispatcher thread (or on the
+   * submitting thread if the request needed no I/O).  <page> holds the page
+   * read or written; <error> is set if the request failed.
+   */
+  typedef std::function<void(const Page& page, std::exception_ptr error)>
+      Callback;
+
+  /**
+   * Starts the dispatcher thread.
+   */
+  IoScheduler();
+
+  /**
+   * Completes all queued requests and stops the dispatcher thread.
+   */
+  ~IoScheduler();
+
+  /**
+   * Limits the rate of a class.
+   *
+   * @param io_class        Class to limit.
+   * @param pages_per_sec   Pages per second the class may move, or 0 for no
+   *                        limit (the default).
+   * @param burst_pages     Pages the class may move at once after being idle;
+   *                        it also bounds the pages merged into one operation,
+   *                        and so how long the class keeps the files busy.
+   */
+  void setRateLimit(const IoClass io_class, const double pages_per_sec,
+                    const std::uint32_t burst_pages = MAX_MERGE_PAGES);
+
+  /**
+   * Queues a read of a page.
+   *
+   * @param io_class    Priority class.
+   * @param file        File to read from.
+   * @param page_number Page to read.
+   * @param done        Called with the page once it has been read.
+   */
+  void submitRead(const IoClass io_class, File* file,
+                  const PageId page_number, const Callback& done);
+
+  /**
+   * Queues a write of a page.
+   *
+   * @param io_class  Priority class.
+   * @param file      File to write to.
+   * @param page      Page to write; it is copied.
+   * @param done      Called once the page has been written, or empty.
+   */
+  void submitWrite(const IoClass io_class, File* file, const Page& page,
+                   const Callback& done = Callback());
+
+  /**
+   * Reads a page and waits for it.
+   *
+   * @param io_class    Priority class.
+   * @param file        File to read from.
+   * @param page_number Page to read.
+   * @param page        Receives the page.
+   * @throws  BadgerDbException  Whatever reading the page threw.
+   */
+  void read(const IoClass io_class, File* file, const PageId page_number,
+            Page& page);
+
+  /**
+   * Reads a run of adjacent pages and waits for it.  Pages with a queued
+   * write are answered from the write's copy, like submitRead() does, whether
+   * or not they are on the file yet; the others are read with one backend
+   * operation per stretch of them.
+   *
+   * The caller must keep writes of these pages from being submitted
+   * meanwhile, as a buffer pool does for pages it is loading.
+   *
+   * @param file        File to read from.
+   * @param first_page  First page to read.
+   * @param count       Number of pages to read.
+   * @return  The pages, in page order.
+   * @throws  BadgerDbException  Whatever reading the pages threw.
+   */
+  std::vector<Page> readPages(File* file, const PageId first_page,
+                              const std::size_t count);
+
+  /**
+   * Waits until every write queued for a file has reached it, retrying writes
+   * that failed earlier.
+   *
+   * @param file  File whose writes to wait for, or NULL for all files.
+   * @throws  BadgerDbException  If a write failed; it stays queued.
+   */
+  void drain(const File* file);
+
+  /**
+   * Drops queued writes of a page, for instance because it is being deleted.
+   * Their callbacks are called with a WriteDiscardedException.  A write
+   * already being issued still completes.
+   *
+   * @param file        File of the page.
+   * @param page_number Page whose writes to drop.
+   */
+  void discard(const File* file, const PageId page_number);
+
+  /**
+   * Runs an operation on the files while no request is being issued.
+   *
+   * @param operation Operation to run.
+   */
+  void exclusive(const std::function<void()>& operation);
+
+  /**
+   * Returns the counters of a class.
+   *
+   * @param io_class  Class to report.
+   */
+  IoClassStats getStats(const IoClass io_class);
+
+ private:
+  /**
+   * Kinds of requests.
+   */
+  enum IoType {
+    READ_REQUEST,
+    WRITE_REQUEST
+  };
+
+  /**
+   * Page a request is for.
+   */
+  typedef std::pair<const File*, PageId> PageKey;
+
+  /**
+   * One queued or dispatched request.
+   */
+  struct Request {
+    IoType type;
+    IoClass io_class;
+    File* file;
+    PageId page_number;
+
+    /**
+     * Data to write, or the page read.
+     */
+    Page page;
+
+    /**
+     * Callbacks of everyone waiting for the request.
+     */
+    std::vector<Callback> callbacks;
+
+    /**
+     * True while the request is being issued.
+     */
+    bool dispatched;
+
+    /**
+     * True if the write failed and waits in failed_ for a retry.
+     */
+    bool failed;
+
+    /**
+     * Why the write failed, if it did.
+     */
+    std::exception_ptr error;
+
+    /**
+     * Position in the queue of its class while queued.
+     */
+    std::list<Request*>::iterator position;
+  };
+
+  /**
+   * A request that completed, ready to be reported to its callbacks.
+   */
+  struct Completion {
+    std::vector<Callback> callbacks;
+
+    /**
+     * Page to report.
+     */
+    const Page* page;
+
+    /**
+     * Copy of the page if the request lives on after completing.
+     */
+    std::unique_ptr<Page> kept_page;
+
+    std::exception_ptr error;
+
+    /**
+     * Request to delete once reported, or NULL if it lives on.
+     */
+    Request* request;
+
+    Completion() : page(NULL), request(NULL) {}
+  };
+
+  /**
+   * Token bucket limiting a class.
+   */
+  struct RateLimit {
+    double pages_per_sec;
+    double burst;
+    double tokens;
+    std::uint64_t refilled_at;
+
+    RateLimit() : pages_per_sec(0), burst(0), tokens(0), refilled_at(0) {}
+  };
+
+  /**
+   * Main loop of the dispatcher thread.
+   */
+  void run();
+
+  /**
+   * Picks the class to serve next, or returns -1 and sets <wake_at> to when a
+   * rate-limited class gets a token (0 if no class has requests).
+   * Requires mutex_.
+   */
+  int pickClass(std::uint64_t& wake_at);
+
+  /**
+   * Takes the request at the head of a class and the requests mergeable with
+   * it off the queue, in page order, at most <max_pages> of them.  Requires
+   * mutex_.
+   */
+  std::vector<Request*> takeRun(const int io_class,
+                                const std::size_t max_pages);
+
+  /**
+   * Issues a run of requests to the file.  Sets <error> of each request that
+   * failed.  Runs without mutex_, holding device_.
+   */
+  void issue(const std::vector<Request*>& run,
+             std::vector<std::exception_ptr>& errors);
+
+  /**
+   * Returns true if a write for the file (any file if NULL) is queued,
+   * dispatched or failed.  Requires mutex_.
+   */
+  bool hasWrites(const File* file) const;
+
+  /**
+   * Queues a request in its class and wakes the dispatcher.  Requires mutex_.
+   */
+  void enqueue(Request* request);
+
+  /**
+   * Moves a queued request to a more urgent class.  Requires mutex_.
+   */
+  void promote(Request* request, const IoClass io_class);
+
+  /**
+   * Protects everything below except device_.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Held while requests are issued and by exclusive().
+   */
+  std::mutex device_;
+
+  /**
+   * Signalled when a request is queued or the scheduler stops.
+   */
+  std::condition_variable queued_cv_;
+
+  /**
+   * Signalled when requests complete.
+   */
+  std::condition_variable done_cv_;
+
+  /**
+   * Queued requests of each class, oldest first.
+   */
+  std::list<Request*> queues_[NUM_CLASSES];
+
+  /**
+   * Queued reads by page.
+   */
+  std::map<PageKey, Request*> reads_;
+
+  /**
+   * Newest write of each page that has not reached its file yet.
+   */
+  std::map<PageKey, Request*> writes_;
+
+  /**
+   * Writes that failed and wait for drain() to retry them.
+   */
+  std::list<Request*> failed_;
+
+  RateLimit limits_[NUM_CLASSES];
+  IoClassStats stats_[NUM_CLASSES];
+
+  /**
+   * True once the destructor asked the dispatcher to stop.
+   */
+  bool stopping_;
+
+  std::thread dispatcher_;
+};
+
+}
@@ -0,0 +1,73 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "kv_store.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Collects the keys and values a scan visits, up to a limit.
+ */
+class Collector {
+ public:
+  Collector(std::vector<std::pair<std::string, std::string> >& entries,
+            const std::size_t limit)
+      : entries_(entries), limit_(limit) {}
+
+  bool operator()(const std::string& key, const std::string& value) {
+    entries_.push_back(std::make_pair(key, value));
+    return entries_.size() < limit_;
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string> >& entries_;
+  const std::size_t limit_;
+};
+
+}
+
+KVStore::KVStore(const std::string& name, const LsmOptions& options)
+    : tree_(name, options) {}
+
+void KVStore::put(const std::string& key, const std::string& value) {
+  tree_.put(key, value);
+}
+
+Status KVStore::get(const std::string& key, std::string& value) {
+  return tree_.get(key, value);
+}
+
+void KVStore::remove(const std::string& key) {
+  tree_.remove(key);
+}
+
+std::size_t KVStore::scan(const std::string& start, const std::string& end,
+                          const ScanVisitor& visit) {
+  return tree_.scan(start, end, visit);
+}
+
+std::vector<std::pair<std::string, std::string> > KVStore::scan(
+    const std::string& start, const std::string& end,
+    const std::size_t limit) {
+  std::vector<std::pair<std::string, std::string> > entries;
+  if (limit > 0) {
+    tree_.scan(start, end, Collector(entries, limit));
+  }
+  return entries;
+}
+
+void KVStore::flush() {
+  tree_.flush();
+}
+
+void KVStore::destroy(const std::string& name) {
+  LsmTree::destroy(name);
+}
+
+}
@@ -0,0 +1,126 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lsm_tree.h"
+#include "status.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Key-value store of byte-string keys and values.
+ *
+ * The way to keep data in BadgerDB without building on BufMgr and Page:
+ * keys and values are any strings, together up to SortedRun::MAX_ENTRY_SIZE
+ * bytes, and keys are ordered bytewise.  The store is an LsmTree, whose
+ * files start with the store's name; LsmOptions tune it.
+ *
+ * All methods may be called from several threads.
+ */
+class KVStore {
+ public:
+  /**
+   * Called by scan() with each key and its value; returns false to end the
+   * scan.
+   */
+  typedef LsmTree::ScanVisitor ScanVisitor;
+
+  /**
+   * Opens the store of the given name, creating it if there is none.
+   *
+   * @param name      Name the store's files start with.
+   * @param options   Settings of the store's LsmTree.
+   */
+  explicit KVStore(const std::string& name,
+                   const LsmOptions& options = LsmOptions());
+
+  /**
+   * Sets the value of <key>.
+   *
+   * @param key     Key.
+   * @param value   Value.
+   * @throws  InsufficientSpaceException  If key and value together are
+   *                                      longer than
+   *                                      SortedRun::MAX_ENTRY_SIZE.
+   */
+  void put(const std::string& key, const std::string& value);
+
+  /**
+   * Looks up the value of <key>.
+   *
+   * @param key     Key.
+   * @param value   Set to the value, if the key has one.
+   * @return  STATUS_OK, or STATUS_NOT_FOUND if the key has no value.
+   */
+  Status get(const std::string& key, std::string& value);
+
+  /**
+   * Removes <key>, if it has a value.
+   *
+   * @param key   Key.
+   */
+  void remove(const std::string& key);
+
+  /**
+   * Visits the keys in [<start>, <end>) in key order, as they were when the
+   * scan started.
+   *
+   * @param start   Smallest key to visit.
+   * @param end     Key to stop before; empty to go to the last key.
+   * @param visit   Called with each key and value, until it returns false.
+   * @return  Number of keys visited.
+   */
+  std::size_t scan(const std::string& start, const std::string& end,
+                   const ScanVisitor& visit);
+
+  /**
+   * Returns up to <limit> keys in [<start>, <end>) and their values, in key
+   * order.
+   *
+   * @param start   Smallest key to return.
+   * @param end     Key to stop before; empty to go to the last key.
+   * @param limit   Largest number of keys to return.
+   * @return  The keys and values.
+   */
+  std::vector<std::pair<std::string, std::string> > scan(
+      const std::string& start, const std::string& end,
+      const std::size_t limit);
+
+  /**
+   * Writes what is only in memory to the store's files.
+   */
+  void flush();
+
+  /**
+   * Returns the counters of the store's LsmTree.
+   *
+   * @return  Counters.
+   */
+  LsmStats stats() { return tree_.stats(); }
+
+  /**
+   * Removes every file of the store of the given name, which must not be
+   * open.
+   *
+   * @param name  Name the store's files start with.
+   */
+  static void destroy(const std::string& name);
+
+ private:
+  /**
+   * The store's contents.
+   */
+  LsmTree tree_;
+};
+
+}
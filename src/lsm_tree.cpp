@@ -0,0 +1,975 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "lsm_tree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <set>
+#include <sstream>
+
+#include "exceptions/insufficient_space_exception.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Largest piece of the manifest stored in one page.
+ */
+const std::size_t MANIFEST_CHUNK = Page::DATA_SIZE - 64;
+
+/**
+ * File numbers recorded in the manifest at a time ahead of their use.
+ */
+const std::uint64_t FILE_NUMBER_LEASE = 16;
+
+/**
+ * Start of the manifest: the next file number, the oldest log needed and the
+ * number of runs listed after it.  Every run or log ever created has a
+ * number below the next file number.
+ */
+struct ManifestHeader {
+  std::uint64_t next_file_number;
+  std::uint64_t log_number;
+  std::uint64_t runs;
+};
+
+/**
+ * Entry of the manifest for one run.
+ */
+struct ManifestRun {
+  std::uint64_t level;
+  std::uint64_t number;
+};
+
+/**
+ * Orders runs by their smallest key, as in levels below level 0.
+ */
+bool smallerRun(const std::shared_ptr<SortedRun>& a,
+                const std::shared_ptr<SortedRun>& b) {
+  return a->smallest() < b->smallest();
+}
+
+/**
+ * Orders runs newest first, as in level 0.
+ */
+bool newerRun(const std::shared_ptr<SortedRun>& a,
+              const std::shared_ptr<SortedRun>& b) {
+  return a->number() > b->number();
+}
+
+/**
+ * Removes the runs of <removed> from <runs>.
+ */
+void removeRuns(std::vector<std::shared_ptr<SortedRun> >& runs,
+                const std::vector<std::shared_ptr<SortedRun> >& removed) {
+  for (std::size_t i = 0; i < removed.size(); ++i) {
+    runs.erase(std::remove(runs.begin(), runs.end(), removed[i]), runs.end());
+  }
+}
+
+/**
+ * Entries of one input of a merge, in key order.
+ */
+class EntrySource {
+ public:
+  virtual ~EntrySource() {}
+
+  /**
+   * Returns true until the source has passed its last entry.
+   */
+  virtual bool valid() const = 0;
+
+  /**
+   * Returns the entry at the source's position.
+   */
+  virtual const RunEntry& entry() const = 0;
+
+  /**
+   * Moves to the next entry.
+   */
+  virtual void next() = 0;
+};
+
+/**
+ * Entries of a memtable from <start>, which must not change while they are
+ * read.
+ */
+class MemtableSource : public EntrySource {
+ public:
+  typedef std::map<std::string, std::pair<EntryType, std::string> > Entries;
+
+  MemtableSource(const std::shared_ptr<const Entries>& entries,
+                 const std::string& start)
+      : entries_(entries), iter_(entries->lower_bound(start)) {
+    load();
+  }
+
+  bool valid() const { return iter_ != entries_->end(); }
+
+  const RunEntry& entry() const { return entry_; }
+
+  void next() {
+    ++iter_;
+    load();
+  }
+
+ private:
+  void load() {
+    if (valid()) {
+      entry_.key = iter_->first;
+      entry_.type = iter_->second.first;
+      entry_.value = iter_->second.second;
+    }
+  }
+
+  std::shared_ptr<const Entries> entries_;
+  Entries::const_iterator iter_;
+  RunEntry entry_;
+};
+
+/**
+ * Entries of runs with disjoint key ranges in key order from <start>, one
+ * run after another: a level below level 0, or a single run.
+ */
+class LevelSource : public EntrySource {
+ public:
+  LevelSource(const std::vector<std::shared_ptr<SortedRun> >& runs,
+              const std::string& start)
+      : runs_(runs), next_run_(0) {
+    while (next_run_ < runs_.size() && runs_[next_run_]->largest() < start) {
+      ++next_run_;
+    }
+    if (next_run_ < runs_.size()) {
+      cursor_.reset(new SortedRunCursor(runs_[next_run_++], start));
+    }
+  }
+
+  bool valid() const { return cursor_ && cursor_->valid(); }
+
+  const RunEntry& entry() const { return cursor_->entry(); }
+
+  void next() {
+    cursor_->next();
+    if (!cursor_->valid()) {
+      if (next_run_ < runs_.size()) {
+        cursor_.reset(new SortedRunCursor(runs_[next_run_++]));
+      } else {
+        cursor_.reset();
+      }
+    }
+  }
+
+ private:
+  const std::vector<std::shared_ptr<SortedRun> > runs_;
+  std::size_t next_run_;
+  std::unique_ptr<SortedRunCursor> cursor_;
+};
+
+/**
+ * Merges sources given newest first into the newest entry of each key, in
+ * key order.
+ */
+class MergeCursor {
+ public:
+  explicit MergeCursor(std::vector<std::unique_ptr<EntrySource> >& sources)
+      : current_(-1) {
+    sources_.swap(sources);
+    findSmallest();
+  }
+
+  bool valid() const { return current_ >= 0; }
+
+  const RunEntry& entry() const { return sources_[current_]->entry(); }
+
+  void next() {
+    // Older entries of the same key are hidden by the one returned.
+    const std::string key = entry().key;
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+      if (sources_[i]->valid() && sources_[i]->entry().key == key) {
+        sources_[i]->next();
+      }
+    }
+    findSmallest();
+  }
+
+ private:
+  void findSmallest() {
+    current_ = -1;
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+      if (sources_[i]->valid() &&
+          (current_ < 0 ||
+           sources_[i]->entry().key < sources_[current_]->entry().key)) {
+        current_ = i;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<EntrySource> > sources_;
+  int current_;
+};
+
+}
+
+LsmTree::LsmTree(const std::string& name, const LsmOptions& options)
+    : name_(name),
+      options_(options),
+      flushing_(false),
+      busy_levels_(NUM_LEVELS, false),
+      compact_pointers_(NUM_LEVELS),
+      next_file_number_(1),
+      file_number_limit_(1),
+      log_page_written_(false),
+      stopping_(false),
+      gets_(0),
+      memtable_hits_(0),
+      run_reads_(0),
+      filter_skips_(0) {
+  std::shared_ptr<Version> version(new Version);
+  std::uint64_t log_number = 0;
+  bool existed;
+  {
+    std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+    existed = File::exists(manifestName(name_));
+    manifest_.reset(new File(existed ? File::open(manifestName(name_))
+                                     : File::create(manifestName(name_))));
+  }
+  if (existed) {
+    next_file_number_ = readManifest(*version, log_number);
+    file_number_limit_ = next_file_number_;
+  }
+
+  // Remove what a crash left behind: runs replaced by a compaction or not
+  // yet in the manifest, and logs already flushed.  Then replay the logs
+  // still needed into a run.
+  std::set<std::uint64_t> live;
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    for (std::size_t i = 0; i < version->levels[level].size(); ++i) {
+      live.insert(version->levels[level][i]->number());
+    }
+  }
+  std::vector<std::uint64_t> logs;
+  Memtable replayed;
+  for (std::uint64_t number = 1; number < next_file_number_; ++number) {
+    bool log_exists;
+    {
+      std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+      if (live.count(number) == 0 && File::exists(runName(name_, number))) {
+        File::remove(runName(name_, number));
+      }
+      log_exists = File::exists(logName(name_, number));
+      if (log_exists && number < log_number) {
+        File::remove(logName(name_, number));
+        log_exists = false;
+      }
+    }
+    if (log_exists) {
+      replayLog(number, replayed);
+      logs.push_back(number);
+    }
+  }
+  // The manifest written meanwhile still needs the logs being replayed.
+  version_ = version;
+  memtable_.reset(new Memtable);
+  memtable_->log_number = log_number;
+  if (!replayed.entries.empty()) {
+    SortedRunWriter writer(options_.bloom_bits_per_key);
+    for (std::map<std::string, MemEntry>::const_iterator iter =
+             replayed.entries.begin();
+         iter != replayed.entries.end(); ++iter) {
+      writer.add(iter->first, iter->second.first, iter->second.second);
+    }
+    std::uint64_t number;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      number = takeFileNumber();
+    }
+    version->levels[0].insert(version->levels[0].begin(),
+                              writer.finish(runName(name_, number), number));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    newLog();
+  }
+  for (std::size_t i = 0; i < logs.size(); ++i) {
+    std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+    File::remove(logName(name_, logs[i]));
+  }
+  for (int i = 0; i < options_.background_threads; ++i) {
+    threads_.push_back(std::thread(&LsmTree::backgroundThread, this));
+  }
+}
+
+LsmTree::~LsmTree() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_.notify_all();
+  for (std::size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i].join();
+  }
+  // Runs close their own files, taking the file mutex; drop them first.
+  version_.reset();
+  std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+  log_.reset();
+  manifest_.reset();
+}
+
+void LsmTree::put(const std::string& key, const std::string& value) {
+  write(key, ENTRY_VALUE, value);
+}
+
+void LsmTree::remove(const std::string& key) {
+  write(key, ENTRY_DELETION, std::string());
+}
+
+Status LsmTree::get(const std::string& key, std::string& value) {
+  ++gets_;
+  std::shared_ptr<const Version> version;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::shared_ptr<Memtable> memtables[] = {memtable_, frozen_};
+    for (int i = 0; i < 2; ++i) {
+      if (!memtables[i]) {
+        continue;
+      }
+      const std::map<std::string, MemEntry>::const_iterator iter =
+          memtables[i]->entries.find(key);
+      if (iter != memtables[i]->entries.end()) {
+        ++memtable_hits_;
+        if (iter->second.first == ENTRY_DELETION) {
+          return STATUS_NOT_FOUND;
+        }
+        value = iter->second.second;
+        return STATUS_OK;
+      }
+    }
+    version = version_;
+  }
+  RunEntry entry;
+  if (!findInRuns(*version, key, entry) || entry.type == ENTRY_DELETION) {
+    return STATUS_NOT_FOUND;
+  }
+  value.swap(entry.value);
+  return STATUS_OK;
+}
+
+std::size_t LsmTree::scan(const std::string& start, const std::string& end,
+                          const ScanVisitor& visit) {
+  // The memtable changes under the scan, so its part of the range is
+  // copied; the frozen memtable and the runs do not.
+  std::shared_ptr<Memtable> memtable(new Memtable);
+  std::shared_ptr<Memtable> frozen;
+  std::shared_ptr<const Version> version;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memtable->entries.insert(
+        memtable_->entries.lower_bound(start),
+        end.empty() ? memtable_->entries.end()
+                    : memtable_->entries.lower_bound(end));
+    frozen = frozen_;
+    version = version_;
+  }
+
+  std::vector<std::unique_ptr<EntrySource> > sources;
+  sources.emplace_back(new MemtableSource(
+      std::shared_ptr<const MemtableSource::Entries>(memtable,
+                                                     &memtable->entries),
+      start));
+  if (frozen) {
+    sources.emplace_back(new MemtableSource(
+        std::shared_ptr<const MemtableSource::Entries>(frozen,
+                                                       &frozen->entries),
+        start));
+  }
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    const std::vector<std::shared_ptr<SortedRun> >& runs =
+        version->levels[level];
+    std::vector<std::shared_ptr<SortedRun> > overlapping;
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+      if (!(runs[i]->largest() < start) &&
+          (end.empty() || runs[i]->smallest() < end)) {
+        overlapping.push_back(runs[i]);
+      }
+    }
+    if (level == 0) {
+      // Runs of level 0 overlap each other: each is a source of its own.
+      for (std::size_t i = 0; i < overlapping.size(); ++i) {
+        sources.emplace_back(new LevelSource(
+            std::vector<std::shared_ptr<SortedRun> >(1, overlapping[i]),
+            start));
+      }
+    } else if (!overlapping.empty()) {
+      sources.emplace_back(new LevelSource(overlapping, start));
+    }
+  }
+
+  std::size_t visited = 0;
+  for (MergeCursor merge(sources); merge.valid(); merge.next()) {
+    const RunEntry& entry = merge.entry();
+    if (!end.empty() && !(entry.key < end)) {
+      break;
+    }
+    if (entry.type == ENTRY_DELETION) {
+      continue;
+    }
+    ++visited;
+    if (!visit(entry.key, entry.value)) {
+      break;
+    }
+  }
+  return visited;
+}
+
+bool LsmTree::findInRuns(const Version& version, const std::string& key,
+                         RunEntry& entry) {
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    const std::vector<std::shared_ptr<SortedRun> >& runs =
+        version.levels[level];
+    std::size_t first = 0;
+    std::size_t last = runs.size();
+    if (level > 0) {
+      // Runs do not overlap: only the last one starting at or before <key>
+      // may hold it.
+      std::size_t lo = 0;
+      std::size_t hi = runs.size();
+      while (lo < hi) {
+        const std::size_t mid = (lo + hi) / 2;
+        if (key < runs[mid]->smallest()) {
+          hi = mid;
+        } else {
+          lo = mid + 1;
+        }
+      }
+      if (lo == 0) {
+        continue;
+      }
+      first = lo - 1;
+      last = lo;
+    }
+    for (std::size_t i = first; i < last; ++i) {
+      if (!runs[i]->mayContain(key)) {
+        if (!(key < runs[i]->smallest() || runs[i]->largest() < key)) {
+          ++filter_skips_;
+        }
+        continue;
+      }
+      ++run_reads_;
+      if (runs[i]->find(key, entry)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void LsmTree::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!memtable_->entries.empty()) {
+    while (frozen_ && !background_error_) {
+      done_.wait(lock);
+    }
+    if (!background_error_) {
+      frozen_ = memtable_;
+      newLog();
+      work_.notify_all();
+    }
+  }
+  while (frozen_ && !background_error_) {
+    done_.wait(lock);
+  }
+  if (background_error_) {
+    std::rethrow_exception(background_error_);
+  }
+}
+
+void LsmTree::waitForCompactions() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    if (background_error_) {
+      std::rethrow_exception(background_error_);
+    }
+    bool idle = !frozen_;
+    for (int level = 0; idle && level < NUM_LEVELS; ++level) {
+      idle = !busy_levels_[level] &&
+          (level == NUM_LEVELS - 1 || levelScore(level) < 1);
+    }
+    if (idle) {
+      return;
+    }
+    done_.wait(lock);
+  }
+}
+
+LsmStats LsmTree::stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  LsmStats stats = stats_;
+  stats.gets = gets_;
+  stats.memtable_hits = memtable_hits_;
+  stats.run_reads = run_reads_;
+  stats.filter_skips = filter_skips_;
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    const std::vector<std::shared_ptr<SortedRun> >& runs =
+        version_->levels[level];
+    std::uint64_t bytes = 0;
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+      bytes += runs[i]->bytes();
+    }
+    stats.level_runs.push_back(runs.size());
+    stats.level_bytes.push_back(bytes);
+  }
+  return stats;
+}
+
+void LsmTree::destroy(const std::string& name) {
+  std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+  const std::string manifest = manifestName(name);
+  if (!File::exists(manifest)) {
+    return;
+  }
+  std::uint64_t next_file_number = 0;
+  {
+    File file = File::open(manifest);
+    FileIterator iter = file.begin();
+    if (iter != file.end()) {
+      Page page = *iter;
+      const std::string chunk = *page.begin();
+      ManifestHeader header;
+      std::memcpy(&header, chunk.data(), sizeof(header));
+      next_file_number = header.next_file_number;
+    }
+  }
+  for (std::uint64_t number = 1; number < next_file_number; ++number) {
+    if (File::exists(runName(name, number))) {
+      File::remove(runName(name, number));
+    }
+    if (File::exists(logName(name, number))) {
+      File::remove(logName(name, number));
+    }
+  }
+  File::remove(manifest);
+}
+
+std::string LsmTree::manifestName(const std::string& name) {
+  return name + ".manifest";
+}
+
+std::string LsmTree::runName(const std::string& name,
+                             const std::uint64_t number) {
+  std::ostringstream filename;
+  filename << name << "." << number << ".run";
+  return filename.str();
+}
+
+std::string LsmTree::logName(const std::string& name,
+                             const std::uint64_t number) {
+  std::ostringstream filename;
+  filename << name << "." << number << ".log";
+  return filename.str();
+}
+
+std::uint64_t LsmTree::readManifest(Version& version,
+                                    std::uint64_t& log_number) {
+  std::string manifest;
+  for (FileIterator iter = manifest_->begin(); iter != manifest_->end();
+       ++iter) {
+    manifest_pages_.push_back(*iter);
+    manifest.append(*manifest_pages_.back().begin());
+  }
+  ManifestHeader header;
+  assert(manifest.length() >= sizeof(header));
+  std::memcpy(&header, manifest.data(), sizeof(header));
+  for (std::uint64_t i = 0; i < header.runs; ++i) {
+    ManifestRun run;
+    std::memcpy(&run, &manifest[sizeof(header) + i * sizeof(run)],
+                sizeof(run));
+    version.levels[run.level].push_back(
+        SortedRun::open(runName(name_, run.number), run.number));
+  }
+  std::sort(version.levels[0].begin(), version.levels[0].end(), newerRun);
+  for (int level = 1; level < NUM_LEVELS; ++level) {
+    std::sort(version.levels[level].begin(), version.levels[level].end(),
+              smallerRun);
+  }
+  log_number = header.log_number;
+  return header.next_file_number;
+}
+
+void LsmTree::writeManifest() {
+  ManifestHeader header;
+  header.next_file_number = file_number_limit_;
+  header.log_number = frozen_ ? frozen_->log_number : memtable_->log_number;
+  header.runs = 0;
+  std::string runs;
+  for (int level = 0; level < NUM_LEVELS; ++level) {
+    for (std::size_t i = 0; i < version_->levels[level].size(); ++i) {
+      ManifestRun run;
+      run.level = level;
+      run.number = version_->levels[level][i]->number();
+      runs.append(reinterpret_cast<const char*>(&run), sizeof(run));
+      ++header.runs;
+    }
+  }
+  std::string manifest(reinterpret_cast<const char*>(&header), sizeof(header));
+  manifest.append(runs);
+
+  // Rewrite the pages there are in place and add any more needed; a page no
+  // longer needed keeps a placeholder past the end of the runs.
+  std::vector<Page> added;
+  std::size_t i = 0;
+  for (std::size_t offset = 0; offset < manifest.length();
+       offset += MANIFEST_CHUNK, ++i) {
+    const std::string chunk = manifest.substr(offset, MANIFEST_CHUNK);
+    if (i < manifest_pages_.size()) {
+      const RecordId record_id = {manifest_pages_[i].page_number(), 1};
+      manifest_pages_[i].updateRecord(record_id, chunk);
+    } else {
+      added.push_back(Page());
+      added.back().insertRecord(chunk);
+    }
+  }
+  for (; i < manifest_pages_.size(); ++i) {
+    const RecordId record_id = {manifest_pages_[i].page_number(), 1};
+    manifest_pages_[i].updateRecord(record_id, std::string(1, '\0'));
+  }
+  if (!manifest_pages_.empty()) {
+    manifest_->writePages(manifest_pages_);
+  }
+  if (!added.empty()) {
+    manifest_->appendPages(added);
+    manifest_pages_.insert(manifest_pages_.end(), added.begin(), added.end());
+  }
+  manifest_->sync();
+}
+
+void LsmTree::replayLog(const std::uint64_t number, Memtable& memtable) {
+  std::unique_ptr<File> log;
+  {
+    std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+    log.reset(new File(File::open(logName(name_, number))));
+  }
+  RunEntry entry;
+  for (FileIterator page_iter = log->begin(); page_iter != log->end();
+       ++page_iter) {
+    Page page = *page_iter;
+    for (PageIterator iter = page.begin(); iter != page.end(); ++iter) {
+      SortedRun::decodeEntry(*iter, entry);
+      memtable.entries[entry.key] = MemEntry(entry.type, entry.value);
+    }
+  }
+  std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+  log.reset();
+}
+
+std::uint64_t LsmTree::takeFileNumber() {
+  const std::uint64_t number = next_file_number_++;
+  if (next_file_number_ >= file_number_limit_) {
+    // Record the numbers before a file has one, so that reopening after a
+    // crash removes a file the manifest never listed.
+    file_number_limit_ = next_file_number_ + FILE_NUMBER_LEASE;
+    writeManifest();
+  }
+  return number;
+}
+
+void LsmTree::newLog() {
+  const std::uint64_t number = takeFileNumber();
+  {
+    std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+    log_.reset(new File(File::create(logName(name_, number))));
+  }
+  log_page_ = Page();
+  log_page_written_ = false;
+  memtable_.reset(new Memtable);
+  memtable_->log_number = number;
+  writeManifest();
+}
+
+void LsmTree::write(const std::string& key, const EntryType type,
+                    const std::string& value) {
+  const std::size_t size = key.length() + value.length();
+  const std::size_t limit = SortedRun::MAX_ENTRY_SIZE;
+  if (size > limit) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, size, limit);
+  }
+  const std::string record = SortedRun::encodeEntry(key, type, value);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  makeRoomForWrite(lock);
+  RecordId record_id;
+  if (log_page_.tryInsertRecord(record, record_id) != STATUS_OK) {
+    log_page_ = Page();
+    log_page_written_ = false;
+    log_page_.insertRecord(record);
+  }
+  if (log_page_written_) {
+    log_->writeDirtySectors(log_page_);
+  } else {
+    std::vector<Page> pages(1, log_page_);
+    log_->appendPages(pages);
+    log_page_ = pages.front();
+    log_page_written_ = true;
+  }
+  log_page_.clear_dirty_sectors();
+  if (options_.sync_log) {
+    log_->sync();
+  }
+
+  MemEntry& entry = memtable_->entries[key];
+  entry.first = type;
+  entry.second = value;
+  memtable_->bytes += size;
+  ++stats_.writes;
+}
+
+void LsmTree::makeRoomForWrite(std::unique_lock<std::mutex>& lock) {
+  bool stalled = false;
+  for (;;) {
+    if (background_error_) {
+      std::rethrow_exception(background_error_);
+    }
+    const bool level0_full =
+        version_->levels[0].size() >= 3 * options_.level0_runs;
+    const bool memtable_full = memtable_->bytes >= options_.memtable_bytes;
+    if (!level0_full && !memtable_full) {
+      return;
+    }
+    if (level0_full || frozen_) {
+      if (!stalled) {
+        ++stats_.write_stalls;
+        stalled = true;
+      }
+      done_.wait(lock);
+      continue;
+    }
+    frozen_ = memtable_;
+    newLog();
+    work_.notify_all();
+  }
+}
+
+void LsmTree::backgroundThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (background_error_) {
+      work_.wait(lock);
+      continue;
+    }
+    try {
+      Compaction compaction;
+      if (frozen_ && !flushing_) {
+        flushing_ = true;
+        const std::shared_ptr<Memtable> memtable = frozen_;
+        flushMemtable(lock, memtable);
+      } else if (pickCompaction(compaction)) {
+        compact(lock, compaction);
+      } else {
+        work_.wait(lock);
+      }
+    } catch (...) {
+      if (!lock.owns_lock()) {
+        lock.lock();
+      }
+      background_error_ = std::current_exception();
+      done_.notify_all();
+    }
+  }
+}
+
+void LsmTree::flushMemtable(std::unique_lock<std::mutex>& lock,
+                            const std::shared_ptr<Memtable>& memtable) {
+  const std::uint64_t number = takeFileNumber();
+  lock.unlock();
+  SortedRunWriter writer(options_.bloom_bits_per_key);
+  for (std::map<std::string, MemEntry>::const_iterator iter =
+           memtable->entries.begin();
+       iter != memtable->entries.end(); ++iter) {
+    writer.add(iter->first, iter->second.first, iter->second.second);
+  }
+  const std::shared_ptr<SortedRun> run =
+      writer.finish(runName(name_, number), number);
+  lock.lock();
+
+  std::shared_ptr<Version> version(new Version(*version_));
+  version->levels[0].insert(version->levels[0].begin(), run);
+  version_ = version;
+  frozen_.reset();
+  flushing_ = false;
+  ++stats_.flushes;
+  stats_.bytes_flushed += run->bytes();
+  writeManifest();
+  {
+    std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+    File::remove(logName(name_, memtable->log_number));
+  }
+  done_.notify_all();
+  work_.notify_all();
+}
+
+double LsmTree::levelScore(const int level) const {
+  const std::vector<std::shared_ptr<SortedRun> >& runs =
+      version_->levels[level];
+  if (level == 0) {
+    return static_cast<double>(runs.size()) / options_.level0_runs;
+  }
+  double limit = options_.level1_bytes;
+  for (int i = 1; i < level; ++i) {
+    limit *= options_.level_ratio;
+  }
+  std::uint64_t bytes = 0;
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    bytes += runs[i]->bytes();
+  }
+  return bytes / limit;
+}
+
+bool LsmTree::pickCompaction(Compaction& compaction) {
+  int best = -1;
+  double best_score = 1;
+  for (int level = 0; level < NUM_LEVELS - 1; ++level) {
+    if (busy_levels_[level] || busy_levels_[level + 1]) {
+      continue;
+    }
+    const double score = levelScore(level);
+    if (score >= best_score) {
+      best = level;
+      best_score = score;
+    }
+  }
+  if (best < 0) {
+    return false;
+  }
+
+  const std::vector<std::vector<std::shared_ptr<SortedRun> > >& levels =
+      version_->levels;
+  compaction.level = best;
+  compaction.inputs.clear();
+  compaction.overlapping.clear();
+  if (best == 0) {
+    compaction.inputs = levels[0];
+  } else {
+    // The first run after where the last compaction of the level stopped.
+    const std::vector<std::shared_ptr<SortedRun> >& runs = levels[best];
+    std::size_t i = 0;
+    while (i < runs.size() &&
+           !(compact_pointers_[best] < runs[i]->smallest())) {
+      ++i;
+    }
+    if (i == runs.size()) {
+      i = 0;
+    }
+    compaction.inputs.push_back(runs[i]);
+    compact_pointers_[best] = runs[i]->largest();
+  }
+  std::string smallest = compaction.inputs.front()->smallest();
+  std::string largest = compaction.inputs.front()->largest();
+  for (std::size_t i = 1; i < compaction.inputs.size(); ++i) {
+    smallest = std::min(smallest, compaction.inputs[i]->smallest());
+    largest = std::max(largest, compaction.inputs[i]->largest());
+  }
+  for (std::size_t i = 0; i < levels[best + 1].size(); ++i) {
+    if (levels[best + 1][i]->overlaps(smallest, largest)) {
+      compaction.overlapping.push_back(levels[best + 1][i]);
+    }
+  }
+  // A deletion can go once no deeper level may hold an older value.
+  compaction.drop_deletions = true;
+  for (int level = best + 2; level < NUM_LEVELS; ++level) {
+    for (std::size_t i = 0; i < levels[level].size(); ++i) {
+      if (levels[level][i]->overlaps(smallest, largest)) {
+        compaction.drop_deletions = false;
+      }
+    }
+  }
+  busy_levels_[best] = true;
+  busy_levels_[best + 1] = true;
+  return true;
+}
+
+void LsmTree::compact(std::unique_lock<std::mutex>& lock,
+                      const Compaction& compaction) {
+  std::vector<std::shared_ptr<SortedRun> > outputs;
+  std::uint64_t bytes = 0;
+  const bool move =
+      compaction.inputs.size() == 1 && compaction.overlapping.empty();
+  if (move) {
+    // Nothing to merge with: the run moves down as it is.
+    outputs = compaction.inputs;
+  } else {
+    lock.unlock();
+    // Each input run is newer than the next, and all of them than the runs
+    // of the level below.
+    std::vector<std::unique_ptr<EntrySource> > sources;
+    for (std::size_t i = 0; i < compaction.inputs.size(); ++i) {
+      sources.emplace_back(new LevelSource(
+          std::vector<std::shared_ptr<SortedRun> >(1, compaction.inputs[i]),
+          std::string()));
+    }
+    sources.emplace_back(
+        new LevelSource(compaction.overlapping, std::string()));
+    SortedRunWriter writer(options_.bloom_bits_per_key);
+    for (MergeCursor merge(sources); merge.valid(); merge.next()) {
+      const RunEntry& entry = merge.entry();
+      if (entry.type == ENTRY_DELETION && compaction.drop_deletions) {
+        continue;
+      }
+      if (writer.bytes() >= options_.run_bytes) {
+        finishRun(writer, outputs);
+      }
+      writer.add(entry.key, entry.type, entry.value);
+    }
+    if (!writer.empty()) {
+      finishRun(writer, outputs);
+    }
+    for (std::size_t i = 0; i < outputs.size(); ++i) {
+      bytes += outputs[i]->bytes();
+    }
+    lock.lock();
+  }
+
+  std::shared_ptr<Version> version(new Version(*version_));
+  std::vector<std::shared_ptr<SortedRun> >& next_level =
+      version->levels[compaction.level + 1];
+  removeRuns(version->levels[compaction.level], compaction.inputs);
+  removeRuns(next_level, compaction.overlapping);
+  next_level.insert(next_level.end(), outputs.begin(), outputs.end());
+  std::sort(next_level.begin(), next_level.end(), smallerRun);
+  version_ = version;
+  if (!move) {
+    for (std::size_t i = 0; i < compaction.inputs.size(); ++i) {
+      compaction.inputs[i]->markObsolete();
+    }
+    for (std::size_t i = 0; i < compaction.overlapping.size(); ++i) {
+      compaction.overlapping[i]->markObsolete();
+    }
+  }
+  busy_levels_[compaction.level] = false;
+  busy_levels_[compaction.level + 1] = false;
+  ++stats_.compactions;
+  stats_.bytes_compacted += bytes;
+  writeManifest();
+  done_.notify_all();
+  work_.notify_all();
+}
+
+void LsmTree::finishRun(SortedRunWriter& writer,
+                        std::vector<std::shared_ptr<SortedRun> >& outputs) {
+  std::uint64_t number;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    number = takeFileNumber();
+  }
+  outputs.push_back(writer.finish(runName(name_, number), number));
+}
+
+}
@@ -0,0 +1,513 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include "file.h"
+#include "page.h"
+#include "sorted_run.h"
+#include "status.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Settings of an LsmTree.
+ */
+struct LsmOptions {
+  /**
+   * Size of the memtable, in bytes of keys and values, at which it is
+   * flushed to a run.
+   */
+  std::size_t memtable_bytes;
+
+  /**
+   * Size at which compaction starts a new run of the output level.
+   */
+  std::size_t run_bytes;
+
+  /**
+   * Number of runs in level 0 that makes it due for compaction.  Writes
+   * wait while it has three times as many.
+   */
+  std::size_t level0_runs;
+
+  /**
+   * Size of level 1 that makes it due for compaction; each level below may
+   * hold <level_ratio> times as much as the one above.
+   */
+  std::size_t level1_bytes;
+
+  /**
+   * Growth in size from one level to the next.
+   */
+  std::size_t level_ratio;
+
+  /**
+   * Bits per key of the BloomFilter of each run.
+   */
+  std::size_t bloom_bits_per_key;
+
+  /**
+   * Number of background threads that flush memtables and compact levels.
+   */
+  int background_threads;
+
+  /**
+   * Whether every write syncs the log before it returns.  Otherwise a crash
+   * may lose the last writes, though the tree stays consistent.
+   */
+  bool sync_log;
+
+  LsmOptions()
+      : memtable_bytes(4 << 20),
+        run_bytes(2 << 20),
+        level0_runs(4),
+        level1_bytes(8 << 20),
+        level_ratio(10),
+        bloom_bits_per_key(10),
+        background_threads(2),
+        sync_log(false) {}
+};
+
+/**
+ * @brief Counters of an LsmTree.
+ */
+struct LsmStats {
+  /**
+   * Writes: puts and removes.
+   */
+  std::uint64_t writes;
+
+  /**
+   * Lookups, and those answered by a memtable.
+   */
+  std::uint64_t gets;
+  std::uint64_t memtable_hits;
+
+  /**
+   * Runs a lookup read a data page of, and runs it skipped because their
+   * filter ruled the key out.
+   */
+  std::uint64_t run_reads;
+  std::uint64_t filter_skips;
+
+  /**
+   * Memtables flushed to runs, and their size in bytes.
+   */
+  std::uint64_t flushes;
+  std::uint64_t bytes_flushed;
+
+  /**
+   * Compactions, and the size of the runs they wrote in bytes.
+   */
+  std::uint64_t compactions;
+  std::uint64_t bytes_compacted;
+
+  /**
+   * Writes that waited for a flush or a compaction.
+   */
+  std::uint64_t write_stalls;
+
+  /**
+   * Number of runs and their size in bytes, by level.
+   */
+  std::vector<std::size_t> level_runs;
+  std::vector<std::uint64_t> level_bytes;
+
+  LsmStats()
+      : writes(0),
+        gets(0),
+        memtable_hits(0),
+        run_reads(0),
+        filter_skips(0),
+        flushes(0),
+        bytes_flushed(0),
+        compactions(0),
+        bytes_compacted(0),
+        write_stalls(0) {}
+};
+
+/**
+ * @brief Log-structured merge tree of byte-string keys and values stored in
+ *        BadgerDB files.
+ *
+ * Writes go to a log file and to an in-memory memtable ordered by key.  A
+ * full memtable is frozen and a background thread flushes it to a sorted run
+ * (see SortedRun) in level 0, written with one sequential write, after which
+ * its log is removed.  Runs in level 0 may overlap; each level below holds
+ * runs with disjoint key ranges, up to LsmOptions::level_ratio times as many
+ * bytes as the level above.  A level over its size is compacted by merging
+ * runs of it into the overlapping runs of the next level, keeping the newest
+ * entry of each key and dropping deletions once no level below could hold
+ * the key.  Several background threads run flushes and compactions of
+ * levels that do not overlap at the same time.
+ *
+ * A lookup checks the memtables, then the runs from the newest, skipping
+ * runs whose key range or BloomFilter rules the key out, and reads at most
+ * one data page of each run it checks.  Scans and compactions merge the
+ * memtables and runs in key order, keeping the newest entry of each key.
+ *
+ * The runs of each level are listed in a manifest file, rewritten when they
+ * change along with the number of the oldest log still needed.  Opening a
+ * tree reads the manifest, replays the logs into a run and starts a new log.
+ * Files are named <name>.manifest, <name>.<number>.run and
+ * <name>.<number>.log, so a name starting with File::MEMORY_PREFIX keeps
+ * the tree in memory.
+ *
+ * All methods may be called from several threads.
+ */
+class LsmTree {
+ public:
+  /**
+   * Number of levels.
+   */
+  static const int NUM_LEVELS = 7;
+
+  /**
+   * Called by scan() with each key and its value; returns false to end the
+   * scan.
+   */
+  typedef std::function<bool(const std::string& key,
+                             const std::string& value)> ScanVisitor;
+
+  /**
+   * Opens the tree of the given name, creating it if there is none.
+   *
+   * @param name      Name the tree's files start with.
+   * @param options   Settings of the tree.
+   */
+  explicit LsmTree(const std::string& name,
+                   const LsmOptions& options = LsmOptions());
+
+  /**
+   * Stops the background threads, waiting for the flush or compactions
+   * under way.  A memtable not flushed yet stays in its log, and is replayed
+   * when the tree is opened again.
+   */
+  ~LsmTree();
+
+  /**
+   * Sets the value of <key>.
+   *
+   * @param key     Key.
+   * @param value   Value.
+   * @throws  InsufficientSpaceException  If key and value together are
+   *                                      longer than
+   *                                      SortedRun::MAX_ENTRY_SIZE.
+   */
+  void put(const std::string& key, const std::string& value);
+
+  /**
+   * Removes <key>, if it has a value.
+   *
+   * @param key   Key.
+   */
+  void remove(const std::string& key);
+
+  /**
+   * Looks up the value of <key>.
+   *
+   * @param key     Key.
+   * @param value   Set to the value, if the key has one.
+   * @return  STATUS_OK, or STATUS_NOT_FOUND if the key has no value.
+   */
+  Status get(const std::string& key, std::string& value);
+
+  /**
+   * Visits the keys in [<start>, <end>) that have a value, in key order.
+   * The scan sees the tree as it was when it started, whatever is written
+   * meanwhile: it copies that part of the memtable and keeps the runs of the
+   * time open.
+   *
+   * @param start   Smallest key to visit.
+   * @param end     Key to stop before; empty to go to the last key.
+   * @param visit   Called with each key and value, until it returns false.
+   * @return  Number of keys visited.
+   */
+  std::size_t scan(const std::string& start, const std::string& end,
+                   const ScanVisitor& visit);
+
+  /**
+   * Flushes the memtable to a run and waits until it is written.
+   */
+  void flush();
+
+  /**
+   * Waits until no level is due for compaction and no flush or compaction
+   * is under way.
+   */
+  void waitForCompactions();
+
+  /**
+   * Returns the counters of the tree.
+   *
+   * @return  Counters.
+   */
+  LsmStats stats();
+
+  /**
+   * Removes every file of the tree of the given name, which must not be
+   * open.
+   *
+   * @param name  Name the tree's files start with.
+   */
+  static void destroy(const std::string& name);
+
+ private:
+  /**
+   * Entry of a memtable: its kind and value.
+   */
+  typedef std::pair<EntryType, std::string> MemEntry;
+
+  /**
+   * Entries not in a run yet, newest of each key, and the log they are in.
+   */
+  struct Memtable {
+    std::map<std::string, MemEntry> entries;
+    std::size_t bytes;
+    std::uint64_t log_number;
+
+    Memtable() : bytes(0), log_number(0) {}
+  };
+
+  /**
+   * Runs of every level: level 0 newest first, other levels in key order.
+   * A version is never changed once installed, so readers can use it
+   * without the lock.
+   */
+  struct Version {
+    std::vector<std::vector<std::shared_ptr<SortedRun> > > levels;
+
+    Version() : levels(NUM_LEVELS) {}
+  };
+
+  /**
+   * Runs picked to be merged into <level> + 1: <inputs> from <level> and
+   * <overlapping> from the level below.
+   */
+  struct Compaction {
+    int level;
+    std::vector<std::shared_ptr<SortedRun> > inputs;
+    std::vector<std::shared_ptr<SortedRun> > overlapping;
+    bool drop_deletions;
+  };
+
+  /**
+   * Returns the names of the tree's files.
+   */
+  static std::string manifestName(const std::string& name);
+  static std::string runName(const std::string& name,
+                             const std::uint64_t number);
+  static std::string logName(const std::string& name,
+                             const std::uint64_t number);
+
+  /**
+   * Reads the manifest into <version>; returns the next file number and
+   * sets <log_number> to the oldest log needed.
+   */
+  std::uint64_t readManifest(Version& version, std::uint64_t& log_number);
+
+  /**
+   * Writes the manifest of the installed version, with the log of the
+   * oldest memtable as the oldest log needed.  The lock must be held.
+   */
+  void writeManifest();
+
+  /**
+   * Adds the entries of log <number> to <memtable>.
+   */
+  void replayLog(const std::uint64_t number, Memtable& memtable);
+
+  /**
+   * Returns the number of a new run or log, first recording a batch of
+   * numbers in the manifest if it has none left.  The lock must be held.
+   */
+  std::uint64_t takeFileNumber();
+
+  /**
+   * Starts a new log and memtable.  The lock must be held.
+   */
+  void newLog();
+
+  /**
+   * Writes an entry to the log and the memtable, first making room for it.
+   */
+  void write(const std::string& key, const EntryType type,
+             const std::string& value);
+
+  /**
+   * Freezes a full memtable for a background thread to flush, waiting while
+   * the one frozen before is still being flushed or level 0 is too full.
+   */
+  void makeRoomForWrite(std::unique_lock<std::mutex>& lock);
+
+  /**
+   * Body of the background threads.
+   */
+  void backgroundThread();
+
+  /**
+   * Writes <memtable> to a new run in level 0 and installs it.  Called
+   * with the lock held, which is released while the run is written.
+   */
+  void flushMemtable(std::unique_lock<std::mutex>& lock,
+                     const std::shared_ptr<Memtable>& memtable);
+
+  /**
+   * Returns how far over its size <level> is: 1 or more if it is due for
+   * compaction.  The lock must be held.
+   */
+  double levelScore(const int level) const;
+
+  /**
+   * Picks the runs of the level most due for compaction that no other
+   * compaction is using, and marks its levels busy.  Returns false if there
+   * are none.  The lock must be held.
+   */
+  bool pickCompaction(Compaction& compaction);
+
+  /**
+   * Merges the runs of <compaction> into new runs of the level below, and
+   * installs them.  Called with the lock held, which is released while the
+   * runs are merged.
+   */
+  void compact(std::unique_lock<std::mutex>& lock,
+               const Compaction& compaction);
+
+  /**
+   * Writes the entries of <writer> to a new run and adds it to <outputs>.
+   * The lock must not be held.
+   */
+  void finishRun(SortedRunWriter& writer,
+                 std::vector<std::shared_ptr<SortedRun> >& outputs);
+
+  /**
+   * Looks <key> up in the runs of <version>.
+   */
+  bool findInRuns(const Version& version, const std::string& key,
+                  RunEntry& entry);
+
+  /**
+   * Name the tree's files start with.
+   */
+  const std::string name_;
+
+  /**
+   * Settings of the tree.
+   */
+  const LsmOptions options_;
+
+  /**
+   * Guards everything below except the counters.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Signalled when a memtable is frozen or a level may be due for
+   * compaction, for the background threads.
+   */
+  std::condition_variable work_;
+
+  /**
+   * Signalled when a flush or compaction finishes, for writers waiting for
+   * room and for flush() and waitForCompactions().
+   */
+  std::condition_variable done_;
+
+  /**
+   * Memtable taking writes, and the one frozen before it that is being
+   * flushed (NULL if none).
+   */
+  std::shared_ptr<Memtable> memtable_;
+  std::shared_ptr<Memtable> frozen_;
+
+  /**
+   * Whether a background thread is flushing <frozen_>.
+   */
+  bool flushing_;
+
+  /**
+   * Runs of the tree.
+   */
+  std::shared_ptr<const Version> version_;
+
+  /**
+   * Whether a compaction is reading or writing each level.
+   */
+  std::vector<bool> busy_levels_;
+
+  /**
+   * Key after which the next compaction of each level starts, so the runs
+   * of a level take turns.
+   */
+  std::vector<std::string> compact_pointers_;
+
+  /**
+   * Number given to the next run or log.
+   */
+  std::atomic<std::uint64_t> next_file_number_;
+
+  /**
+   * Next file number in the manifest, always past <next_file_number_>;
+   * numbers from here on are not handed out until the manifest records
+   * them.  Guarded by the lock.
+   */
+  std::uint64_t file_number_limit_;
+
+  /**
+   * Log of <memtable_>, the page being filled and whether that page is in
+   * the file yet.
+   */
+  std::unique_ptr<File> log_;
+  Page log_page_;
+  bool log_page_written_;
+
+  /**
+   * Manifest file, and its pages as last written.
+   */
+  std::unique_ptr<File> manifest_;
+  std::vector<Page> manifest_pages_;
+
+  /**
+   * First failure of a background thread, thrown to the next writer.
+   */
+  std::exception_ptr background_error_;
+
+  /**
+   * Set to stop the background threads.
+   */
+  bool stopping_;
+
+  /**
+   * Counters; those of lookups are updated without the lock.
+   */
+  LsmStats stats_;
+  std::atomic<std::uint64_t> gets_;
+  std::atomic<std::uint64_t> memtable_hits_;
+  std::atomic<std::uint64_t> run_reads_;
+  std::atomic<std::uint64_t> filter_skips_;
+
+  /**
+   * Background threads.
+   */
+  std::vector<std::thread> threads_;
+};
+
+}
@@ -1,17 +1,37 @@
 #include <iostream>
 #include <stdlib.h>
 //#include <stdio.h>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <memory>
+#include <sstream>
+#include <thread>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "page.h"
 #include "buffer.h"
+#include "epoch_manager.h"
+#include "fault_injecting_backend.h"
+#include "event_loop.h"
 #include "file_iterator.h"
+#include "io_scheduler.h"
+#include "kv_store.h"
+#include "lsm_tree.h"
+#include "metrics_exporter.h"
 #include "page_iterator.h"
+#include "exceptions/file_exists_exception.h"
+#include "exceptions/file_format_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
+#include "exceptions/slot_in_use_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/io_fault_exception.h"
 
 #define PRINT_ERROR(str) \
 { \
@@ -28,7 +48,56 @@ RecordId rid[2*num], rid2, rid3, rid4[num];
 Page *page, *page2, *page3;
 char tmpbuf[100];
 BufMgr* bufMgr;
-File *file1ptr, *file2ptr, *file3ptr, *file4ptr, *file5ptr, *file7ptr,*file8ptr,*file9ptr,*file10ptr,*file11ptr,*file12ptr;
+std::string filePrefix;
+File *file1ptr, *file2ptr, *file3ptr, *file4ptr, *file5ptr, *file7ptr,*file8ptr,*file9ptr,*file10ptr,*file11ptr,*file12ptr,*file13ptr;
+
+//Memory backend whose next write, once armed, waits until released and then fails, so that a test can act
+//while a write is being issued
+class GatedBackend : public MemoryBackend
+{
+public:
+	GatedBackend() : armed(false), entered(false), released(false) {}
+
+	void arm()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		armed = true;
+	}
+
+	void waitEntered()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&] { return entered; });
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		released = true;
+		cv.notify_all();
+	}
+
+	virtual void write(const std::uint64_t offset, const char* buffer, const std::size_t length)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (armed) {
+			armed = false;
+			entered = true;
+			cv.notify_all();
+			cv.wait(lock, [&] { return released; });
+			throw IoFaultException("write", "gated");
+		}
+		lock.unlock();
+		MemoryBackend::write(offset, buffer, length);
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool armed;
+	bool entered;
+	bool released;
+};
 
 
 void test1();
@@ -45,12 +114,40 @@ void test9();
 void test10();
 void test11();
 void test12();
-
-int main()
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
+void test33();
+void test34();
+void test35();
+
+int main(int argc, char* argv[])
 {
+	//An optional argument is prepended to all file names; pass File::MEMORY_PREFIX ("mem:")
+	//to run everything against in-memory files
+	if (argc > 1)
+		filePrefix = argv[1];
+
 	//Following code shows how to you File and Page classes
 
-  const std::string& filename = "test.db";
+  const std::string filename = filePrefix + "test.db";
   // Clean up from any previous runs that crashed.
   try
 	{
@@ -82,12 +179,14 @@ int main()
     for (FileIterator iter = new_file.begin();
          iter != new_file.end();
          ++iter) {
-      // Iterate through all records on the page.
-      for (PageIterator page_iter = (*iter).begin();
-           page_iter != (*iter).end();
+      // Iterate through all records on the page.  The iterator refers to the
+      // page it walks, so keep the page alive for the whole loop.
+      Page curr_page = *iter;
+      for (PageIterator page_iter = curr_page.begin();
+           page_iter != curr_page.end();
            ++page_iter) {
         std::cout << "Found record: " << *page_iter
-            << " on page " << (*iter).page_number() << "\n";
+            << " on page " << curr_page.page_number() << "\n";
       }
     }
 
@@ -115,18 +214,19 @@ void testBufMgr()
 	bufMgr = new BufMgr(num);
 
 	// create dummy files
-	const std::string& filename1 = "test.1";
-	const std::string& filename2 = "test.2";
-	const std::string& filename3 = "test.3";
-	const std::string& filename4 = "test.4";
-	const std::string& filename5 = "test.5";
-
-	const std::string& filename7 = "test.7";
-	const std::string& filename8 = "test.8";
-	const std::string& filename9 = "test.9";
-	const std::string& filename10 = "test.10";
-	const std::string& filename11 = "test.11";
-	const std::string& filename12 = "test.12";
+	const std::string filename1 = filePrefix + "test.1";
+	const std::string filename2 = filePrefix + "test.2";
+	const std::string filename3 = filePrefix + "test.3";
+	const std::string filename4 = filePrefix + "test.4";
+	const std::string filename5 = filePrefix + "test.5";
+
+	const std::string filename7 = filePrefix + "test.7";
+	const std::string filename8 = filePrefix + "test.8";
+	const std::string filename9 = filePrefix + "test.9";
+	const std::string filename10 = filePrefix + "test.10";
+	const std::string filename11 = filePrefix + "test.11";
+	const std::string filename12 = filePrefix + "test.12";
+	const std::string filename13 = filePrefix + "test.13";
 
   try
 	{
@@ -142,6 +242,7 @@ void testBufMgr()
 		File::remove(filename10);
 		File::remove(filename11);
 		File::remove(filename12);
+		File::remove(filename13);
 
 	}
 	catch(FileNotFoundException e)
@@ -160,6 +261,7 @@ void testBufMgr()
 	File file10 = File::create(filename10);
 	File file11 = File::create(filename11);
 	File file12 = File::create(filename12);
+	File file13 = File::create(filename13);
 
 	file1ptr = &file1;
 	file2ptr = &file2;
@@ -173,6 +275,7 @@ void testBufMgr()
 	file10ptr = &file10;
 	file11ptr = &file11;
 	file12ptr = &file12;
+	file13ptr = &file13;
 
 	//Test buffer manager
 	//Comment tests which you do not wish to run now. Tests are dependent on their preceding tests. So, they have to be run in the following order. 
@@ -190,6 +293,29 @@ void testBufMgr()
 	test10();
 	test11();
 	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
+	test29();
+	test30();
+	test31();
+	test32();
+	test33();
+	test34();
+	test35();
 
 	//Close files before deleting them
 	file1.~File();
@@ -204,6 +330,7 @@ void testBufMgr()
 	file10.~File();
 	file11.~File();
 	file12.~File();
+	file13.~File();
 
 	//Delete files
 	File::remove(filename1);
@@ -218,6 +345,7 @@ void testBufMgr()
 	File::remove(filename10);
 	File::remove(filename11);
 	File::remove(filename12);
+	File::remove(filename13);
 
 	delete bufMgr;
 
@@ -532,3 +660,1797 @@ void test12()
 	std::cout << "Test 12 passed" << "\n";
 }
 
+void test13()
+{
+	//Small buffer pool backed by a compressed tier large enough for every page
+	BufMgr* tieredMgr = new BufMgr(num/10, num*Page::SIZE);
+
+	for (i = 0; i < num; i++) {
+		tieredMgr->allocPage(file13ptr, pid[i], page);
+		sprintf((char*)tmpbuf, "test.13 Page %d %7.1f", pid[i], (float)pid[i]);
+		rid[i] = page->insertRecord(tmpbuf);
+		tieredMgr->unPinPage(file13ptr, pid[i], true);
+	}
+
+	tieredMgr->clearBufStats();
+	for (i = 0; i < num; i++)
+	{
+		tieredMgr->readPage(file13ptr, pid[i], page);
+		sprintf((char*)tmpbuf, "test.13 Page %d %7.1f", pid[i], (float)pid[i]);
+		if(strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		tieredMgr->unPinPage(file13ptr, pid[i], false);
+	}
+
+	//Evicted pages must have come back from the compressed tier, not from disk
+	if(tieredMgr->getBufStats().diskreads != 0 || tieredMgr->getCompressedCache()->getStats().hits == 0)
+	{
+		PRINT_ERROR("ERROR :: PAGES WERE NOT SERVED FROM THE COMPRESSED TIER");
+	}
+
+	tieredMgr->flushFile(file13ptr);
+	if(tieredMgr->getCompressedCache()->size() != 0)
+	{
+		PRINT_ERROR("ERROR :: COMPRESSED TIER STILL HOLDS PAGES OF A FLUSHED FILE");
+	}
+	delete tieredMgr;
+
+	std::cout << "Test 13 passed" << "\n";
+}
+
+void test14()
+{
+	//Flushing a file whose storage crashes while syncing. The dirty pages must stay
+	//in the buffer pool so that the flush can be retried once the storage is back.
+	std::shared_ptr<FaultInjectingBackend> disk(new FaultInjectingBackend(std::make_shared<MemoryBackend>()));
+	disk->setDelayedWrites(true);
+	File file14 = File::create("test.14", disk);
+
+	for (i = 0; i < num; i++) {
+		bufMgr->allocPage(&file14, pid[i], page);
+		sprintf((char*)tmpbuf, "test.14 Page %d %7.1f", pid[i], (float)pid[i]);
+		rid[i] = page->insertRecord(tmpbuf);
+		bufMgr->unPinPage(&file14, pid[i], true);
+	}
+	//Make what reached the file so far durable; the records only live in the buffer pool
+	file14.sync();
+
+	disk->injectFault(FaultInjectingBackend::CRASH, 0, FaultInjectingBackend::SYNC_OP);
+	try
+	{
+		bufMgr->flushFile(&file14);
+		PRINT_ERROR("ERROR :: Storage crashed during the flush. Exception should have been thrown before execution reaches this point.");
+	}
+	catch(const IoFaultException&)
+	{
+	}
+
+	disk->recover();
+	bufMgr->flushFile(&file14);
+
+	//A crash now must not lose anything that was flushed
+	disk->crash();
+	disk->recover();
+	for (i = 0; i < num; i++)
+	{
+		Page flushed = file14.readPage(pid[i]);
+		sprintf((char*)tmpbuf, "test.14 Page %d %7.1f", pid[i], (float)pid[i]);
+		if(strncmp(flushed.getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+
+	//The same holds for a checkpoint whose write through the scheduler fails
+	{
+		IoScheduler scheduler;
+		BufMgr* schedMgr = new BufMgr(num/10, 0, &scheduler);
+		PageId failedPid;
+		schedMgr->allocPage(&file14, failedPid, page);
+		sprintf((char*)tmpbuf, "test.14 Page %d", failedPid);
+		const RecordId failedRid = page->insertRecord(tmpbuf);
+		schedMgr->unPinPage(&file14, failedPid, true);
+
+		disk->injectFault(FaultInjectingBackend::IO_ERROR, 0, FaultInjectingBackend::WRITE_OP);
+		try
+		{
+			schedMgr->checkpoint();
+			PRINT_ERROR("ERROR :: Write failed during the checkpoint. Exception should have been thrown before execution reaches this point.");
+		}
+		catch(const IoFaultException&)
+		{
+		}
+		if(schedMgr->snapshot(0).dirty != 1)
+		{
+			PRINT_ERROR("ERROR :: PAGE WAS CLEAN AFTER ITS CHECKPOINT WRITE FAILED");
+		}
+		if(schedMgr->checkpoint() != 1 || file14.readPage(failedPid).getRecord(failedRid) != tmpbuf)
+		{
+			PRINT_ERROR("ERROR :: CHECKPOINT DID NOT RETRY THE FAILED WRITE");
+		}
+		delete schedMgr;
+	}
+
+	//A write that fails after a newer write of its page was queued hands its sectors on to the newer one,
+	//which otherwise only writes the sectors changed since
+	{
+		std::shared_ptr<GatedBackend> gated = std::make_shared<GatedBackend>();
+		File gatedFile = File::create("test.14.gated", gated);
+		Page blank = gatedFile.allocatePage();
+		gatedFile.writePage(blank);
+		IoScheduler scheduler;
+		Page older = gatedFile.readPage(blank.page_number());
+		const std::string big(6000, 'x');
+		const RecordId bigRid = older.insertRecord(big);
+		gated->arm();
+		scheduler.submitWrite(IO_BACKGROUND, &gatedFile, older);
+		gated->waitEntered();
+		Page newer = older;
+		newer.clear_dirty_sectors();
+		const RecordId smallRid = newer.insertRecord("small");
+		scheduler.submitWrite(IO_BACKGROUND, &gatedFile, newer);
+		gated->release();
+		scheduler.drain(&gatedFile);
+		Page written = gatedFile.readPage(blank.page_number());
+		if(written.getRecord(bigRid) != big || written.getRecord(smallRid) != "small")
+		{
+			PRINT_ERROR("ERROR :: SECTORS OF A FAILED WRITE WERE LOST");
+		}
+	}
+
+	std::cout << "Test 14 passed" << "\n";
+}
+
+void test15()
+{
+	//The counters behind snapshot() must follow pins, dirty pages, evictions and flushes
+	BufMgr* snapMgr = new BufMgr(num/2);
+	const PageId held = num/10;
+
+	for (i = 1; i <= held; i++)
+	{
+		snapMgr->readPage(file1ptr, i, page);
+		snapMgr->readPage(file2ptr, i, page2);
+		snapMgr->unPinPage(file2ptr, i, true);
+	}
+
+	BufPoolSnapshot snap = snapMgr->snapshot();
+	std::uint64_t aged = 0;
+	for (int b = 0; b < BufPoolSnapshot::AGE_BUCKETS; b++)
+		aged += snap.ageHistogram[b];
+	if(snap.frames != num/2 || snap.valid != 2*held || snap.pinned != held || snap.dirty != held ||
+		 snap.accesses != 2*held || snap.evictions != 0 || snap.sampledFrames != num/2 || aged != 2*held)
+	{
+		PRINT_ERROR("ERROR :: SNAPSHOT COUNTS DO NOT MATCH THE BUFFER POOL");
+	}
+	if(snap.files.size() != 2 || snap.files[0].pages != held || snap.files[1].pages != held)
+	{
+		PRINT_ERROR("ERROR :: SNAPSHOT RESIDENCY DOES NOT MATCH THE BUFFER POOL");
+	}
+	//The page read last has age 0 and the first one read is the oldest
+	if(snap.ageHistogram[0] != 1 || snap.ageHistogram[5] == 0)
+	{
+		PRINT_ERROR("ERROR :: SNAPSHOT AGES DO NOT MATCH THE ACCESS ORDER");
+	}
+
+	//Reading more pages than there are free frames evicts the unpinned ones
+	for (i = 1; i <= held; i++)
+		snapMgr->unPinPage(file1ptr, i, false);
+	for (i = held + 1; i <= held + num/2; i++)
+	{
+		snapMgr->readPage(file1ptr, i, page);
+		snapMgr->unPinPage(file1ptr, i, false);
+	}
+	snap = snapMgr->snapshot();
+	if(snap.valid != num/2 || snap.pinned != 0 || snap.evictions == 0 || snap.clockAdvances < snap.evictions)
+	{
+		PRINT_ERROR("ERROR :: SNAPSHOT DID NOT SEE EVICTIONS");
+	}
+
+	//The text form must read back the same
+	std::stringstream text;
+	snap.write(text);
+	BufPoolSnapshot copy;
+	if(!copy.read(text) || copy.valid != snap.valid || copy.evictions != snap.evictions ||
+		 copy.files.size() != snap.files.size() || copy.files[0].filename != snap.files[0].filename ||
+		 copy.ageHistogram != snap.ageHistogram)
+	{
+		PRINT_ERROR("ERROR :: SNAPSHOT DID NOT SURVIVE ITS TEXT FORM");
+	}
+
+	snapMgr->flushFile(file1ptr);
+	snapMgr->flushFile(file2ptr);
+	snap = snapMgr->snapshot();
+	if(snap.valid != 0 || snap.dirty != 0 || !snap.files.empty())
+	{
+		PRINT_ERROR("ERROR :: SNAPSHOT STILL COUNTS PAGES OF FLUSHED FILES");
+	}
+	delete snapMgr;
+
+	std::cout << "Test 15 passed" << "\n";
+}
+
+void test16()
+{
+	//A buffer pool doing its I/O through a scheduler writes evicted dirty pages in the background.
+	//Reading them back must return the newest data whether or not the write has reached the file yet.
+	IoScheduler scheduler;
+	File file16 = File::create("test.16", std::make_shared<MemoryBackend>());
+	BufMgr* schedMgr = new BufMgr(num/10, 0, &scheduler);
+
+	for (i = 0; i < num; i++) {
+		schedMgr->allocPage(&file16, pid[i], page);
+		sprintf((char*)tmpbuf, "test.16 Page %d %7.1f", pid[i], (float)pid[i]);
+		rid[i] = page->insertRecord(tmpbuf);
+		schedMgr->unPinPage(&file16, pid[i], true);
+	}
+	for (i = 0; i < num; i++)
+	{
+		schedMgr->readPage(&file16, pid[i], page);
+		sprintf((char*)tmpbuf, "test.16 Page %d %7.1f", pid[i], (float)pid[i]);
+		if(strncmp(page->getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		schedMgr->unPinPage(&file16, pid[i], true);
+	}
+
+	std::uint32_t dirty = schedMgr->snapshot(0).dirty;
+	if(dirty == 0 || schedMgr->checkpoint() != dirty || schedMgr->snapshot(0).dirty != 0)
+	{
+		PRINT_ERROR("ERROR :: CHECKPOINT DID NOT WRITE THE DIRTY PAGES");
+	}
+
+	schedMgr->flushFile(&file16);
+	for (i = 0; i < num; i++)
+	{
+		Page flushed = file16.readPage(pid[i]);
+		sprintf((char*)tmpbuf, "test.16 Page %d %7.1f", pid[i], (float)pid[i]);
+		if(strncmp(flushed.getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+	}
+	delete schedMgr;
+
+	//Writes queued while the device is busy are merged into runs of adjacent pages, and a read of
+	//a page with a queued write is answered from it
+	IoClassStats writesBefore = scheduler.getStats(IO_BACKGROUND);
+	IoClassStats readsBefore = scheduler.getStats(IO_FOREGROUND);
+	Page forwarded;
+	scheduler.exclusive([&] {
+		for (i = 0; i < num; i++)
+			scheduler.submitWrite(IO_BACKGROUND, &file16, file16.readPage(pid[i]));
+		scheduler.read(IO_FOREGROUND, &file16, pid[0], forwarded);
+	});
+	scheduler.drain(&file16);
+	IoClassStats writes = scheduler.getStats(IO_BACKGROUND);
+	IoClassStats reads = scheduler.getStats(IO_FOREGROUND);
+	if(writes.pages - writesBefore.pages != num || writes.failures != 0 ||
+		 writes.batches - writesBefore.batches > num/IoScheduler::MAX_MERGE_PAGES + 2)
+	{
+		PRINT_ERROR("ERROR :: QUEUED WRITES WERE NOT MERGED");
+	}
+	if(reads.folded - readsBefore.folded != 1 || reads.pages != readsBefore.pages)
+	{
+		PRINT_ERROR("ERROR :: READ WAS NOT ANSWERED FROM THE QUEUED WRITE");
+	}
+
+	//A checkpoint waiting for its writes is not held up by pages deleted before they were written
+	File disposed16 = File::create("test.16.disposed", std::make_shared<MemoryBackend>());
+	BufMgr* disposeMgr = new BufMgr(num/10, 0, &scheduler);
+	PageId disposedPid[2];
+	for (i = 0; i < 2; i++)
+	{
+		disposeMgr->allocPage(&disposed16, disposedPid[i], page);
+		disposeMgr->unPinPage(&disposed16, disposedPid[i], true);
+	}
+	//Spend the only token of the background class, so the checkpoint's writes stay queued
+	scheduler.setRateLimit(IO_BACKGROUND, 0.001, 1);
+	scheduler.submitWrite(IO_BACKGROUND, &file16, file16.readPage(pid[0]));
+	writesBefore = scheduler.getStats(IO_BACKGROUND);
+	std::uint32_t checkpointed = 0;
+	std::thread checkpointer([&] { checkpointed = disposeMgr->checkpoint(); });
+	while (scheduler.getStats(IO_BACKGROUND).requests - writesBefore.requests < 2)
+		std::this_thread::yield();
+	for (i = 0; i < 2; i++)
+		disposeMgr->disposePage(&disposed16, disposedPid[i]);
+	checkpointer.join();
+	scheduler.setRateLimit(IO_BACKGROUND, 0);
+	if(checkpointed != 2)
+	{
+		PRINT_ERROR("ERROR :: CHECKPOINT DID NOT COUNT THE DISCARDED WRITES");
+	}
+	delete disposeMgr;
+
+	std::cout << "Test 16 passed" << "\n";
+}
+
+void test17()
+{
+	//Asynchronous reads of pages that are not in the pool finish on the event loop; a second
+	//read of a page that is still loading waits for the first one instead of reading it again
+	IoScheduler scheduler;
+	File file17 = File::create("test.17", std::make_shared<MemoryBackend>());
+	for (i = 0; i < num; i++) {
+		Page written = file17.allocatePage();
+		pid[i] = written.page_number();
+		sprintf((char*)tmpbuf, "test.17 Page %d %7.1f", pid[i], (float)pid[i]);
+		rid[i] = written.insertRecord(tmpbuf);
+		file17.writePage(written);
+	}
+	BufMgr* asyncMgr = new BufMgr(num, 0, &scheduler);
+
+	EventLoop loop;
+	int completed = 0;
+	for (int round = 0; round < 2; round++)
+		for (i = 0; i < num; i++)
+		{
+			const PageId pageNo = pid[i];
+			const RecordId recordId = rid[i];
+			asyncMgr->readPageAsync(&file17, pageNo, loop, [&, pageNo, recordId](Page* page, std::exception_ptr error) {
+				char expected[100];
+				sprintf(expected, "test.17 Page %d %7.1f", pageNo, (float)pageNo);
+				if(error || strncmp(page->getRecord(recordId).c_str(), expected, strlen(expected)) != 0)
+				{
+					PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+				}
+				asyncMgr->unPinPage(&file17, pageNo, false);
+				if (++completed == 2*num)
+					loop.stop();
+			});
+		}
+	if(completed != 0)
+	{
+		PRINT_ERROR("ERROR :: READS OF PAGES NOT IN THE POOL COMPLETED BEFORE THE LOOP RAN");
+	}
+	loop.run();
+	if(asyncMgr->getBufStats().diskreads != (int)num)
+	{
+		PRINT_ERROR("ERROR :: PAGES WERE READ MORE THAN ONCE");
+	}
+
+	//A page in the pool is handed over right away, and a failed read reports its exception
+	EventLoop loop2;
+	bool hit = false;
+	asyncMgr->readPageAsync(&file17, pid[0], loop2, [&](Page* page, std::exception_ptr error) {
+		hit = page != NULL && !error;
+	});
+	if(!hit)
+	{
+		PRINT_ERROR("ERROR :: HIT DID NOT COMPLETE IMMEDIATELY");
+	}
+	asyncMgr->unPinPage(&file17, pid[0], false);
+
+	bool failed = false;
+	asyncMgr->readPageAsync(&file17, pid[num-1] + 1, loop2, [&](Page* page, std::exception_ptr error) {
+		try
+		{
+			std::rethrow_exception(error);
+		}
+		catch(const InvalidPageException&)
+		{
+			failed = page == NULL;
+		}
+		loop2.stop();
+	});
+	loop2.run();
+	if(!failed)
+	{
+		PRINT_ERROR("ERROR :: READ OF AN INVALID PAGE DID NOT FAIL");
+	}
+
+	asyncMgr->flushFile(&file17);
+	delete asyncMgr;
+
+	std::cout << "Test 17 passed" << "\n";
+}
+
+void test18()
+{
+	//A batch lookup pins the pages that are in the pool, the same frames readPage() returns,
+	//and leaves out the others
+	BufMgr* batchMgr = new BufMgr(num);
+	Page* resident[num];
+	for (i = 1; i <= num/2; i++)
+	{
+		batchMgr->readPage(file1ptr, i, resident[i-1]);
+		batchMgr->unPinPage(file1ptr, i, false);
+	}
+
+	File* files[num];
+	PageId pageNos[num];
+	Page* pages[num];
+	for (i = 0; i < num; i++)
+	{
+		files[i] = file1ptr;
+		pageNos[i] = i + 1;
+	}
+	if(batchMgr->pinResidentPages(num, files, pageNos, pages) != num/2)
+	{
+		PRINT_ERROR("ERROR :: BATCH LOOKUP DID NOT FIND THE RESIDENT PAGES");
+	}
+	for (i = 0; i < num; i++)
+	{
+		if((i < num/2 && pages[i] != resident[i]) || (i >= num/2 && pages[i] != NULL))
+		{
+			PRINT_ERROR("ERROR :: BATCH LOOKUP RETURNED THE WRONG FRAME");
+		}
+	}
+
+	//Every page found was pinned once
+	for (i = 0; i < num/2; i++)
+		batchMgr->unPinPage(file1ptr, pageNos[i], false);
+	if(batchMgr->snapshot(0).pinned != 0)
+	{
+		PRINT_ERROR("ERROR :: BATCH LOOKUP PINNED PAGES MORE THAN ONCE");
+	}
+	batchMgr->flushFile(file1ptr);
+	delete batchMgr;
+
+	std::cout << "Test 18 passed" << "\n";
+}
+
+void test19()
+{
+	//Readers of a page share its latch; a writer waits for them and keeps new readers out
+	BufMgr* latchMgr = new BufMgr(num);
+	latchMgr->readPage(file1ptr, 1, page, LATCH_SHARED);
+	latchMgr->readPage(file1ptr, 1, page2, LATCH_SHARED);
+	if(page != page2)
+	{
+		PRINT_ERROR("ERROR :: SAME PAGE READ INTO TWO FRAMES");
+	}
+
+	std::atomic<bool> written(false);
+	std::thread writer([&] {
+		Page* page3;
+		latchMgr->readPage(file1ptr, 1, page3, LATCH_EXCLUSIVE);
+		written = true;
+		latchMgr->unPinPage(file1ptr, 1, true, LATCH_EXCLUSIVE);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	if(written)
+	{
+		PRINT_ERROR("ERROR :: WRITER GOT A PAGE LATCHED BY READERS");
+	}
+
+	//Upgrading waits for the other reader, and only one reader can be upgrading at a time
+	std::atomic<bool> upgraded(false);
+	std::thread upgrader([&] {
+		upgraded = latchMgr->upgradeLatch(page2);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	if(upgraded || latchMgr->upgradeLatch(page))
+	{
+		PRINT_ERROR("ERROR :: LATCH UPGRADED WHILE ANOTHER READER HELD IT");
+	}
+	latchMgr->unPinPage(file1ptr, 1, false, LATCH_SHARED);
+	upgrader.join();
+	if(!upgraded)
+	{
+		PRINT_ERROR("ERROR :: LATCH WAS NOT UPGRADED ONCE THE OTHER READER LEFT");
+	}
+	latchMgr->unPinPage(file1ptr, 1, true, LATCH_EXCLUSIVE);
+	writer.join();
+	if(!written)
+	{
+		PRINT_ERROR("ERROR :: WRITER DID NOT GET THE PAGE ONCE IT WAS FREE");
+	}
+
+	latchMgr->flushFile(file1ptr);
+	delete latchMgr;
+
+	std::cout << "Test 19 passed" << "\n";
+}
+
+void test20()
+{
+	//Retired objects are reclaimed only once no reader that could see them is left
+	EpochManager epochs;
+	EpochManager::Participant participant(epochs);
+	bool reclaimed = false;
+	participant.enter();
+	epochs.retire([&] { reclaimed = true; });
+	epochs.reclaim();
+	if(reclaimed)
+	{
+		PRINT_ERROR("ERROR :: OBJECT RECLAIMED WHILE A READER COULD SEE IT");
+	}
+	participant.exit();
+	epochs.reclaim();
+	if(!reclaimed || epochs.pending() != 0)
+	{
+		PRINT_ERROR("ERROR :: OBJECT NOT RECLAIMED ONCE THE READER LEFT");
+	}
+
+	//Resident pages can be read without pinning them
+	BufMgr* epochMgr = new BufMgr(num, 0, NULL, &epochs);
+	epochMgr->readPage(file1ptr, 1, page);
+	epochMgr->unPinPage(file1ptr, 1, false);
+	PageId seen = Page::INVALID_NUMBER;
+	bool read;
+	{
+		EpochManager::Guard guard(participant);
+		read = epochMgr->readResident(file1ptr, 1, [&](const Page& resident) { seen = resident.page_number(); });
+	}
+	if(!read || seen != 1)
+	{
+		PRINT_ERROR("ERROR :: LOCK-FREE READ DID NOT FIND A RESIDENT PAGE");
+	}
+	{
+		EpochManager::Guard guard(participant);
+		read = epochMgr->readResident(file1ptr, 2, [&](const Page&) {});
+	}
+	if(read)
+	{
+		PRINT_ERROR("ERROR :: LOCK-FREE READ FOUND A PAGE THAT IS NOT IN THE POOL");
+	}
+
+	//Frames freed while a reader is inside an epoch are not reused before it leaves
+	participant.enter();
+	epochMgr->flushFile(file1ptr);
+	std::atomic<bool> filled(false);
+	std::thread filler([&] {
+		for (PageId pageNo = 1; pageNo <= (PageId) num; pageNo++)
+		{
+			Page* page3;
+			epochMgr->readPage(file1ptr, pageNo, page3);
+			epochMgr->unPinPage(file1ptr, pageNo, false);
+		}
+		filled = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	if(filled)
+	{
+		PRINT_ERROR("ERROR :: FRAME REUSED WHILE A READER COULD SEE ITS OLD PAGE");
+	}
+	participant.exit();
+	filler.join();
+
+	epochMgr->flushFile(file1ptr);
+	delete epochMgr;
+
+	std::cout << "Test 20 passed" << "\n";
+}
+
+void test21()
+{
+	//An extent is read into adjacent frames, taking along a page that was already in the pool
+	BufMgr* extentMgr = new BufMgr(num);
+	extentMgr->readPage(file1ptr, pid[2], page);
+	extentMgr->unPinPage(file1ptr, pid[2], false);
+	Page* pages;
+	extentMgr->readExtent(file1ptr, pid[0], 8, pages);
+	for (i = 0; i < 8; i++)
+	{
+		sprintf((char*)tmpbuf, "test.1 Page %d %7.1f", pid[i], (float)pid[i]);
+		if(pages[i].page_number() != pid[i] || strncmp(pages[i].getRecord(rid[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: EXTENT DID NOT HOLD ITS PAGES IN ORDER");
+		}
+	}
+
+	//Its pages are pool pages like any other
+	extentMgr->readPage(file1ptr, pid[2], page);
+	if(page != &pages[2])
+	{
+		PRINT_ERROR("ERROR :: PAGE OF AN EXTENT READ INTO ANOTHER FRAME");
+	}
+	extentMgr->unPinPage(file1ptr, pid[2], false);
+	extentMgr->readExtent(file1ptr, pid[0], 8, page);
+	if(page != pages)
+	{
+		PRINT_ERROR("ERROR :: RESIDENT EXTENT READ INTO OTHER FRAMES");
+	}
+	extentMgr->unPinExtent(file1ptr, pid[0], 8, false);
+	extentMgr->unPinExtent(file1ptr, pid[0], 8, false);
+
+	//A page pinned elsewhere cannot be moved into an extent
+	extentMgr->readPage(file1ptr, pid[17], page);
+	try
+	{
+		extentMgr->readExtent(file1ptr, pid[16], 4, pages);
+		PRINT_ERROR("ERROR :: PAGE PINNED ELSEWHERE MOVED INTO AN EXTENT");
+	}
+	catch(const PagePinnedException&)
+	{
+	}
+
+	//A dirty page stays dirty when it moves
+	sprintf((char*)tmpbuf, "test.21 Page %d", pid[17]);
+	const RecordId moved = page->insertRecord(tmpbuf);
+	extentMgr->unPinPage(file1ptr, pid[17], true);
+	extentMgr->readExtent(file1ptr, pid[16], 2, pages);
+	extentMgr->unPinExtent(file1ptr, pid[16], 2, false);
+	extentMgr->flushFile(file1ptr);
+	if(file1ptr->readPage(pid[17]).getRecord(moved) != tmpbuf)
+	{
+		PRINT_ERROR("ERROR :: CHANGES TO A PAGE MOVED INTO AN EXTENT WERE LOST");
+	}
+	delete extentMgr;
+
+	//A page whose write-back is still queued in the scheduler is read from the queue, not from the file
+	File file21 = File::create("test.21", std::make_shared<MemoryBackend>());
+	PageId extentPid[8];
+	for (i = 0; i < 8; i++)
+		extentPid[i] = file21.allocatePage().page_number();
+	{
+		IoScheduler scheduler;
+		BufMgr* schedMgr = new BufMgr(4, 0, &scheduler);
+		//Spend the only token of the background class, so evicted pages stay queued
+		scheduler.setRateLimit(IO_BACKGROUND, 0.001, 1);
+		scheduler.submitWrite(IO_BACKGROUND, &file21, file21.readPage(extentPid[7]));
+		schedMgr->readPage(&file21, extentPid[0], page);
+		sprintf((char*)tmpbuf, "test.21 Page %d", extentPid[0]);
+		const RecordId queued = page->insertRecord(tmpbuf);
+		schedMgr->unPinPage(&file21, extentPid[0], true);
+		for (i = 4; i < 8; i++)
+		{
+			schedMgr->readPage(&file21, extentPid[i], page);
+			schedMgr->unPinPage(&file21, extentPid[i], false);
+		}
+		schedMgr->readExtent(&file21, extentPid[0], 4, pages);
+		if(pages[0].getRecord(queued) != tmpbuf)
+		{
+			PRINT_ERROR("ERROR :: EXTENT READ A PAGE WHOSE WRITE-BACK WAS QUEUED FROM THE FILE");
+		}
+		schedMgr->unPinExtent(&file21, extentPid[0], 4, true);
+		scheduler.setRateLimit(IO_BACKGROUND, 0);
+		schedMgr->flushFile(&file21);
+		if(file21.readPage(extentPid[0]).getRecord(queued) != tmpbuf)
+		{
+			PRINT_ERROR("ERROR :: STALE EXTENT PAGE WAS WRITTEN BACK");
+		}
+
+		//Pages allocated through the pool are only reserved in the file until their first write-back,
+		//so while it is queued an extent over them can only come from the queue
+		scheduler.setRateLimit(IO_BACKGROUND, 0.001, 1);
+		scheduler.submitWrite(IO_BACKGROUND, &file21, file21.readPage(extentPid[7]));
+		PageId reservedPid[4];
+		RecordId reservedRid[4];
+		for (i = 0; i < 4; i++)
+		{
+			schedMgr->allocPage(&file21, reservedPid[i], page);
+			sprintf((char*)tmpbuf, "test.21 Reserved %d", reservedPid[i]);
+			reservedRid[i] = page->insertRecord(tmpbuf);
+			schedMgr->unPinPage(&file21, reservedPid[i], true);
+		}
+		for (i = 4; i < 8; i++)
+		{
+			schedMgr->readPage(&file21, extentPid[i], page);
+			schedMgr->unPinPage(&file21, extentPid[i], false);
+		}
+		schedMgr->readExtent(&file21, reservedPid[0], 4, pages);
+		for (i = 0; i < 4; i++)
+		{
+			sprintf((char*)tmpbuf, "test.21 Reserved %d", reservedPid[i]);
+			if(reservedPid[i] != reservedPid[0] + i || pages[i].getRecord(reservedRid[i]) != tmpbuf)
+			{
+				PRINT_ERROR("ERROR :: EXTENT OVER PAGES WITH QUEUED WRITES DID NOT HOLD THEIR DATA");
+			}
+		}
+		schedMgr->unPinExtent(&file21, reservedPid[0], 4, false);
+		scheduler.setRateLimit(IO_BACKGROUND, 0);
+		schedMgr->flushFile(&file21);
+		sprintf((char*)tmpbuf, "test.21 Reserved %d", reservedPid[3]);
+		if(file21.readPage(reservedPid[3]).getRecord(reservedRid[3]) != tmpbuf)
+		{
+			PRINT_ERROR("ERROR :: RESERVED EXTENT PAGE NEVER REACHED THE FILE");
+		}
+		delete schedMgr;
+	}
+
+	std::cout << "Test 21 passed" << "\n";
+}
+
+void test22()
+{
+	//Reading through a reference swizzles it to the frame, and reads through it find the same frame
+	BufMgr* swizzleMgr = new BufMgr(num);
+	PageRef* ref = new PageRef(pid[5]);
+	swizzleMgr->readPage(file1ptr, *ref, page);
+	swizzleMgr->unPinPage(file1ptr, pid[5], false);
+	if(page->page_number() != pid[5] || !ref->swizzled())
+	{
+		PRINT_ERROR("ERROR :: REFERENCE NOT SWIZZLED TO THE PAGE");
+	}
+	swizzleMgr->readPage(file1ptr, *ref, page2);
+	swizzleMgr->unPinPage(file1ptr, pid[5], false);
+	if(page2 != page)
+	{
+		PRINT_ERROR("ERROR :: SWIZZLED REFERENCE LED TO ANOTHER FRAME");
+	}
+
+	//A frame is swizzled by one reference; copies and other references read through the hash table
+	PageRef copy(*ref);
+	PageRef other(pid[5]);
+	swizzleMgr->readPage(file1ptr, other, page2);
+	swizzleMgr->unPinPage(file1ptr, pid[5], false);
+	if(copy.swizzled() || other.swizzled() || page2 != page)
+	{
+		PRINT_ERROR("ERROR :: FRAME SWIZZLED BY TWO REFERENCES");
+	}
+	delete ref;
+	swizzleMgr->readPage(file1ptr, other, page2);
+	swizzleMgr->unPinPage(file1ptr, pid[5], false);
+	if(!other.swizzled())
+	{
+		PRINT_ERROR("ERROR :: DESTROYED REFERENCE KEPT THE FRAME SWIZZLED");
+	}
+
+	//Evicting the page unswizzles its reference
+	swizzleMgr->flushFile(file1ptr);
+	if(other.swizzled())
+	{
+		PRINT_ERROR("ERROR :: REFERENCE STILL SWIZZLED AFTER EVICTION");
+	}
+	swizzleMgr->readPage(file1ptr, other, page2);
+	if(page2->page_number() != pid[5])
+	{
+		PRINT_ERROR("ERROR :: UNSWIZZLED REFERENCE LED TO THE WRONG PAGE");
+	}
+	swizzleMgr->unPinPage(file1ptr, pid[5], false);
+	delete swizzleMgr;
+	if(other.swizzled())
+	{
+		PRINT_ERROR("ERROR :: REFERENCE OUTLIVED ITS POOL SWIZZLED");
+	}
+
+	std::cout << "Test 22 passed" << "\n";
+}
+
+void test23()
+{
+	//A page read from the file has no changed sectors; overwriting a record marks only its own
+	Page built = file1ptr->allocatePage();
+	RecordId records[16];
+	for (i = 0; i < 16; i++)
+	{
+		records[i] = built.insertRecord(std::string(256, (char)('a' + i)));
+	}
+	file1ptr->writePage(built);
+	const PageId sectorPage = built.page_number();
+	BufMgr* sectorMgr = new BufMgr(num);
+	sectorMgr->readPage(file1ptr, sectorPage, page);
+	if(page->dirty_sectors() != 0)
+	{
+		PRINT_ERROR("ERROR :: PAGE READ FROM THE FILE HAS CHANGED SECTORS");
+	}
+	page->updateRecord(records[0], std::string(256, 'x'));
+	if(page->dirty_sectors() != 1U << (Page::SECTORS - 1))
+	{
+		PRINT_ERROR("ERROR :: RECORD UPDATE MARKED OTHER SECTORS CHANGED");
+	}
+	sectorMgr->unPinPage(file1ptr, sectorPage, true);
+
+	//Write-back leaves the other sectors on disk alone
+	Page other = file1ptr->readPage(sectorPage);
+	other.updateRecord(records[15], std::string(256, 'y'));
+	file1ptr->writePage(other);
+	sectorMgr->flushFile(file1ptr);
+	Page written = file1ptr->readPage(sectorPage);
+	if(written.getRecord(records[0]) != std::string(256, 'x') || written.getRecord(records[15]) != std::string(256, 'y'))
+	{
+		PRINT_ERROR("ERROR :: WRITE-BACK OVERWROTE SECTORS THAT DID NOT CHANGE");
+	}
+
+	//Changes that move records and touch the header are written too
+	sectorMgr->readPage(file1ptr, sectorPage, page);
+	page->updateRecord(records[3], "shorter");
+	page->deleteRecord(records[7]);
+	const RecordId added = page->insertRecord("test.23 added");
+	sectorMgr->unPinPage(file1ptr, sectorPage, true);
+	sectorMgr->flushFile(file1ptr);
+	written = file1ptr->readPage(sectorPage);
+	if(written.getRecord(records[3]) != "shorter" || written.getRecord(added) != "test.23 added" || written.getRecord(records[15]) != std::string(256, 'y'))
+	{
+		PRINT_ERROR("ERROR :: CHANGES TO A PAGE LOST IN A PARTIAL WRITE");
+	}
+	for (i = 0; i < 16; i++)
+	{
+		if(i != 0 && i != 3 && i != 7 && i != 15 && written.getRecord(records[i]) != std::string(256, (char)('a' + i)))
+		{
+			PRINT_ERROR("ERROR :: RECORD MOVED BY A DELETE NOT WRITTEN");
+		}
+	}
+	delete sectorMgr;
+	file1ptr->deletePage(sectorPage);
+
+	std::cout << "Test 23 passed" << "\n";
+}
+
+void test24()
+{
+	//Pool lookups and reads are counted per file
+	BufMgr* metricsMgr = new BufMgr(num);
+	const std::uint64_t hits = file1ptr->stats().cache_hits;
+	const std::uint64_t misses = file1ptr->stats().cache_misses;
+	const std::uint64_t reads = file1ptr->stats().page_reads;
+	for (i = 0; i < 5; i++)
+	{
+		metricsMgr->readPage(file1ptr, pid[i], page);
+		metricsMgr->unPinPage(file1ptr, pid[i], false);
+	}
+	metricsMgr->readPage(file1ptr, pid[0], page);
+	metricsMgr->unPinPage(file1ptr, pid[0], false);
+	if(file1ptr->stats().cache_hits != hits + 1 || file1ptr->stats().cache_misses != misses + 5 || file1ptr->stats().page_reads != reads + 5)
+	{
+		PRINT_ERROR("ERROR :: FILE COUNTERS DID NOT COUNT POOL LOOKUPS AND READS");
+	}
+	File* residentFiles[2] = {file1ptr, file1ptr};
+	Page* residentPages[2];
+	metricsMgr->pinResidentPages(2, residentFiles, pid, residentPages);
+	metricsMgr->unPinPage(file1ptr, pid[0], false);
+	metricsMgr->unPinPage(file1ptr, pid[1], false);
+	if(file1ptr->stats().cache_hits != hits + 3 || file1ptr->stats().cache_misses != misses + 5)
+	{
+		PRINT_ERROR("ERROR :: FILE COUNTERS DID NOT COUNT A BATCH OF POOL LOOKUPS");
+	}
+
+	//The text file holds the counters of every open file and the residency of every pool
+	const std::string metricsPath = "test.metrics";
+	{
+		MetricsExporter exporter(MetricsExporter::TEXT_FILE, metricsPath, std::chrono::milliseconds(0));
+		exporter.addPool("test", metricsMgr);
+		if(!exporter.exportNow())
+		{
+			PRINT_ERROR("ERROR :: METRICS NOT WRITTEN TO THE FILE");
+		}
+		std::ifstream in(metricsPath.c_str());
+		std::stringstream text;
+		text << in.rdbuf();
+		std::stringstream misses_line, resident_line;
+		misses_line << "badgerdb_file_cache_misses_total{file=\"" << file1ptr->filename() << "\"} " << file1ptr->stats().cache_misses << "\n";
+		resident_line << "badgerdb_pool_resident_pages{pool=\"test\",file=\"" << file1ptr->filename() << "\"} 5\n";
+		if(text.str().find(misses_line.str()) == std::string::npos || text.str().find(resident_line.str()) == std::string::npos)
+		{
+			PRINT_ERROR("ERROR :: METRICS FILE MISSING FILE COUNTERS OR RESIDENCY");
+		}
+		exporter.removePool(metricsMgr);
+	}
+	std::remove(metricsPath.c_str());
+
+	//A collector listening on a Unix socket receives the same text; with none listening the export fails
+	const std::string socketPath = "test.metrics.sock";
+	unlink(socketPath.c_str());
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath.c_str());
+	if(listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0)
+	{
+		PRINT_ERROR("ERROR :: COULD NOT LISTEN ON A UNIX SOCKET");
+	}
+	{
+		MetricsExporter exporter(MetricsExporter::UNIX_SOCKET, socketPath, std::chrono::milliseconds(0));
+		exporter.addPool("test", metricsMgr);
+		const bool sent = exporter.exportNow();
+		std::string received;
+		const int connection = accept(listener, NULL, NULL);
+		char chunk[4096];
+		ssize_t n;
+		while (connection >= 0 && (n = read(connection, chunk, sizeof(chunk))) > 0)
+			received.append(chunk, n);
+		if (connection >= 0)
+			close(connection);
+		if(!sent || received != exporter.render())
+		{
+			PRINT_ERROR("ERROR :: METRICS NOT RECEIVED ON THE UNIX SOCKET");
+		}
+		close(listener);
+		unlink(socketPath.c_str());
+		if(exporter.exportNow() || exporter.exports() != 1 || exporter.failures() != 1)
+		{
+			PRINT_ERROR("ERROR :: EXPORT WITH NO COLLECTOR LISTENING DID NOT FAIL");
+		}
+		exporter.removePool(metricsMgr);
+	}
+	delete metricsMgr;
+
+	std::cout << "Test 24 passed" << "\n";
+}
+
+void test25()
+{
+	//Pages allocated through the pool are formatted in their frames; nothing is read or written
+	File file25 = File::create("test.25", std::make_shared<MemoryBackend>());
+	BufMgr* allocMgr = new BufMgr(num);
+	const std::uint64_t reads = file25.stats().page_reads;
+	const std::uint64_t writes = file25.stats().page_writes;
+	PageId allocated[3];
+	RecordId allocatedRids[3];
+	for (i = 0; i < 3; i++)
+	{
+		allocMgr->allocPage(&file25, allocated[i], page);
+		sprintf((char*)tmpbuf, "test.25 Page %d", allocated[i]);
+		allocatedRids[i] = page->insertRecord(tmpbuf);
+		allocMgr->unPinPage(&file25, allocated[i], true);
+	}
+	if(file25.stats().page_reads != reads || file25.stats().page_writes != writes || allocated[1] != allocated[0] + 1 || allocated[2] != allocated[1] + 1)
+	{
+		PRINT_ERROR("ERROR :: ALLOCATING A PAGE IN THE POOL DID PAGE I/O");
+	}
+	try
+	{
+		file25.readPage(allocated[0]);
+		PRINT_ERROR("ERROR :: PAGE FOUND IN THE FILE BEFORE IT WAS WRITTEN");
+	}
+	catch(const InvalidPageException&)
+	{
+	}
+
+	//Reserved pages join the used list in page order whatever order they are written in
+	Page first = file25.reservePage();
+	Page second = file25.reservePage();
+	second.insertRecord("test.25 second");
+	file25.writePage(second);
+	FileIterator iter = file25.begin();
+	if(iter == file25.end() || (*iter).page_number() != second.page_number() || ++iter != file25.end())
+	{
+		PRINT_ERROR("ERROR :: WRITTEN RESERVED PAGE NOT LINKED INTO THE FILE");
+	}
+	first.insertRecord("test.25 first");
+	file25.writePage(first);
+	iter = file25.begin();
+	if((*iter).page_number() != first.page_number() || (*++iter).page_number() != second.page_number() || ++iter != file25.end())
+	{
+		PRINT_ERROR("ERROR :: RESERVED PAGES LINKED OUT OF ORDER");
+	}
+
+	//Pages allocated later do not reuse reserved numbers, and a reservation can be dropped
+	Page dropped = file25.reservePage();
+	file25.deletePage(dropped.page_number());
+	Page appended = file25.allocatePage();
+	if(appended.page_number() <= second.page_number() || appended.page_number() <= allocated[2])
+	{
+		PRINT_ERROR("ERROR :: ALLOCATED PAGE REUSED A RESERVED NUMBER");
+	}
+
+	//Write-back puts the pool's pages into the file, and the list stays in order
+	allocMgr->flushFile(&file25);
+	PageId previous = 0;
+	int linked = 0;
+	for (iter = file25.begin(); iter != file25.end(); ++iter)
+	{
+		if((*iter).page_number() <= previous)
+		{
+			PRINT_ERROR("ERROR :: USED LIST OUT OF ORDER AFTER WRITE-BACK");
+		}
+		previous = (*iter).page_number();
+		linked++;
+	}
+	for (i = 0; i < 3; i++)
+	{
+		sprintf((char*)tmpbuf, "test.25 Page %d", allocated[i]);
+		if(file25.readPage(allocated[i]).getRecord(allocatedRids[i]) != tmpbuf)
+		{
+			PRINT_ERROR("ERROR :: PAGE ALLOCATED IN THE POOL LOST AT WRITE-BACK");
+		}
+	}
+	if(linked != 6)
+	{
+		PRINT_ERROR("ERROR :: WRONG NUMBER OF PAGES IN THE FILE");
+	}
+	delete allocMgr;
+
+	std::cout << "Test 25 passed" << "\n";
+}
+
+void test26()
+{
+	//A file growing past its end is preallocated a whole chunk at a time, and pages are handed out from it
+	const std::uint64_t chunk = 64 * 1024;
+	File::setGrowthChunk(chunk);
+	std::remove("test.26");
+	std::shared_ptr<StreamBackend> disk = std::make_shared<StreamBackend>("test.26", std::fstream::in | std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	{
+		File file26 = File::create("test.26", disk);
+		PageId pageNumbers[8];
+		RecordId pageRids[8];
+		for (i = 0; i < 8; i++)
+		{
+			Page allocated = file26.allocatePage();
+			pageNumbers[i] = allocated.page_number();
+			sprintf((char*)tmpbuf, "test.26 Page %d", pageNumbers[i]);
+			pageRids[i] = allocated.insertRecord(tmpbuf);
+			file26.writePage(allocated);
+			//Seven pages fit in the first chunk after the file header
+			if(disk->size() != (i < 7 ? chunk : 2 * chunk))
+			{
+				PRINT_ERROR("ERROR :: FILE NOT GROWN BY WHOLE CHUNKS");
+			}
+		}
+		int pages = 0;
+		for (FileIterator iter = file26.begin(); iter != file26.end(); ++iter)
+		{
+			pages++;
+		}
+		if(pages != 8)
+		{
+			PRINT_ERROR("ERROR :: PREALLOCATED SPACE READ AS PAGES");
+		}
+		for (i = 0; i < 8; i++)
+		{
+			sprintf((char*)tmpbuf, "test.26 Page %d", pageNumbers[i]);
+			if(file26.readPage(pageNumbers[i]).getRecord(pageRids[i]) != tmpbuf)
+			{
+				PRINT_ERROR("ERROR :: PAGE IN PREALLOCATED SPACE LOST");
+			}
+		}
+
+		//Reserved pages are covered by the chunk before they are written
+		Page reserved = file26.reservePage();
+		const std::uint64_t reserved_end = sizeof(FileHeader) + reserved.page_number() * Page::SIZE;
+		if(disk->size() < reserved_end || disk->size() % chunk != 0)
+		{
+			PRINT_ERROR("ERROR :: RESERVED PAGE NOT PREALLOCATED");
+		}
+	}
+	std::remove("test.26");
+
+	//Without a chunk the file grows by each page as it is written
+	File::setGrowthChunk(0);
+	std::shared_ptr<StreamBackend> exact = std::make_shared<StreamBackend>("test.26", std::fstream::in | std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	{
+		File file26 = File::create("test.26", exact);
+		file26.writePage(file26.allocatePage());
+		if(exact->size() != sizeof(FileHeader) + Page::SIZE)
+		{
+			PRINT_ERROR("ERROR :: FILE PREALLOCATED WITHOUT A GROWTH CHUNK");
+		}
+	}
+	std::remove("test.26");
+
+	//A file of another layout version, or from before files had one, is refused instead of misread
+	std::shared_ptr<MemoryBackend> versioned = std::make_shared<MemoryBackend>();
+	{
+		File file26 = File::create("test.26.versioned", versioned);
+		file26.writePage(file26.allocatePage());
+	}
+	File::open("test.26.versioned", versioned);
+	const std::uint16_t formats[2][2] = {{File::FORMAT_MAGIC, File::FORMAT_VERSION - 1}, {0, 0}};
+	for (i = 0; i < 2; i++)
+	{
+		versioned->write(offsetof(FileHeader, magic), (const char*)formats[i], sizeof(formats[i]));
+		try
+		{
+			File::open("test.26.versioned", versioned);
+			PRINT_ERROR("ERROR :: FILE OF ANOTHER LAYOUT VERSION WAS OPENED");
+		}
+		catch(const FileFormatException& e)
+		{
+			if(e.found_version() != formats[i][1] || File::isOpen("test.26.versioned"))
+			{
+				PRINT_ERROR("ERROR :: REFUSED FILE WAS LEFT OPEN");
+			}
+		}
+	}
+
+	std::cout << "Test 26 passed" << "\n";
+}
+
+void test27()
+{
+	//Deleted pages are punched out or cut off, and the free list still hands them out
+	File::setPunchFreedPages(true);
+	std::remove("test.27");
+	std::shared_ptr<StreamBackend> disk = std::make_shared<StreamBackend>("test.27", std::fstream::in | std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	{
+		File file27 = File::create("test.27", disk);
+		PageId pageNumbers[64];
+		RecordId pageRids[64];
+		for (i = 0; i < 64; i++)
+		{
+			Page allocated = file27.allocatePage();
+			pageNumbers[i] = allocated.page_number();
+			sprintf((char*)tmpbuf, "test.27 Page %d", pageNumbers[i]);
+			pageRids[i] = allocated.insertRecord(tmpbuf);
+			file27.writePage(allocated);
+		}
+		struct stat before;
+		stat("test.27", &before);
+
+		for (i = 1; i < 40; i++)
+		{
+			file27.deletePage(pageNumbers[i]);
+		}
+		file27.deletePage(pageNumbers[63]);
+		if(disk->size() != sizeof(FileHeader) + (pageNumbers[63] - 1) * Page::SIZE)
+		{
+			PRINT_ERROR("ERROR :: DELETED LAST PAGE NOT CUT OFF");
+		}
+		for (i = 59; i < 63; i++)
+		{
+			file27.deletePage(pageNumbers[i]);
+		}
+		file27.reclaimFreeSpace();
+		if(disk->size() != sizeof(FileHeader) + (pageNumbers[59] - 1) * Page::SIZE)
+		{
+			PRINT_ERROR("ERROR :: TRAILING FREE PAGES NOT CUT OFF");
+		}
+		struct stat after;
+		stat("test.27", &after);
+		if(after.st_blocks >= before.st_blocks / 2)
+		{
+			PRINT_ERROR("ERROR :: SPACE OF DELETED PAGES NOT GIVEN BACK");
+		}
+
+		int pages = 0;
+		for (FileIterator iter = file27.begin(); iter != file27.end(); ++iter)
+		{
+			Page curr = *iter;
+			const int index = curr.page_number() - pageNumbers[0];
+			sprintf((char*)tmpbuf, "test.27 Page %d", curr.page_number());
+			if(curr.getRecord(pageRids[index]) != tmpbuf)
+			{
+				PRINT_ERROR("ERROR :: PAGE KEPT IN THE FILE LOST ITS DATA");
+			}
+			pages++;
+		}
+		if(pages != 20)
+		{
+			PRINT_ERROR("ERROR :: WRONG NUMBER OF PAGES LEFT IN THE FILE");
+		}
+
+		//Every punched page is handed out again before the file grows
+		for (i = 1; i < 40; i++)
+		{
+			Page reused = file27.allocatePage();
+			if(reused.page_number() <= pageNumbers[0] || reused.page_number() >= pageNumbers[40])
+			{
+				PRINT_ERROR("ERROR :: FREE PAGE NOT REUSED");
+			}
+			sprintf((char*)tmpbuf, "test.27 reused %d", reused.page_number());
+			const RecordId reusedRid = reused.insertRecord(tmpbuf);
+			file27.writePage(reused);
+			if(file27.readPage(reused.page_number()).getRecord(reusedRid) != tmpbuf)
+			{
+				PRINT_ERROR("ERROR :: REUSED PAGE LOST ITS DATA");
+			}
+		}
+		if(file27.allocatePage().page_number() != pageNumbers[59])
+		{
+			PRINT_ERROR("ERROR :: FILE DID NOT GROW AFTER THE FREE LIST RAN OUT");
+		}
+	}
+	std::remove("test.27");
+	File::setPunchFreedPages(false);
+
+	//Released memory reads as zeros, and a cut-off memory file grows back with zeros
+	MemoryBackend memory;
+	const std::string ones(3 * MemoryBackend::CHUNK_SIZE, '1');
+	memory.write(0, ones.data(), ones.size());
+	memory.deallocate(100, 2 * MemoryBackend::CHUNK_SIZE);
+	memory.truncate(MemoryBackend::CHUNK_SIZE / 2);
+	memory.write(MemoryBackend::CHUNK_SIZE, "1", 1);
+	std::string bytes(MemoryBackend::CHUNK_SIZE + 1, '\0');
+	memory.read(0, &bytes[0], bytes.size());
+	if(memory.size() != MemoryBackend::CHUNK_SIZE + 1 || bytes != std::string(100, '1') + std::string(MemoryBackend::CHUNK_SIZE - 100, '\0') + "1")
+	{
+		PRINT_ERROR("ERROR :: RELEASED MEMORY NOT READ AS ZEROS");
+	}
+
+	std::cout << "Test 27 passed" << "\n";
+}
+
+void test28()
+{
+	//The try variants report expected conditions as a status and leave everything as it was
+	Page statusPage;
+	const std::string record(1000, 'r');
+	RecordId recordIds[16];
+	int inserted = 0;
+	while (statusPage.tryInsertRecord(record, recordIds[inserted]) == STATUS_OK)
+	{
+		inserted++;
+	}
+	if(inserted != 8 || !statusPage.hasSpaceForRecord(std::string(100, 'r')))
+	{
+		PRINT_ERROR("ERROR :: WRONG NUMBER OF RECORDS FIT ON A PAGE");
+	}
+	std::string found;
+	if(statusPage.tryUpdateRecord(recordIds[0], std::string(2000, 'u')) != STATUS_INSUFFICIENT_SPACE || statusPage.tryGetRecord(recordIds[0], found) != STATUS_OK || found != record)
+	{
+		PRINT_ERROR("ERROR :: FAILED UPDATE CHANGED THE RECORD");
+	}
+	if(statusPage.tryDeleteRecord(recordIds[0]) != STATUS_OK || statusPage.tryDeleteRecord(recordIds[0]) != STATUS_INVALID_RECORD || statusPage.tryGetRecord(recordIds[0], found) != STATUS_INVALID_RECORD || statusPage.tryUpdateRecord(recordIds[0], record) != STATUS_INVALID_RECORD)
+	{
+		PRINT_ERROR("ERROR :: DELETED RECORD NOT REPORTED AS INVALID");
+	}
+
+	File file28 = File::create("test.28", std::make_shared<MemoryBackend>());
+	Page filePage = file28.allocatePage();
+	Page deletedPage = file28.allocatePage();
+	file28.deletePage(deletedPage.page_number());
+	Page readBack;
+	if(file28.tryReadPage(filePage.page_number(), readBack) != STATUS_OK || readBack.page_number() != filePage.page_number() || file28.tryReadPage(deletedPage.page_number(), readBack) != STATUS_INVALID_PAGE || file28.tryReadPage(100, readBack) != STATUS_INVALID_PAGE)
+	{
+		PRINT_ERROR("ERROR :: FILE STATUS WRONG");
+	}
+
+	BufHashTbl table(7);
+	FrameId frame;
+	table.insert(&file28, 1, 3);
+	if(table.tryLookup(&file28, 2, frame) != STATUS_NOT_FOUND || table.tryLookup(&file28, 1, frame) != STATUS_OK || frame != 3 || table.tryRemove(&file28, 1) != STATUS_OK || table.tryRemove(&file28, 1) != STATUS_NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: HASH TABLE STATUS WRONG");
+	}
+
+	//A full pool and a missing page leave the pool usable
+	BufMgr* statusMgr = new BufMgr(2);
+	PageId allocated[3];
+	Page* pages[3];
+	if(statusMgr->tryAllocPage(&file28, allocated[0], pages[0]) != STATUS_OK || statusMgr->tryAllocPage(&file28, allocated[1], pages[1]) != STATUS_OK || statusMgr->tryAllocPage(&file28, allocated[2], pages[2]) != STATUS_BUFFER_EXCEEDED || statusMgr->tryReadPage(&file28, filePage.page_number(), pages[2]) != STATUS_BUFFER_EXCEEDED)
+	{
+		PRINT_ERROR("ERROR :: FULL POOL NOT REPORTED");
+	}
+	statusMgr->unPinPage(&file28, allocated[0], true);
+	statusMgr->unPinPage(&file28, allocated[1], true);
+	if(statusMgr->tryReadPage(&file28, deletedPage.page_number(), pages[2]) != STATUS_INVALID_PAGE || statusMgr->tryReadPage(&file28, 100, pages[2]) != STATUS_INVALID_PAGE)
+	{
+		PRINT_ERROR("ERROR :: MISSING PAGE NOT REPORTED");
+	}
+	if(statusMgr->tryReadPage(&file28, filePage.page_number(), pages[2]) != STATUS_OK || pages[2]->page_number() != filePage.page_number())
+	{
+		PRINT_ERROR("ERROR :: POOL NOT USABLE AFTER A MISSING PAGE");
+	}
+	statusMgr->unPinPage(&file28, filePage.page_number(), false);
+	statusMgr->flushFile(&file28);
+	delete statusMgr;
+
+	std::cout << "Test 28 passed" << "\n";
+}
+
+void test29()
+{
+	//Moving a File hands its reference to the file over; the file stays open until the last one goes
+	File file29 = File::create("test.29", std::make_shared<MemoryBackend>());
+	for (int j = 0; j < 4; j++)
+	{
+		Page newPage = file29.allocatePage();
+		newPage.insertRecord("test.29 record");
+		file29.writePage(newPage);
+	}
+	{
+		std::vector<File> files;
+		for (int j = 0; j < 8; j++)
+			files.push_back(file29);
+		File moved(std::move(file29));
+		file29 = std::move(files.back());
+		files.clear();
+		try
+		{
+			File::create("test.29", std::make_shared<MemoryBackend>());
+			PRINT_ERROR("ERROR :: FILE CLOSED WHILE STILL OPEN");
+		}
+		catch (const FileExistsException&)
+		{
+		}
+		if(!(moved.begin() == file29.begin()) || moved.begin() == moved.end())
+		{
+			PRINT_ERROR("ERROR :: ITERATORS OVER THE SAME FILE NOT EQUAL");
+		}
+	}
+
+	//Pages deleted from and allocated again in the middle are linked back in order
+	file29.deletePage(2);
+	file29.deletePage(3);
+	Page reused = file29.allocatePage();
+	reused.insertRecord("test.29 record");
+	file29.writePage(reused);
+	PageId expected = 1;
+	for (FileIterator iter = file29.begin(); iter != file29.end(); ++iter)
+	{
+		if((*iter).page_number() != expected)
+			PRINT_ERROR("ERROR :: USED LIST OUT OF ORDER");
+		expected += expected == 1 ? 2 : 1;
+	}
+	if(expected != 5)
+	{
+		PRINT_ERROR("ERROR :: WRONG NUMBER OF USED PAGES");
+	}
+
+	//A moved page keeps its records, and the page moved from can be read into again
+	Page source = file29.readPage(1);
+	const RecordId firstRecord = {1, 1};
+	Page target(std::move(source));
+	if(target.getRecord(firstRecord) != "test.29 record" || file29.tryReadPage(4, source) != STATUS_OK || source.getRecord(RecordId{4, 1}) != "test.29 record")
+	{
+		PRINT_ERROR("ERROR :: MOVED PAGE WRONG");
+	}
+
+	//A page reserved in place is blank
+	file29.reservePage(target);
+	if(target.page_number() != 5 || target.begin() != target.end() || target.getFreeSpace() != Page::DATA_SIZE)
+	{
+		PRINT_ERROR("ERROR :: PAGE RESERVED IN PLACE NOT BLANK");
+	}
+	target.insertRecord("test.29 record");
+	file29.writePage(target);
+	if(file29.readPage(5).getRecord(RecordId{5, 1}) != "test.29 record")
+	{
+		PRINT_ERROR("ERROR :: PAGE RESERVED IN PLACE NOT WRITTEN");
+	}
+
+	std::cout << "Test 29 passed" << "\n";
+}
+
+void test30()
+{
+	//A sorted page finds records by key with a binary search; record ids stay as they were
+	Page sortedPage;
+	sortedPage.makeSorted();
+	const int keys = 200;
+	RecordId sortedIds[keys];
+	for (int j = 0; j < keys; j++)
+	{
+		const int key = j * 73 % keys;
+		sprintf((char*)tmpbuf, "key%03d", key);
+		sortedIds[key] = sortedPage.insertRecord(tmpbuf, "value");
+	}
+	RecordId found;
+	if(sortedPage.keyCount() != keys || sortedPage.tryFindRecord("key137", found) != STATUS_OK || !(found == sortedIds[137]) || sortedPage.getRecord(found) != "key137value" || sortedPage.tryFindRecord("key200", found) != STATUS_NOT_FOUND || sortedPage.tryFindRecord("key13", found) != STATUS_NOT_FOUND || sortedPage.lowerBound("key1") != 100)
+	{
+		PRINT_ERROR("ERROR :: KEY NOT FOUND ON SORTED PAGE");
+	}
+	for (int j = 0; j < keys; j++)
+	{
+		if(!(sortedPage.recordAt(j) == sortedIds[j]))
+			PRINT_ERROR("ERROR :: SORTED PAGE OUT OF ORDER");
+	}
+
+	//Deletes and updates keep the order
+	for (int j = 0; j < keys; j += 2)
+		sortedPage.deleteRecord(sortedIds[j]);
+	sortedPage.updateRecord(sortedIds[1], "key999value");
+	if(sortedPage.keyCount() != keys / 2 || !(sortedPage.recordAt(0) == sortedIds[3]) || !(sortedPage.recordAt(keys / 2 - 1) == sortedIds[1]) || sortedPage.tryFindRecord("key001", found) != STATUS_NOT_FOUND || sortedPage.tryFindRecord("key999", found) != STATUS_OK || sortedPage.tryFindRecord("key004", found) != STATUS_NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: SORTED PAGE WRONG AFTER DELETES");
+	}
+	for (int j = 1; j < keys; j += 2)
+		sortedPage.deleteRecord(sortedIds[j]);
+	if(sortedPage.keyCount() != 0 || sortedPage.getFreeSpace() != Page::DATA_SIZE)
+	{
+		PRINT_ERROR("ERROR :: EMPTY SORTED PAGE NOT EMPTY");
+	}
+
+	//A page with records can be sorted, and stays sorted through its file
+	File file30 = File::create("test.30", std::make_shared<MemoryBackend>());
+	Page filePage = file30.allocatePage();
+	filePage.insertRecord("pear");
+	filePage.insertRecord("apple");
+	filePage.insertRecord("fig");
+	if(filePage.tryFindRecord("fig", found) != STATUS_OK || filePage.getRecord(found) != "fig")
+	{
+		PRINT_ERROR("ERROR :: KEY NOT FOUND ON UNSORTED PAGE");
+	}
+	filePage.makeSorted();
+	filePage.insertRecord("banana");
+	file30.writePage(filePage);
+	Page readBack = file30.readPage(filePage.page_number());
+	const char* fruits[] = {"apple", "banana", "fig", "pear"};
+	for (int j = 0; j < 4; j++)
+	{
+		if(!readBack.isSorted() || readBack.getRecord(readBack.recordAt(j)) != fruits[j])
+			PRINT_ERROR("ERROR :: SORTED PAGE NOT SORTED AFTER A READ");
+	}
+
+	//A record keyed by its whole contents is found by its new contents once updated
+	readBack.updateRecord(readBack.recordAt(0), "cherry pie");
+	readBack.updateRecord(readBack.recordAt(0), "kiwi");
+	if(readBack.tryFindRecord("cherry pie", found) != STATUS_OK || readBack.getRecord(found) != "cherry pie" || readBack.tryFindRecord("kiwi", found) != STATUS_OK || readBack.getRecord(found) != "kiwi" || readBack.tryFindRecord("banana", found) != STATUS_NOT_FOUND || readBack.tryFindRecord("apple", found) != STATUS_NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: UPDATED RECORD NOT FOUND ON SORTED PAGE");
+	}
+
+	std::cout << "Test 30 passed" << "\n";
+}
+
+void test31()
+{
+	//A fixed-length page holds more records than a slotted one, padded to their length
+	Page fixedPage;
+	fixedPage.makeFixedLength(16);
+	RecordId fixedIds[600];
+	int fixedCount = 0;
+	sprintf((char*)tmpbuf, "rec%03d", fixedCount);
+	while (fixedPage.tryInsertRecord(tmpbuf, fixedIds[fixedCount]) == STATUS_OK)
+	{
+		fixedCount++;
+		sprintf((char*)tmpbuf, "rec%03d", fixedCount);
+	}
+	if(fixedCount != 506 || fixedPage.getFreeSpace() != 0 || fixedPage.getRecord(fixedIds[5]) != std::string("rec005") + std::string(10, '\0'))
+	{
+		PRINT_ERROR("ERROR :: WRONG RECORDS ON A FIXED-LENGTH PAGE");
+	}
+
+	//Deleted slots are found again in the bitmap, and iteration skips them
+	for (int j = 0; j < fixedCount; j += 3)
+		fixedPage.deleteRecord(fixedIds[j]);
+	int iterated = 0;
+	for (PageIterator iter = fixedPage.begin(); iter != fixedPage.end(); ++iter)
+		iterated++;
+	RecordId reused;
+	std::string fixedRecord;
+	if(iterated != fixedCount - (fixedCount + 2) / 3 || fixedPage.tryInsertRecord(std::string(17, 'x'), reused) != STATUS_INSUFFICIENT_SPACE || fixedPage.tryInsertRecord("again", reused) != STATUS_OK || !(reused == fixedIds[0]) || fixedPage.tryGetRecord(fixedIds[3], fixedRecord) != STATUS_INVALID_RECORD)
+	{
+		PRINT_ERROR("ERROR :: FIXED-LENGTH PAGE WRONG AFTER DELETES");
+	}
+	fixedPage.updateRecord(fixedIds[1], "updated");
+	if(fixedPage.getRecord(fixedIds[1]).compare(0, 8, std::string("updated\0", 8)) != 0 || fixedPage.tryUpdateRecord(fixedIds[1], std::string(17, 'x')) != STATUS_INSUFFICIENT_SPACE)
+	{
+		PRINT_ERROR("ERROR :: FIXED-LENGTH RECORD NOT UPDATED");
+	}
+
+	//Only an empty page changes format, and a fixed-length page stays one through its file
+	try
+	{
+		fixedPage.makeFixedLength(8);
+		PRINT_ERROR("ERROR :: PAGE WITH RECORDS CHANGED FORMAT");
+	}
+	catch (const SlotInUseException&)
+	{
+	}
+	File file31 = File::create("test.31", std::make_shared<MemoryBackend>());
+	Page filePage = file31.allocatePage();
+	filePage.makeFixedLength(8);
+	const RecordId fileRecord = filePage.insertRecord("12345678");
+	file31.writePage(filePage);
+	Page readBack = file31.readPage(filePage.page_number());
+	RecordId found;
+	if(!readBack.isFixedLength() || readBack.getRecord(fileRecord) != "12345678" || readBack.tryFindRecord("12345678", found) != STATUS_OK || !(found == fileRecord))
+	{
+		PRINT_ERROR("ERROR :: FIXED-LENGTH PAGE WRONG AFTER A READ");
+	}
+
+	//A record shorter than the record length is found by its unpadded contents
+	const RecordId shortRecord = readBack.insertRecord("short");
+	if(readBack.tryFindRecord("short", found) != STATUS_OK || !(found == shortRecord) || readBack.tryFindRecord("shor", found) != STATUS_NOT_FOUND || readBack.tryFindRecord("123456789", found) != STATUS_NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: SHORT RECORD NOT FOUND ON FIXED-LENGTH PAGE");
+	}
+
+	std::cout << "Test 31 passed" << "\n";
+}
+
+void test32()
+{
+	//A prefix-compressed page stores the prefix its records share once, and gives them back whole
+	Page plainPage;
+	Page prefixPage;
+	prefixPage.makePrefixCompressed();
+	RecordId prefixIds[1000];
+	int plainCount = 0;
+	int prefixCount = 0;
+	RecordId rid;
+	sprintf((char*)tmpbuf, "tenant-0042/us-east-1/orders/%08d", prefixCount);
+	while (prefixPage.tryInsertRecord(tmpbuf, prefixIds[prefixCount]) == STATUS_OK)
+	{
+		if(plainPage.tryInsertRecord(tmpbuf, rid) == STATUS_OK)
+			plainCount++;
+		prefixCount++;
+		sprintf((char*)tmpbuf, "tenant-0042/us-east-1/orders/%08d", prefixCount);
+	}
+	if(prefixCount < 2 * plainCount || prefixPage.prefixLength() != 34 || prefixPage.getRecord(prefixIds[123]) != "tenant-0042/us-east-1/orders/00000123")
+	{
+		PRINT_ERROR("ERROR :: WRONG RECORDS ON A PREFIX-COMPRESSED PAGE");
+	}
+	int iterated = 0;
+	for (PageIterator iter = prefixPage.begin(); iter != prefixPage.end(); ++iter)
+	{
+		sprintf((char*)tmpbuf, "tenant-0042/us-east-1/orders/%08d", iterated++);
+		if(*iter != tmpbuf)
+			PRINT_ERROR("ERROR :: WRONG RECORD ITERATED ON A PREFIX-COMPRESSED PAGE");
+	}
+
+	//A record without the prefix shortens it, and the records already there keep their contents
+	for (int j = 100; j < prefixCount; j++)
+		prefixPage.deleteRecord(prefixIds[j]);
+	const RecordId other = prefixPage.insertRecord("tenant-0042/eu-west-1/orders");
+	prefixPage.updateRecord(prefixIds[7], "tenant-0007");
+	RecordId found;
+	if(prefixPage.prefixLength() != 9 || prefixPage.getRecord(other) != "tenant-0042/eu-west-1/orders" || prefixPage.getRecord(prefixIds[7]) != "tenant-0007" || prefixPage.getRecord(prefixIds[99]) != "tenant-0042/us-east-1/orders/00000099" || prefixPage.tryFindRecord("tenant-0042/us-east-1/orders/00000050", found) != STATUS_OK || !(found == prefixIds[50]) || prefixPage.tryFindRecord("other", found) != STATUS_NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: PREFIX-COMPRESSED PAGE WRONG AFTER THE PREFIX CHANGED");
+	}
+
+	//An emptied page takes the prefix of the next record
+	for (int j = 0; j < 100; j++)
+		prefixPage.deleteRecord(prefixIds[j]);
+	prefixPage.deleteRecord(other);
+	prefixPage.insertRecord("tenant-0001/ap-south-1/users/1");
+	if(prefixPage.prefixLength() != 30 || prefixPage.getFreeSpace() != Page::DATA_SIZE - sizeof(PageSlot) - 32)
+	{
+		PRINT_ERROR("ERROR :: EMPTIED PREFIX-COMPRESSED PAGE KEPT ITS PREFIX");
+	}
+
+	//A sorted page keeps the prefix within its keys and stays sorted through its file
+	File file32 = File::create("test.32", std::make_shared<MemoryBackend>());
+	Page filePage = file32.allocatePage();
+	filePage.insertRecord("tenant-0042/us-east-1/b", "2");
+	filePage.insertRecord("tenant-0042/us-east-1/a", "1");
+	filePage.makePrefixCompressed();
+	filePage.insertRecord("tenant-0042/us-east-1/c", "3");
+	filePage.insertRecord("tenant-0042/eu-west-1/d", "4");
+	file32.writePage(filePage);
+	Page readBack = file32.readPage(filePage.page_number());
+	const char* sorted[] = {"tenant-0042/eu-west-1/d4", "tenant-0042/us-east-1/a1", "tenant-0042/us-east-1/b2", "tenant-0042/us-east-1/c3"};
+	for (int j = 0; j < 4; j++)
+	{
+		if(!readBack.isPrefixCompressed() || !readBack.isSorted() || readBack.getRecord(readBack.recordAt(j)) != sorted[j])
+			PRINT_ERROR("ERROR :: SORTED PREFIX-COMPRESSED PAGE NOT SORTED AFTER A READ");
+	}
+	if(readBack.prefixLength() != 12 || readBack.tryFindRecord("tenant-0042/us-east-1/b", found) != STATUS_OK || readBack.getRecord(found) != "tenant-0042/us-east-1/b2" || readBack.lowerBound("tenant-0042/us-east-1/bb") != 3 || readBack.lowerBound("tenant-0041") != 0 || readBack.lowerBound("tenant-0043") != 4 || readBack.tryFindRecord("tenant-0042/us-east-1/e", found) != STATUS_NOT_FOUND)
+	{
+		PRINT_ERROR("ERROR :: KEY NOT FOUND ON A SORTED PREFIX-COMPRESSED PAGE");
+	}
+
+	std::cout << "Test 32 passed" << "\n";
+}
+
+void test33()
+{
+	//Small memtables and levels, so a few thousand writes flush and compact many times
+	const std::string name = filePrefix + "test.33";
+	LsmTree::destroy(name);
+	LsmOptions options;
+	options.memtable_bytes = 8192;
+	options.run_bytes = 32768;
+	options.level0_runs = 2;
+	options.level1_bytes = 131072;
+	options.level_ratio = 4;
+	const int keys = 3000;
+	const std::string padding(40, 'v');
+	{
+		LsmTree tree(name, options);
+		for (int i = 0; i < keys; i++)
+		{
+			sprintf((char*)tmpbuf, "key%06d", (i * 7919) % keys);
+			tree.put(tmpbuf, tmpbuf + padding);
+		}
+		for (int i = 0; i < keys; i += 5)
+		{
+			sprintf((char*)tmpbuf, "key%06d", i);
+			tree.put(tmpbuf, "new");
+		}
+		for (int i = 0; i < keys; i += 7)
+		{
+			sprintf((char*)tmpbuf, "key%06d", i);
+			tree.remove(tmpbuf);
+		}
+		tree.waitForCompactions();
+		const LsmStats stats = tree.stats();
+		if(stats.flushes == 0 || stats.compactions == 0 || stats.level_runs[0] >= 2 || stats.writes != keys + keys / 5 + keys / 7 + 1)
+		{
+			PRINT_ERROR("ERROR :: LSM TREE DID NOT FLUSH AND COMPACT");
+		}
+	}
+
+	//Every key has its newest value once reopened, without a flush of the last writes
+	{
+		LsmTree tree(name, options);
+		tree.put("unflushed", "1");
+		tree.remove("key000001");
+		std::string value;
+		for (int i = 0; i < keys; i++)
+		{
+			sprintf((char*)tmpbuf, "key%06d", i);
+			const Status status = tree.get(tmpbuf, value);
+			const bool removed = i % 7 == 0 || i == 1;
+			const std::string expected = i % 5 == 0 ? std::string("new") : tmpbuf + padding;
+			if(removed ? status != STATUS_NOT_FOUND : status != STATUS_OK || value != expected)
+			{
+				PRINT_ERROR("ERROR :: WRONG VALUE IN LSM TREE");
+			}
+		}
+		if(tree.get("key", value) != STATUS_NOT_FOUND || tree.get("key999999", value) != STATUS_NOT_FOUND)
+		{
+			PRINT_ERROR("ERROR :: LSM TREE FOUND A KEY NEVER WRITTEN");
+		}
+		if(tree.stats().filter_skips == 0)
+		{
+			PRINT_ERROR("ERROR :: LSM TREE FILTERS SKIPPED NO RUN");
+		}
+	}
+	{
+		LsmTree tree(name, options);
+		std::string value;
+		if(tree.get("unflushed", value) != STATUS_OK || value != "1" || tree.get("key000001", value) != STATUS_NOT_FOUND)
+		{
+			PRINT_ERROR("ERROR :: LSM TREE LOST WRITES OF ITS LOG");
+		}
+	}
+
+	//A crash after a run was written but before the manifest listed it leaves the run behind;
+	//fill every unused number up to the one after the last file with such runs
+	std::vector<std::string> orphans;
+	{
+		int last = 0;
+		for (int i = 1; i < 1000; i++)
+		{
+			sprintf((char*)tmpbuf, ".%d", i);
+			if(File::exists(name + tmpbuf + ".run") || File::exists(name + tmpbuf + ".log"))
+				last = i;
+		}
+		for (int i = 1; i <= last + 1; i++)
+		{
+			sprintf((char*)tmpbuf, ".%d", i);
+			if(!File::exists(name + tmpbuf + ".run") && !File::exists(name + tmpbuf + ".log"))
+			{
+				orphans.push_back(name + tmpbuf + ".run");
+				File::create(orphans.back());
+			}
+		}
+	}
+	{
+		LsmTree tree(name, options);
+		for (std::size_t i = 0; i < orphans.size(); i++)
+		{
+			if(File::exists(orphans[i]))
+			{
+				PRINT_ERROR("ERROR :: LSM TREE KEPT A RUN ITS MANIFEST NEVER LISTED");
+			}
+		}
+		tree.put("after crash", "1");
+		tree.flush();
+		tree.waitForCompactions();
+		std::string value;
+		if(tree.get("after crash", value) != STATUS_OK || tree.get("unflushed", value) != STATUS_OK || value != "1")
+		{
+			PRINT_ERROR("ERROR :: LSM TREE LOST WRITES AFTER A CRASH");
+		}
+	}
+	LsmTree::destroy(name);
+	if(File::exists(name + ".manifest"))
+	{
+		PRINT_ERROR("ERROR :: LSM TREE NOT DESTROYED");
+	}
+
+	std::cout << "Test 33 passed" << "\n";
+}
+
+void test34()
+{
+	//Keys spread over runs, the frozen and the live memtable, with some removed and overwritten
+	const std::string name = filePrefix + "test.34";
+	KVStore::destroy(name);
+	LsmOptions options;
+	options.memtable_bytes = 8192;
+	options.run_bytes = 32768;
+	options.level0_runs = 2;
+	options.level1_bytes = 131072;
+	options.level_ratio = 4;
+	{
+		KVStore store(name, options);
+		const int keys = 2000;
+		for (int i = 0; i < keys; i++)
+		{
+			sprintf((char*)tmpbuf, "k%05d", i);
+			store.put(tmpbuf, "old");
+		}
+		store.flush();
+		for (int i = 0; i < keys; i += 3)
+		{
+			sprintf((char*)tmpbuf, "k%05d", i);
+			store.put(tmpbuf, tmpbuf);
+		}
+		for (int i = 1; i < keys; i += 3)
+		{
+			sprintf((char*)tmpbuf, "k%05d", i);
+			store.remove(tmpbuf);
+		}
+		std::string value;
+		if(store.get("k00003", value) != STATUS_OK || value != "k00003" || store.get("k00004", value) != STATUS_NOT_FOUND || store.get("k00005", value) != STATUS_OK || value != "old")
+		{
+			PRINT_ERROR("ERROR :: WRONG VALUE IN KEY-VALUE STORE");
+		}
+
+		//A full scan sees every key left once, in order, with its newest value
+		int expected = 0;
+		bool ordered = true;
+		const std::size_t visited = store.scan("", "", [&](const std::string& key, const std::string& val) {
+			if(expected % 3 == 1)
+				expected++;
+			sprintf((char*)tmpbuf, "k%05d", expected);
+			ordered = ordered && key == tmpbuf && val == (expected % 3 == 0 ? key : std::string("old"));
+			expected++;
+			return true;
+		});
+		if(!ordered || visited != keys - (keys + 1) / 3)
+		{
+			PRINT_ERROR("ERROR :: KEY-VALUE STORE SCAN WRONG");
+		}
+
+		//Ranges end before their end key, stop at the limit, and see nothing written after they start
+		std::vector<std::pair<std::string, std::string> > range = store.scan("k00010", "k00016", 100);
+		if(range.size() != 4 || range[0].first != "k00011" || range[3].first != "k00015" || range[1].second != "k00012")
+		{
+			PRINT_ERROR("ERROR :: KEY-VALUE STORE RANGE SCAN WRONG");
+		}
+		if(store.scan("k01000", "", 5).size() != 5 || !store.scan("k99999", "", 5).empty() || !store.scan("", "", 0).empty())
+		{
+			PRINT_ERROR("ERROR :: KEY-VALUE STORE SCAN LIMIT WRONG");
+		}
+		std::size_t seen = store.scan("k00000", "k00100", [&](const std::string& key, const std::string&) {
+			store.put(key + "x", "new");
+			return true;
+		});
+		if(seen != store.scan("k00000", "k00100", 1000).size() / 2 || store.get("k00000x", value) != STATUS_OK)
+		{
+			PRINT_ERROR("ERROR :: KEY-VALUE STORE SCAN SAW ITS OWN WRITES");
+		}
+	}
+	KVStore::destroy(name);
+
+	std::cout << "Test 34 passed" << "\n";
+}
+
+void test35()
+{
+	//A memory file that grows past the spill limit moves to a temporary file and keeps its pages,
+	//also once pages are punched out of it or cut off its end
+	const std::uint64_t limit = 8 * Page::SIZE;
+	const std::string memoryName = std::string(File::MEMORY_PREFIX) + "test.35";
+	File::setMemorySpillLimit(limit);
+	File::setPunchFreedPages(true);
+	std::shared_ptr<MemoryBackend> memory = std::make_shared<MemoryBackend>(limit);
+	for (int round = 0; round < 2; round++)
+	{
+		//Once as a "mem:" file, once on a backend that tells whether it has spilled
+		File file35 = round == 0 ? File::create(memoryName) : File::create("test.35", memory);
+		PageId pageNumbers[32];
+		RecordId pageRids[32];
+		for (i = 0; i < 32; i++)
+		{
+			Page allocated = file35.allocatePage();
+			pageNumbers[i] = allocated.page_number();
+			sprintf((char*)tmpbuf, "test.35 Page %d", pageNumbers[i]);
+			pageRids[i] = allocated.insertRecord(tmpbuf);
+			file35.writePage(allocated);
+			if(round == 1 && memory->spilled() != (memory->size() > limit))
+			{
+				PRINT_ERROR("ERROR :: MEMORY FILE DID NOT SPILL AT ITS LIMIT");
+			}
+		}
+		if(round == 1 && !memory->spilled())
+		{
+			PRINT_ERROR("ERROR :: MEMORY FILE DID NOT SPILL");
+		}
+
+		for (i = 1; i < 10; i++)
+			file35.deletePage(pageNumbers[i]);
+		file35.deletePage(pageNumbers[31]);
+		for (i = 0; i < 31; i++)
+		{
+			if (i >= 1 && i < 10)
+				continue;
+			sprintf((char*)tmpbuf, "test.35 Page %d", pageNumbers[i]);
+			if(file35.readPage(pageNumbers[i]).getRecord(pageRids[i]) != tmpbuf)
+			{
+				PRINT_ERROR("ERROR :: SPILLED MEMORY FILE LOST A PAGE");
+			}
+		}
+
+		//Punched and cut off pages can be used again
+		for (i = 0; i < 10; i++)
+		{
+			Page reused = file35.allocatePage();
+			sprintf((char*)tmpbuf, "test.35 reused %d", reused.page_number());
+			const RecordId reusedRid = reused.insertRecord(tmpbuf);
+			file35.writePage(reused);
+			if(file35.readPage(reused.page_number()).getRecord(reusedRid) != tmpbuf)
+			{
+				PRINT_ERROR("ERROR :: REUSED PAGE OF A SPILLED MEMORY FILE LOST ITS DATA");
+			}
+		}
+	}
+	File::remove(memoryName);
+	File::setPunchFreedPages(false);
+	File::setMemorySpillLimit(0);
+
+	std::cout << "Test 35 passed" << "\n";
+}
@@ -64,10 +64,129 @@
  * @code
  *   $ ./src/badgerdb_main
  * @endcode
+ * Passing <code>mem:</code> as an argument runs the same tests against
+ * in-memory files.
  *
  * If you want to edit what <code>badgerdb_main</code> does, edit
  * <code>src/main.cpp</code>.
  *
+ * The benchmarks in <code>src/bench</code> are built with
+ * <code>make bench</code>.  <code>src/bench/bufmgr_stress</code> also checks
+ * the buffer manager under concurrent use; to run it under ThreadSanitizer,
+ * build it with CMake:
+ * @code
+ *   $ cmake -S . -B build-tsan -DBADGERDB_TSAN=ON
+ *   $ cmake --build build-tsan --target bufmgr_stress
+ *   $ ./build-tsan/bufmgr_stress 4 32
+ * @endcode
+ *
+ * BufMgr::snapshot() summarizes the state of a buffer pool without stopping
+ * it.  <code>make tools</code> builds <code>src/tools/bufstat</code>, which
+ * prints snapshots saved with BufPoolSnapshot::write(), and the rates between
+ * two of them.
+ *
+ * A BufMgr constructed with an IoScheduler reads missing pages without
+ * holding its latch and leaves write-back to the scheduler, which serves
+ * foreground reads before background writes, can rate limit each class and
+ * merges requests for adjacent pages.  <code>src/bench/io_scheduler_bench</code>
+ * compares read latency with and without it while the pool is checkpointed.
+ * BufMgr::readPageAsync() reads through the scheduler without blocking and
+ * hands the page to a callback run on an EventLoop;
+ * <code>src/bench/async_read_bench</code> measures it with many reads in
+ * flight.
+ *
+ * Indexes probing many pages at once can use BufMgr::pinResidentPages(),
+ * which interleaves the lookups with prefetching;
+ * <code>src/bench/lookup_batch_bench</code> measures it by batch size.
+ *
+ * Threads sharing a pinned page latch it shared or exclusive through
+ * BufMgr::readPage() and BufMgr::unPinPage() with a LatchMode, or
+ * BufMgr::latchPage(); see badgerdb::FrameLatch.
+ *
+ * Given an EpochManager, BufMgr::readResident() reads resident pages without
+ * the pool latch or a pin; freed frames are then reused only once no reader
+ * can still see their old page.  <code>src/bench/epoch_stress</code> checks
+ * this under heavy eviction and <code>src/bench/epoch_overhead</code> measures
+ * what it costs.
+ *
+ * BufMgr::readExtent() reads a run of consecutive pages into adjacent frames
+ * of the same pool, to be used as one 16 KiB or 64 KiB page;
+ * <code>src/bench/mixed_page_bench</code> compares sharing the pool between
+ * page sizes with splitting it.
+ *
+ * Structures that follow page references can keep them as PageRef objects.
+ * Reading through a PageRef swizzles it into a pointer to the frame, so
+ * later reads skip the hash table, until the page is evicted;
+ * <code>src/bench/swizzle_bench</code> measures tree traversals both ways.
+ *
+ * Pages remember which 512-byte sectors their changes touched, and dirty
+ * pages are written back one sector run at a time with
+ * File::writeDirtySectors(); <code>src/bench/dirty_sector_bench</code>
+ * measures the write amplification of small updates.
+ *
+ * Every open File counts its page and byte I/O, syncs and buffer pool hits
+ * and misses (File::stats()).  A MetricsExporter periodically writes these,
+ * along with how many frames of each pool every file holds, in the
+ * Prometheus text format to a local file or Unix socket;
+ * <code>src/bench/metrics_overhead</code> measures what counting costs.
+ *
+ * BufMgr::allocPage() formats new pages in their frames without any I/O;
+ * File::reservePage() sets their numbers aside, and they join the file when
+ * first written back.  <code>src/bench/alloc_page_bench</code> measures
+ * pages allocated per second.
+ *
+ * With File::setGrowthChunk(), files growing past their end are preallocated
+ * a whole chunk at a time with fallocate() and later pages are handed out
+ * from it; <code>src/bench/file_growth_bench</code> measures append
+ * throughput and the extents files end up in for several chunk sizes.
+ *
+ * With File::setPunchFreedPages(), deleted pages give their space back: the
+ * last page of a file is cut off and others are punched out, and
+ * File::reclaimFreeSpace() does the same in runs for pages deleted earlier;
+ * <code>src/bench/hole_punch_bench</code> reports disk usage after a bulk
+ * delete.
+ *
+ * Page, File, BufHashTbl and BufMgr have try* variants of their operations
+ * that return a badgerdb::Status for expected conditions, such as a full
+ * page or a missing page, instead of throwing;
+ * <code>src/bench/status_bench</code> compares the two in an insert loop.
+ *
+ * File and Page move without copying: a moved File hands over its reference
+ * to the open file, and pages are read and reserved in place where there is a
+ * page to reuse; <code>src/bench/page_copy_bench</code> counts the heap
+ * allocations and page buffers of the main.cpp workloads.
+ *
+ * Page::makeSorted() gives a page a directory of its records ordered by key,
+ * which Page::tryFindRecord() binary searches;
+ * <code>src/bench/sorted_page_bench</code> compares that with scanning.
+ *
+ * Page::makeFixedLength() formats a page for records of one length, kept in
+ * an array after a bitmap of the slots in use;
+ * <code>src/bench/fixed_page_bench</code> compares records per page and scans
+ * with slotted pages.
+ *
+ * Page::makePrefixCompressed() stores the prefix the records of a page share
+ * once and puts each record back together as it is read;
+ * <code>src/bench/prefix_page_bench</code> reports records per page and read
+ * cost on keys like <code>tenant/region/table/id</code>.
+ *
+ * LsmTree is a log-structured merge tree of byte-string keys: writes go to a
+ * log and a memtable, which is flushed to a SortedRun of prefix-compressed
+ * pages with a BloomFilter, and background threads compact the runs level by
+ * level; <code>src/bench/lsm_bench</code> compares its ingest and lookup
+ * rates with updating pages in place through the buffer manager.
+ *
+ * KVStore puts, gets, removes and scans ranges of byte-string keys, for
+ * programs that want to store data without building on BufMgr and Page.
+ * <code>make tools</code> also builds <code>src/tools/db_bench</code>, which
+ * runs fillseq, fillrandom, overwrite, readrandom and readseq against a store
+ * and reports operations per second and latency percentiles.
+ *
+ * Buffer manager, file and page operations carry tracing hooks that are
+ * compiled out unless you build with <code>make TRACE=1</code> (or
+ * <code>-DBADGERDB_TRACE=ON</code> with CMake).  See badgerdb::Tracer for
+ * turning them on at run time and exporting Chrome trace JSON.
+ *
  * @subsection documentation_sec Rebuilding the documentation
  *
  * Documentation is generated by using Doxygen.  If you have updated the
@@ -112,6 +231,13 @@
  *  badgerdb::File::remove("filename.db");
  * @endcode
  *
+ * Files whose names start with <code>mem:</code> are kept in memory instead of
+ * on disk until they are removed, which is useful for temporary and test data:
+ * @code
+ *  // Create a file that never touches the filesystem.
+ *  badgerdb::File tmp_file = badgerdb::File::create("mem:sort.run.1");
+ * @endcode
+ *
  * @subsubsection file_data_sec Reading and writing data in a file
  *
  * Data is added to a File by first allocating a Page, populating it with data,
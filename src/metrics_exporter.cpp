@@ -0,0 +1,260 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "metrics_exporter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "file.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Returns <value> escaped for use as a label value.
+ */
+std::string escapeLabel(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (std::size_t i = 0; i < value.size(); ++i) {
+    switch (value[i]) {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped += value[i];
+    }
+  }
+  return escaped;
+}
+
+/**
+ * Writes the HELP and TYPE lines of a metric.
+ */
+void describe(std::ostream& out, const char* name, const char* type,
+              const char* help) {
+  out << "# HELP " << name << " " << help << "\n"
+      << "# TYPE " << name << " " << type << "\n";
+}
+
+/**
+ * A per-file counter: its name, help text and where it is in a snapshot.
+ */
+struct FileCounter {
+  const char* name;
+  const char* help;
+  std::uint64_t FileStatsSnapshot::*value;
+};
+
+const FileCounter FILE_COUNTERS[] = {
+    {"badgerdb_file_page_reads_total", "Pages read from the file.",
+     &FileStatsSnapshot::page_reads},
+    {"badgerdb_file_page_writes_total", "Pages written to the file.",
+     &FileStatsSnapshot::page_writes},
+    {"badgerdb_file_read_bytes_total", "Bytes read from the file.",
+     &FileStatsSnapshot::bytes_read},
+    {"badgerdb_file_written_bytes_total", "Bytes written to the file.",
+     &FileStatsSnapshot::bytes_written},
+    {"badgerdb_file_syncs_total", "Times the file was made durable.",
+     &FileStatsSnapshot::syncs},
+    {"badgerdb_file_cache_hits_total",
+     "Buffer pool lookups that found a page of the file resident.",
+     &FileStatsSnapshot::cache_hits},
+    {"badgerdb_file_cache_misses_total",
+     "Buffer pool lookups that had to load a page of the file.",
+     &FileStatsSnapshot::cache_misses},
+};
+
+}
+
+MetricsExporter::MetricsExporter(const Target target, const std::string& path,
+                                 const std::chrono::milliseconds interval)
+    : target_(target),
+      path_(path),
+      interval_(interval),
+      stopping_(false),
+      exports_(0),
+      failures_(0) {
+  if (interval_.count() > 0) {
+    exporter_ = std::thread(&MetricsExporter::run, this);
+  }
+}
+
+MetricsExporter::~MetricsExporter() {
+  if (exporter_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    stop_cv_.notify_all();
+    exporter_.join();
+    exportNow();
+  }
+}
+
+void MetricsExporter::addPool(const std::string& name, BufMgr* pool) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pools_.push_back(std::make_pair(name, pool));
+}
+
+void MetricsExporter::removePool(BufMgr* pool) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < pools_.size(); ++i) {
+    if (pools_[i].second == pool) {
+      pools_.erase(pools_.begin() + i);
+      return;
+    }
+  }
+}
+
+std::string MetricsExporter::render() {
+  std::ostringstream out;
+  const std::vector<FileStatsSnapshot> files = File::allStats();
+  for (std::size_t c = 0; c < sizeof(FILE_COUNTERS) / sizeof(FILE_COUNTERS[0]);
+       ++c) {
+    const FileCounter& counter = FILE_COUNTERS[c];
+    describe(out, counter.name, "counter", counter.help);
+    for (std::size_t f = 0; f < files.size(); ++f) {
+      out << counter.name << "{file=\"" << escapeLabel(files[f].filename)
+          << "\"} " << files[f].*counter.value << "\n";
+    }
+  }
+
+  // Snapshots without the age histogram only take the pool latch once.
+  std::vector<std::pair<std::string, BufPoolSnapshot> > pools;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t p = 0; p < pools_.size(); ++p) {
+      pools.push_back(std::make_pair(escapeLabel(pools_[p].first),
+                                     pools_[p].second->snapshot(0)));
+    }
+  }
+  describe(out, "badgerdb_pool_frames", "gauge", "Frames in the pool.");
+  for (std::size_t p = 0; p < pools.size(); ++p) {
+    out << "badgerdb_pool_frames{pool=\"" << pools[p].first << "\"} "
+        << pools[p].second.frames << "\n";
+  }
+  describe(out, "badgerdb_pool_valid_frames", "gauge",
+           "Frames holding a page.");
+  for (std::size_t p = 0; p < pools.size(); ++p) {
+    out << "badgerdb_pool_valid_frames{pool=\"" << pools[p].first << "\"} "
+        << pools[p].second.valid << "\n";
+  }
+  describe(out, "badgerdb_pool_dirty_frames", "gauge",
+           "Frames holding a dirty page.");
+  for (std::size_t p = 0; p < pools.size(); ++p) {
+    out << "badgerdb_pool_dirty_frames{pool=\"" << pools[p].first << "\"} "
+        << pools[p].second.dirty << "\n";
+  }
+  describe(out, "badgerdb_pool_accesses_total", "counter",
+           "Page accesses to the pool.");
+  for (std::size_t p = 0; p < pools.size(); ++p) {
+    out << "badgerdb_pool_accesses_total{pool=\"" << pools[p].first << "\"} "
+        << pools[p].second.accesses << "\n";
+  }
+  describe(out, "badgerdb_pool_evictions_total", "counter",
+           "Pages evicted from the pool to make room.");
+  for (std::size_t p = 0; p < pools.size(); ++p) {
+    out << "badgerdb_pool_evictions_total{pool=\"" << pools[p].first << "\"} "
+        << pools[p].second.evictions << "\n";
+  }
+  describe(out, "badgerdb_pool_resident_pages", "gauge",
+           "Frames of the pool holding pages of the file.");
+  for (std::size_t p = 0; p < pools.size(); ++p) {
+    const std::vector<FileResidency>& resident = pools[p].second.files;
+    for (std::size_t f = 0; f < resident.size(); ++f) {
+      out << "badgerdb_pool_resident_pages{pool=\"" << pools[p].first
+          << "\",file=\"" << escapeLabel(resident[f].filename) << "\"} "
+          << resident[f].pages << "\n";
+    }
+  }
+  return out.str();
+}
+
+bool MetricsExporter::exportNow() {
+  const std::string text = render();
+  std::lock_guard<std::mutex> lock(export_mutex_);
+  const bool written =
+      target_ == TEXT_FILE ? writeFile(text) : writeSocket(text);
+  ++(written ? exports_ : failures_);
+  return written;
+}
+
+void MetricsExporter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+    lock.unlock();
+    exportNow();
+    lock.lock();
+  }
+}
+
+bool MetricsExporter::writeFile(const std::string& text) const {
+  // Readers see either the previous export or this one, never a partial one.
+  const std::string temporary = path_ + ".tmp";
+  {
+    std::ofstream out(temporary.c_str(), std::ios::out | std::ios::trunc);
+    out << text;
+    out.close();
+    if (!out) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), path_.c_str()) == 0;
+}
+
+bool MetricsExporter::writeSocket(const std::string& text) const {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path_.c_str(), path_.size());
+
+  const int socket_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    return false;
+  }
+  bool sent = ::connect(socket_fd, reinterpret_cast<sockaddr*>(&address),
+                        sizeof(address)) == 0;
+  std::size_t offset = 0;
+  while (sent && offset < text.size()) {
+    // MSG_NOSIGNAL: a collector that goes away must not kill the process.
+    const ssize_t n = ::send(socket_fd, text.data() + offset,
+                             text.size() - offset, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    sent = n > 0;
+    if (sent) {
+      offset += n;
+    }
+  }
+  ::close(socket_fd);
+  return sent;
+}
+
+}
@@ -0,0 +1,155 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace badgerdb {
+
+class BufMgr;
+
+/**
+ * @brief Periodically writes per-file I/O and cache metrics in the
+ *        Prometheus text format to a local file or Unix socket.
+ *
+ * Every export renders the counters of all open files (File::allStats()) and
+ * the occupancy of the buffer pools added with addPool(), including how many
+ * frames each file holds.  The target is either:
+ *
+ * - TEXT_FILE:    a file that is replaced atomically on every export, for a
+ *                 textfile collector or anything else that reads it.
+ * - UNIX_SOCKET:  a stream socket some collector listens on; each export
+ *                 connects, sends the text and closes.  An export with no one
+ *                 listening fails and is retried at the next interval.
+ *
+ * Nothing is sent over the network.  Failed exports are counted and otherwise
+ * ignored, so metrics never get in the way of the database.
+ */
+class MetricsExporter {
+ public:
+  /**
+   * Where the metrics go.
+   */
+  enum Target {
+    TEXT_FILE,
+    UNIX_SOCKET
+  };
+
+  /**
+   * Starts exporting to <path> every <interval>, until destroyed.  With a
+   * zero interval nothing is exported until exportNow() is called.
+   *
+   * @param target    Kind of target.
+   * @param path      Path of the file or socket.
+   * @param interval  Time between exports.
+   */
+  MetricsExporter(const Target target, const std::string& path,
+                  const std::chrono::milliseconds interval);
+
+  /**
+   * Stops exporting, after one last export if exports are periodic.
+   */
+  ~MetricsExporter();
+
+  /**
+   * Includes a buffer pool in the exports under <name>, until removePool().
+   *
+   * @param name  Value of the pool label.
+   * @param pool  Pool to export.
+   */
+  void addPool(const std::string& name, BufMgr* pool);
+
+  /**
+   * Stops including a buffer pool; call before destroying the pool.
+   *
+   * @param pool  Pool added with addPool().
+   */
+  void removePool(BufMgr* pool);
+
+  /**
+   * Returns the current metrics in the Prometheus text format.
+   */
+  std::string render();
+
+  /**
+   * Exports the current metrics now.
+   *
+   * @return  True if they reached the target.
+   */
+  bool exportNow();
+
+  /**
+   * Returns the number of exports that reached the target.
+   */
+  std::uint64_t exports() const { return exports_.load(); }
+
+  /**
+   * Returns the number of exports that failed.
+   */
+  std::uint64_t failures() const { return failures_.load(); }
+
+ private:
+  MetricsExporter(const MetricsExporter&);
+  MetricsExporter& operator=(const MetricsExporter&);
+
+  /**
+   * Body of the exporting thread.
+   */
+  void run();
+
+  /**
+   * Replaces the target file with <text>.
+   */
+  bool writeFile(const std::string& text) const;
+
+  /**
+   * Sends <text> to the target socket.
+   */
+  bool writeSocket(const std::string& text) const;
+
+  const Target target_;
+  const std::string path_;
+  const std::chrono::milliseconds interval_;
+
+  /**
+   * Pools to export with their names, guarded by <mutex_>.
+   */
+  std::vector<std::pair<std::string, BufMgr*> > pools_;
+
+  /**
+   * Guards <pools_> and <stopping_>.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Serializes writes to the target.
+   */
+  std::mutex export_mutex_;
+
+  /**
+   * Wakes the exporting thread to stop.
+   */
+  std::condition_variable stop_cv_;
+
+  bool stopping_;
+
+  std::atomic<std::uint64_t> exports_;
+  std::atomic<std::uint64_t> failures_;
+
+  std::thread exporter_;
+};
+
+}
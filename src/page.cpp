@@ -5,7 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <vector>
 
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
@@ -13,9 +16,19 @@
 #include "exceptions/slot_in_use_exception.h"
 #include "page_iterator.h"
 #include "page.h"
+#include "trace.h"
 
 namespace badgerdb {
 
+namespace {
+
+/**
+ * Bytes of a key kept in its PageKeySlot.
+ */
+const std::size_t KEY_PREFIX_SIZE = sizeof(std::uint32_t);
+
+}
+
 Page::Page() {
   initialize();
 }
@@ -27,44 +40,392 @@ void Page::initialize() {
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
+  header_.flags = 0;
+  header_.record_length = 0;
   data_.assign(DATA_SIZE, char());
+  dirty_sectors_ = ALL_SECTORS;
 }
 
 RecordId Page::insertRecord(const std::string& record_data) {
-  if (!hasSpaceForRecord(record_data)) {
+  RecordId record_id;
+  if (tryInsertRecord(record_data, record_id) != STATUS_OK) {
     throw InsufficientSpaceException(
         page_number(), record_data.length(), getFreeSpace());
   }
-  const SlotId slot_number = getAvailableSlot();
-  insertRecordInSlot(slot_number, record_data);
-  return {page_number(), slot_number};
+  return record_id;
+}
+
+Status Page::tryInsertRecord(const std::string& record_data,
+                             RecordId& record_id) {
+  BADGERDB_TRACE_SPAN(TRACE_ALL, "page", "Page::insertRecord");
+  return insertKeyedRecord(record_data, record_data.length(), record_id);
+}
+
+RecordId Page::insertRecord(const std::string& key, const std::string& value) {
+  RecordId record_id;
+  if (tryInsertRecord(key, value, record_id) != STATUS_OK) {
+    throw InsufficientSpaceException(
+        page_number(), key.length() + value.length(), getFreeSpace());
+  }
+  return record_id;
+}
+
+Status Page::tryInsertRecord(const std::string& key, const std::string& value,
+                             RecordId& record_id) {
+  BADGERDB_TRACE_SPAN(TRACE_ALL, "page", "Page::insertRecord");
+  makeSorted();
+  return insertKeyedRecord(key + value, key.length(), record_id);
+}
+
+Status Page::insertKeyedRecord(const std::string& record_data,
+                               const std::size_t key_length,
+                               RecordId& record_id) {
+  if (!hasSpaceForKeyedRecord(record_data, key_length)) {
+    return STATUS_INSUFFICIENT_SPACE;
+  }
+  SlotId slot_number;
+  if (isFixedLength()) {
+    slot_number = firstFreeFixedSlot();
+    setFixedSlotUsed(slot_number, true);
+    writeFixedRecord(slot_number, record_data);
+  } else if (isPrefixCompressed()) {
+    const std::size_t prefix_length =
+        prefixFor(record_data, key_length, INVALID_SLOT);
+    if (prefix_length != prefixLength() ||
+        record_data.compare(0, prefix_length, prefixData(),
+                            prefix_length) != 0) {
+      setPrefix(record_data.substr(0, prefix_length));
+    }
+    slot_number = getAvailableSlot();
+    insertRecordInSlot(slot_number, record_data.substr(prefix_length));
+  } else {
+    slot_number = getAvailableSlot();
+    insertRecordInSlot(slot_number, record_data);
+  }
+  if (isSorted()) {
+    // After any records with the same key, so they stay in insertion order.
+    const PageKeySlot entry = makeKeySlot(slot_number, key_length);
+    insertKeySlot(keyBound(record_data.data(), key_length, true /* upper */),
+                  entry);
+  }
+  record_id.page_number = page_number();
+  record_id.slot_number = slot_number;
+  return STATUS_OK;
+}
+
+void Page::makeSorted() {
+  if (isSorted() || isFixedLength()) {
+    return;
+  }
+  std::vector<PageKeySlot> entries;
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    const PageSlot* slot = getSlot(i);
+    if (slot->used) {
+      entries.push_back(makeKeySlot(i, prefixLength() + slot->item_length));
+    }
+  }
+  const std::size_t directory_size = entries.size() * sizeof(PageKeySlot);
+  if (directory_size > getFreeSpace()) {
+    throw InsufficientSpaceException(page_number(), directory_size,
+                                     getFreeSpace());
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [this](const PageKeySlot& a, const PageKeySlot& b) {
+    return compareKey(a, &data_[getSlot(b.slot_number)->item_offset],
+                      b.key_length, b.key_prefix) < 0;
+  });
+  if (!entries.empty()) {
+    std::memcpy(&data_[header_.free_space_lower_bound], &entries[0],
+                directory_size);
+    markDataDirty(header_.free_space_lower_bound, directory_size);
+  }
+  header_.free_space_lower_bound += directory_size;
+  header_.flags |= SORTED_FLAG;
+  dirty_sectors_ |= 1;
+}
+
+Status Page::tryFindRecord(const std::string& key,
+                           RecordId& record_id) const {
+  BADGERDB_TRACE_SPAN(TRACE_ALL, "page", "Page::findRecord");
+  // Every record of a prefix-compressed page starts with its prefix.
+  const std::size_t prefix_length = prefixLength();
+  if (prefix_length > 0 &&
+      key.compare(0, prefix_length, prefixData(), prefix_length) != 0) {
+    return STATUS_NOT_FOUND;
+  }
+  if (!isSorted()) {
+    // Records of a fixed-length page are stored padded with zeros, so the
+    // key is padded the same way.
+    std::string padded;
+    if (isFixedLength()) {
+      if (key.length() > header_.record_length) {
+        return STATUS_NOT_FOUND;
+      }
+      padded = key;
+      padded.resize(header_.record_length, '\0');
+    }
+    for (SlotId i = nextUsedSlot(INVALID_SLOT); i != INVALID_SLOT;
+         i = nextUsedSlot(i)) {
+      const bool equal = isFixedLength()
+          ? data_.compare(fixedRecordOffset(i), header_.record_length,
+                          padded) == 0
+          : data_.compare(getSlot(i).item_offset, getSlot(i).item_length,
+                          key, prefix_length, std::string::npos) == 0;
+      if (equal) {
+        record_id.page_number = page_number();
+        record_id.slot_number = i;
+        return STATUS_OK;
+      }
+    }
+    return STATUS_NOT_FOUND;
+  }
+  const std::size_t position =
+      keyBound(key.data(), key.length(), false /* upper */);
+  if (position == keyCount()) {
+    return STATUS_NOT_FOUND;
+  }
+  const PageKeySlot entry = getKeySlot(position);
+  const char* suffix = key.data() + prefix_length;
+  const std::size_t suffix_length = key.length() - prefix_length;
+  if (compareKey(entry, suffix, suffix_length,
+                 keyPrefix(suffix, suffix_length)) != 0) {
+    return STATUS_NOT_FOUND;
+  }
+  record_id.page_number = page_number();
+  record_id.slot_number = entry.slot_number;
+  return STATUS_OK;
+}
+
+std::size_t Page::keyCount() const {
+  return (header_.free_space_lower_bound - keyDirectoryOffset()) /
+      sizeof(PageKeySlot);
+}
+
+std::size_t Page::lowerBound(const std::string& key) const {
+  return keyBound(key.data(), key.length(), false /* upper */);
+}
+
+void Page::makeFixedLength(const std::uint16_t record_length) {
+  assert(record_length > 0);
+  const SlotId used_slot = nextUsedSlot(INVALID_SLOT);
+  if (used_slot != INVALID_SLOT) {
+    throw SlotInUseException(page_number(), used_slot);
+  }
+  // As many records as fit with a bit each in the bitmap.
+  std::size_t capacity = DATA_SIZE * 8 / (record_length * 8 + 1);
+  while (capacity > 0 &&
+         (capacity + 7) / 8 + capacity * record_length > DATA_SIZE) {
+    --capacity;
+  }
+  if (capacity == 0) {
+    throw InsufficientSpaceException(page_number(), record_length,
+                                     getFreeSpace());
+  }
+  data_.assign(DATA_SIZE, char());
+  header_.flags = FIXED_LENGTH_FLAG;
+  header_.record_length = record_length;
+  header_.num_slots = capacity;
+  header_.num_free_slots = capacity;
+  // The bounds enclose what is left after the record array.
+  header_.free_space_lower_bound = fixedRecordOffset(capacity + 1);
+  header_.free_space_upper_bound = DATA_SIZE;
+  dirty_sectors_ = ALL_SECTORS;
+}
+
+void Page::makePrefixCompressed() {
+  if (isPrefixCompressed() || isFixedLength()) {
+    return;
+  }
+  // The longest prefix of every record, and of every key of a sorted page.
+  std::string prefix;
+  std::size_t records = 0;
+  for (SlotId i = nextUsedSlot(INVALID_SLOT); i != INVALID_SLOT;
+       i = nextUsedSlot(i)) {
+    const PageSlot* slot = getSlot(i);
+    if (records++ == 0) {
+      prefix.assign(data_, slot->item_offset, slot->item_length);
+      continue;
+    }
+    std::size_t length = 0;
+    while (length < prefix.length() && length < slot->item_length &&
+           prefix[length] == data_[slot->item_offset + length]) {
+      ++length;
+    }
+    prefix.resize(length);
+  }
+  for (std::size_t position = 0; position < keyCount(); ++position) {
+    prefix.resize(std::min<std::size_t>(prefix.length(),
+                                        getKeySlot(position).key_length));
+  }
+  // The records give up the prefix, which is stored once with its length.
+  const std::size_t space = sizeof(std::uint16_t) + prefix.length();
+  if (space > getFreeSpace() + records * prefix.length()) {
+    throw InsufficientSpaceException(page_number(), space, getFreeSpace());
+  }
+  setPrefix(prefix);
+}
+
+std::size_t Page::prefixLength() const {
+  if (!isPrefixCompressed()) {
+    return 0;
+  }
+  std::uint16_t length;
+  std::memcpy(&length, &data_[DATA_SIZE - sizeof(length)], sizeof(length));
+  return length;
+}
+
+RecordId Page::recordAt(const std::size_t position) const {
+  assert(position < keyCount());
+  const RecordId record_id = {page_number(),
+                              getKeySlot(position).slot_number};
+  return record_id;
 }
 
 std::string Page::getRecord(const RecordId& record_id) const {
-  validateRecordId(record_id);
+  std::string record_data;
+  if (tryGetRecord(record_id, record_data) != STATUS_OK) {
+    throw InvalidRecordException(record_id, page_number());
+  }
+  return record_data;
+}
+
+Status Page::tryGetRecord(const RecordId& record_id,
+                          std::string& record_data) const {
+  BADGERDB_TRACE_SPAN(TRACE_ALL, "page", "Page::getRecord");
+  if (!isValidRecordId(record_id)) {
+    return STATUS_INVALID_RECORD;
+  }
+  if (isFixedLength()) {
+    record_data.assign(data_, fixedRecordOffset(record_id.slot_number),
+                       header_.record_length);
+    return STATUS_OK;
+  }
   const PageSlot& slot = getSlot(record_id.slot_number);
-  return data_.substr(slot.item_offset, slot.item_length);
+  if (isPrefixCompressed()) {
+    record_data.assign(prefixData(), prefixLength());
+    record_data.append(data_, slot.item_offset, slot.item_length);
+    return STATUS_OK;
+  }
+  record_data.assign(data_, slot.item_offset, slot.item_length);
+  return STATUS_OK;
 }
 
 void Page::updateRecord(const RecordId& record_id,
                         const std::string& record_data) {
-  validateRecordId(record_id);
+  switch (tryUpdateRecord(record_id, record_data)) {
+    case STATUS_INVALID_RECORD:
+      throw InvalidRecordException(record_id, page_number());
+    case STATUS_INSUFFICIENT_SPACE:
+      throw InsufficientSpaceException(
+          page_number(), record_data.length(),
+          isFixedLength()
+              ? header_.record_length
+              : getFreeSpace() + getSlot(record_id.slot_number)->item_length);
+    default:
+      break;
+  }
+}
+
+Status Page::tryUpdateRecord(const RecordId& record_id,
+                             const std::string& record_data) {
+  BADGERDB_TRACE_SPAN(TRACE_ALL, "page", "Page::updateRecord");
+  if (!isValidRecordId(record_id)) {
+    return STATUS_INVALID_RECORD;
+  }
+  if (isFixedLength()) {
+    if (record_data.length() > header_.record_length) {
+      return STATUS_INSUFFICIENT_SPACE;
+    }
+    writeFixedRecord(record_id.slot_number, record_data);
+    return STATUS_OK;
+  }
   const PageSlot* slot = getSlot(record_id.slot_number);
+  std::size_t key_length = record_data.length();
+  std::size_t position = 0;
+  if (isSorted()) {
+    // A record keyed by its whole contents stays so; any other keeps the
+    // length of its key.
+    position = findKeySlot(record_id.slot_number);
+    const std::size_t old_key_length = getKeySlot(position).key_length;
+    if (old_key_length != slot->item_length) {
+      key_length = std::min<std::size_t>(prefixLength() + old_key_length,
+                                         record_data.length());
+    }
+  }
+  std::size_t prefix_length = 0;
+  std::ptrdiff_t record_size = record_data.length();
+  if (isPrefixCompressed()) {
+    prefix_length = prefixFor(record_data, key_length, record_id.slot_number);
+    record_size =
+        prefixedRecordSpace(record_data, prefix_length, record_id.slot_number);
+  }
   const std::size_t free_space_after_delete =
       getFreeSpace() + slot->item_length;
-  if (record_data.length() > free_space_after_delete) {
-    throw InsufficientSpaceException(
-        page_number(), record_data.length(), free_space_after_delete);
+  if (record_size > static_cast<std::ptrdiff_t>(free_space_after_delete)) {
+    return STATUS_INSUFFICIENT_SPACE;
+  }
+  // The key may change with the record, so take its entry out of the key
+  // directory and put it back where the new key belongs.
+  if (isSorted()) {
+    removeKeySlot(position);
+  }
+  std::string suffix;
+  const std::string* stored = &record_data;
+  if (isPrefixCompressed()) {
+    if (prefix_length != prefixLength() ||
+        record_data.compare(0, prefix_length, prefixData(),
+                            prefix_length) != 0) {
+      // The other records grow into the space this one leaves, so it goes
+      // before the prefix changes.
+      deleteRecord(record_id, false /* allow_slot_compaction */);
+      setPrefix(record_data.substr(0, prefix_length));
+    }
+    suffix.assign(record_data, prefix_length, std::string::npos);
+    stored = &suffix;
+  }
+  if (slot->used && stored->length() == slot->item_length) {
+    // A record of the same length is overwritten where it is, which changes
+    // nothing else on the page.
+    data_.replace(slot->item_offset, slot->item_length, *stored);
+    markDataDirty(slot->item_offset, slot->item_length);
+  } else {
+    // We have to disallow slot compaction here because we're going to place
+    // the record data in the same slot, and compaction might delete the slot
+    // if we permit it.
+    if (slot->used) {
+      deleteRecord(record_id, false /* allow_slot_compaction */);
+    }
+    insertRecordInSlot(record_id.slot_number, *stored);
+  }
+  if (isSorted()) {
+    const PageKeySlot entry = makeKeySlot(record_id.slot_number, key_length);
+    insertKeySlot(keyBound(record_data.data(), key_length, true /* upper */),
+                  entry);
   }
-  // We have to disallow slot compaction here because we're going to place the
-  // record data in the same slot, and compaction might delete the slot if we
-  // permit it.
-  deleteRecord(record_id, false /* allow_slot_compaction */);
-  insertRecordInSlot(record_id.slot_number, record_data);
+  return STATUS_OK;
 }
 
 void Page::deleteRecord(const RecordId& record_id) {
+  if (tryDeleteRecord(record_id) != STATUS_OK) {
+    throw InvalidRecordException(record_id, page_number());
+  }
+}
+
+Status Page::tryDeleteRecord(const RecordId& record_id) {
+  BADGERDB_TRACE_SPAN(TRACE_ALL, "page", "Page::deleteRecord");
+  if (!isValidRecordId(record_id)) {
+    return STATUS_INVALID_RECORD;
+  }
+  if (isFixedLength()) {
+    setFixedSlotUsed(record_id.slot_number, false);
+    writeFixedRecord(record_id.slot_number, std::string());
+    return STATUS_OK;
+  }
+  if (isSorted()) {
+    removeKeySlot(findKeySlot(record_id.slot_number));
+  }
   deleteRecord(record_id, true /* allow_slot_compaction */);
+  return STATUS_OK;
 }
 
 void Page::deleteRecord(const RecordId& record_id,
@@ -72,6 +433,8 @@ void Page::deleteRecord(const RecordId& record_id,
   validateRecordId(record_id);
   PageSlot* slot = getSlot(record_id.slot_number);
   data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
+  markDataDirty(slot->item_offset, slot->item_length);
+  markSlotDirty(record_id.slot_number);
 
   // Compact the data by removing the hole left by this record (if necessary).
   std::uint16_t move_offset = slot->item_offset; 
@@ -86,12 +449,14 @@ void Page::deleteRecord(const RecordId& record_id,
       // Update the slot for the other data to reflect the soon-to-be-new
       // location.
       other_slot->item_offset += slot->item_length;
+      markSlotDirty(i);
     }
   }
   // If we have data to move, shift it to the right.
   if (move_bytes > 0) {
     const std::string& data_to_move = data_.substr(move_offset, move_bytes);
     data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+    markDataDirty(move_offset, move_bytes + slot->item_length);
   }
   header_.free_space_upper_bound += slot->item_length;
 
@@ -116,18 +481,118 @@ void Page::deleteRecord(const RecordId& record_id,
         break;
       }
     }
+    const std::size_t removed = sizeof(PageSlot) * num_slots_to_delete;
     header_.num_slots -= num_slots_to_delete;
     header_.num_free_slots -= num_slots_to_delete;
-    header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
+    // Move the key directory of a sorted page down to the slot array.
+    const std::size_t offset = keyDirectoryOffset();
+    const std::size_t directory_size =
+        header_.free_space_lower_bound - offset - removed;
+    if (directory_size > 0) {
+      std::memmove(&data_[offset], &data_[offset + removed], directory_size);
+      std::memset(&data_[offset + directory_size], 0, removed);
+      markDataDirty(offset, directory_size + removed);
+    }
+    header_.free_space_lower_bound -= removed;
   }
 }
 
 bool Page::hasSpaceForRecord(const std::string& record_data) const {
-  std::size_t record_size = record_data.length();
+  return hasSpaceForKeyedRecord(record_data, record_data.length());
+}
+
+bool Page::hasSpaceForKeyedRecord(const std::string& record_data,
+                                  const std::size_t key_length) const {
+  if (isFixedLength()) {
+    return header_.num_free_slots > 0 &&
+        record_data.length() <= header_.record_length;
+  }
+  std::ptrdiff_t record_size = record_data.length();
+  if (isPrefixCompressed()) {
+    record_size = prefixedRecordSpace(
+        record_data, prefixFor(record_data, key_length, INVALID_SLOT),
+        INVALID_SLOT);
+  }
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
   }
-  return record_size <= getFreeSpace();
+  if (isSorted()) {
+    record_size += sizeof(PageKeySlot);
+  }
+  return record_size <= static_cast<std::ptrdiff_t>(getFreeSpace());
+}
+
+std::size_t Page::prefixFor(const std::string& record_data,
+                            const std::size_t key_length,
+                            const SlotId replaced) const {
+  const std::size_t others = header_.num_slots - header_.num_free_slots -
+      (replaced != INVALID_SLOT ? 1 : 0);
+  if (others == 0) {
+    return key_length;
+  }
+  const std::size_t limit = std::min(prefixLength(), key_length);
+  const char* prefix = prefixData();
+  std::size_t length = 0;
+  while (length < limit && record_data[length] == prefix[length]) {
+    ++length;
+  }
+  return length;
+}
+
+std::ptrdiff_t Page::prefixedRecordSpace(const std::string& record_data,
+                                         const std::size_t prefix_length,
+                                         const SlotId replaced) const {
+  const std::ptrdiff_t others = header_.num_slots - header_.num_free_slots -
+      (replaced != INVALID_SLOT ? 1 : 0);
+  // Bytes taken off the prefix, which each other record takes back.
+  const std::ptrdiff_t cut = static_cast<std::ptrdiff_t>(prefixLength()) -
+      static_cast<std::ptrdiff_t>(prefix_length);
+  return others * cut - cut +
+      static_cast<std::ptrdiff_t>(record_data.length() - prefix_length);
+}
+
+void Page::setPrefix(const std::string& prefix) {
+  const std::size_t old_length = prefixLength();
+  if (isPrefixCompressed() && prefix.length() == old_length &&
+      prefix.compare(0, old_length, prefixData(), old_length) == 0) {
+    return;
+  }
+  // Put every record back together, then store it without the new prefix.
+  std::vector<std::string> records(header_.num_slots + 1);
+  for (SlotId i = nextUsedSlot(INVALID_SLOT); i != INVALID_SLOT;
+       i = nextUsedSlot(i)) {
+    const PageSlot* slot = getSlot(i);
+    records[i].assign(prefixData(), old_length);
+    records[i].append(data_, slot->item_offset, slot->item_length);
+    records[i].erase(0, prefix.length());
+  }
+  std::memset(&data_[header_.free_space_upper_bound], 0,
+              DATA_SIZE - header_.free_space_upper_bound);
+  const std::uint16_t length = prefix.length();
+  std::size_t offset = DATA_SIZE - sizeof(length);
+  std::memcpy(&data_[offset], &length, sizeof(length));
+  offset -= prefix.length();
+  data_.replace(offset, prefix.length(), prefix);
+  header_.flags |= PREFIX_FLAG;
+  for (SlotId i = nextUsedSlot(INVALID_SLOT); i != INVALID_SLOT;
+       i = nextUsedSlot(i)) {
+    PageSlot* slot = getSlot(i);
+    slot->item_length = records[i].length();
+    offset -= records[i].length();
+    slot->item_offset = offset;
+    data_.replace(offset, records[i].length(), records[i]);
+  }
+  header_.free_space_upper_bound = offset;
+  // Keys keep their order; their entries lose the new prefix instead.
+  for (std::size_t position = 0; position < keyCount(); ++position) {
+    const PageKeySlot old_entry = getKeySlot(position);
+    const PageKeySlot entry = makeKeySlot(
+        old_entry.slot_number, old_length + old_entry.key_length);
+    std::memcpy(
+        &data_[keyDirectoryOffset() + position * sizeof(PageKeySlot)],
+        &entry, sizeof(entry));
+  }
+  dirty_sectors_ = ALL_SECTORS;
 }
 
 PageSlot* Page::getSlot(const SlotId slot_number) {
@@ -154,11 +619,21 @@ SlotId Page::getAvailableSlot() {
       }
     }
   } else {
-    // Have to allocate a new slot.
+    // Have to allocate a new slot.  The key directory of a sorted page
+    // follows the slot array, so move it up to make room.
+    const std::size_t offset = keyDirectoryOffset();
+    const std::size_t directory_size = header_.free_space_lower_bound - offset;
+    if (directory_size > 0) {
+      std::memmove(&data_[offset + sizeof(PageSlot)], &data_[offset],
+                   directory_size);
+      std::memset(&data_[offset], 0, sizeof(PageSlot));
+      markDataDirty(offset, directory_size + sizeof(PageSlot));
+    }
     slot_number = header_.num_slots + 1;
     ++header_.num_slots;
     ++header_.num_free_slots;
-    header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    header_.free_space_lower_bound += sizeof(PageSlot);
+    dirty_sectors_ |= 1;
   }
   assert(slot_number != INVALID_SLOT);
   return static_cast<SlotId>(slot_number);
@@ -181,16 +656,221 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
   data_.replace(slot->item_offset, slot->item_length, record_data);
+  markSlotDirty(slot_number);
+  markDataDirty(slot->item_offset, slot->item_length);
 }
 
 void Page::validateRecordId(const RecordId& record_id) const {
-  if (record_id.page_number != page_number()) {
+  if (!isValidRecordId(record_id)) {
     throw InvalidRecordException(record_id, page_number());
   }
-  const PageSlot& slot = getSlot(record_id.slot_number);
-  if (!slot.used) {
-    throw InvalidRecordException(record_id, page_number());
+}
+
+bool Page::isValidRecordId(const RecordId& record_id) const {
+  if (record_id.page_number != page_number()) {
+    return false;
+  }
+  if (isFixedLength()) {
+    return record_id.slot_number != INVALID_SLOT &&
+        record_id.slot_number <= header_.num_slots &&
+        isSlotUsed(record_id.slot_number);
+  }
+  return getSlot(record_id.slot_number).used;
+}
+
+bool Page::isSlotUsed(const SlotId slot_number) const {
+  if (isFixedLength()) {
+    const std::size_t bit = slot_number - 1;
+    return (static_cast<unsigned char>(data_[bit / 8]) >> (bit % 8)) & 1;
+  }
+  return getSlot(slot_number).used;
+}
+
+SlotId Page::nextUsedSlot(const SlotId start) const {
+  if (isFixedLength()) {
+    // Slot n is bit n - 1; look at the bitmap a byte at a time, skipping
+    // bytes with no slot in use.  Bits past the last slot are never set.
+    std::size_t bit = start;
+    while (bit < header_.num_slots) {
+      unsigned char byte = static_cast<unsigned char>(data_[bit / 8]) >>
+          (bit % 8);
+      if (byte == 0) {
+        bit = (bit / 8 + 1) * 8;
+        continue;
+      }
+      while ((byte & 1) == 0) {
+        byte >>= 1;
+        ++bit;
+      }
+      return static_cast<SlotId>(bit + 1);
+    }
+    return INVALID_SLOT;
+  }
+  for (SlotId i = start + 1; i <= header_.num_slots; ++i) {
+    if (getSlot(i).used) {
+      return i;
+    }
+  }
+  return INVALID_SLOT;
+}
+
+SlotId Page::firstFreeFixedSlot() const {
+  // Bits past the last slot are clear too, but a free slot comes first.
+  assert(header_.num_free_slots > 0);
+  std::size_t byte_index = 0;
+  while (static_cast<unsigned char>(data_[byte_index]) == 0xff) {
+    ++byte_index;
+  }
+  unsigned char byte = static_cast<unsigned char>(data_[byte_index]);
+  std::size_t bit = byte_index * 8;
+  while ((byte & 1) != 0) {
+    byte >>= 1;
+    ++bit;
+  }
+  assert(bit < header_.num_slots);
+  return static_cast<SlotId>(bit + 1);
+}
+
+void Page::setFixedSlotUsed(const SlotId slot_number, const bool used) {
+  const std::size_t bit = slot_number - 1;
+  const char mask = static_cast<char>(1 << (bit % 8));
+  if (used) {
+    data_[bit / 8] |= mask;
+    --header_.num_free_slots;
+  } else {
+    data_[bit / 8] &= ~mask;
+    ++header_.num_free_slots;
+  }
+  markDataDirty(bit / 8, 1);
+  dirty_sectors_ |= 1;
+}
+
+void Page::writeFixedRecord(const SlotId slot_number,
+                            const std::string& record_data) {
+  const std::size_t offset = fixedRecordOffset(slot_number);
+  const std::size_t length = record_data.length();
+  data_.replace(offset, length, record_data);
+  data_.replace(offset + length, header_.record_length - length,
+                header_.record_length - length, '\0');
+  markDataDirty(offset, header_.record_length);
+}
+
+PageKeySlot Page::getKeySlot(const std::size_t position) const {
+  // Entries follow 6-byte slots, so they need not be aligned.
+  PageKeySlot entry;
+  std::memcpy(&entry,
+              &data_[keyDirectoryOffset() + position * sizeof(PageKeySlot)],
+              sizeof(entry));
+  return entry;
+}
+
+PageKeySlot Page::makeKeySlot(const SlotId slot_number,
+                              const std::size_t key_length) const {
+  PageKeySlot entry;
+  entry.slot_number = slot_number;
+  entry.key_length = key_length - prefixLength();
+  entry.key_prefix =
+      keyPrefix(&data_[getSlot(slot_number).item_offset], entry.key_length);
+  return entry;
+}
+
+void Page::insertKeySlot(const std::size_t position,
+                         const PageKeySlot& entry) {
+  const std::size_t offset =
+      keyDirectoryOffset() + position * sizeof(PageKeySlot);
+  const std::size_t tail = header_.free_space_lower_bound - offset;
+  std::memmove(&data_[offset + sizeof(PageKeySlot)], &data_[offset], tail);
+  std::memcpy(&data_[offset], &entry, sizeof(entry));
+  header_.free_space_lower_bound += sizeof(PageKeySlot);
+  markDataDirty(offset, tail + sizeof(PageKeySlot));
+  dirty_sectors_ |= 1;
+}
+
+void Page::removeKeySlot(const std::size_t position) {
+  const std::size_t offset =
+      keyDirectoryOffset() + position * sizeof(PageKeySlot);
+  const std::size_t tail =
+      header_.free_space_lower_bound - offset - sizeof(PageKeySlot);
+  std::memmove(&data_[offset], &data_[offset + sizeof(PageKeySlot)], tail);
+  std::memset(&data_[offset + tail], 0, sizeof(PageKeySlot));
+  header_.free_space_lower_bound -= sizeof(PageKeySlot);
+  markDataDirty(offset, tail + sizeof(PageKeySlot));
+  dirty_sectors_ |= 1;
+}
+
+std::size_t Page::findKeySlot(const SlotId slot_number) const {
+  const std::size_t count = keyCount();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (getKeySlot(i).slot_number == slot_number) {
+      return i;
+    }
+  }
+  assert(false);
+  return count;
+}
+
+std::size_t Page::keyBound(const char* key, std::size_t length,
+                           const bool upper) const {
+  // Every key of a prefix-compressed page starts with its prefix, so a key
+  // that does not comes before or after all of them.
+  const std::size_t prefix_length = prefixLength();
+  if (prefix_length > 0) {
+    const int result = std::memcmp(
+        key, prefixData(), std::min(length, prefix_length));
+    if (result > 0) {
+      return keyCount();
+    }
+    if (result < 0 || length < prefix_length) {
+      return 0;
+    }
+    key += prefix_length;
+    length -= prefix_length;
+  }
+  const std::uint32_t prefix = keyPrefix(key, length);
+  std::size_t low = 0;
+  std::size_t high = keyCount();
+  while (low < high) {
+    const std::size_t middle = low + (high - low) / 2;
+    const int result = compareKey(getKeySlot(middle), key, length, prefix);
+    if (result < 0 || (upper && result == 0)) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+int Page::compareKey(const PageKeySlot& entry, const char* key,
+                     const std::size_t length,
+                     const std::uint32_t prefix) const {
+  if (entry.key_prefix != prefix) {
+    return entry.key_prefix < prefix ? -1 : 1;
+  }
+  // Equal prefixes mean the bytes they hold are equal, so skip them.
+  const std::size_t common = std::min<std::size_t>(entry.key_length, length);
+  const std::size_t skip = std::min(common, KEY_PREFIX_SIZE);
+  const int result =
+      std::memcmp(&data_[getSlot(entry.slot_number).item_offset] + skip,
+                  key + skip, common - skip);
+  if (result != 0) {
+    return result;
+  }
+  if (entry.key_length == length) {
+    return 0;
+  }
+  return entry.key_length < length ? -1 : 1;
+}
+
+std::uint32_t Page::keyPrefix(const char* key, const std::size_t length) {
+  std::uint32_t prefix = 0;
+  for (std::size_t i = 0; i < KEY_PREFIX_SIZE; ++i) {
+    prefix <<= 8;
+    if (i < length) {
+      prefix |= static_cast<unsigned char>(key[i]);
+    }
   }
+  return prefix;
 }
 
 PageIterator Page::begin() {
@@ -12,6 +12,7 @@
 #include <memory>
 #include <string>
 
+#include "status.h"
 #include "types.h"
 
 namespace badgerdb {
@@ -20,7 +21,9 @@ namespace badgerdb {
  * @brief Header metadata in a page.
  *
  * Header metadata in each page which tracks where space has been used and
- * contains a pointer to the next page in the file.
+ * contains a pointer to the next page in the file.  It is stored as is, so
+ * changing it changes the layout of files and needs a new
+ * File::FORMAT_VERSION.
  */
 struct PageHeader {
   /**
@@ -57,6 +60,17 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Format of the page; see Page::SORTED_FLAG, Page::FIXED_LENGTH_FLAG and
+   * Page::PREFIX_FLAG.
+   */
+  std::uint16_t flags;
+
+  /**
+   * Length of every record of a fixed-length page; zero for other pages.
+   */
+  std::uint16_t record_length;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -67,7 +81,9 @@ struct PageHeader {
     return num_slots == rhs.num_slots &&
         num_free_slots == rhs.num_free_slots &&
         current_page_number == rhs.current_page_number &&
-        next_page_number == rhs.next_page_number;
+        next_page_number == rhs.next_page_number &&
+        flags == rhs.flags &&
+        record_length == rhs.record_length;
   }
 };
 
@@ -92,6 +108,32 @@ struct PageSlot {
   std::uint16_t item_length;
 };
 
+/**
+ * @brief Entry of the key directory of a sorted page.
+ *
+ * A sorted page keeps one entry per record, in the order of the records'
+ * keys, right after its slot array.  The key of a record is its first
+ * <key_length> bytes.  The first bytes of the key are copied into the entry,
+ * so most comparisons of a binary search stay in the directory.
+ */
+struct PageKeySlot {
+  /**
+   * Slot of the record.
+   */
+  SlotId slot_number;
+
+  /**
+   * Length of the key at the start of the record.
+   */
+  std::uint16_t key_length;
+
+  /**
+   * First four bytes of the key, big-endian and padded with zeros, so
+   * prefixes compare as the bytes do.
+   */
+  std::uint32_t key_prefix;
+};
+
 class PageIterator;
 
 /**
@@ -117,6 +159,22 @@ class Page {
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
+  /**
+   * Granularity of dirty tracking in bytes: a disk sector.
+   */
+  static const std::size_t SECTOR_SIZE = 512;
+
+  /**
+   * Number of sectors in a page.
+   */
+  static const std::size_t SECTORS = SIZE / SECTOR_SIZE;
+
+  /**
+   * Mask with a bit set for every sector of a page.
+   */
+  static const std::uint32_t ALL_SECTORS =
+      static_cast<std::uint32_t>((1ULL << SECTORS) - 1);
+
   /**
    * Number of page indicating that it's invalid.
    */
@@ -127,11 +185,42 @@ class Page {
    */
   static const SlotId INVALID_SLOT = 0;
 
+  /**
+   * Flag of PageHeader::flags set on a sorted page; see makeSorted().
+   */
+  static const std::uint16_t SORTED_FLAG = 1;
+
+  /**
+   * Flag of PageHeader::flags set on a fixed-length page; see
+   * makeFixedLength().
+   */
+  static const std::uint16_t FIXED_LENGTH_FLAG = 2;
+
+  /**
+   * Flag of PageHeader::flags set on a prefix-compressed page; see
+   * makePrefixCompressed().
+   */
+  static const std::uint16_t PREFIX_FLAG = 4;
+
   /**
    * Constructs a new, uninitialized page.
    */
   Page();
 
+  /**
+   * Copies a page.  Copying onto an existing page reuses its storage.
+   */
+  Page(const Page& other) = default;
+  Page& operator=(const Page& other) = default;
+
+  /**
+   * Moves a page without copying its data.  The page moved from is left
+   * without data until it is initialized or read into again (see
+   * File::tryReadPage()).
+   */
+  Page(Page&& other) = default;
+  Page& operator=(Page&& other) = default;
+
   /**
    * Inserts a new record into the page.
    *
@@ -153,7 +242,9 @@ class Page {
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
-   * new one, with the exception that the record ID will not change.
+   * new one, with the exception that the record ID will not change.  On a
+   * sorted page, a record keyed by its whole contents is keyed by the whole
+   * new record; any other record keeps the length of its key.
    *
    * @param record_id   ID of record to update.
    * @param record_data Updated bytes that compose the record.
@@ -169,6 +260,51 @@ class Page {
    */
   void deleteRecord(const RecordId& record_id);
 
+  /**
+   * Inserts a new record into the page, like insertRecord(), but reports a
+   * full page instead of throwing.
+   *
+   * @param record_data  Bytes that compose the record.
+   * @param record_id    Receives the ID of the newly inserted record.
+   * @return  STATUS_OK, or STATUS_INSUFFICIENT_SPACE if the page has no room
+   *          for the record.
+   */
+  Status tryInsertRecord(const std::string& record_data, RecordId& record_id);
+
+  /**
+   * Returns the record with the given ID, like getRecord(), but reports a
+   * bad ID instead of throwing.
+   *
+   * @param record_id    ID of the record to return.
+   * @param record_data  Receives a copy of the record.
+   * @return  STATUS_OK, or STATUS_INVALID_RECORD if the ID has a bad page or
+   *          slot number.
+   */
+  Status tryGetRecord(const RecordId& record_id,
+                      std::string& record_data) const;
+
+  /**
+   * Updates the record with the given ID, like updateRecord(), but reports
+   * a bad ID or a full page instead of throwing.  The page is unchanged if
+   * the update fails.
+   *
+   * @param record_id   ID of record to update.
+   * @param record_data Updated bytes that compose the record.
+   * @return  STATUS_OK, STATUS_INVALID_RECORD or STATUS_INSUFFICIENT_SPACE.
+   */
+  Status tryUpdateRecord(const RecordId& record_id,
+                         const std::string& record_data);
+
+  /**
+   * Deletes the record with the given ID, like deleteRecord(), but reports a
+   * bad ID instead of throwing.
+   *
+   * @param record_id   ID of the record to delete.
+   * @return  STATUS_OK, or STATUS_INVALID_RECORD if the ID has a bad page or
+   *          slot number.
+   */
+  Status tryDeleteRecord(const RecordId& record_id);
+
   /**
    * Returns true if the page has enough free space to hold the given data.
    *
@@ -178,12 +314,155 @@ class Page {
   bool hasSpaceForRecord(const std::string& record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Makes this page sorted: a directory of the records ordered by key is
+   * kept after the slot array, so records can be found by key with a binary
+   * search.  Inserts and deletes shift the directory, not the records, and
+   * record IDs do not change.  The records already on the page are keyed by
+   * their whole contents, as are those inserted with insertRecord(record).
+   * Does nothing if the page is sorted already, or if it is a fixed-length
+   * page, which keeps its records in slot order.
+   *
+   * @throws  InsufficientSpaceException  If the page has no room for the
+   *                                      directory of its records.
+   */
+  void makeSorted();
+
+  /**
+   * Makes this empty page a fixed-length page for records of
+   * <record_length> bytes.  Instead of a slot per record, the page holds an
+   * array of records addressed by slot number, preceded by a bitmap of the
+   * slots in use, so more records fit and finding one is a multiply.
+   * Shorter records are padded with zero bytes to <record_length>; longer
+   * ones do not fit.
+   *
+   * @param record_length  Length of every record, at least 1 byte.
+   * @throws  SlotInUseException  If the page holds records.
+   * @throws  InsufficientSpaceException  If no record of <record_length>
+   *                                      bytes fits on a page.
+   */
+  void makeFixedLength(const std::uint16_t record_length);
+
+  /**
+   * Makes this page prefix-compressed: the longest prefix its records share
+   * is stored once, at the end of the data, and each record without it.
+   * Records are put back together as they are read, so the page is used as
+   * any other.  The prefix only gets shorter as records that do not share
+   * it are inserted, which rewrites the records on the page, until the page
+   * is emptied; the next record inserted then sets it again.  On a sorted
+   * page the prefix is kept within every key, so keys compare as before.
+   * Does nothing if the page is prefix-compressed already, or if it is a
+   * fixed-length page.
+   *
+   * @throws  InsufficientSpaceException  If the page has no room for the
+   *                                      length of the prefix.
+   */
+  void makePrefixCompressed();
+
+  /**
+   * Returns true if the page is prefix-compressed.
+   *
+   * @return  Whether the page stores the prefix of its records once.
+   */
+  bool isPrefixCompressed() const {
+    return (header_.flags & PREFIX_FLAG) != 0;
+  }
+
+  /**
+   * Returns the length of the prefix the records of a prefix-compressed page
+   * share, which is not stored with each of them; 0 for any other page.
+   *
+   * @return  Length of the prefix in bytes.
+   */
+  std::size_t prefixLength() const;
+
+  /**
+   * Returns true if the page is a fixed-length page.
+   *
+   * @return  Whether the page holds fixed-length records.
+   */
+  bool isFixedLength() const {
+    return (header_.flags & FIXED_LENGTH_FLAG) != 0;
+  }
+
+  /**
+   * Returns true if the page keeps its records ordered by key.
+   *
+   * @return  Whether the page is sorted.
+   */
+  bool isSorted() const { return (header_.flags & SORTED_FLAG) != 0; }
+
+  /**
+   * Inserts a record made of <key> followed by <value>, keyed by <key>.  The
+   * page is made sorted first if it is not.
+   *
+   * @param key    Key of the record.
+   * @param value  Bytes that follow the key in the record.
+   * @return  ID of the newly inserted record.
+   */
+  RecordId insertRecord(const std::string& key, const std::string& value);
+
+  /**
+   * Inserts a keyed record, like insertRecord(key, value), but reports a
+   * full page instead of throwing.
+   *
+   * @param key        Key of the record.
+   * @param value      Bytes that follow the key in the record.
+   * @param record_id  Receives the ID of the newly inserted record.
+   * @return  STATUS_OK, or STATUS_INSUFFICIENT_SPACE if the page has no room
+   *          for the record.
+   */
+  Status tryInsertRecord(const std::string& key, const std::string& value,
+                         RecordId& record_id);
+
+  /**
+   * Finds the first record (in key order) whose key is <key>.  A sorted page
+   * is binary searched; the records of any other page are compared whole
+   * with <key>, one after another.  On a fixed-length page, <key> is padded
+   * with zeros to the record length first, as inserted records are.
+   *
+   * @param key        Key to look for.
+   * @param record_id  Receives the ID of the record.
+   * @return  STATUS_OK, or STATUS_NOT_FOUND if no record has the key.
+   */
+  Status tryFindRecord(const std::string& key, RecordId& record_id) const;
+
+  /**
+   * Returns the number of records in the key directory: the records of a
+   * sorted page, or 0 for any other page.
+   *
+   * @return  Number of keys.
+   */
+  std::size_t keyCount() const;
+
+  /**
+   * Returns the position in key order of the first record whose key is not
+   * less than <key>, or keyCount() if there is none.
+   *
+   * @param key   Key to look for.
+   * @return  Position in key order.
+   */
+  std::size_t lowerBound(const std::string& key) const;
+
+  /**
+   * Returns the ID of the record at <position> in key order.
+   *
+   * @param position  Position in key order, less than keyCount().
+   * @return  ID of the record.
+   */
+  RecordId recordAt(const std::size_t position) const;
+
+  /**
+   * Returns this page's free space in bytes: that of its free slots, on a
+   * fixed-length page.
    *
    * @return  Free space in bytes.
    */
-  std::uint16_t getFreeSpace() const { return header_.free_space_upper_bound -
-                                              header_.free_space_lower_bound; }
+  std::uint16_t getFreeSpace() const {
+    if (isFixedLength()) {
+      return header_.num_free_slots * header_.record_length;
+    }
+    return header_.free_space_upper_bound - header_.free_space_lower_bound;
+  }
 
   /**
    * Returns this page's number in its file.
@@ -199,6 +478,30 @@ class Page {
    */
   PageId next_page_number() const { return header_.next_page_number; }
 
+  /**
+   * Returns the sectors of the page image (header followed by data) changed
+   * since the page was read or since clear_dirty_sectors(), one bit per
+   * sector.  A new page has all of them set.
+   *
+   * @return  Mask of changed sectors.
+   */
+  std::uint32_t dirty_sectors() const { return dirty_sectors_; }
+
+  /**
+   * Forgets the changed sectors, once they have been written.
+   */
+  void clear_dirty_sectors() { dirty_sectors_ = 0; }
+
+  /**
+   * Adds <sectors> to the changed sectors, for a copy of the page that
+   * replaces an older one whose changes have not been written yet.
+   *
+   * @param sectors Mask of sectors to add.
+   */
+  void add_dirty_sectors(const std::uint32_t sectors) {
+    dirty_sectors_ |= sectors;
+  }
+
   /**
    * Returns an iterator at the first record in the page.
    *
@@ -227,6 +530,7 @@ class Page {
    */
   void set_page_number(const PageId new_page_number) {
     header_.current_page_number = new_page_number;
+    dirty_sectors_ |= 1;
   }
 
   /**
@@ -236,6 +540,29 @@ class Page {
    */
   void set_next_page_number(const PageId new_next_page_number) {
     header_.next_page_number = new_next_page_number;
+    dirty_sectors_ |= 1;
+  }
+
+  /**
+   * Records that <length> bytes at <offset> in the data have changed.
+   */
+  void markDataDirty(const std::size_t offset, const std::size_t length) {
+    if (length == 0) {
+      return;
+    }
+    const std::size_t first = (sizeof(PageHeader) + offset) / SECTOR_SIZE;
+    const std::size_t last =
+        (sizeof(PageHeader) + offset + length - 1) / SECTOR_SIZE;
+    dirty_sectors_ |= static_cast<std::uint32_t>(
+        ((1ULL << (last + 1)) - 1) & ~((1ULL << first) - 1));
+  }
+
+  /**
+   * Records that the header and the slot of <slot_number> have changed.
+   */
+  void markSlotDirty(const SlotId slot_number) {
+    dirty_sectors_ |= 1;
+    markDataDirty((slot_number - 1) * sizeof(PageSlot), sizeof(PageSlot));
   }
 
   /**
@@ -313,6 +640,175 @@ class Page {
    */
   void validateRecordId(const RecordId& record_id) const;
 
+  /**
+   * Returns true if the given record ID is valid for this page; see
+   * validateRecordId().
+   *
+   * @param record_id   Record ID to check.
+   */
+  bool isValidRecordId(const RecordId& record_id) const;
+
+  /**
+   * Inserts a record whose key is its first <key_length> bytes; the common
+   * part of tryInsertRecord() and its keyed variant.
+   *
+   * @param record_data  Bytes that compose the record.
+   * @param key_length   Length of the key at the start of the record.
+   * @param record_id    Receives the ID of the newly inserted record.
+   * @return  STATUS_OK or STATUS_INSUFFICIENT_SPACE.
+   */
+  Status insertKeyedRecord(const std::string& record_data,
+                           const std::size_t key_length, RecordId& record_id);
+
+  /**
+   * Returns true if the page has room for a record whose key is its first
+   * <key_length> bytes; the space of the key matters on a prefix-compressed
+   * page.
+   */
+  bool hasSpaceForKeyedRecord(const std::string& record_data,
+                              const std::size_t key_length) const;
+
+  /**
+   * Returns the prefix stored once on a prefix-compressed page, which is
+   * prefixLength() bytes long.
+   */
+  const char* prefixData() const {
+    return &data_[DATA_SIZE - sizeof(std::uint16_t) - prefixLength()];
+  }
+
+  /**
+   * Returns the length the prefix of a prefix-compressed page must have for
+   * <record_data>, keyed by its first <key_length> bytes, to join the records
+   * on the page other than the one in <replaced> (INVALID_SLOT for none).
+   * With no other records, that is the whole key.
+   */
+  std::size_t prefixFor(const std::string& record_data,
+                        const std::size_t key_length,
+                        const SlotId replaced) const;
+
+  /**
+   * Returns the free space a prefix-compressed page gives up to take
+   * <record_data> with its prefix set to <prefix_length> bytes: the record
+   * without the prefix, and the bytes the other records (all but the one in
+   * <replaced>) grow by as the prefix gets shorter, less those the prefix
+   * gives back.
+   */
+  std::ptrdiff_t prefixedRecordSpace(const std::string& record_data,
+                                     const std::size_t prefix_length,
+                                     const SlotId replaced) const;
+
+  /**
+   * Sets the prefix of the page to <prefix>, which every record on it must
+   * start with, rewriting the records without it.  Also makes the page
+   * prefix-compressed.  The page must have room for the records as they
+   * become.  Does nothing if the prefix is already <prefix>.
+   */
+  void setPrefix(const std::string& prefix);
+
+  /**
+   * Returns the size of the used bitmap of a fixed-length page.
+   */
+  std::size_t bitmapSize() const { return (header_.num_slots + 7) / 8; }
+
+  /**
+   * Returns the offset in the data of the record in <slot_number> of a
+   * fixed-length page.
+   */
+  std::size_t fixedRecordOffset(const SlotId slot_number) const {
+    return bitmapSize() + (slot_number - 1) * header_.record_length;
+  }
+
+  /**
+   * Returns true if <slot_number> is in use, on a page of either format.
+   * The slot number must be allocated.
+   */
+  bool isSlotUsed(const SlotId slot_number) const;
+
+  /**
+   * Returns the first slot in use after <start>, or INVALID_SLOT if there is
+   * none.
+   *
+   * @param start   Slot to start after; INVALID_SLOT to start at the first.
+   */
+  SlotId nextUsedSlot(const SlotId start) const;
+
+  /**
+   * Returns the first free slot of a fixed-length page, which must have one.
+   */
+  SlotId firstFreeFixedSlot() const;
+
+  /**
+   * Sets or clears the used bit of <slot_number> of a fixed-length page.
+   */
+  void setFixedSlotUsed(const SlotId slot_number, const bool used);
+
+  /**
+   * Writes <record_data>, padded with zeros, into <slot_number> of a
+   * fixed-length page.
+   */
+  void writeFixedRecord(const SlotId slot_number,
+                        const std::string& record_data);
+
+  /**
+   * Returns the offset of the key directory in the data: right after the
+   * slot array.
+   */
+  std::size_t keyDirectoryOffset() const {
+    return header_.num_slots * sizeof(PageSlot);
+  }
+
+  /**
+   * Returns the entry of the key directory at <position>.
+   */
+  PageKeySlot getKeySlot(const std::size_t position) const;
+
+  /**
+   * Returns the entry of the key directory for the record in <slot_number>,
+   * with its key being the first <key_length> bytes of the record.  The
+   * entry of a prefix-compressed page holds the key without the prefix.
+   */
+  PageKeySlot makeKeySlot(const SlotId slot_number,
+                          const std::size_t key_length) const;
+
+  /**
+   * Inserts <entry> into the key directory at <position>, shifting the
+   * entries after it.  The page must have room for it.
+   */
+  void insertKeySlot(const std::size_t position, const PageKeySlot& entry);
+
+  /**
+   * Removes the entry at <position> from the key directory.
+   */
+  void removeKeySlot(const std::size_t position);
+
+  /**
+   * Returns the position in the key directory of the record in
+   * <slot_number>.
+   */
+  std::size_t findKeySlot(const SlotId slot_number) const;
+
+  /**
+   * Returns the position in key order of the first record whose key is not
+   * less than (or, if <upper> is set, greater than) the <length> bytes at
+   * <key>.  The key starts with the prefix on a prefix-compressed page.
+   */
+  std::size_t keyBound(const char* key, const std::size_t length,
+                       const bool upper) const;
+
+  /**
+   * Compares the key of <entry> with the <length> bytes at <key>, whose
+   * prefix is <prefix>; returns a negative number, zero or a positive number
+   * as the key of the entry is less than, equal to or greater than it.  On a
+   * prefix-compressed page, both keys leave out the prefix of the page.
+   */
+  int compareKey(const PageKeySlot& entry, const char* key,
+                 const std::size_t length, const std::uint32_t prefix) const;
+
+  /**
+   * Returns the prefix of the <length> bytes at <key> kept in PageKeySlot.
+   */
+  static std::uint32_t keyPrefix(const char* key, const std::size_t length);
+
   /**
    * Returns whether the page is in use or is a free page.
    *
@@ -332,15 +828,26 @@ class Page {
 
   std::string data_;
 
+  /**
+   * Sectors changed since the page was read or last written; see
+   * dirty_sectors().  Not part of the page image.
+   */
+  std::uint32_t dirty_sectors_;
+
   friend class File;
   friend class PageIterator;
+  friend class PageCompressor;
   friend class PageTest;
   friend class BufferTest;
 };
 
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
+static_assert(Page::SECTORS <= 32 && Page::SIZE % Page::SECTOR_SIZE == 0,
+              "Dirty sectors of a page must fit a 32-bit mask.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(PageKeySlot) == 8,
+              "Key directory entries must have no padding.");
 
 }
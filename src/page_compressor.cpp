@@ -0,0 +1,213 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_compressor.h"
+
+#include <cstring>
+#include <stdint.h>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Number of bits used to index the match finder's hash table.
+ */
+const int HASH_BITS = 12;
+
+/**
+ * Largest distance a back-reference can span (offsets are two bytes).
+ */
+const std::size_t MAX_OFFSET = 65535;
+
+/**
+ * After every 2^SKIP_SHIFT failed match attempts in a row the encoder moves
+ * one byte further ahead per attempt.
+ */
+const std::size_t SKIP_SHIFT = 5;
+
+std::uint32_t read32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint64_t read64(const char* p) {
+  std::uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t hash32(const std::uint32_t value) {
+  return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+void putLength(std::size_t length, std::string& dest) {
+  while (length >= 255) {
+    dest.push_back(static_cast<char>(255));
+    length -= 255;
+  }
+  dest.push_back(static_cast<char>(length));
+}
+
+void putSequence(const char* literals, const std::size_t num_literals,
+                 const std::size_t offset, const std::size_t match_length,
+                 std::string& dest) {
+  const std::size_t match_code =
+      match_length == 0 ? 0 : match_length - PageCompressor::MIN_MATCH;
+  const std::size_t literal_nibble = num_literals < 15 ? num_literals : 15;
+  const std::size_t match_nibble = match_code < 15 ? match_code : 15;
+  dest.push_back(static_cast<char>((literal_nibble << 4) | match_nibble));
+  if (literal_nibble == 15) {
+    putLength(num_literals - 15, dest);
+  }
+  dest.append(literals, num_literals);
+  if (match_length == 0) {
+    return;
+  }
+  dest.push_back(static_cast<char>(offset & 0xff));
+  dest.push_back(static_cast<char>(offset >> 8));
+  if (match_nibble == 15) {
+    putLength(match_code - 15, dest);
+  }
+}
+
+bool getLength(const unsigned char*& in, const unsigned char* in_end,
+               std::size_t& length) {
+  unsigned char byte;
+  do {
+    if (in == in_end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}
+
+void PageCompressor::compress(const char* source, const std::size_t length,
+                              std::string& dest) {
+  dest.clear();
+  // Positions are stored off by one so that zero means "empty".
+  std::uint32_t table[1 << HASH_BITS];
+  std::memset(table, 0, sizeof(table));
+  std::size_t anchor = 0;
+  std::size_t pos = 0;
+  std::size_t misses = 0;
+  while (pos + MIN_MATCH <= length) {
+    const std::uint32_t sequence = read32(source + pos);
+    const std::uint32_t h = hash32(sequence);
+    const std::size_t candidate = table[h];
+    table[h] = static_cast<std::uint32_t>(pos + 1);
+    if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET ||
+        read32(source + candidate - 1) != sequence) {
+      // Step faster through data that keeps failing to match, so
+      // incompressible pages are given up on cheaply.
+      pos += 1 + (misses++ >> SKIP_SHIFT);
+      continue;
+    }
+    misses = 0;
+    const std::size_t match = candidate - 1;
+    std::size_t match_length = MIN_MATCH;
+    while (pos + match_length + sizeof(std::uint64_t) <= length) {
+      const std::uint64_t diff = read64(source + match + match_length) ^
+                                 read64(source + pos + match_length);
+      if (diff != 0) {
+        // Pages are in host byte order; on little-endian hosts the lowest set
+        // bit belongs to the first differing byte.
+        match_length += __builtin_ctzll(diff) / 8;
+        break;
+      }
+      match_length += sizeof(std::uint64_t);
+    }
+    while (pos + match_length < length &&
+           source[match + match_length] == source[pos + match_length]) {
+      ++match_length;
+    }
+    putSequence(source + anchor, pos - anchor, pos - match, match_length,
+                dest);
+    pos += match_length;
+    anchor = pos;
+  }
+  putSequence(source + anchor, length - anchor, 0, 0, dest);
+}
+
+bool PageCompressor::decompress(const std::string& source, char* dest,
+                                const std::size_t length) {
+  const unsigned char* in =
+      reinterpret_cast<const unsigned char*>(source.data());
+  const unsigned char* const in_end = in + source.size();
+  std::size_t out = 0;
+  while (in != in_end) {
+    const unsigned char token = *in++;
+    std::size_t num_literals = token >> 4;
+    if (num_literals == 15 && !getLength(in, in_end, num_literals)) {
+      return false;
+    }
+    if (num_literals > static_cast<std::size_t>(in_end - in) ||
+        num_literals > length - out) {
+      return false;
+    }
+    std::memcpy(dest + out, in, num_literals);
+    in += num_literals;
+    out += num_literals;
+    if (in == in_end) {
+      break;
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    const std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    std::size_t match_length = token & 0x0f;
+    if (match_length == 15 && !getLength(in, in_end, match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > out || match_length > length - out) {
+      return false;
+    }
+    // A match may overlap the bytes it produces.  The output repeats with a
+    // period of <offset>, so copy whole periods from the start of the match
+    // source, doubling the chunk each round.
+    const std::size_t start = out - offset;
+    std::size_t copied = 0;
+    while (copied < match_length) {
+      std::size_t chunk = out + copied - start;
+      if (chunk > match_length - copied) {
+        chunk = match_length - copied;
+      }
+      std::memcpy(dest + out + copied, dest + start, chunk);
+      copied += chunk;
+    }
+    out += match_length;
+  }
+  return out == length;
+}
+
+void PageCompressor::compressPage(const Page& page, std::string& dest) {
+  char image[Page::SIZE];
+  std::memcpy(image, &page.header_, sizeof(page.header_));
+  std::memcpy(image + sizeof(page.header_), page.data_.data(),
+              Page::DATA_SIZE);
+  compress(image, Page::SIZE, dest);
+}
+
+bool PageCompressor::decompressPage(const std::string& source, Page& page) {
+  char image[Page::SIZE];
+  if (!decompress(source, image, Page::SIZE)) {
+    return false;
+  }
+  std::memcpy(&page.header_, image, sizeof(page.header_));
+  page.data_.assign(image + sizeof(page.header_), Page::DATA_SIZE);
+  page.clear_dirty_sectors();
+  return true;
+}
+
+}
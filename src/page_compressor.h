@@ -0,0 +1,78 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Lossless compressor for in-memory page images.
+ *
+ * Uses a small byte-oriented LZ77 scheme (literal runs followed by
+ * back-references into the already decoded output).  Pages are mostly free
+ * space and short, repetitive records, so this is cheap to run and compresses
+ * them well without depending on an external library.
+ *
+ * Each encoded sequence starts with a token byte whose high nibble is the
+ * literal run length and whose low nibble is the match length minus
+ * MIN_MATCH.  A nibble value of 15 is followed by extension bytes that are
+ * added to it until a byte other than 255 is seen.  The literals come next,
+ * then a two byte little-endian match offset.  The final sequence only holds
+ * literals.
+ */
+class PageCompressor {
+ public:
+  /**
+   * Shortest back-reference the encoder emits.
+   */
+  static const std::size_t MIN_MATCH = 4;
+
+  /**
+   * Compresses <length> bytes starting at <source>.
+   *
+   * @param source  Bytes to compress.
+   * @param length  Number of bytes to compress.
+   * @param dest    Compressed bytes are returned via this string.
+   */
+  static void compress(const char* source, const std::size_t length,
+                       std::string& dest);
+
+  /**
+   * Decompresses bytes produced by compress().
+   *
+   * @param source  Compressed bytes.
+   * @param dest    Buffer the original bytes are written to.
+   * @param length  Size of the original data; <dest> must hold this many bytes.
+   * @return  True if the input decoded to exactly <length> bytes.
+   */
+  static bool decompress(const std::string& source, char* dest,
+                         const std::size_t length);
+
+  /**
+   * Compresses the header and data of a page.
+   *
+   * @param page  Page to compress.
+   * @param dest  Compressed page image is returned via this string.
+   */
+  static void compressPage(const Page& page, std::string& dest);
+
+  /**
+   * Restores a page compressed with compressPage().
+   *
+   * @param source  Compressed page image.
+   * @param page    Page whose header and data are overwritten.
+   * @return  True if the image was valid.
+   */
+  static bool decompressPage(const std::string& source, Page& page);
+};
+
+}
@@ -0,0 +1,23 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_ref.h"
+
+#include "buffer.h"
+
+namespace badgerdb {
+
+PageRef::~PageRef() {
+  // The pool may unswizzle the reference meanwhile; unswizzle() then finds
+  // nothing to do.
+  BufMgr* owner = owner_.load();
+  if (owner != NULL) {
+    owner->unswizzle(*this);
+  }
+}
+
+}
@@ -0,0 +1,79 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+
+namespace badgerdb {
+
+class BufMgr;
+class Page;
+
+/**
+ * @brief Reference to a page that a buffer pool can swizzle into a pointer.
+ *
+ * Index nodes and other in-memory structures that follow page references
+ * keep them as PageRefs and read them with BufMgr::readPage(File*, PageRef&,
+ * Page*&).  The first read of a page through a reference swizzles it: the
+ * reference then points at the frame, and further reads pin the frame
+ * without looking the page up in the pool's hash table.  When the page leaves
+ * the pool the reference is unswizzled back to its page number.
+ *
+ * A frame is swizzled by at most one reference, so the pool can find it on
+ * eviction; reads through other references to the same page work as usual,
+ * but take the hash table.  A reference must stay put while swizzled; copies
+ * start out unswizzled and destruction unswizzles, so references can live in
+ * containers that move them.
+ */
+class PageRef {
+ public:
+  explicit PageRef(const PageId page_number)
+      : page_number_(page_number), page_(NULL), owner_(NULL) {}
+
+  PageRef(const PageRef& other)
+      : page_number_(other.page_number_), page_(NULL), owner_(NULL) {}
+
+  /**
+   * Unswizzles the reference.  The pool that swizzled it must still exist.
+   */
+  ~PageRef();
+
+  /**
+   * Returns the number of the page referred to.
+   */
+  PageId page_number() const { return page_number_; }
+
+  /**
+   * Returns true if the reference points at a frame, for diagnostics.
+   */
+  bool swizzled() const { return owner_.load() != NULL; }
+
+ private:
+  friend class BufMgr;
+
+  PageRef& operator=(const PageRef&);
+
+  PageId page_number_;
+
+  /**
+   * Frame holding the page while swizzled, NULL otherwise.  Only the pool
+   * touches it, under its latch.
+   */
+  Page* page_;
+
+  /**
+   * Pool that swizzled the reference, NULL while it is not swizzled.
+   */
+  std::atomic<BufMgr*> owner_;
+};
+
+}
@@ -0,0 +1,319 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "sorted_run.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "page_iterator.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Counts of the pages and entries of a run, the first record of its meta
+ * page.
+ */
+struct RunMeta {
+  std::uint32_t data_pages;
+  std::uint32_t index_pages;
+  std::uint32_t filter_pages;
+  std::uint64_t entries;
+};
+
+/**
+ * Length of the trailer of an entry: the length of the key and the kind.
+ */
+const std::size_t TRAILER_SIZE = sizeof(std::uint16_t) + 1;
+
+/**
+ * Largest piece of the filter stored in one record.
+ */
+const std::size_t FILTER_CHUNK = Page::DATA_SIZE - 64;
+
+/**
+ * Page number of the meta page, the first page of every run.
+ */
+const PageId META_PAGE = 1;
+
+/**
+ * Returns the record of the <slot_number>th record of <page>.
+ */
+std::string recordOf(const Page& page, const SlotId slot_number) {
+  const RecordId record_id = {page.page_number(), slot_number};
+  return page.getRecord(record_id);
+}
+
+/**
+ * Returns a blank data page: sorted, with the prefix its keys share stored
+ * once.
+ */
+Page newDataPage() {
+  Page page;
+  page.makeSorted();
+  page.makePrefixCompressed();
+  return page;
+}
+
+}
+
+std::string SortedRun::encodeEntry(const std::string& key,
+                                   const EntryType type,
+                                   const std::string& value) {
+  std::string record;
+  record.reserve(key.length() + value.length() + TRAILER_SIZE);
+  record.append(key);
+  record.append(value);
+  const std::uint16_t key_length = key.length();
+  record.append(reinterpret_cast<const char*>(&key_length),
+                sizeof(key_length));
+  record.push_back(static_cast<char>(type));
+  return record;
+}
+
+void SortedRun::decodeEntry(const std::string& record, RunEntry& entry) {
+  assert(record.length() >= TRAILER_SIZE);
+  const std::size_t trailer = record.length() - TRAILER_SIZE;
+  std::uint16_t key_length;
+  std::memcpy(&key_length, &record[trailer], sizeof(key_length));
+  entry.key.assign(record, 0, key_length);
+  entry.value.assign(record, key_length, trailer - key_length);
+  entry.type = static_cast<EntryType>(record[trailer + sizeof(key_length)]);
+}
+
+std::mutex& SortedRun::fileMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+SortedRun::SortedRun(const std::string& filename, const std::uint64_t number)
+    : filename_(filename),
+      number_(number),
+      entries_(0),
+      pages_(0),
+      obsolete_(false) {}
+
+SortedRun::~SortedRun() {
+  std::lock_guard<std::mutex> guard(fileMutex());
+  file_.reset();
+  if (obsolete_ && File::exists(filename_)) {
+    File::remove(filename_);
+  }
+}
+
+std::shared_ptr<SortedRun> SortedRun::open(const std::string& filename,
+                                           const std::uint64_t number) {
+  std::shared_ptr<SortedRun> run(new SortedRun(filename, number));
+  {
+    std::lock_guard<std::mutex> guard(fileMutex());
+    run->file_.reset(new File(File::open(filename)));
+  }
+  const Page meta_page = run->file_->readPage(META_PAGE);
+  RunMeta meta;
+  const std::string counts = recordOf(meta_page, 1);
+  assert(counts.length() == sizeof(meta));
+  std::memcpy(&meta, counts.data(), sizeof(meta));
+  run->largest_ = recordOf(meta_page, 2);
+  run->entries_ = meta.entries;
+  run->pages_ = 1 + meta.data_pages + meta.index_pages + meta.filter_pages;
+
+  // The index and the filter follow the data pages; read them at once.
+  std::vector<Page> pages = run->file_->readPages(
+      META_PAGE + 1 + meta.data_pages, meta.index_pages + meta.filter_pages);
+  std::string filter;
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    for (PageIterator iter = pages[i].begin(); iter != pages[i].end();
+         ++iter) {
+      if (i < meta.index_pages) {
+        run->first_keys_.push_back(*iter);
+      } else {
+        filter.append(*iter);
+      }
+    }
+  }
+  assert(run->first_keys_.size() == meta.data_pages);
+  run->smallest_ = run->first_keys_.front();
+  run->filter_ = BloomFilter(filter);
+  return run;
+}
+
+bool SortedRun::mayContain(const std::string& key) const {
+  if (key < smallest_ || largest_ < key) {
+    return false;
+  }
+  return filter_.mayContain(key);
+}
+
+bool SortedRun::find(const std::string& key, RunEntry& entry) const {
+  if (key < smallest_) {
+    return false;
+  }
+  const PageId page_number = META_PAGE + 1 + dataPageFor(key);
+  Page page;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    page = file_->readPage(page_number);
+  }
+  RecordId record_id;
+  if (page.tryFindRecord(key, record_id) != STATUS_OK) {
+    return false;
+  }
+  decodeEntry(page.getRecord(record_id), entry);
+  return true;
+}
+
+std::size_t SortedRun::dataPageFor(const std::string& key) const {
+  const std::vector<std::string>::const_iterator page_key =
+      std::upper_bound(first_keys_.begin(), first_keys_.end(), key);
+  if (page_key == first_keys_.begin()) {
+    return 0;
+  }
+  return page_key - first_keys_.begin() - 1;
+}
+
+std::vector<Page> SortedRun::readDataPages(const std::size_t first,
+                                           const std::size_t count) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return file_->readPages(META_PAGE + 1 + first, count);
+}
+
+SortedRunWriter::SortedRunWriter(const std::size_t bits_per_key)
+    : bits_per_key_(bits_per_key) {}
+
+void SortedRunWriter::add(const std::string& key, const EntryType type,
+                          const std::string& value) {
+  assert(hashes_.empty() || last_key_ < key);
+  assert(key.length() + value.length() <= SortedRun::MAX_ENTRY_SIZE);
+  // The value and the trailer follow the key in the record.
+  std::string tail = SortedRun::encodeEntry(key, type, value);
+  tail.erase(0, key.length());
+  RecordId record_id;
+  if (pages_.empty() ||
+      pages_.back().tryInsertRecord(key, tail, record_id) != STATUS_OK) {
+    pages_.push_back(newDataPage());
+    first_keys_.push_back(key);
+    pages_.back().insertRecord(key, tail);
+  }
+  last_key_ = key;
+  hashes_.push_back(BloomFilter::hash(key));
+}
+
+std::shared_ptr<SortedRun> SortedRunWriter::finish(
+    const std::string& filename, const std::uint64_t number) {
+  assert(!empty());
+  std::shared_ptr<SortedRun> run(new SortedRun(filename, number));
+  run->smallest_ = first_keys_.front();
+  run->largest_ = last_key_;
+  run->entries_ = hashes_.size();
+  run->filter_ = BloomFilter(hashes_, bits_per_key_);
+
+  std::vector<Page> index_pages(1);
+  for (std::size_t i = 0; i < first_keys_.size(); ++i) {
+    RecordId record_id;
+    if (index_pages.back().tryInsertRecord(first_keys_[i], record_id) !=
+        STATUS_OK) {
+      index_pages.push_back(Page());
+      index_pages.back().insertRecord(first_keys_[i]);
+    }
+  }
+  std::vector<Page> filter_pages;
+  const std::string& filter = run->filter_.bits();
+  for (std::size_t offset = 0; offset < filter.length();
+       offset += FILTER_CHUNK) {
+    filter_pages.push_back(Page());
+    filter_pages.back().insertRecord(filter.substr(offset, FILTER_CHUNK));
+  }
+
+  RunMeta meta;
+  std::memset(&meta, 0, sizeof(meta));
+  meta.data_pages = pages_.size();
+  meta.index_pages = index_pages.size();
+  meta.filter_pages = filter_pages.size();
+  meta.entries = hashes_.size();
+  Page meta_page;
+  meta_page.insertRecord(
+      std::string(reinterpret_cast<const char*>(&meta), sizeof(meta)));
+  meta_page.insertRecord(last_key_);
+
+  std::vector<Page> pages;
+  pages.reserve(1 + pages_.size() + index_pages.size() + filter_pages.size());
+  pages.push_back(std::move(meta_page));
+  for (std::size_t i = 0; i < pages_.size(); ++i) {
+    pages.push_back(std::move(pages_[i]));
+  }
+  for (std::size_t i = 0; i < index_pages.size(); ++i) {
+    pages.push_back(std::move(index_pages[i]));
+  }
+  for (std::size_t i = 0; i < filter_pages.size(); ++i) {
+    pages.push_back(std::move(filter_pages[i]));
+  }
+  run->pages_ = pages.size();
+  run->first_keys_.swap(first_keys_);
+  {
+    std::lock_guard<std::mutex> guard(SortedRun::fileMutex());
+    run->file_.reset(new File(File::create(filename)));
+  }
+  run->file_->appendPages(pages);
+  run->file_->sync();
+
+  pages_.clear();
+  first_keys_.clear();
+  last_key_.clear();
+  hashes_.clear();
+  return run;
+}
+
+SortedRunCursor::SortedRunCursor(const std::shared_ptr<SortedRun>& run,
+                                 const std::string& start)
+    : run_(run),
+      next_read_(run->dataPageFor(start)),
+      next_page_(0),
+      read_ahead_(1),
+      position_(0) {
+  loadPage();
+  while (valid() && entry().key < start) {
+    next();
+  }
+}
+
+void SortedRunCursor::next() {
+  assert(valid());
+  if (++position_ == entries_.size()) {
+    loadPage();
+  }
+}
+
+void SortedRunCursor::loadPage() {
+  entries_.clear();
+  position_ = 0;
+  if (next_page_ == pages_.size()) {
+    if (next_read_ == run_->dataPages()) {
+      return;
+    }
+    std::size_t count = run_->dataPages() - next_read_;
+    if (count > read_ahead_) {
+      count = read_ahead_;
+    }
+    pages_ = run_->readDataPages(next_read_, count);
+    next_read_ += count;
+    next_page_ = 0;
+    read_ahead_ *= 2;
+    if (read_ahead_ > SortedRun::READ_AHEAD_PAGES) {
+      read_ahead_ = SortedRun::READ_AHEAD_PAGES;
+    }
+  }
+  const Page& page = pages_[next_page_++];
+  entries_.resize(page.keyCount());
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    SortedRun::decodeEntry(page.getRecord(page.recordAt(i)), entries_[i]);
+  }
+}
+
+}
@@ -0,0 +1,407 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "bloom_filter.h"
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * Kinds of entries of a sorted run or an LsmTree log.
+ */
+enum EntryType {
+  /**
+   * The key has the value of the entry.
+   */
+  ENTRY_VALUE = 0,
+
+  /**
+   * The key was deleted; the entry hides older values of it.
+   */
+  ENTRY_DELETION = 1
+};
+
+/**
+ * @brief Key, kind and value of an entry read from a sorted run.
+ */
+struct RunEntry {
+  std::string key;
+  EntryType type;
+  std::string value;
+};
+
+/**
+ * @brief Immutable file of entries sorted by key, as written by
+ *        SortedRunWriter.
+ *
+ * The file holds, in page order, a meta page (the number of pages of each
+ * kind, the number of entries and the largest key), the data pages, index
+ * pages holding the first key of every data page, and the pages of a
+ * BloomFilter of the keys.  Data pages are sorted and prefix-compressed (see
+ * Page::makeSorted() and Page::makePrefixCompressed()); an entry is a record
+ * keyed by the key of the entry, followed by its value and a trailer with
+ * the length of the key and the kind of entry.
+ *
+ * Opening a run reads the index and the filter into memory, so a lookup
+ * reads at most the one data page that may hold the key.  The file is read
+ * under a mutex of the run, so one run can be shared by several threads.
+ */
+class SortedRun {
+ public:
+  /**
+   * Largest entry (key and value) a run or an LsmTree log holds: half a page,
+   * so that every page of the run has room for a key.
+   */
+  static const std::size_t MAX_ENTRY_SIZE = Page::DATA_SIZE / 2;
+
+  /**
+   * Largest number of data pages read at once by SortedRunCursor.
+   */
+  static const std::size_t READ_AHEAD_PAGES = 32;
+
+  /**
+   * Opens the run written earlier to <filename>.
+   *
+   * @param filename  Name of the file of the run.
+   * @param number    Number of the run in its LsmTree.
+   * @return  The run.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   */
+  static std::shared_ptr<SortedRun> open(const std::string& filename,
+                                         const std::uint64_t number);
+
+  /**
+   * Returns the record of an entry: <key>, <value> and the trailer.
+   *
+   * @param key   Key of the entry.
+   * @param type  Kind of entry.
+   * @param value Value of the entry; empty for a deletion.
+   * @return  Record of the entry.
+   */
+  static std::string encodeEntry(const std::string& key, const EntryType type,
+                                 const std::string& value);
+
+  /**
+   * Splits the record of an entry into its parts.
+   *
+   * @param record  Record made by encodeEntry().
+   * @param entry   Set to the entry.
+   */
+  static void decodeEntry(const std::string& record, RunEntry& entry);
+
+  /**
+   * Returns the mutex held around creating, opening, closing and removing
+   * the files of runs and LsmTree logs.  File keeps the open files in static
+   * maps, which are not threadsafe, and runs are closed on whichever thread
+   * drops them last.
+   */
+  static std::mutex& fileMutex();
+
+  /**
+   * Closes the file, and removes it if the run was marked obsolete.
+   */
+  ~SortedRun();
+
+  /**
+   * Returns false if <key> is certainly not in the run: it is outside the
+   * range of the run's keys, or its filter rules it out.
+   *
+   * @param key   Key to look for.
+   * @return  Whether the run may hold the key.
+   */
+  bool mayContain(const std::string& key) const;
+
+  /**
+   * Looks up <key>, reading the data page that would hold it.
+   *
+   * @param key     Key to look for.
+   * @param entry   Set to the entry of the key, if there is one.
+   * @return  Whether the run holds an entry (a value or a deletion) of
+   *          the key.
+   */
+  bool find(const std::string& key, RunEntry& entry) const;
+
+  /**
+   * Returns the index (from 0) of the data page that would hold <key>: the
+   * last one whose first key is not greater than it, or the first one.
+   *
+   * @param key   Key to look for.
+   * @return  Index of the data page.
+   */
+  std::size_t dataPageFor(const std::string& key) const;
+
+  /**
+   * Reads <count> data pages, starting at data page <first> (from 0), with
+   * one read of the file.
+   *
+   * @param first   Index of the first data page.
+   * @param count   Number of data pages to read.
+   * @return  The pages.
+   */
+  std::vector<Page> readDataPages(const std::size_t first,
+                                  const std::size_t count) const;
+
+  /**
+   * Marks the run as replaced; its file is removed once the last reference
+   * to the run goes.
+   */
+  void markObsolete() { obsolete_ = true; }
+
+  /**
+   * Returns true if the keys of the run overlap [smallest, largest].
+   */
+  bool overlaps(const std::string& smallest,
+                const std::string& largest) const {
+    return !(largest < smallest_ || largest_ < smallest);
+  }
+
+  /**
+   * Returns the number of the run in its LsmTree.
+   */
+  std::uint64_t number() const { return number_; }
+
+  /**
+   * Returns the smallest key of the run.
+   */
+  const std::string& smallest() const { return smallest_; }
+
+  /**
+   * Returns the largest key of the run.
+   */
+  const std::string& largest() const { return largest_; }
+
+  /**
+   * Returns the number of data pages.
+   */
+  std::size_t dataPages() const { return first_keys_.size(); }
+
+  /**
+   * Returns the number of entries.
+   */
+  std::uint64_t entries() const { return entries_; }
+
+  /**
+   * Returns the size of the file of the run in bytes.
+   */
+  std::uint64_t bytes() const { return pages_ * Page::SIZE; }
+
+ private:
+  SortedRun(const std::string& filename, const std::uint64_t number);
+
+  /**
+   * Name of the file of the run.
+   */
+  const std::string filename_;
+
+  /**
+   * Number of the run in its LsmTree.
+   */
+  const std::uint64_t number_;
+
+  /**
+   * Serializes reads of the file.
+   */
+  mutable std::mutex mutex_;
+
+  /**
+   * The file, open for as long as the run.
+   */
+  std::unique_ptr<File> file_;
+
+  /**
+   * First key of every data page.
+   */
+  std::vector<std::string> first_keys_;
+
+  /**
+   * Smallest and largest keys of the run.
+   */
+  std::string smallest_;
+  std::string largest_;
+
+  /**
+   * Filter of the keys of the run.
+   */
+  BloomFilter filter_;
+
+  /**
+   * Number of entries.
+   */
+  std::uint64_t entries_;
+
+  /**
+   * Number of pages of the file, not counting its header.
+   */
+  std::uint64_t pages_;
+
+  /**
+   * Set once the run has been replaced.
+   */
+  std::atomic<bool> obsolete_;
+
+  friend class SortedRunWriter;
+};
+
+/**
+ * @brief Builds a sorted run from entries given in ascending key order.
+ *
+ * Data pages are filled in memory; finish() adds the index and filter pages
+ * and writes the whole file with one File::appendPages().
+ *
+ * @warning This class is not threadsafe.
+ */
+class SortedRunWriter {
+ public:
+  /**
+   * Constructs a writer of an empty run.
+   *
+   * @param bits_per_key  Bits of the run's BloomFilter per key.
+   */
+  explicit SortedRunWriter(const std::size_t bits_per_key);
+
+  /**
+   * Adds an entry after those added so far.
+   *
+   * @param key   Key of the entry, greater than every key added before.
+   * @param type  Kind of entry.
+   * @param value Value of the entry; empty for a deletion.
+   */
+  void add(const std::string& key, const EntryType type,
+           const std::string& value);
+
+  /**
+   * Returns the size of the data pages filled so far in bytes.
+   */
+  std::uint64_t bytes() const { return pages_.size() * Page::SIZE; }
+
+  /**
+   * Returns true if no entry has been added.
+   */
+  bool empty() const { return hashes_.empty(); }
+
+  /**
+   * Writes the run to a new file and syncs it.  The writer is left empty.
+   *
+   * @param filename  Name of the file of the run.
+   * @param number    Number of the run in its LsmTree.
+   * @return  The run, open.
+   * @throws  FileExistsException     If the file already exists.
+   */
+  std::shared_ptr<SortedRun> finish(const std::string& filename,
+                                    const std::uint64_t number);
+
+ private:
+  /**
+   * Bits of the BloomFilter per key.
+   */
+  const std::size_t bits_per_key_;
+
+  /**
+   * Data pages filled so far; the last one is being filled.
+   */
+  std::vector<Page> pages_;
+
+  /**
+   * First key of every data page.
+   */
+  std::vector<std::string> first_keys_;
+
+  /**
+   * Last key added.
+   */
+  std::string last_key_;
+
+  /**
+   * Hashes of the keys added, for the filter.
+   */
+  std::vector<std::uint64_t> hashes_;
+};
+
+/**
+ * @brief Walks the entries of a sorted run in key order.
+ *
+ * Data pages are read one at first, then twice as many each time up to
+ * SortedRun::READ_AHEAD_PAGES, so a short scan reads little more than it
+ * needs and a long one reads large extents.
+ *
+ * @warning This class is not threadsafe.
+ */
+class SortedRunCursor {
+ public:
+  /**
+   * Constructs a cursor at the first entry of <run> whose key is not less
+   * than <start>.
+   *
+   * @param run   Run to walk.
+   * @param start Key to start at; by default the first entry.
+   */
+  explicit SortedRunCursor(const std::shared_ptr<SortedRun>& run,
+                           const std::string& start = std::string());
+
+  /**
+   * Returns true until the cursor has passed the last entry.
+   */
+  bool valid() const { return position_ < entries_.size(); }
+
+  /**
+   * Returns the entry at the cursor.
+   */
+  const RunEntry& entry() const { return entries_[position_]; }
+
+  /**
+   * Moves to the next entry.
+   */
+  void next();
+
+ private:
+  /**
+   * Decodes the entries of the next data page, reading the next pages of
+   * the run if those read are used up.
+   */
+  void loadPage();
+
+  /**
+   * Run being walked.
+   */
+  std::shared_ptr<SortedRun> run_;
+
+  /**
+   * Data pages read ahead.
+   */
+  std::vector<Page> pages_;
+
+  /**
+   * Index of the next data page to read from the run, and of the next page
+   * of <pages_> to decode.
+   */
+  std::size_t next_read_;
+  std::size_t next_page_;
+
+  /**
+   * Number of data pages the next read of the run reads.
+   */
+  std::size_t read_ahead_;
+
+  /**
+   * Entries of the current data page, and the position in them.
+   */
+  std::vector<RunEntry> entries_;
+  std::size_t position_;
+};
+
+}
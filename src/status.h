@@ -0,0 +1,56 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+namespace badgerdb {
+
+/**
+ * Outcome of the try* variants of Page, File, BufHashTbl and BufMgr
+ * operations, and of lookups such as LsmTree::get() and KVStore::get().
+ * They return the conditions a caller is expected to handle, such as a full
+ * page, as a status instead of throwing, so loops that meet them often do not
+ * pay for building and unwinding an exception.  Anything else (I/O errors,
+ * misuse) still throws, as from the plain operations.
+ */
+enum Status {
+  /**
+   * The operation succeeded.
+   */
+  STATUS_OK = 0,
+
+  /**
+   * What was looked up does not exist: a page not in the buffer pool
+   * (BufHashTbl, HashNotFoundException), or a key not on a sorted page
+   * (Page::tryFindRecord()) or not in a store (LsmTree::get(),
+   * KVStore::get()).
+   */
+  STATUS_NOT_FOUND,
+
+  /**
+   * The page has no room for the record (InsufficientSpaceException).
+   */
+  STATUS_INSUFFICIENT_SPACE,
+
+  /**
+   * Every frame of the buffer pool is pinned (BufferExceededException).
+   */
+  STATUS_BUFFER_EXCEEDED,
+
+  /**
+   * The page does not exist in the file or is not used
+   * (InvalidPageException).
+   */
+  STATUS_INVALID_PAGE,
+
+  /**
+   * The record is not on the page (InvalidRecordException).
+   */
+  STATUS_INVALID_RECORD
+};
+
+}
@@ -0,0 +1,149 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Prints a buffer pool snapshot written by BufPoolSnapshot::write().
+ *
+ * Given a second, later snapshot of the same pool, also prints the rates of
+ * accesses, clock hand movement and evictions between the two.  "-" reads a
+ * snapshot from standard input.
+ *
+ * Usage: bufstat <snapshot> [later_snapshot]
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "buffer_snapshot.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Number of files listed before the rest are summed up.
+ */
+const std::size_t MAX_FILES = 20;
+
+bool load(const std::string& name, BufPoolSnapshot& snapshot) {
+  if (name == "-") {
+    return snapshot.read(std::cin);
+  }
+  std::ifstream in(name.c_str());
+  return in && snapshot.read(in);
+}
+
+double percent(const std::uint64_t part, const std::uint64_t whole) {
+  return whole == 0 ? 0 : 100.0 * part / whole;
+}
+
+void print(const BufPoolSnapshot& snap) {
+  std::printf("frames   %10u\n", snap.frames);
+  std::printf("valid    %10u  %5.1f%%\n", snap.valid,
+              percent(snap.valid, snap.frames));
+  std::printf("pinned   %10u  %5.1f%%\n", snap.pinned,
+              percent(snap.pinned, snap.frames));
+  std::printf("dirty    %10u  %5.1f%%\n", snap.dirty,
+              percent(snap.dirty, snap.frames));
+  std::printf("accesses %10llu  evictions %llu  clock advances %llu\n",
+              static_cast<unsigned long long>(snap.accesses),
+              static_cast<unsigned long long>(snap.evictions),
+              static_cast<unsigned long long>(snap.clockAdvances));
+
+  std::printf("\n%-40s %10s %7s\n", "file", "frames", "share");
+  std::uint64_t others = 0;
+  for (std::size_t i = 0; i < snap.files.size(); ++i) {
+    if (i < MAX_FILES) {
+      std::printf("%-40s %10u %6.1f%%\n", snap.files[i].filename.c_str(),
+                  snap.files[i].pages,
+                  percent(snap.files[i].pages, snap.frames));
+    } else {
+      others += snap.files[i].pages;
+    }
+  }
+  if (snap.files.size() > MAX_FILES) {
+    std::printf("(%zu more files) %*llu %6.1f%%\n",
+                snap.files.size() - MAX_FILES, 24,
+                static_cast<unsigned long long>(others),
+                percent(others, snap.frames));
+  }
+
+  if (snap.sampledFrames == 0) {
+    return;
+  }
+  std::printf("\nage in accesses (estimated from %u frames)\n",
+              snap.sampledFrames);
+  int last = BufPoolSnapshot::AGE_BUCKETS - 1;
+  while (last > 0 && snap.ageHistogram[last] == 0) {
+    --last;
+  }
+  for (int b = 0; b <= last; ++b) {
+    const std::uint64_t start = BufPoolSnapshot::bucketStart(b);
+    char range[48];
+    if (b == BufPoolSnapshot::AGE_BUCKETS - 1) {
+      std::snprintf(range, sizeof(range), ">= %llu",
+                    static_cast<unsigned long long>(start));
+    } else {
+      std::snprintf(range, sizeof(range), "%llu-%llu",
+                    static_cast<unsigned long long>(start),
+                    static_cast<unsigned long long>(
+                        BufPoolSnapshot::bucketStart(b + 1) - 1));
+    }
+    const int bar = static_cast<int>(
+        percent(snap.ageHistogram[b], snap.frames) / 2 + 0.5);
+    std::printf("%24s %10llu %s\n", range,
+                static_cast<unsigned long long>(snap.ageHistogram[b]),
+                std::string(bar, '#').c_str());
+  }
+}
+
+void printRates(const BufPoolSnapshot& earlier,
+                const BufPoolSnapshot& later) {
+  const double seconds = (later.takenAt - earlier.takenAt) / 1e9;
+  std::printf("\nover %.3f s\n", seconds);
+  std::printf("accesses       %12.0f /s\n",
+              BufPoolSnapshot::rate(earlier, later, earlier.accesses,
+                                    later.accesses));
+  std::printf("clock velocity %12.0f frames/s\n",
+              BufPoolSnapshot::rate(earlier, later, earlier.clockAdvances,
+                                    later.clockAdvances));
+  std::printf("evictions      %12.0f /s\n",
+              BufPoolSnapshot::rate(earlier, later, earlier.evictions,
+                                    later.evictions));
+}
+
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    std::fprintf(stderr, "usage: %s <snapshot> [later_snapshot]\n", argv[0]);
+    return 2;
+  }
+  BufPoolSnapshot snap;
+  if (!load(argv[1], snap)) {
+    std::fprintf(stderr, "%s: not a buffer pool snapshot\n", argv[1]);
+    return 1;
+  }
+  if (argc == 2) {
+    print(snap);
+    return 0;
+  }
+  BufPoolSnapshot later;
+  if (!load(argv[2], later)) {
+    std::fprintf(stderr, "%s: not a buffer pool snapshot\n", argv[2]);
+    return 1;
+  }
+  if (later.takenAt <= snap.takenAt) {
+    std::fprintf(stderr, "%s was not taken after %s\n", argv[2], argv[1]);
+    return 1;
+  }
+  print(later);
+  printRates(snap, later);
+  return 0;
+}
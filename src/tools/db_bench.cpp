@@ -0,0 +1,323 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Runs benchmarks against a KVStore, one after another on the same store,
+ * and prints for each the operations per second and the latency
+ * percentiles of single operations:
+ *
+ * - fillseq:    writes <num> keys in order into a new store.
+ * - fillrandom: writes <num> keys in random order into a new store.
+ * - overwrite:  writes <num> random keys into the store.
+ * - readrandom: looks up <reads> random keys.
+ * - readseq:    scans up to <reads> keys in order.
+ * - stats:      prints the counters and levels of the store.
+ *
+ * Keys are 16 digits; random keys are drawn from [0, num), so a random fill
+ * writes some keys twice and leaves others out.  The store's files start
+ * with <db>, which may be "mem:..." to keep them in memory; it is removed
+ * when done.
+ *
+ * Usage: db_bench [--benchmarks=fillseq,fillrandom,...] [--num=N]
+ *                 [--reads=N] [--value_size=N] [--db=name] [--sync=0|1]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kv_store.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Settings from the command line.
+ */
+struct Flags {
+  std::string benchmarks;
+  long num;
+  long reads;
+  long value_size;
+  std::string db;
+  bool sync;
+
+  Flags()
+      : benchmarks("fillseq,fillrandom,overwrite,readrandom,readseq,stats"),
+        num(1000000),
+        reads(-1),
+        value_size(100),
+        db("dbbench"),
+        sync(false) {}
+};
+
+/**
+ * Sets <value> to the part of <arg> after "--<name>=" if it starts so.
+ */
+bool parseFlag(const char* arg, const char* name, std::string& value) {
+  const std::size_t length = std::strlen(name);
+  if (std::strncmp(arg, "--", 2) != 0 ||
+      std::strncmp(arg + 2, name, length) != 0 || arg[2 + length] != '=') {
+    return false;
+  }
+  value = arg + 3 + length;
+  return true;
+}
+
+/**
+ * Returns the key of number <i>.
+ */
+std::string makeKey(const long i) {
+  char key[32];
+  std::snprintf(key, sizeof(key), "%016ld", i);
+  return key;
+}
+
+/**
+ * Times single operations of one benchmark and prints the result.
+ */
+class Stats {
+ public:
+  Stats() : bytes_(0), start_(Clock::now()), last_(start_) {
+    latencies_.reserve(1 << 20);
+  }
+
+  /**
+   * Records an operation that ended now and moved <bytes> of keys and values.
+   */
+  void finishOp(const std::size_t bytes) {
+    const Clock::time_point now = Clock::now();
+    latencies_.push_back(
+        std::chrono::duration<double, std::micro>(now - last_).count());
+    bytes_ += bytes;
+    last_ = now;
+  }
+
+  /**
+   * Prints the rates and latency percentiles under <name>, with <note>.
+   */
+  void report(const std::string& name, const std::string& note) {
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start_).count();
+    const std::size_t ops = latencies_.size();
+    std::printf("%-12s: %9.3f micros/op; %10.0f ops/sec;", name.c_str(),
+                ops == 0 ? 0 : seconds * 1e6 / ops,
+                ops == 0 ? 0 : ops / seconds);
+    if (bytes_ > 0) {
+      std::printf(" %7.1f MB/s;", bytes_ / 1048576.0 / seconds);
+    }
+    std::sort(latencies_.begin(), latencies_.end());
+    std::printf(" p50 %.2f p99 %.2f p99.9 %.2f max %.2f us", percentile(50),
+                percentile(99), percentile(99.9),
+                ops == 0 ? 0 : latencies_.back());
+    if (!note.empty()) {
+      std::printf(" (%s)", note.c_str());
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  double percentile(const double p) const {
+    if (latencies_.empty()) {
+      return 0;
+    }
+    std::size_t index = static_cast<std::size_t>(p / 100 * latencies_.size());
+    if (index >= latencies_.size()) {
+      index = latencies_.size() - 1;
+    }
+    return latencies_[index];
+  }
+
+  std::vector<double> latencies_;
+  std::uint64_t bytes_;
+  Clock::time_point start_;
+  Clock::time_point last_;
+};
+
+/**
+ * Runs the benchmarks named in the flags.
+ */
+class Benchmark {
+ public:
+  explicit Benchmark(const Flags& flags)
+      : flags_(flags), value_(flags.value_size, 'x'), random_(301) {
+    options_.sync_log = flags.sync;
+    KVStore::destroy(flags_.db);
+  }
+
+  ~Benchmark() {
+    store_.reset();
+    KVStore::destroy(flags_.db);
+  }
+
+  /**
+   * Runs the benchmark <name>; returns false if there is none so named.
+   */
+  bool run(const std::string& name) {
+    Stats stats;
+    std::string note;
+    if (name == "fillseq") {
+      open(true);
+      write(false, stats);
+    } else if (name == "fillrandom") {
+      open(true);
+      write(true, stats);
+    } else if (name == "overwrite") {
+      open(false);
+      write(true, stats);
+    } else if (name == "readrandom") {
+      open(false);
+      readRandom(stats, note);
+    } else if (name == "readseq") {
+      open(false);
+      readSequential(stats);
+    } else if (name == "stats") {
+      open(false);
+      printStats();
+      return true;
+    } else {
+      return false;
+    }
+    stats.report(name, note);
+    return true;
+  }
+
+ private:
+  /**
+   * Opens the store unless it is open, emptying it first if <fresh>.
+   */
+  void open(const bool fresh) {
+    if (fresh) {
+      store_.reset();
+      KVStore::destroy(flags_.db);
+    }
+    if (!store_) {
+      store_.reset(new KVStore(flags_.db, options_));
+    }
+  }
+
+  void write(const bool random, Stats& stats) {
+    for (long i = 0; i < flags_.num; ++i) {
+      const long k = random ? random_() % flags_.num : i;
+      const std::string key = makeKey(k);
+      store_->put(key, value_);
+      stats.finishOp(key.length() + value_.length());
+    }
+  }
+
+  void readRandom(Stats& stats, std::string& note) {
+    const long reads = flags_.reads < 0 ? flags_.num : flags_.reads;
+    long found = 0;
+    std::string value;
+    for (long i = 0; i < reads; ++i) {
+      const std::string key = makeKey(random_() % flags_.num);
+      if (store_->get(key, value) == STATUS_OK) {
+        ++found;
+      }
+      stats.finishOp(0);
+    }
+    std::ostringstream out;
+    out << found << " of " << reads << " found";
+    note = out.str();
+  }
+
+  void readSequential(Stats& stats) {
+    const long reads = flags_.reads < 0 ? flags_.num : flags_.reads;
+    long visited = 0;
+    store_->scan(std::string(), std::string(),
+                 [&](const std::string& key, const std::string& value) {
+                   stats.finishOp(key.length() + value.length());
+                   return ++visited < reads;
+                 });
+  }
+
+  void printStats() {
+    const LsmStats stats = store_->stats();
+    std::printf("writes %llu  gets %llu  memtable hits %llu  run reads %llu  "
+                "filter skips %llu\n",
+                static_cast<unsigned long long>(stats.writes),
+                static_cast<unsigned long long>(stats.gets),
+                static_cast<unsigned long long>(stats.memtable_hits),
+                static_cast<unsigned long long>(stats.run_reads),
+                static_cast<unsigned long long>(stats.filter_skips));
+    std::printf("flushes %llu (%.1f MB)  compactions %llu (%.1f MB)  "
+                "write stalls %llu\n",
+                static_cast<unsigned long long>(stats.flushes),
+                stats.bytes_flushed / 1048576.0,
+                static_cast<unsigned long long>(stats.compactions),
+                stats.bytes_compacted / 1048576.0,
+                static_cast<unsigned long long>(stats.write_stalls));
+    std::printf("level  runs        MB\n");
+    for (std::size_t level = 0; level < stats.level_runs.size(); ++level) {
+      if (stats.level_runs[level] > 0) {
+        std::printf("%5zu %5zu %9.1f\n", level, stats.level_runs[level],
+                    stats.level_bytes[level] / 1048576.0);
+      }
+    }
+  }
+
+  const Flags flags_;
+  const std::string value_;
+  LsmOptions options_;
+  std::mt19937_64 random_;
+  std::unique_ptr<KVStore> store_;
+};
+
+}
+
+int main(int argc, char** argv) {
+  Flags flags;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (parseFlag(argv[i], "benchmarks", value)) {
+      flags.benchmarks = value;
+    } else if (parseFlag(argv[i], "num", value)) {
+      flags.num = std::atol(value.c_str());
+    } else if (parseFlag(argv[i], "reads", value)) {
+      flags.reads = std::atol(value.c_str());
+    } else if (parseFlag(argv[i], "value_size", value)) {
+      flags.value_size = std::atol(value.c_str());
+    } else if (parseFlag(argv[i], "db", value)) {
+      flags.db = value;
+    } else if (parseFlag(argv[i], "sync", value)) {
+      flags.sync = std::atoi(value.c_str()) != 0;
+    } else {
+      std::fprintf(stderr, "%s: unknown flag %s\n", argv[0], argv[i]);
+      return 2;
+    }
+  }
+  if (flags.num <= 0 || flags.value_size < 0) {
+    std::fprintf(stderr, "%s: --num must be positive and --value_size not "
+                 "negative\n", argv[0]);
+    return 2;
+  }
+
+  std::printf("keys: 16 bytes, values: %ld bytes, entries: %ld, db: %s\n",
+              flags.value_size, flags.num, flags.db.c_str());
+  Benchmark benchmark(flags);
+  std::stringstream names(flags.benchmarks);
+  std::string name;
+  while (std::getline(names, name, ',')) {
+    if (!name.empty() && !benchmark.run(name)) {
+      std::fprintf(stderr, "%s: unknown benchmark %s\n", argv[0],
+                   name.c_str());
+      return 2;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace badgerdb {
+
+namespace {
+
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  std::uint64_t start_ns;
+  std::uint64_t end_ns;
+};
+
+/**
+ * Ring buffer of one thread.  Only its thread appends, so the mutex is
+ * uncontended except while spans are exported or cleared.
+ */
+struct ThreadBuffer {
+  std::mutex mutex;
+  std::uint32_t tid;
+  std::vector<TraceEvent> events;
+
+  /**
+   * Number of spans ever appended; the next one goes to next % capacity.
+   */
+  std::uint64_t next;
+};
+
+/**
+ * Buffers of all threads that ever recorded a span.
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+
+  /**
+   * Timestamp exported spans are relative to.
+   */
+  std::uint64_t epoch_ns;
+
+  Registry() : epoch_ns(Tracer::now()) {}
+};
+
+Registry& registry() {
+  static Registry instance;
+  return instance;
+}
+
+thread_local ThreadBuffer* this_thread_buffer = NULL;
+
+ThreadBuffer& threadBuffer() {
+  if (this_thread_buffer == NULL) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.mutex);
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+    buffer->tid = reg.buffers.size() + 1;
+    buffer->events.resize(Tracer::RING_CAPACITY);
+    buffer->next = 0;
+    this_thread_buffer = buffer.get();
+    reg.buffers.push_back(std::move(buffer));
+  }
+  return *this_thread_buffer;
+}
+
+void writeJsonString(std::ostream& out, const char* text) {
+  out << '"';
+  for (const char* c = text; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      out << '\\';
+    }
+    out << *c;
+  }
+  out << '"';
+}
+
+}
+
+const std::size_t Tracer::RING_CAPACITY;
+
+std::atomic<int> Tracer::level_(TRACE_OFF);
+std::atomic<std::uint32_t> Tracer::sample_interval_(1);
+thread_local std::uint32_t Tracer::sample_counter_ = 0;
+
+void Tracer::record(const char* category, const char* name,
+                    const std::uint64_t start_ns, const std::uint64_t end_ns) {
+  ThreadBuffer& buffer = threadBuffer();
+  std::lock_guard<std::mutex> guard(buffer.mutex);
+  TraceEvent& event = buffer.events[buffer.next % RING_CAPACITY];
+  event.category = category;
+  event.name = name;
+  event.start_ns = start_ns;
+  event.end_ns = end_ns;
+  ++buffer.next;
+}
+
+void Tracer::exportChromeJson(std::ostream& out) {
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> guard(reg.mutex);
+  std::uint64_t dropped = 0;
+  bool first = true;
+  char number[64];
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (std::size_t b = 0; b < reg.buffers.size(); ++b) {
+    ThreadBuffer& buffer = *reg.buffers[b];
+    std::lock_guard<std::mutex> buffer_guard(buffer.mutex);
+    out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+        << "\"pid\":1,\"tid\":" << buffer.tid
+        << ",\"args\":{\"name\":\"thread " << buffer.tid << "\"}}";
+    first = false;
+
+    // Oldest surviving span first.
+    std::uint64_t begin = 0;
+    if (buffer.next > RING_CAPACITY) {
+      begin = buffer.next - RING_CAPACITY;
+      dropped += begin;
+    }
+    for (std::uint64_t i = begin; i < buffer.next; ++i) {
+      const TraceEvent& event = buffer.events[i % RING_CAPACITY];
+      out << ",\n{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"cat\":";
+      writeJsonString(out, event.category);
+      // Chrome trace timestamps are in microseconds.
+      // Spans started just before the registry existed get negative times.
+      std::snprintf(number, sizeof(number), "%.3f",
+                    static_cast<std::int64_t>(event.start_ns - reg.epoch_ns) /
+                        1e3);
+      out << ",\"ph\":\"X\",\"ts\":" << number;
+      std::snprintf(number, sizeof(number), "%.3f",
+                    (event.end_ns - event.start_ns) / 1e3);
+      out << ",\"dur\":" << number << ",\"pid\":1,\"tid\":" << buffer.tid
+          << "}";
+    }
+  }
+  out << "\n],\"otherData\":{\"dropped_spans\":" << dropped << "}}\n";
+}
+
+std::size_t Tracer::recordedSpans() {
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> guard(reg.mutex);
+  std::size_t spans = 0;
+  for (std::size_t b = 0; b < reg.buffers.size(); ++b) {
+    std::lock_guard<std::mutex> buffer_guard(reg.buffers[b]->mutex);
+    spans += std::min<std::uint64_t>(reg.buffers[b]->next, RING_CAPACITY);
+  }
+  return spans;
+}
+
+std::uint64_t Tracer::droppedSpans() {
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> guard(reg.mutex);
+  std::uint64_t dropped = 0;
+  for (std::size_t b = 0; b < reg.buffers.size(); ++b) {
+    std::lock_guard<std::mutex> buffer_guard(reg.buffers[b]->mutex);
+    if (reg.buffers[b]->next > RING_CAPACITY) {
+      dropped += reg.buffers[b]->next - RING_CAPACITY;
+    }
+  }
+  return dropped;
+}
+
+void Tracer::clear() {
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> guard(reg.mutex);
+  for (std::size_t b = 0; b < reg.buffers.size(); ++b) {
+    std::lock_guard<std::mutex> buffer_guard(reg.buffers[b]->mutex);
+    reg.buffers[b]->next = 0;
+  }
+}
+
+}
@@ -0,0 +1,220 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <stdint.h>
+
+namespace badgerdb {
+
+/**
+ * Detail of tracing, from nothing to every traced span.  A span is recorded
+ * if its level is at most the current level.
+ */
+enum TraceLevel {
+  /**
+   * Nothing is recorded.
+   */
+  TRACE_OFF = 0,
+
+  /**
+   * Buffer manager calls and file I/O.
+   */
+  TRACE_IO = 1,
+
+  /**
+   * Also frame allocation and record operations on pages.
+   */
+  TRACE_ALL = 2
+};
+
+/**
+ * @brief Collects timed spans into per-thread ring buffers.
+ *
+ * Spans are recorded with the BADGERDB_TRACE_SPAN macro, which expands to
+ * nothing unless the code is compiled with BADGERDB_TRACE defined, so tracing
+ * costs nothing in a normal build.  When compiled in, tracing starts out at
+ * TRACE_OFF and a span costs one relaxed atomic load until the level is
+ * raised.  With sampling, only every n-th eligible span of a thread is
+ * recorded.
+ *
+ * Each thread records into its own ring buffer, which keeps the most recent
+ * RING_CAPACITY spans and counts the ones it overwrote.  Buffers outlive their
+ * threads, so spans of finished threads can still be exported.
+ *
+ * exportChromeJson() writes everything recorded as Chrome trace JSON, which
+ * chrome://tracing and Perfetto can load.
+ */
+class Tracer {
+ public:
+  /**
+   * Number of spans each thread's ring buffer holds.
+   */
+  static const std::size_t RING_CAPACITY = 64 * 1024;
+
+  /**
+   * Sets the level of detail.  Takes effect for spans started afterwards.
+   *
+   * @param level Level of detail.
+   */
+  static void setLevel(const TraceLevel level) {
+    level_.store(level, std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns the level of detail.
+   */
+  static TraceLevel level() {
+    return static_cast<TraceLevel>(level_.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Records only every <every>-th eligible span of each thread.
+   *
+   * @param every Sampling interval; 0 and 1 record every span.
+   */
+  static void setSampleInterval(const std::uint32_t every) {
+    sample_interval_.store(every, std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns true if a span at <level> should be recorded now.  Advances the
+   * sampling counter of the calling thread.
+   *
+   * @param level Level of the span.
+   */
+  static bool shouldRecord(const int level) {
+    if (level > level_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    const std::uint32_t every =
+        sample_interval_.load(std::memory_order_relaxed);
+    return every <= 1 || ++sample_counter_ % every == 0;
+  }
+
+  /**
+   * Returns a monotonic timestamp in nanoseconds.
+   */
+  static std::uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * Appends a finished span to the calling thread's ring buffer.
+   *
+   * @param category  Category of the span; must be a string literal.
+   * @param name      Name of the span; must be a string literal.
+   * @param start_ns  Timestamp the span started at.
+   * @param end_ns    Timestamp the span ended at.
+   */
+  static void record(const char* category, const char* name,
+                     const std::uint64_t start_ns, const std::uint64_t end_ns);
+
+  /**
+   * Writes all recorded spans as Chrome trace JSON.  Safe to call while
+   * other threads are recording.
+   *
+   * @param out Stream to write to.
+   */
+  static void exportChromeJson(std::ostream& out);
+
+  /**
+   * Returns the number of spans held in the ring buffers.
+   */
+  static std::size_t recordedSpans();
+
+  /**
+   * Returns the number of spans lost because a ring buffer was full.
+   */
+  static std::uint64_t droppedSpans();
+
+  /**
+   * Discards all recorded spans.
+   */
+  static void clear();
+
+ private:
+  /**
+   * Current level of detail.
+   */
+  static std::atomic<int> level_;
+
+  /**
+   * Current sampling interval.
+   */
+  static std::atomic<std::uint32_t> sample_interval_;
+
+  /**
+   * Number of eligible spans the calling thread has started.
+   */
+  static thread_local std::uint32_t sample_counter_;
+};
+
+/**
+ * @brief Records the time from its construction to its destruction as a span,
+ * if the span is selected by the current level and sampling.
+ */
+class TraceSpan {
+ public:
+  /**
+   * Starts the span.
+   *
+   * @param level     Level of the span.
+   * @param category  Category of the span; must be a string literal.
+   * @param name      Name of the span; must be a string literal.
+   */
+  TraceSpan(const int level, const char* category, const char* name)
+      : category_(category),
+        name_(Tracer::shouldRecord(level) ? name : NULL),
+        start_ns_(name_ != NULL ? Tracer::now() : 0) {
+  }
+
+  /**
+   * Ends the span and records it.
+   */
+  ~TraceSpan() {
+    if (name_ != NULL) {
+      Tracer::record(category_, name_, start_ns_, Tracer::now());
+    }
+  }
+
+ private:
+  TraceSpan(const TraceSpan&);
+  TraceSpan& operator=(const TraceSpan&);
+
+  const char* const category_;
+
+  /**
+   * Name of the span, or NULL if it is not recorded.
+   */
+  const char* const name_;
+
+  const std::uint64_t start_ns_;
+};
+
+}
+
+#define BADGERDB_TRACE_CONCAT_INNER(a, b) a##b
+#define BADGERDB_TRACE_CONCAT(a, b) BADGERDB_TRACE_CONCAT_INNER(a, b)
+
+/**
+ * Traces the rest of the enclosing scope as a span named <name> in
+ * <category> at TraceLevel <level>.  Expands to nothing unless BADGERDB_TRACE
+ * is defined.
+ */
+#ifdef BADGERDB_TRACE
+#define BADGERDB_TRACE_SPAN(level, category, name)                        \
+  ::badgerdb::TraceSpan BADGERDB_TRACE_CONCAT(badgerdb_trace_span_,       \
+                                              __LINE__)(level, category, name)
+#else
+#define BADGERDB_TRACE_SPAN(level, category, name) do {} while (0)
+#endif